@@ -13,6 +13,9 @@
 #   <matrix type> is the matrix type, i.e., dense or sparse
 #   <sample dimension> is the dimension of each sample for the input
 #
+# For large inputs, prefer the CNTK "convertToBinary" action, which parses
+# the input on several threads.
+#
 
 import sys
 import argparse
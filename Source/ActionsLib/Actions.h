@@ -57,6 +57,10 @@ void DoWriteOutput(const ConfigParameters& config);
 template <typename ElemType>
 void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
+void DoBuildIndex(const ConfigParameters& config);
+template <typename ElemType>
+void DoConvertToBinaryFormat(const ConfigParameters& config);
+template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
@@ -16,6 +16,7 @@
 #include "Config.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
+#include "MPIWrapper.h"
 
 #include <string>
 #include <chrono>
@@ -26,6 +27,7 @@
 #include <set>
 #include <memory>
 #include <map>
+#include <type_traits>
 
 #ifndef let
 #define let const auto
@@ -112,6 +114,77 @@ void DoCreateLabelMap(const ConfigParameters& config)
 template void DoCreateLabelMap<float>(const ConfigParameters& config);
 template void DoCreateLabelMap<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoBuildIndex() - implements CNTK "buildIndex" command
+// Indexes the input files of a reader and writes the index cache files
+// (see the 'cacheIndex' reader option), so that the training does not have
+// to scan large inputs before it can start.
+// ===========================================================================
+
+template <typename ElemType>
+void DoBuildIndex(const ConfigParameters& config)
+{
+    // this gets the section name we are interested in
+    std::string section = config(L"section");
+    // get that section (probably a peer config section, which works thanks to heirarchal symbol resolution)
+    ConfigParameters configSection(config(section));
+    ConfigParameters readerConfig(configSection("reader"));
+    // the cache has to be complete before this command returns
+    readerConfig.Insert("cacheIndex", "true");
+    readerConfig.Insert("cacheIndexAsync", "false");
+    int traceLevel = config(L"traceLevel", 0);
+
+    auto start = std::chrono::system_clock::now();
+
+    // the readers index their inputs upon initialization
+    DataReader dataReader(readerConfig);
+
+    auto elapsed = std::chrono::system_clock::now() - start;
+    if (traceLevel > 0)
+        fprintf(stderr, "BuildIndex: %f seconds elapsed\n", (float) (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()) / 1000);
+}
+
+template void DoBuildIndex<float>(const ConfigParameters& config);
+template void DoBuildIndex<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoConvertToBinaryFormat() - implements CNTK "convertToBinary" command
+// Converts the input of a CNTKTextFormatReader section into the CNTK binary
+// format (CBF) that is read by the CNTKBinaryReader. The reader section takes
+// the additional options 'outputFile', 'compressChunks' and, per input stream,
+// 'outputFormat' and 'halfPrecision'.
+// ===========================================================================
+
+template <typename ElemType>
+void DoConvertToBinaryFormat(const ConfigParameters& config)
+{
+    // all workers would write the same output file, so only the main node converts
+    auto mpi = MPIWrapper::GetInstance();
+    if (mpi && !mpi->IsMainNode())
+        return;
+
+    // this gets the section name we are interested in
+    std::string section = config(L"section");
+    // get that section (probably a peer config section, which works thanks to heirarchal symbol resolution)
+    ConfigParameters configSection(config(section));
+    ConfigParameters readerConfig(configSection("reader"));
+    readerConfig.Insert("precision", std::is_same<ElemType, double>::value ? "double" : "float");
+    if (config.ExistsCurrent(L"outputFile"))
+        readerConfig.Insert("outputFile", config(L"outputFile"));
+    if (config.ExistsCurrent(L"chunkSizeInBytes"))
+        readerConfig.Insert("chunkSizeInBytes", config(L"chunkSizeInBytes"));
+    if (config.ExistsCurrent(L"compressChunks"))
+        readerConfig.Insert("compressChunks", config(L"compressChunks"));
+
+    typedef void (*ConvertToBinaryFormatProc)(const ConfigParameters& config);
+    Plugin plugin;
+    ConvertToBinaryFormatProc convert = (ConvertToBinaryFormatProc)plugin.Load(L"CNTKBinaryReader", "ConvertToBinaryFormat");
+    convert(readerConfig);
+}
+
+template void DoConvertToBinaryFormat<float>(const ConfigParameters& config);
+template void DoConvertToBinaryFormat<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoParameterSVD() - implements CNTK "SVD" command
 // ===========================================================================
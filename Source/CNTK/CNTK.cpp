@@ -24,6 +24,7 @@
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "CommonMatrix.h"
+#include "ConvolutionEngine.h" // used for SetConvolutionTuningCachePath()
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "EnvironmentUtil.h"
@@ -37,6 +38,7 @@
 #include "BrainScriptEvaluator.h"
 #include "BrainScriptParser.h"
 #include "PerformanceProfiler.h"
+#include "NodeProfiler.h"
 #include "CNTKLibrary.h"
 
 #include <string>
@@ -85,6 +87,40 @@ void SetupProfiling(ProfilerContext& profilerContext, const ConfigParamType& con
     }
 }
 
+// Per-node profiling; the summary and the trace are written when the context goes out of scope
+struct NodeProfilerContext
+{
+    wstring traceFile;
+
+    ~NodeProfilerContext()
+    {
+        if (!Globals::ShouldEnableNodeProfiling())
+            return;
+        try
+        {
+            NodeProfiler::PrintSummary(stderr);
+            NodeProfiler::WriteChromeTrace(traceFile);
+        }
+        catch (const exception& e)
+        {
+            fprintf(stderr, "NodeProfiler: WARNING: Failed to write the node profile: %s\n", e.what());
+        }
+    }
+};
+
+template <typename ConfigParamType>
+void SetupNodeProfiling(NodeProfilerContext& nodeProfilerContext, const ConfigParamType& config, int nodeRank)
+{
+    if (config(L"nodeProfilerEnabled", false))
+    {
+        wstring workDir = config(L"WorkDir", L".");
+        wstring traceFile = config(L"nodeProfilerTraceFile", L"");
+        nodeProfilerContext.traceFile = traceFile.empty() ? workDir + L"/nodeProfile." + std::to_wstring(nodeRank) + L".json" : traceFile;
+        NodeProfiler::SetMaxTraceEvents(config(L"nodeProfilerMaxTraceEvents", (size_t)1000000));
+        Globals::SetNodeProfiling(true);
+    }
+}
+
 void RedirectStdErr(wstring logpath, bool appendLogFile = false)
 {
     // TODO: if there is already a file, rename it
@@ -321,6 +357,14 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoCreateLabelMap<ElemType>(commandParams);
                 }
+                else if (thisAction == "buildIndex")
+                {
+                    DoBuildIndex<ElemType>(commandParams);
+                }
+                else if (thisAction == "convertToBinary")
+                {
+                    DoConvertToBinaryFormat<ElemType>(commandParams);
+                }
                 else if (thisAction == "writeWordAndClass")
                 {
                     DoWriteWordAndClassInfo<ElemType>(commandParams);
@@ -465,6 +509,10 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
 
+    wstring convolutionTuningCache = config(L"convolutionTuningCache", L"");
+    if (!convolutionTuningCache.empty())
+        SetConvolutionTuningCachePath(convolutionTuningCache);
+
 #ifndef CPUONLY
     auto valpp = config.Find(L"deviceId");
     if (valpp)
@@ -504,6 +552,7 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetNodeExecutionThreads(config(L"nodeExecutionThreads", (size_t)0));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
@@ -527,6 +576,8 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     // Setup profiling
     ProfilerContext profilerContext;
     SetupProfiling(profilerContext, config, paralleltrain ? (int)mpi->CurrentNodeRank() : 0);
+    NodeProfilerContext nodeProfilerContext;
+    SetupNodeProfiling(nodeProfilerContext, config, paralleltrain ? (int)mpi->CurrentNodeRank() : 0);
 
     // execute the actions
     // std::string type = config(L"precision", "float");
@@ -634,6 +685,10 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
     if (config(L"forceConstantRandomSeed", false))
         Globals::ForceConstantRandomSeed();
 
+    wstring convolutionTuningCache = config(L"convolutionTuningCache", L"");
+    if (!convolutionTuningCache.empty())
+        SetConvolutionTuningCachePath(convolutionTuningCache);
+
     // get the command param set they want
     wstring logpath = config(L"stderr", L"");
 
@@ -656,6 +711,7 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetNodeExecutionThreads(config(L"nodeExecutionThreads", (size_t)0));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
@@ -728,6 +784,8 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
     // Setup profiling
     ProfilerContext profilerContext;
     SetupProfiling(profilerContext, config, paralleltrain ? (int)mpi->CurrentNodeRank() : 0);
+    NodeProfilerContext nodeProfilerContext;
+    SetupNodeProfiling(nodeProfilerContext, config, paralleltrain ? (int)mpi->CurrentNodeRank() : 0);
 
     // run commands
     std::string type = config(L"precision", "float");
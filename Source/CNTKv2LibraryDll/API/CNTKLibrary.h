@@ -670,6 +670,7 @@ namespace CNTK
         friend class BlockMomentumDistributedLearner;
         friend class Internal::VariableResolver;
         friend class Trainer;
+        friend class Serializer;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -998,6 +999,11 @@ namespace CNTK
     private:
         CNTK_API NDArrayView(::CNTK::DataType dataType, const DeviceDescriptor& device, ::CNTK::StorageFormat storageType, const NDShape& viewShape, bool readOnly, void* tensorView);
 
+        // Same as Alias(), but returns a raw object that the caller owns and takes the read-only flag of the alias as is.
+        NDArrayView* NewAlias(bool readOnly) const;
+
+        bool IsMapped() const { return m_mappedStorage != nullptr; }
+
         template <typename ElementType>
         static std::shared_ptr<Microsoft::MSR::CNTK::Matrix<ElementType>> GetMatrixImpl(const Microsoft::MSR::CNTK::TensorView<ElementType>* tensorView, size_t rowColSplitPoint);
 
@@ -1025,6 +1031,7 @@ namespace CNTK
         bool m_isReadOnly;
 
         std::shared_ptr<void> m_tensorView; // Microsoft::MSR::CNTK::TensorView<ElemType>*
+        std::shared_ptr<void> m_mappedStorage; // Memory-mapped model file backing the view, if any (see ModelFormat::CNTKv2Mapped)
     };
 
     enum class MaskKind : char
@@ -3161,6 +3168,14 @@ namespace CNTK
         /// ONNX support limited subset of CNTK.
         ///
         ONNX,
+
+        ///
+        /// CNTK version 2 format with the values of Parameters and Constants stored as aligned raw blobs.
+        /// Loading memory-maps the file on the CPU instead of parsing and copying the values, so that
+        /// processes loading the same model share its pages. On Windows a model cannot be saved to a file
+        /// that a loaded model is mapped from.
+        ///
+        CNTKv2Mapped,
     };
 
 
@@ -5454,6 +5469,13 @@ namespace CNTK
 
     CNTK_API DistributedLearnerPtr CreateQuantizedDataParallelDistributedLearner(QuantizedDistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributeAfterSamples, bool useAsyncBufferedParameterUpdate = false);
 
+    ///
+    /// Data parallel distributed learner that exchanges only the topKRatio largest values of each gradient
+    /// (or the values whose magnitude is at least 'threshold' if topKRatio is 0) and accumulates the other values
+    /// locally, adding them to the gradients of the following minibatches.
+    ///
+    CNTK_API DistributedLearnerPtr CreateSparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributeAfterSamples, double topKRatio, double threshold = 0);
+
     CNTK_API DistributedLearnerPtr CreateBlockMomentumDistributedLearner(
         DistributedCommunicatorPtr communicator,
         LearnerPtr learner,
@@ -5585,6 +5607,115 @@ namespace CNTK
     ///
     CNTK_API EvaluatorPtr CreateEvaluator(const FunctionPtr& evaluationFunction, const std::vector<ProgressWriterPtr>& progressWriters = {});
 
+    ///
+    /// Parameters of the beam search of a BeamSearchDecoder.
+    ///
+    struct BeamSearchOptions
+    {
+        ///
+        /// Number of hypotheses that are extended at each step for each sequence, and number of results returned for each sequence.
+        ///
+        size_t beamWidth = 5;
+
+        ///
+        /// Maximum number of tokens of a result, including the end token.
+        ///
+        size_t maxLength = 100;
+
+        ///
+        /// Exponent of the length normalization: the score of a hypothesis is its log-probability divided by ((5 + length) / 6)^lengthPenalty.
+        /// 0 ranks the hypotheses by their log-probability, larger values favor longer hypotheses.
+        ///
+        double lengthPenalty = 0;
+
+        ///
+        /// If true, the search of a sequence stops as soon as 'beamWidth' hypotheses have ended. Otherwise it stops when
+        /// none of the hypotheses that are still extended can reach the score of the 'beamWidth'-th best ended one,
+        /// which gives the exact result of the beam search.
+        ///
+        bool earlyStopping = false;
+    };
+
+    ///
+    /// A result of a BeamSearchDecoder.
+    ///
+    struct BeamSearchHypothesis
+    {
+        ///
+        /// Generated tokens, without the start and the end token.
+        ///
+        std::vector<size_t> tokens;
+
+        ///
+        /// Log-probability of the tokens including the end token, and the length normalized score the results are ordered by.
+        ///
+        double logProbability;
+        double score;
+    };
+
+    ///
+    /// BeamSearchDecoder generates output sequences of a sequence-to-sequence model with beam search.
+    ///
+    /// The model is given as a step Function that computes a single output step of a batch of hypotheses. Its arguments are
+    /// the previous token (a one-hot vector), the recurrent state inputs, and context inputs such as the encoder output, all with
+    /// the batch axis as their only dynamic axis except for the context inputs, which may also have a sequence axis.
+    /// Its outputs are the log-probabilities of the next token and the new value of each recurrent state input.
+    ///
+    /// The hypotheses of all sequences are evaluated together as one minibatch at each step. The recurrent state of a hypothesis
+    /// is the output of the previous step, so a step costs the same regardless of the length of the hypotheses.
+    ///
+    class BeamSearchDecoder : public std::enable_shared_from_this<BeamSearchDecoder>
+    {
+    public:
+        ///
+        /// Decodes a batch of sequences. 'initialStates' holds for some of the state inputs their value at the first step as
+        /// one sample per sequence, the other state inputs start at zero. 'contexts' holds one sample (or sequence) per sequence
+        /// for each context input. Returns for each sequence up to 'beamWidth' results, best first.
+        ///
+        CNTK_API std::vector<std::vector<BeamSearchHypothesis>> Decode(const std::unordered_map<Variable, ValuePtr>& initialStates,
+                                                                       const std::unordered_map<Variable, ValuePtr>& contexts,
+                                                                       const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice());
+
+        ///
+        /// Step Function that is used for decoding.
+        ///
+        FunctionPtr StepFunction() const { return m_stepFunction; }
+
+        CNTK_API virtual ~BeamSearchDecoder() {}
+
+    private:
+        template <typename T1, typename ...CtorArgTypes>
+        friend std::shared_ptr<T1> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+        BeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                          const std::vector<std::pair<Variable, Variable>>& stateFeedback, size_t startToken, size_t endToken,
+                          const BeamSearchOptions& options);
+
+        template <typename ElementType>
+        std::vector<std::vector<BeamSearchHypothesis>> Decode(const std::unordered_map<Variable, ValuePtr>& initialStates,
+                                                              const std::unordered_map<Variable, ValuePtr>& contexts,
+                                                              const DeviceDescriptor& computeDevice);
+
+        FunctionPtr m_stepFunction;
+        Variable m_tokenInput;
+        Variable m_logProbabilities;
+        std::vector<std::pair<Variable, Variable>> m_stateFeedback;
+        size_t m_vocabularySize;
+        size_t m_startToken;
+        size_t m_endToken;
+        BeamSearchOptions m_options;
+    };
+
+    ///
+    /// Construct a BeamSearchDecoder for the specified step Function. 'tokenInput' is the argument of 'stepFunction' that takes
+    /// the previous token, 'logProbabilities' its output with the log-probabilities of the next token, and 'stateFeedback' pairs
+    /// each output with the new value of a recurrent state with the argument that takes it at the next step.
+    /// The first step of each sequence gets 'startToken', a hypothesis ends with 'endToken'.
+    ///
+    CNTK_API BeamSearchDecoderPtr CreateBeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                                                          const std::vector<std::pair<Variable, Variable>>& stateFeedback, size_t startToken, size_t endToken,
+                                                          const BeamSearchOptions& options = BeamSearchOptions());
+
     enum class DataUnit : unsigned int
     {
         ///Indiciate that the frequency of action is counted by sweep.
@@ -214,6 +214,9 @@ namespace CNTK
     class Evaluator;
     typedef std::shared_ptr<Evaluator> EvaluatorPtr;
 
+    class BeamSearchDecoder;
+    typedef std::shared_ptr<BeamSearchDecoder> BeamSearchDecoderPtr;
+
     class Trainer;
     typedef std::shared_ptr<Trainer> TrainerPtr;
 
@@ -294,6 +297,9 @@ namespace CNTK
 
         CNTK_API void SetMathLibTraceLevel(int traceLevel);
 
+        // Sets the file in which the CPU convolution engine auto-tuner keeps its decisions across runs.
+        CNTK_API void SetConvolutionTuningCachePath(const std::wstring& path);
+
         CNTK_API void ForceDeterministicAlgorithms();
         CNTK_API bool ShouldForceDeterministicAlgorithms();
 
@@ -324,6 +330,16 @@ namespace CNTK
         CNTK_API void EnableNodeTiming();
         CNTK_API void DisableNodeTimeing();
 
+        // Executes independent nodes of networks on the CPU concurrently on the given number of threads (0 or 1 = serial).
+        CNTK_API void SetNodeExecutionThreads(size_t numThreads);
+
+        // Per-node profile of forward and backward propagation: enabling discards earlier recordings,
+        // the profile is printed as a summary sorted by time or written as a Chrome trace (JSON).
+        CNTK_API void EnableNodeProfiling();
+        CNTK_API void DisableNodeProfiling();
+        CNTK_API void PrintNodeProfile();
+        CNTK_API void WriteNodeProfileTrace(const std::wstring& filePath);
+
         CNTK_API void EnableCPUEvalOptimization();
         CNTK_API void DisableCPUEvalOptimization();
 
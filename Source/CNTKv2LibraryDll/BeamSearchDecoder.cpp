@@ -0,0 +1,410 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace CNTK
+{
+    namespace
+    {
+        // A hypothesis that is still extended.
+        struct ActiveHypothesis
+        {
+            std::vector<size_t> tokens;
+            double logProbability;
+        };
+
+        // Search state of one sequence of the batch.
+        struct SequenceSearch
+        {
+            std::vector<ActiveHypothesis> active;
+            std::vector<BeamSearchHypothesis> ended; // best first, at most 'beamWidth'
+            bool done = false;
+        };
+
+        double NormalizedScore(double logProbability, size_t length, double lengthPenalty)
+        {
+            if (lengthPenalty == 0)
+                return logProbability;
+            return logProbability / std::pow((5.0 + length) / 6.0, lengthPenalty);
+        }
+
+        bool HasOnlyBatchAxis(const Variable& variable)
+        {
+            return (variable.DynamicAxes().size() == 1) && (variable.DynamicAxes()[0] == Axis::DefaultBatchAxis());
+        }
+
+        // Number of samples of a value of a variable that has the batch axis as its only dynamic axis.
+        size_t NumSamples(const Variable& variable, const ValuePtr& value)
+        {
+            if (value->IsSparse() || (value->MaskedCount() != 0))
+                InvalidArgument("BeamSearchDecoder: the value of '%S' must be dense and must not have masked samples.", variable.AsString().c_str());
+
+            size_t sampleSize = variable.Shape().TotalSize();
+            size_t valueSize = value->Shape().TotalSize();
+            if ((sampleSize == 0) || (valueSize % sampleSize != 0))
+                InvalidArgument("BeamSearchDecoder: the shape '%S' of the value of '%S' does not match the shape of the variable.",
+                                value->Shape().AsString().c_str(), variable.AsString().c_str());
+            return valueSize / sampleSize;
+        }
+
+        // Returns the samples at 'indices' of a batch of samples on 'device'. Samples are copied one by one, the batches are
+        // small (beam width times number of sequences) and a sample is usually a vector, so this avoids a trip to the CPU.
+        NDArrayViewPtr GatherSamples(const NDArrayViewPtr& samples, const NDShape& sampleShape, const std::vector<size_t>& indices, const DeviceDescriptor& device)
+        {
+            size_t numSamples = samples->Shape().TotalSize() / sampleShape.TotalSize();
+            auto source = samples->AsShape(sampleShape.AppendShape({ numSamples }));
+            if (source->Device() != device)
+                source = source->DeepClone(device, true);
+
+            auto result = MakeSharedObject<NDArrayView>(samples->GetDataType(), sampleShape.AppendShape({ indices.size() }), device);
+            std::vector<size_t> extent = sampleShape.Dimensions();
+            extent.push_back(1);
+            std::vector<size_t> sourceOffset(extent.size(), 0), resultOffset(extent.size(), 0);
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                sourceOffset.back() = indices[i];
+                resultOffset.back() = i;
+                result->SliceView(resultOffset, extent)->CopyFrom(*source->SliceView(sourceOffset, extent, true));
+            }
+
+            return result;
+        }
+
+        // Returns the samples (or sequences) at 'indices' of a value of an input of the step function.
+        ValuePtr GatherValue(const Variable& variable, const ValuePtr& value, const std::vector<size_t>& indices, const DeviceDescriptor& device)
+        {
+            if (HasOnlyBatchAxis(variable))
+                return MakeSharedObject<Value>(GatherSamples(value->Data(), variable.Shape(), indices, device));
+
+            auto sequences = value->UnpackVariableValue(variable, device);
+            std::vector<NDArrayViewPtr> gathered(indices.size());
+            for (size_t i = 0; i < indices.size(); i++)
+                gathered[i] = sequences[indices[i]];
+            return Value::Create(variable.Shape(), gathered, device, true);
+        }
+
+        template <typename ElementType>
+        ValuePtr TokenBatch(const Variable& tokenInput, size_t vocabularySize, const std::vector<size_t>& tokens, const DeviceDescriptor& device)
+        {
+            if (tokenInput.IsSparse())
+                return Value::CreateBatch<ElementType>(vocabularySize, tokens, device, true);
+
+            std::vector<ElementType> oneHot(vocabularySize * tokens.size(), 0);
+            for (size_t i = 0; i < tokens.size(); i++)
+                oneHot[i * vocabularySize + tokens[i]] = 1;
+            return Value::CreateBatch<ElementType>(tokenInput.Shape(), oneHot, device, true);
+        }
+
+        void AddEndedHypothesis(SequenceSearch& search, BeamSearchHypothesis&& hypothesis, size_t beamWidth)
+        {
+            auto position = std::find_if(search.ended.begin(), search.ended.end(),
+                                         [&](const BeamSearchHypothesis& other) { return other.score < hypothesis.score; });
+            if ((size_t)(position - search.ended.begin()) >= beamWidth)
+                return;
+
+            search.ended.insert(position, std::move(hypothesis));
+            if (search.ended.size() > beamWidth)
+                search.ended.pop_back();
+        }
+    }
+
+    BeamSearchDecoderPtr CreateBeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                                                 const std::vector<std::pair<Variable, Variable>>& stateFeedback, size_t startToken, size_t endToken,
+                                                 const BeamSearchOptions& options)
+    {
+        return MakeSharedObject<BeamSearchDecoder>(stepFunction, tokenInput, logProbabilities, stateFeedback, startToken, endToken, options);
+    }
+
+    BeamSearchDecoder::BeamSearchDecoder(const FunctionPtr& stepFunction, const Variable& tokenInput, const Variable& logProbabilities,
+                                         const std::vector<std::pair<Variable, Variable>>& stateFeedback, size_t startToken, size_t endToken,
+                                         const BeamSearchOptions& options)
+        : m_stepFunction(stepFunction), m_tokenInput(tokenInput), m_logProbabilities(logProbabilities), m_stateFeedback(stateFeedback),
+          m_vocabularySize(0), m_startToken(startToken), m_endToken(endToken), m_options(options)
+    {
+        if (!m_stepFunction)
+            InvalidArgument("BeamSearchDecoder: the step function is not allowed to be null.");
+
+        if ((options.beamWidth == 0) || (options.maxLength == 0))
+            InvalidArgument("BeamSearchDecoder: the beam width and the maximum length must be positive.");
+
+        auto arguments = m_stepFunction->Arguments();
+        auto outputs = m_stepFunction->Outputs();
+        auto isArgument = [&](const Variable& variable) { return std::find(arguments.begin(), arguments.end(), variable) != arguments.end(); };
+        auto isOutput = [&](const Variable& variable) { return std::find(outputs.begin(), outputs.end(), variable) != outputs.end(); };
+        auto checkBatchAxis = [](const Variable& variable)
+        {
+            if (!HasOnlyBatchAxis(variable))
+                InvalidArgument("BeamSearchDecoder: '%S' must have the batch axis as its only dynamic axis.", variable.AsString().c_str());
+        };
+
+        if (!isArgument(m_tokenInput))
+            InvalidArgument("BeamSearchDecoder: the token input '%S' is not an argument of the step function.", m_tokenInput.AsString().c_str());
+        if (!isOutput(m_logProbabilities))
+            InvalidArgument("BeamSearchDecoder: '%S' is not an output of the step function.", m_logProbabilities.AsString().c_str());
+        checkBatchAxis(m_tokenInput);
+        checkBatchAxis(m_logProbabilities);
+
+        if ((m_logProbabilities.GetDataType() != DataType::Float) && (m_logProbabilities.GetDataType() != DataType::Double))
+            InvalidArgument("BeamSearchDecoder: the data type '%s' of the log-probabilities is not supported.", DataTypeName(m_logProbabilities.GetDataType()));
+
+        m_vocabularySize = m_logProbabilities.Shape().TotalSize();
+        if (m_logProbabilities.Shape().HasUnboundDimension() || (m_tokenInput.Shape().TotalSize() != m_vocabularySize))
+            InvalidArgument("BeamSearchDecoder: the token input '%S' and the log-probabilities '%S' must have the same known size.",
+                            m_tokenInput.AsString().c_str(), m_logProbabilities.AsString().c_str());
+        if ((m_startToken >= m_vocabularySize) || (m_endToken >= m_vocabularySize))
+            InvalidArgument("BeamSearchDecoder: the start token %zu and the end token %zu must be smaller than the vocabulary size %zu.",
+                            m_startToken, m_endToken, m_vocabularySize);
+
+        for (const auto& feedback : m_stateFeedback)
+        {
+            if (!isOutput(feedback.first) || !isArgument(feedback.second))
+                InvalidArgument("BeamSearchDecoder: the state '%S' must be an output and '%S' an argument of the step function.",
+                                feedback.first.AsString().c_str(), feedback.second.AsString().c_str());
+            checkBatchAxis(feedback.first);
+            checkBatchAxis(feedback.second);
+            if (feedback.first.Shape() != feedback.second.Shape())
+                InvalidArgument("BeamSearchDecoder: the state '%S' and the state input '%S' must have the same shape.",
+                                feedback.first.AsString().c_str(), feedback.second.AsString().c_str());
+        }
+    }
+
+    std::vector<std::vector<BeamSearchHypothesis>> BeamSearchDecoder::Decode(const std::unordered_map<Variable, ValuePtr>& initialStates,
+                                                                             const std::unordered_map<Variable, ValuePtr>& contexts,
+                                                                             const DeviceDescriptor& computeDevice)
+    {
+        if (m_logProbabilities.GetDataType() == DataType::Float)
+            return Decode<float>(initialStates, contexts, computeDevice);
+        else
+            return Decode<double>(initialStates, contexts, computeDevice);
+    }
+
+    template <typename ElementType>
+    std::vector<std::vector<BeamSearchHypothesis>> BeamSearchDecoder::Decode(const std::unordered_map<Variable, ValuePtr>& initialStates,
+                                                                             const std::unordered_map<Variable, ValuePtr>& contexts,
+                                                                             const DeviceDescriptor& computeDevice)
+    {
+        const size_t beamWidth = m_options.beamWidth;
+        const double lengthPenalty = m_options.lengthPenalty;
+
+        // All arguments of the step function except for the token input need a value, and all values need the same number of sequences.
+        size_t numSequences = 0;
+        auto checkNumSequences = [&](const Variable& variable, size_t count)
+        {
+            if ((numSequences != 0) && (count != numSequences))
+                InvalidArgument("BeamSearchDecoder: the value of '%S' has %zu sequences, expected %zu.", variable.AsString().c_str(), count, numSequences);
+            numSequences = count;
+        };
+
+        std::unordered_set<Variable> stateInputs;
+        for (const auto& feedback : m_stateFeedback)
+            stateInputs.insert(feedback.second);
+
+        for (const auto& state : initialStates)
+        {
+            if (stateInputs.find(state.first) == stateInputs.end())
+                InvalidArgument("BeamSearchDecoder: '%S' is not a state input of the step function.", state.first.AsString().c_str());
+            checkNumSequences(state.first, NumSamples(state.first, state.second));
+        }
+
+        for (const auto& argument : m_stepFunction->Arguments())
+        {
+            if ((argument == m_tokenInput) || (stateInputs.find(argument) != stateInputs.end()))
+                continue;
+
+            auto context = contexts.find(argument);
+            if (context == contexts.end())
+                InvalidArgument("BeamSearchDecoder: no value is given for the argument '%S' of the step function.", argument.AsString().c_str());
+            if (HasOnlyBatchAxis(argument))
+                checkNumSequences(argument, NumSamples(argument, context->second));
+            else
+            {
+                // [sample shape x sequence axis x batch axis]
+                const auto& valueShape = context->second->Shape();
+                if (valueShape.Rank() != argument.Shape().Rank() + 2)
+                    InvalidArgument("BeamSearchDecoder: the shape '%S' of the value of '%S' does not match the shape of the variable.",
+                                    valueShape.AsString().c_str(), argument.AsString().c_str());
+                checkNumSequences(argument, valueShape[valueShape.Rank() - 1]);
+            }
+        }
+
+        if (numSequences == 0)
+            InvalidArgument("BeamSearchDecoder: the number of sequences to decode is not known, an initial state or a context is needed.");
+
+        // The hypotheses of the sequences that are not done form the batch, in the order of the sequences.
+        // Each sequence starts with a single empty hypothesis.
+        std::vector<SequenceSearch> searches(numSequences);
+        for (auto& search : searches)
+            search.active.push_back({ {}, 0 });
+
+        std::vector<size_t> owners(numSequences); // sequence of each sample of the batch
+        for (size_t i = 0; i < numSequences; i++)
+            owners[i] = i;
+
+        std::unordered_map<Variable, ValuePtr> states;
+        for (const auto& stateInput : stateInputs)
+        {
+            auto initialState = initialStates.find(stateInput);
+            if (initialState != initialStates.end())
+                states[stateInput] = GatherValue(stateInput, initialState->second, owners, computeDevice);
+            else
+            {
+                auto zeros = MakeSharedObject<NDArrayView>(stateInput.GetDataType(), stateInput.Shape().AppendShape({ numSequences }), computeDevice);
+                zeros->SetValue((ElementType)0);
+                states[stateInput] = MakeSharedObject<Value>(zeros);
+            }
+        }
+
+        // The contexts only change when sequences are done or the number of hypotheses of a sequence changes.
+        std::unordered_map<Variable, ValuePtr> batchContexts;
+        std::vector<size_t> contextOwners;
+
+        for (size_t step = 0; step < m_options.maxLength; step++)
+        {
+            if (owners != contextOwners)
+            {
+                for (const auto& context : contexts)
+                    batchContexts[context.first] = GatherValue(context.first, context.second, owners, computeDevice);
+                contextOwners = owners;
+            }
+
+            std::vector<size_t> previousTokens;
+            for (const auto& search : searches)
+            {
+                if (search.done)
+                    continue;
+                for (const auto& hypothesis : search.active)
+                    previousTokens.push_back(hypothesis.tokens.empty() ? m_startToken : hypothesis.tokens.back());
+            }
+
+            std::unordered_map<Variable, ValuePtr> arguments(batchContexts);
+            arguments.insert(states.begin(), states.end());
+            arguments[m_tokenInput] = TokenBatch<ElementType>(m_tokenInput, m_vocabularySize, previousTokens, computeDevice);
+
+            std::unordered_map<Variable, ValuePtr> outputs = { { m_logProbabilities, nullptr } };
+            for (const auto& feedback : m_stateFeedback)
+                outputs[feedback.first] = nullptr;
+
+            m_stepFunction->Forward(arguments, outputs, computeDevice);
+
+            auto logProbabilitiesData = outputs[m_logProbabilities]->Data();
+            if (logProbabilitiesData->Device() != DeviceDescriptor::CPUDevice())
+                logProbabilitiesData = logProbabilitiesData->DeepClone(DeviceDescriptor::CPUDevice(), true);
+            if (logProbabilitiesData->Shape().TotalSize() != m_vocabularySize * owners.size())
+                LogicError("BeamSearchDecoder: the step function returned log-probabilities of shape '%S' for %zu hypotheses.",
+                           logProbabilitiesData->Shape().AsString().c_str(), owners.size());
+            const ElementType* logProbabilities = logProbabilitiesData->DataBuffer<ElementType>();
+
+            // Extend the hypotheses of each sequence by all tokens and keep the best ones.
+            bool lastStep = (step + 1 == m_options.maxLength);
+            std::vector<size_t> parents, nextOwners;
+            size_t position = 0; // position of the first hypothesis of the sequence in the batch
+            for (size_t sequence = 0; sequence < numSequences; sequence++)
+            {
+                auto& search = searches[sequence];
+                if (search.done)
+                    continue;
+
+                size_t numCandidates = search.active.size() * m_vocabularySize;
+                auto candidateLogProbability = [&](size_t candidate)
+                {
+                    return search.active[candidate / m_vocabularySize].logProbability + logProbabilities[position * m_vocabularySize + candidate];
+                };
+
+                // At most 'beamWidth' of the best 2 * 'beamWidth' candidates end, the others are enough to fill the beam.
+                std::vector<size_t> candidates(numCandidates);
+                for (size_t i = 0; i < numCandidates; i++)
+                    candidates[i] = i;
+                size_t numBest = std::min(2 * beamWidth, numCandidates);
+                std::partial_sort(candidates.begin(), candidates.begin() + numBest, candidates.end(),
+                                  [&](size_t a, size_t b) { return candidateLogProbability(a) > candidateLogProbability(b); });
+
+                std::vector<ActiveHypothesis> active;
+                for (size_t rank = 0; (rank < numBest) && (active.size() < beamWidth); rank++)
+                {
+                    size_t candidate = candidates[rank];
+                    size_t parent = candidate / m_vocabularySize;
+                    size_t token = candidate % m_vocabularySize;
+                    double logProbability = candidateLogProbability(candidate);
+                    if (logProbability == -std::numeric_limits<double>::infinity())
+                        break;
+
+                    const auto& parentTokens = search.active[parent].tokens;
+                    if ((token == m_endToken) || lastStep)
+                    {
+                        // Hypotheses that reach the maximum length end there, ranked like the others.
+                        if (rank >= beamWidth)
+                            continue;
+                        BeamSearchHypothesis ended{ parentTokens, logProbability, NormalizedScore(logProbability, parentTokens.size() + 1, lengthPenalty) };
+                        if (token != m_endToken)
+                            ended.tokens.push_back(token);
+                        AddEndedHypothesis(search, std::move(ended), beamWidth);
+                        continue;
+                    }
+
+                    active.push_back({ parentTokens, logProbability });
+                    active.back().tokens.push_back(token);
+                    parents.push_back(position + parent);
+                    nextOwners.push_back(sequence);
+                }
+
+                position += search.active.size();
+                search.active = std::move(active);
+
+                // Log-probabilities only decrease when a hypothesis is extended, so the best score an active hypothesis can
+                // reach is its current log-probability normalized by the shortest or the longest length.
+                if (search.active.empty())
+                    search.done = true;
+                else if (search.ended.size() == beamWidth)
+                {
+                    if (m_options.earlyStopping)
+                        search.done = true;
+                    else
+                    {
+                        double bestReachable = -std::numeric_limits<double>::infinity();
+                        for (const auto& hypothesis : search.active)
+                        {
+                            bestReachable = std::max(bestReachable, NormalizedScore(hypothesis.logProbability, hypothesis.tokens.size() + 1, lengthPenalty));
+                            bestReachable = std::max(bestReachable, NormalizedScore(hypothesis.logProbability, m_options.maxLength, lengthPenalty));
+                        }
+                        search.done = (bestReachable <= search.ended.back().score);
+                    }
+                }
+
+                // The batch only keeps the hypotheses of the sequences that are not done.
+                if (search.done)
+                {
+                    size_t numKept = search.active.size();
+                    parents.resize(parents.size() - numKept);
+                    nextOwners.resize(nextOwners.size() - numKept);
+                    search.active.clear();
+                }
+            }
+
+            if (parents.empty())
+                break;
+
+            // The state of each hypothesis is the new state of its parent.
+            for (const auto& feedback : m_stateFeedback)
+            {
+                auto newStates = GatherSamples(outputs[feedback.first]->Data(), feedback.first.Shape(), parents, computeDevice);
+                states[feedback.second] = MakeSharedObject<Value>(newStates);
+            }
+
+            owners = std::move(nextOwners);
+        }
+
+        std::vector<std::vector<BeamSearchHypothesis>> results(numSequences);
+        for (size_t sequence = 0; sequence < numSequences; sequence++)
+            results[sequence] = std::move(searches[sequence].ended);
+
+        return results;
+    }
+}
@@ -13,8 +13,10 @@
 #include <CPUMatrix.h> // For CPUMatrix::SetNumThreads
 #include <thread>
 #include "GPUMatrix.h"
+#include "ConvolutionEngine.h"
 #include "Globals.h"
 #include "PerformanceProfiler.h"
+#include "NodeProfiler.h"
 #include "MPIWrapper.h"
 #include "EnvironmentUtil.h"
 #include "Basics.h"
@@ -220,6 +222,32 @@ namespace CNTK
             Microsoft::MSR::CNTK::Globals::SetNodeTiming(false);
         }
 
+        void SetNodeExecutionThreads(size_t numThreads)
+        {
+            Microsoft::MSR::CNTK::Globals::SetNodeExecutionThreads(numThreads);
+        }
+
+        void EnableNodeProfiling()
+        {
+            Microsoft::MSR::CNTK::NodeProfiler::Reset();
+            Microsoft::MSR::CNTK::Globals::SetNodeProfiling(true);
+        }
+
+        void DisableNodeProfiling()
+        {
+            Microsoft::MSR::CNTK::Globals::SetNodeProfiling(false);
+        }
+
+        void PrintNodeProfile()
+        {
+            Microsoft::MSR::CNTK::NodeProfiler::PrintSummary(stderr);
+        }
+
+        void WriteNodeProfileTrace(const std::wstring& filePath)
+        {
+            Microsoft::MSR::CNTK::NodeProfiler::WriteChromeTrace(filePath);
+        }
+
         void EnableCPUEvalOptimization()
         {
             // optimization is only for float
@@ -588,6 +616,11 @@ namespace CNTK
             Microsoft::MSR::CNTK::SetMathLibTraceLevel(traceLevel);
         }
 
+        void SetConvolutionTuningCachePath(const std::wstring& path)
+        {
+            Microsoft::MSR::CNTK::SetConvolutionTuningCachePath(path);
+        }
+
         void ForceDeterministicAlgorithms()
         {
             Microsoft::MSR::CNTK::Globals::ForceDeterministicAlgorithms();
@@ -5,6 +5,7 @@
 
 #include "stdafx.h"
 #include "DataParallelDistributedLearner.h"
+#include "SparseDataParallelDistributedLearner.h"
 #include "DistributedCommunicator.h"
 #include "Learner.h"
 #include "PerformanceProfiler.h"
@@ -114,6 +115,11 @@ namespace CNTK
         return MakeSharedObject<DataParallelDistributedLearner>(communicator, learner, distributedAfterSamples, useAsyncBufferedParameterUpdate);
     }
 
+    DistributedLearnerPtr CreateSparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributedAfterSamples, double topKRatio, double threshold)
+    {
+        return MakeSharedObject<SparseDataParallelDistributedLearner>(communicator, learner, distributedAfterSamples, topKRatio, threshold);
+    }
+
     DataParallelDistributedLearner::DataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributedAfterSamples, bool useAsyncBufferedParameterUpdate)
         : DistributedLearnerBase(communicator, learner, distributedAfterSamples, !Internal::ShouldUseSparseGradientAggregationInDataParallelSGD())
     {
@@ -10,6 +10,7 @@
 #include "CompositeFunction.h"
 #include "BlockFunction.h"
 #include "Utils.h"
+#include "Serialization.h"
 #include "UserFunctionFactory.h"
 #include "TrainingNodes.h"
 #include "proto/onnx/ONNX.h"
@@ -500,6 +501,12 @@ namespace CNTK
             ONNXFormat::Save(RootFunction(), filepath);
             break;
         }
+
+        case ModelFormat::CNTKv2Mapped:
+        {
+            SaveMappedDictionary(Serialize(), filepath);
+            break;
+        }
         }
     }
 
@@ -526,6 +533,10 @@ namespace CNTK
         case ModelFormat::ONNX:
             return ONNXFormat::Load(filepath, computeDevice);
             break;
+
+        case ModelFormat::CNTKv2Mapped:
+            return Function::Deserialize(LoadMappedDictionary(filepath), computeDevice);
+            break;
         }
 
         return nullptr;
@@ -293,9 +293,35 @@ namespace CNTK
 
         UpdateOnMinibatch(trainingSampleCount);
 
+        // Dense parameters in CPU memory are updated all at once, the others one at a time below.
+        // Noise injection and clipping by the gradient norm need the whole parameter, they are not fused.
+        unordered_set<Parameter> fusedParameters;
+        FusedUpdateRule fusedUpdateRule;
+        bool canFuse = GetCurrentTrainingParameterValue(m_additionalOptions.gaussianNoiseInjectionStdDev) == 0 &&
+                       (m_additionalOptions.gradientClippingThresholdPerSample == numeric_limits<double>::infinity() ||
+                        m_additionalOptions.gradientClippingWithTruncation);
+        if (canFuse && GetFusedUpdateRule(trainingSampleCount, fusedUpdateRule))
+        {
+            vector<Parameter> parameters;
+            for (const auto& parameter : Parameters())
+            {
+                if (CanUpdateFused(parameter, gradientValues.at(parameter), fusedUpdateRule))
+                {
+                    parameters.push_back(parameter);
+                    fusedParameters.insert(parameter);
+                }
+            }
+
+            UpdateFused<float>(parameters, gradientValues, fusedUpdateRule, trainingSampleCount);
+            UpdateFused<double>(parameters, gradientValues, fusedUpdateRule, trainingSampleCount);
+        }
+
         bool needUpdateMasterParameter = !m_masterParameterUpdated;
         for (const auto& parameter : Parameters())
         {
+            if (fusedParameters.find(parameter) != fusedParameters.end())
+                continue;
+
             const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
             const auto& gradientValue = gradientValues.at(parameter);
 
@@ -381,6 +407,294 @@ namespace CNTK
         paramRef.RecordValueUpdate();
     }
 
+    size_t FusedUpdateRule::StateSize() const
+    {
+        switch (kind)
+        {
+        case Kind::SGD:
+            return 0;
+        case Kind::Momentum:
+        case Kind::Nesterov:
+        case Kind::AdaGrad:
+            return 1;
+        case Kind::FSAdaGrad:
+        case Kind::Adam:
+            return 2;
+        case Kind::RMSProp:
+            return 3;
+        default:
+            NOT_IMPLEMENTED;
+        }
+    }
+
+    bool LearnerBase::CanUpdateFused(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const FusedUpdateRule& rule) const
+    {
+        const auto& parameterValue = parameter.Value();
+        const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
+        if ((parameter.GetDataType() != DataType::Float && parameter.GetDataType() != DataType::Double) ||
+            gradientValue->GetDataType() != parameter.GetDataType() ||
+            gradientValue->Shape().TotalSize() != parameterValue->Shape().TotalSize())
+            return false;
+
+        for (const auto& value : { parameterValue, gradientValue, smoothedGradientValue })
+        {
+            if (value->Device().Type() != DeviceKind::CPU || value->GetStorageFormat() != StorageFormat::Dense)
+                return false;
+        }
+
+        // The smoothed gradient holds the values of the state of the rule one after the other, each as large as the parameter.
+        return rule.StateSize() == 0 || smoothedGradientValue->Shape().TotalSize() == rule.StateSize() * parameterValue->Shape().TotalSize();
+    }
+
+    // Elements of a parameter that are updated together by one thread
+    template <typename ElementType>
+    struct FusedUpdateChunk
+    {
+        ElementType* parameter;
+        ElementType* gradient;
+        ElementType* state;       // first value of the smoothed gradient, the next ones are stateStride apart
+        size_t stateStride;       // number of elements of the parameter
+        size_t size;
+        size_t parameterIndex;
+    };
+
+    static const size_t s_fusedUpdateChunkSize = 16384;
+
+    // Same as Matrix::InplaceSoftThreshold()
+    template <typename ElementType>
+    static inline void SoftThreshold(ElementType& value, ElementType threshold)
+    {
+        if (value > threshold)
+            value -= threshold;
+        else if (value < -threshold)
+            value += threshold;
+        else
+            value = 0;
+    }
+
+    // Applies the pre-processing (mean gradient, truncation, L2 regularization) and the update rule to a chunk.
+    // If the rule needs the average multiplier of the parameter, the parameter is not updated here; the scaled
+    // gradient is stored instead, and the sum of the multipliers of the chunk is returned.
+    // Otherwise the parameter is updated and the L1 regularization (soft threshold) is applied.
+    template <typename ElementType>
+    static ElementType ApplyFusedUpdateRule(const FusedUpdateRule& rule, const FusedUpdateChunk<ElementType>& chunk, ElementType gradientScale,
+                                            ElementType truncationThreshold, ElementType l2Weight, ElementType l1Threshold)
+    {
+        const ElementType learningRate = ElementType(rule.learningRate);
+        const ElementType momentum = ElementType(rule.momentum);
+        const ElementType unitGainFactor = rule.unitGain ? ElementType(1.0) - momentum : ElementType(1.0);
+        const ElementType varianceMomentum = ElementType(rule.varianceMomentum);
+        const ElementType multiplier = ElementType(rule.multiplier);
+        const ElementType epsilon = ElementType(rule.epsilon);
+        const ElementType unitGainLearningRate = unitGainFactor * learningRate;
+        const ElementType negativeLearningRate = ElementType(-rule.learningRate);
+        const bool storeScaledGradient = (rule.kind == FusedUpdateRule::Kind::AdaGrad || rule.kind == FusedUpdateRule::Kind::RMSProp) && rule.needAveMultiplier;
+
+        ElementType* w = chunk.parameter;
+        ElementType* grad = chunk.gradient;
+        ElementType* s0 = chunk.state;
+        ElementType* s1 = chunk.state + chunk.stateStride;
+        ElementType* s2 = chunk.state + 2 * chunk.stateStride;
+        ElementType aveMultiplier = 0;
+        for (size_t i = 0; i < chunk.size; i++)
+        {
+            ElementType g = grad[i] * gradientScale;
+            if (g > truncationThreshold)
+                g = truncationThreshold;
+            else if (g < -truncationThreshold)
+                g = -truncationThreshold;
+            g += l2Weight * w[i];
+
+            switch (rule.kind)
+            {
+            case FusedUpdateRule::Kind::SGD:
+                w[i] += negativeLearningRate * g;
+                break;
+            case FusedUpdateRule::Kind::Momentum:
+                s0[i] = unitGainLearningRate * g + momentum * s0[i];
+                w[i] -= s0[i];
+                break;
+            case FusedUpdateRule::Kind::Nesterov:
+                s0[i] = unitGainLearningRate * g + momentum * s0[i];
+                w[i] += -momentum * s0[i];
+                w[i] += -unitGainLearningRate * g;
+                break;
+            case FusedUpdateRule::Kind::AdaGrad:
+            {
+                const ElementType floor = 1e-16f;
+                s0[i] += g * g;
+                ElementType a = sqrt(s0[i] + floor);
+                g /= a;
+                aveMultiplier += 1 / a;
+                break;
+            }
+            case FusedUpdateRule::Kind::FSAdaGrad:
+            {
+                ElementType adaSqr = varianceMomentum * s0[i] + (1.0f - varianceMomentum) * g * g;
+                s0[i] = adaSqr;
+                if (adaSqr != 0.0f)
+                {
+                    ElementType weight = multiplier * ((ElementType) 1.0 / sqrt(adaSqr));
+                    if (weight > 10.0f)
+                        weight = 10.0f;
+                    g *= weight;
+                }
+                if (momentum > 0.0f)
+                {
+                    g = momentum * s1[i] + unitGainFactor * g;
+                    s1[i] = g;
+                }
+                w[i] -= g * learningRate;
+                break;
+            }
+            case FusedUpdateRule::Kind::Adam:
+            {
+                ElementType ada;
+                if (!rule.adamax)
+                {
+                    ElementType adaSqr = varianceMomentum * s0[i] + (1.0f - varianceMomentum) * g * g;
+                    s0[i] = adaSqr;
+                    ada = sqrt(adaSqr);
+                }
+                else
+                    ada = s0[i] = std::max(varianceMomentum * s0[i], std::abs(g));
+
+                ElementType weight = multiplier * (ElementType)(1.0 / (ada + epsilon));
+                g = momentum * s1[i] + unitGainFactor * g;
+                s1[i] = g;
+                w[i] -= g * weight * learningRate;
+                break;
+            }
+            case FusedUpdateRule::Kind::RMSProp:
+            {
+                // s0: accumulated variances, s1: signs of the previous gradients, s2: step sizes
+                const ElementType floor = 1e-6f;
+                if (!rule.initialized)
+                {
+                    s0[i] = g * g;
+                    s1[i] = 0;
+                    s2[i] = ElementType(0.02);
+                }
+                s0[i] = varianceMomentum * s0[i] + (ElementType(1.0) - varianceMomentum) * (g * g);
+                const int gradientSign = (ElementType(0) < g) - (g < ElementType(0));
+                if (s1[i] * gradientSign > 0)
+                    s2[i] = std::min(s2[i] * ElementType(rule.inc), ElementType(rule.max));
+                else
+                    s2[i] = std::max(s2[i] * ElementType(rule.dec), ElementType(rule.min));
+
+                ElementType a = s2[i] / sqrt(s0[i] + floor);
+                g *= a;
+                s1[i] = (ElementType) gradientSign;
+                aveMultiplier += a;
+                break;
+            }
+            default:
+                NOT_IMPLEMENTED;
+            }
+
+            if (rule.kind == FusedUpdateRule::Kind::AdaGrad || rule.kind == FusedUpdateRule::Kind::RMSProp)
+            {
+                if (storeScaledGradient)
+                {
+                    grad[i] = g;
+                    continue;
+                }
+                w[i] += negativeLearningRate * g;
+            }
+
+            if (l1Threshold > 0)
+                SoftThreshold(w[i], l1Threshold);
+        }
+
+        return aveMultiplier;
+    }
+
+    template <typename ElementType>
+    void LearnerBase::UpdateFused(const vector<Parameter>& parameters, const unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                                  const FusedUpdateRule& rule, size_t trainingSampleCount)
+    {
+        // Split the parameters of this type into chunks of up to s_fusedUpdateChunkSize elements
+        vector<Parameter> typedParameters;
+        vector<FusedUpdateChunk<ElementType>> chunks;
+        for (const auto& parameter : parameters)
+        {
+            if (parameter.GetDataType() != AsDataType<ElementType>())
+                continue;
+
+            ElementType* parameterData = GetWritableMatrix<ElementType>(parameter.Value())->Data();
+            ElementType* gradientData = GetWritableMatrix<ElementType>(gradientValues.at(parameter))->Data();
+            ElementType* stateData = rule.StateSize() > 0 ? GetWritableMatrix<ElementType>(m_smoothedGradientValues.at(parameter))->Data() : nullptr;
+            size_t numElements = parameter.Shape().TotalSize();
+            for (size_t begin = 0; begin < numElements; begin += s_fusedUpdateChunkSize)
+            {
+                FusedUpdateChunk<ElementType> chunk;
+                chunk.parameter = parameterData + begin;
+                chunk.gradient = gradientData + begin;
+                chunk.state = stateData ? stateData + begin : nullptr;
+                chunk.stateStride = numElements;
+                chunk.size = std::min(s_fusedUpdateChunkSize, numElements - begin);
+                chunk.parameterIndex = typedParameters.size();
+                chunks.push_back(chunk);
+            }
+            typedParameters.push_back(parameter);
+        }
+
+        if (typedParameters.empty())
+            return;
+
+        // Same values as in PreProcess() and PostProcess(), the operations that are not needed get neutral values.
+        const ElementType gradientScale = IsCompatibleMode() ? (ElementType)1.0 / trainingSampleCount : (ElementType)1.0;
+        ElementType truncationThreshold = numeric_limits<ElementType>::infinity();
+        if (m_additionalOptions.gradientClippingThresholdPerSample != numeric_limits<double>::infinity())
+        {
+            double gradientClippingThresholdPerSample = m_additionalOptions.gradientClippingThresholdPerSample;
+            double maxGradientPerMB = IsCompatibleMode() ? gradientClippingThresholdPerSample : gradientClippingThresholdPerSample * trainingSampleCount;
+            truncationThreshold = std::abs(ElementType(maxGradientPerMB));
+        }
+        const ElementType l2Weight = m_additionalOptions.l2RegularizationWeight > 0 ?
+            ElementType(m_additionalOptions.l2RegularizationWeight * (IsCompatibleMode() ? 1 : trainingSampleCount)) : ElementType(0);
+        const ElementType l1Threshold = m_additionalOptions.l1RegularizationWeight > 0 ?
+            ElementType(LearningRate(trainingSampleCount) * m_additionalOptions.l1RegularizationWeight * (IsCompatibleMode() ? 1 : trainingSampleCount)) : ElementType(0);
+
+        vector<ElementType> chunkAveMultipliers(chunks.size());
+#pragma omp parallel for schedule(dynamic)
+        for (long i = 0; i < (long) chunks.size(); i++)
+            chunkAveMultipliers[i] = ApplyFusedUpdateRule(rule, chunks[i], gradientScale, truncationThreshold, l2Weight, l1Threshold);
+
+        // AdaGrad and RMSProp with the average multiplier: the parameters are updated with the scaled gradients
+        // once the average of the multipliers over each parameter is known.
+        if ((rule.kind == FusedUpdateRule::Kind::AdaGrad || rule.kind == FusedUpdateRule::Kind::RMSProp) && rule.needAveMultiplier)
+        {
+            vector<ElementType> aveMultipliers(typedParameters.size(), 0);
+            for (size_t i = 0; i < chunks.size(); i++)
+                aveMultipliers[chunks[i].parameterIndex] += chunkAveMultipliers[i];
+
+#pragma omp parallel for schedule(dynamic)
+            for (long i = 0; i < (long) chunks.size(); i++)
+            {
+                const auto& chunk = chunks[i];
+                const size_t numElements = chunk.stateStride;
+                const ElementType aveMultiplier = numElements > 0 ? aveMultipliers[chunk.parameterIndex] / numElements : (ElementType)1;
+                const ElementType scale = ElementType(-rule.learningRate / aveMultiplier);
+                for (size_t j = 0; j < chunk.size; j++)
+                {
+                    chunk.parameter[j] += scale * chunk.gradient[j];
+                    if (l1Threshold > 0)
+                        SoftThreshold(chunk.parameter[j], l1Threshold);
+                }
+            }
+        }
+
+        for (auto& parameter : typedParameters)
+        {
+#ifdef _DEBUG
+            if (HasNan(parameter.Value(), "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+                LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Uid().c_str());
+#endif
+            parameter.RecordValueUpdate();
+        }
+    }
+
     string LearnerBase::LearnerType() const
     {
         return Typename(this);
@@ -543,6 +857,13 @@ namespace CNTK
         parameterMatrix->SGDUpdate(*gradientMatrix, learningRate);
     }
 
+    /*virtual*/ bool LearnerSGD::GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const /*override*/
+    {
+        rule = FusedUpdateRule(FusedUpdateRule::Kind::SGD);
+        rule.learningRate = LearningRate(trainingSampleCount);
+        return true;
+    }
+
     double LearnerMomentumSGD::MomentumValueForMB(const MomentumSchedule& schedule, size_t minibatchSize) const
     {
         //TODO: The unit gain term (1-beta) should stay as it is (currentMomentum) instead of using the following scaled term.
@@ -631,6 +952,17 @@ namespace CNTK
             learningRate, momentum, unitGainFactor);
     }
 
+    /*virtual*/ bool LearnerMomentumSGD::GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const /*override*/
+    {
+        ReportTrainingParameterValue(m_momentumSchedule, L"Momentum");
+
+        rule = FusedUpdateRule(FusedUpdateRule::Kind::Momentum);
+        rule.learningRate = LearningRate(trainingSampleCount);
+        rule.momentum = MomentumValueForMB(trainingSampleCount);
+        rule.unitGain = UseUnitGainMomentum();
+        return true;
+    }
+
     /*virtual*/ void LearnerNesterov::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, 
                                              const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) /*override*/
     {
@@ -683,6 +1015,15 @@ namespace CNTK
             learningRate, momentum, unitGainFactor);
     }
 
+    /*virtual*/ bool LearnerNesterov::GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const /*override*/
+    {
+        rule = FusedUpdateRule(FusedUpdateRule::Kind::Nesterov);
+        rule.learningRate = LearningRate(trainingSampleCount);
+        rule.momentum = MomentumValueForMB(trainingSampleCount);
+        rule.unitGain = UseUnitGainMomentum();
+        return true;
+    }
+
     LearnerAdaGrad::LearnerAdaGrad(const std::vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    bool needAveMultiplier,
@@ -723,6 +1064,14 @@ namespace CNTK
         Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate / aveMultiplier), *gradientMatrix, *parameterMatrix);
     }
 
+    /*virtual*/ bool LearnerAdaGrad::GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const /*override*/
+    {
+        rule = FusedUpdateRule(FusedUpdateRule::Kind::AdaGrad);
+        rule.learningRate = LearningRate(trainingSampleCount);
+        rule.needAveMultiplier = m_needAveMultiplier;
+        return true;
+    }
+
     LearnerAdaDelta::LearnerAdaDelta(
         const std::vector<Parameter>& parameters,
         const LearningRateSchedule& learningRateSchedule,
@@ -931,6 +1280,17 @@ namespace CNTK
                                                 momentum, varMomentum, unitGainFactor);
     }
 
+    /*virtual*/ bool LearnerFSAdaGrad::GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const /*override*/
+    {
+        rule = FusedUpdateRule(FusedUpdateRule::Kind::FSAdaGrad);
+        rule.learningRate = LearningRate(trainingSampleCount);
+        rule.momentum = MomentumValueForMB(trainingSampleCount);
+        rule.unitGain = UseUnitGainMomentum();
+        rule.varianceMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+        rule.multiplier = m_targetAdagradAvDenom_x_sqrtAdagradSqrFrames;
+        return true;
+    }
+
     LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
         const LearningRateSchedule& learningRateSchedule,
         const MomentumSchedule& momentumSchedule,
@@ -1001,6 +1361,22 @@ namespace CNTK
                                            momentum, varMomentum, (ElementType)m_epsilon, unitGainFactor, m_adamax);
     }
 
+    /*virtual*/ bool LearnerAdam::GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const /*override*/
+    {
+        rule = FusedUpdateRule(FusedUpdateRule::Kind::Adam);
+        rule.learningRate = LearningRate(trainingSampleCount);
+        rule.momentum = MomentumValueForMB(trainingSampleCount);
+        rule.unitGain = UseUnitGainMomentum();
+        rule.varianceMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+        rule.epsilon = m_epsilon;
+        rule.adamax = m_adamax;
+
+        // Bias correction, as in Matrix::AdamUpdate()
+        const double meanCorrection = 1 - pow(rule.momentum, m_smoothedCount);
+        rule.multiplier = m_adamax ? 1. / meanCorrection : sqrt(1 - pow(rule.varianceMomentum, m_smoothedCount)) / meanCorrection;
+        return true;
+    }
+
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    double gamma, double inc, double dec, double max, double min,
@@ -1092,6 +1468,20 @@ namespace CNTK
         Matrix<ElementType>::ScaleAndAdd(ElementType(-learningRate / aveMultiplier), *gradientMatrix, *parameterMatrix);
     }
 
+    /*virtual*/ bool LearnerRMSProp::GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const /*override*/
+    {
+        rule = FusedUpdateRule(FusedUpdateRule::Kind::RMSProp);
+        rule.learningRate = LearningRate(trainingSampleCount);
+        rule.varianceMomentum = m_gamma;
+        rule.inc = m_inc;
+        rule.dec = m_dec;
+        rule.max = m_max;
+        rule.min = m_min;
+        rule.needAveMultiplier = m_needAveMultiplier;
+        rule.initialized = m_smoothedCount > 1;
+        return true;
+    }
+
     // Explicit template instantiations
     template shared_ptr<Matrix<float>> LearnerBase::GetWritableMatrix<float>(const NDArrayViewPtr& arrayView);
     template shared_ptr<Matrix<double>> LearnerBase::GetWritableMatrix<double>(const NDArrayViewPtr& arrayView);
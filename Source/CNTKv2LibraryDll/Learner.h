@@ -12,6 +12,44 @@
 
 namespace CNTK 
 {
+    // The element-wise update rule of a learner with its hyper-parameter values for the current minibatch.
+    // Dense parameters in CPU memory are updated with it all at once, in a single multi-threaded pass over
+    // their elements, instead of one parameter (and several matrix operations) at a time.
+    // The rules match the dense CPU implementations of the Matrix update methods used by the learners.
+    struct FusedUpdateRule
+    {
+        enum class Kind
+        {
+            SGD,
+            Momentum,
+            Nesterov,
+            AdaGrad,
+            FSAdaGrad,
+            Adam,
+            RMSProp
+        };
+
+        Kind kind;
+        double learningRate;
+        double momentum;
+        bool unitGain;
+        double varianceMomentum;   // FSAdaGrad, Adam; gamma for RMSProp
+        double multiplier;         // FSAdaGrad: target average denominator x sqrt(smoothed count); Adam: bias correction
+        double epsilon;            // Adam
+        bool adamax;               // Adam
+        bool needAveMultiplier;    // AdaGrad, RMSProp
+        double inc, dec, max, min; // RMSProp step size adaptation
+        bool initialized;          // RMSProp: false at the first minibatch
+
+        FusedUpdateRule(Kind kind = Kind::SGD)
+            : kind(kind), learningRate(0), momentum(0), unitGain(false), varianceMomentum(0), multiplier(1), epsilon(0), adamax(false),
+              needAveMultiplier(false), inc(1), dec(1), max(0), min(0), initialized(true)
+        {}
+
+        // Number of values of the smoothed gradient per parameter value
+        size_t StateSize() const;
+    };
+
     // An abstract base class at the root of the standard learners hierarchy
     // It implements most of the learner functionality, except for the actual update function,
     // and adds a few pre-/postprocessing methods (which are invoked before and after the update).
@@ -41,6 +79,10 @@ namespace CNTK
         // Allows derived class may override this to perform per-minibatch update actions
         virtual void UpdateOnMinibatch(size_t /*trainingSampleCount*/) {}
 
+        // Returns the element-wise update rule of the learner for the current minibatch (see FusedUpdateRule).
+        // Learners without one update each parameter with the virtual Update method above.
+        virtual bool GetFusedUpdateRule(size_t /*trainingSampleCount*/, FusedUpdateRule& /*rule*/) const { return false; }
+
         std::string LearnerType() const;
 
         // Returns current learning rate.
@@ -123,6 +165,16 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount);
 
+        // Returns true if the parameter can be updated with the fused update rule: a dense float or double parameter
+        // that has its value, gradient and smoothed gradient in CPU memory.
+        bool CanUpdateFused(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const FusedUpdateRule& rule) const;
+
+        // Applies the pre-processing, the update rule and the post-processing to the elements of all given parameters
+        // of the template type, in a single multi-threaded pass.
+        template <typename ElementType>
+        void UpdateFused(const std::vector<Parameter>& parameters, const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues,
+                         const FusedUpdateRule& rule, size_t trainingSampleCount);
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
         static void Print(const NDArrayViewPtr& value, const char* msg);
@@ -150,6 +202,7 @@ namespace CNTK
     protected:
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
+        virtual bool GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const override;
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
@@ -180,6 +233,7 @@ namespace CNTK
 
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
+        virtual bool GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const override;
 
         template <typename ElemType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
@@ -227,6 +281,7 @@ namespace CNTK
 
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
+        virtual bool GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const override;
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
@@ -245,6 +300,7 @@ namespace CNTK
         bool m_needAveMultiplier;
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
+        virtual bool GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const override;
 
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
@@ -302,6 +358,7 @@ namespace CNTK
     protected:
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
+        virtual bool GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const override;
         virtual void UpdateOnMinibatch(size_t trainingSampleCount) override;
 
         template <typename ElementType>
@@ -343,6 +400,7 @@ namespace CNTK
     protected:
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
+        virtual bool GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const override;
         virtual void UpdateOnMinibatch(size_t trainingSampleCount) override;
 
         template <typename ElementType>
@@ -390,6 +448,7 @@ namespace CNTK
         double m_smoothedCount;
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) override;
+        virtual bool GetFusedUpdateRule(size_t trainingSampleCount, FusedUpdateRule& rule) const override;
         virtual void UpdateOnMinibatch(size_t trainingSampleCount) override;
 
         template <typename ElementType>
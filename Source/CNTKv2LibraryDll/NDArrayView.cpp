@@ -511,6 +511,11 @@ namespace CNTK
     }
 
     NDArrayViewPtr NDArrayView::Alias(bool readOnly/* = false*/) const
+    {
+        return NDArrayViewPtr(NewAlias(IsReadOnly() || readOnly), [](NDArrayView* ptr) { delete ptr; });
+    }
+
+    NDArrayView* NDArrayView::NewAlias(bool readOnly) const
     {
         void* tensorView = nullptr;
         switch (m_dataType)
@@ -535,7 +540,9 @@ namespace CNTK
             break;
         }
 
-        return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), Shape(), IsReadOnly() || readOnly, tensorView);
+        auto alias = new NDArrayView(GetDataType(), Device(), GetStorageFormat(), Shape(), readOnly, tensorView);
+        alias->m_mappedStorage = m_mappedStorage;
+        return alias;
     }
 
     NDArrayViewPtr NDArrayView::SliceView(const std::vector<size_t>& startOffset, const std::vector<size_t>& extent, bool readOnly) const
@@ -652,7 +659,9 @@ namespace CNTK
             break;
         }
 
-        return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), sliceViewShape, IsReadOnly() || readOnly, tensorView);
+        auto sliceView = MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), sliceViewShape, IsReadOnly() || readOnly, tensorView);
+        sliceView->m_mappedStorage = m_mappedStorage;
+        return sliceView;
     }
 
     NDArrayViewPtr NDArrayView::AsShape(const NDShape& newShape) const
@@ -688,7 +697,9 @@ namespace CNTK
             break;
         }
 
-        return MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), newShape, IsReadOnly(), tensorView);
+        auto view = MakeSharedObject<NDArrayView>(GetDataType(), Device(), GetStorageFormat(), newShape, IsReadOnly(), tensorView);
+        view->m_mappedStorage = m_mappedStorage;
+        return view;
     }
 
     template <typename ElementType>
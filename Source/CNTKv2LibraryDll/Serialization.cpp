@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "Serialization.h"
+#include "fileutil.h"
 #include <istream>
 #include <ostream>
 #include <string>
@@ -14,6 +16,9 @@
 
 #ifdef _MSC_VER
 #include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 #pragma warning(push)
@@ -31,6 +36,10 @@ namespace CNTK
     static const uint32 MAGIC_NUMBER = 0x636e746bU;
     static const uint32 BLOCK_SIZE = 8 << 10; // 8Kb;
 
+    // Memory-mapped format (see Serializer::WriteMapped).
+    static const uint32 MAPPED_MAGIC_NUMBER = 0x6d6e746bU;
+    static const uint64 MAPPED_DATA_ALIGNMENT = 64;
+
     static void SetUTF8Locale()
     {
 #ifndef _MSC_VER
@@ -113,6 +122,72 @@ namespace CNTK
     };
 
 
+    // A whole file mapped into memory copy-on-write: the pages are shared by all processes that map the file
+    // and only become private to a process when it writes to them, which never modifies the file.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::wstring& filename)
+            : m_data(nullptr), m_size(0)
+        {
+            auto fd = GetFileDescriptor(filename, true);
+#ifdef _MSC_VER
+            HANDLE handle = (HANDLE)_get_osfhandle(fd);
+            LARGE_INTEGER size;
+            HANDLE mapping = GetFileSizeEx(handle, &size) && size.QuadPart > 0 ? CreateFileMappingW(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL) : NULL;
+            if (mapping != NULL)
+            {
+                m_size = (size_t)size.QuadPart;
+                m_data = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                // The view keeps a reference to the mapping object.
+                CloseHandle(mapping);
+            }
+            auto error = GetLastError();
+            _close(fd);
+            if (m_data == NULL)
+                RuntimeError("Cannot map file '%S' into memory, error code %d.", filename.c_str(), (int)error);
+#else
+            struct stat info;
+            int error = EINVAL; // empty file
+            if (fstat(fd, &info) != 0)
+                error = errno;
+            else if (info.st_size > 0)
+            {
+                void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    m_data = static_cast<char*>(data);
+                    m_size = (size_t)info.st_size;
+                }
+                else
+                    error = errno;
+            }
+            close(fd);
+            if (m_data == nullptr)
+                RuntimeError("Cannot map file '%S' into memory: %s.", filename.c_str(), strerror(error));
+#endif
+        }
+
+        ~MappedFile()
+        {
+#ifdef _MSC_VER
+            UnmapViewOfFile(m_data);
+#else
+            munmap(m_data, m_size);
+#endif
+        }
+
+        char* Data() const { return m_data; }
+
+        size_t Size() const { return m_size; }
+
+    private:
+        char* m_data;
+        size_t m_size;
+
+        MappedFile(const MappedFile&) = delete; MappedFile& operator=(const MappedFile&) = delete;
+    };
+
     class Serializer
     {
         friend std::ostream& operator<<(std::ostream&, const Dictionary&);
@@ -124,6 +199,9 @@ namespace CNTK
         friend class Dictionary;
         friend class DictionaryValue;
 
+        friend void SaveMappedDictionary(const Dictionary&, const std::wstring&);
+        friend Dictionary LoadMappedDictionary(const std::wstring&);
+
         Serializer(const Dictionary& dict);
         Serializer(const DictionaryValue& dict);
 
@@ -158,6 +236,9 @@ namespace CNTK
 
         bool ReadNDArrayViewData(io::ZeroCopyInputStream& input);
 
+        void WriteMapped(const std::wstring& filename);
+        bool ReadMapped(const std::wstring& filename, Dictionary& dict);
+
         size_t GetTotalByteSize()
         {
             return m_byteSize + m_proto->ByteSizeLong();
@@ -171,6 +252,7 @@ namespace CNTK
         Dictionary* CreateFromProto(const proto::Dictionary& src);
         std::vector<DictionaryValue>* CreateFromProto(const proto::Vector& src);
         NDArrayView* CreateFromProto(const proto::NDArrayView& src);
+        NDArrayView* CreateMappedNDArrayView(const NDShape& shape, DataType dataType, StorageFormat storageFormat);
         Axis* CreateFromProto(const proto::Axis& src);
         NDShape* CreateFromProto(const proto::NDShape& src);
 
@@ -336,6 +418,25 @@ namespace CNTK
             }
         }
 
+        static const char* RawDataBuffer(const NDArrayView& src)
+        {
+            switch (src.GetDataType())
+            {
+            case DataType::Float:
+                return reinterpret_cast<const char*>(src.DataBuffer<float>());
+            case DataType::Double:
+                return reinterpret_cast<const char*>(src.DataBuffer<double>());
+            case DataType::Float16:
+                return reinterpret_cast<const char*>(src.DataBuffer<float16>());
+            case DataType::Int8:
+                return reinterpret_cast<const char*>(src.DataBuffer<int8_t>());
+            case DataType::Int16:
+                return reinterpret_cast<const char*>(src.DataBuffer<int16_t>());
+            default:
+                LogicError("Unsupported DataType %s", DataTypeName(src.GetDataType()));
+            }
+        }
+
         static void CopyInt8Data(const std::string& src, NDArrayView* dst)
         {
             auto size = src.length();
@@ -349,6 +450,8 @@ namespace CNTK
         Message* m_proto;
         std::vector<std::pair<NDArrayView*, proto::NDArrayView*>> m_arrayViews;
         size_t m_byteSize {0};
+        std::shared_ptr<MappedFile> m_mappedFile;
+        std::vector<std::pair<uint64, uint64>> m_mappedBlobs; // (offset, size in bytes) of the contents of each NDArrayView
     };
 
 
@@ -536,6 +639,9 @@ namespace CNTK
         std::unique_ptr<NDShape> shape(CreateFromProto(src.shape()));
         auto dataType = FromProtoType(src.data_type());
         auto storageFormat = FromProtoType(src.storage_format());
+        if (m_mappedFile != nullptr)
+            return CreateMappedNDArrayView(*shape, dataType, storageFormat);
+
         NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
 
         if (dataType == DataType::Float)
@@ -576,6 +682,29 @@ namespace CNTK
         return dst;
     }
 
+    NDArrayView* Serializer::CreateMappedNDArrayView(const NDShape& shape, DataType dataType, StorageFormat storageFormat)
+    {
+        // The blobs are in the order in which the NDArrayViews appear in the metadata, as when writing them.
+        auto index = m_arrayViews.size();
+        if (IsSparseStorageFormat(storageFormat) || index >= m_mappedBlobs.size())
+            RuntimeError("Invalid contents of NDArrayView %zu in the memory-mapped model file.", index);
+
+        auto offset = m_mappedBlobs[index].first;
+        auto numBytes = m_mappedBlobs[index].second;
+        if (numBytes != shape.TotalSize() * DataTypeSize(dataType))
+        {
+            RuntimeError("Size (%zu bytes) of NDArrayView %zu in the memory-mapped model file does not match its shape '%S' and data type %s.",
+                         (size_t)numBytes, index, shape.AsString().c_str(), DataTypeName(dataType));
+        }
+        if (offset % MAPPED_DATA_ALIGNMENT != 0 || offset > m_mappedFile->Size() || numBytes > m_mappedFile->Size() - offset)
+            RuntimeError("Invalid contents of NDArrayView %zu in the memory-mapped model file.", index);
+
+        NDArrayView* dst = new NDArrayView(dataType, shape, m_mappedFile->Data() + offset, (size_t)numBytes, DeviceDescriptor::CPUDevice(), /*readOnly =*/ true);
+        dst->m_mappedStorage = m_mappedFile;
+        m_arrayViews.push_back({ dst, nullptr });
+        return dst;
+    }
+
     proto::Vector* Serializer::CreateProto(const std::vector<DictionaryValue>& src, Arena* arena)
     {
         proto::Vector* dst = (arena != nullptr) ? 
@@ -876,6 +1005,156 @@ namespace CNTK
         return false;
     }
 
+    // The memory-mapped format stores the contents of the NDArrayViews as is (in the little-endian layout of
+    // the host), each at an aligned offset, so that a reader can use them directly from a mapping of the file:
+    //   magic number (uint32), metadata size (uint32), metadata protobuf without the NDArrayView contents,
+    //   number of NDArrayViews (uint64), offset and size in bytes of the contents of each NDArrayView (uint64 each),
+    //   contents.
+    // On Windows a file cannot be replaced while it is mapped, so a model cannot be saved over one that is loaded.
+    void Serializer::WriteMapped(const std::wstring& filename)
+    {
+        auto metadataSize = m_proto->ByteSizeLong();
+        if (metadataSize >= static_cast<size_t>(INT_MAX))
+            RuntimeError("Size (%zu) of the model metadata exceeds %d bytes.", metadataSize, INT_MAX);
+
+        uint64 headerSize = 2 * sizeof(uint32) + metadataSize + (1 + 2 * m_arrayViews.size()) * sizeof(uint64);
+        std::vector<uint64> offsets, sizes;
+        uint64 offset = headerSize;
+        for (auto& pair : m_arrayViews)
+        {
+            const auto& src = *(pair.first);
+            if (src.IsSparse())
+                InvalidArgument("NDArrayView with sparse storage cannot be saved in the memory-mapped model format.");
+
+            offset = (offset + MAPPED_DATA_ALIGNMENT - 1) / MAPPED_DATA_ALIGNMENT * MAPPED_DATA_ALIGNMENT;
+            offsets.push_back(offset);
+            sizes.push_back(src.Shape().TotalSize() * DataTypeSize(src.GetDataType()));
+            offset += sizes.back();
+        }
+
+        // Replace an existing model only once the new one is complete: processes that have the existing one mapped
+        // keep reading the old file instead of seeing it change underneath them. The temporary file is named after
+        // this process, so that processes saving the same model concurrently do not write into each other's file.
+        auto tempFilename = filename + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+        auto fd = GetFileDescriptor(tempFilename, false);
+        bool isClosed = false;
+        auto discardTempFile = [&]()
+        {
+            if (!isClosed)
+            {
+#ifdef _MSC_VER
+                _close(fd);
+#else
+                close(fd);
+#endif
+            }
+            _wunlink(tempFilename.c_str());
+        };
+
+        bool success = false;
+        int writeError = 0;
+        try
+        {
+            io::FileOutputStream stream(fd);
+            {
+                io::CodedOutputStream output(&stream);
+                output.WriteLittleEndian32(MAPPED_MAGIC_NUMBER);
+                output.WriteLittleEndian32(static_cast<uint32>(metadataSize));
+                m_proto->SerializeToCodedStream(&output);
+                output.WriteLittleEndian64(offsets.size());
+                for (size_t i = 0; i < offsets.size(); i++)
+                {
+                    output.WriteLittleEndian64(offsets[i]);
+                    output.WriteLittleEndian64(sizes[i]);
+                }
+
+                static const char padding[MAPPED_DATA_ALIGNMENT] = {};
+                uint64 position = headerSize;
+                for (size_t i = 0; i < offsets.size(); i++)
+                {
+                    const auto& src = *(m_arrayViews[i].first);
+                    auto buffer = RawDataBuffer(src);
+                    auto numBytes = sizes[i];
+                    output.WriteRaw(padding, static_cast<int>(offsets[i] - position));
+                    for (size_t written = 0; written < numBytes; written += INT_MAX)
+                        output.WriteRaw(buffer + written, static_cast<int>(std::min<size_t>(numBytes - written, INT_MAX)));
+                    position = offsets[i] + numBytes;
+                }
+                success = !output.HadError();
+            }
+
+            // Flushes the buffered contents and closes the file, the descriptor is closed even if this fails.
+            success = stream.Close() && success;
+            isClosed = true;
+            writeError = stream.GetErrno();
+        }
+        catch (...)
+        {
+            discardTempFile();
+            throw;
+        }
+
+        // Never replace the existing model with an incomplete one (e.g. when the disk is full).
+        if (!success)
+        {
+            discardTempFile();
+            RuntimeError("Cannot write the memory-mapped model to file '%S' (error code %d).", tempFilename.c_str(), writeError);
+        }
+
+#ifdef _MSC_VER
+        // Unlike renameOrDie, do not delete the existing model first: if it is mapped, neither can be done, and
+        // the existing model is kept.
+        if (!MoveFileExW(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            auto error = GetLastError();
+            _wunlink(tempFilename.c_str());
+            RuntimeError("Cannot replace file '%S' with the memory-mapped model (error code %d), it may be mapped by a loaded model.",
+                         filename.c_str(), (int)error);
+        }
+#else
+        renameOrDie(tempFilename, filename);
+#endif
+    }
+
+    bool Serializer::ReadMapped(const std::wstring& filename, Dictionary& dict)
+    {
+        m_mappedFile = std::make_shared<MappedFile>(filename);
+        auto data = reinterpret_cast<const uint8*>(m_mappedFile->Data());
+        auto size = m_mappedFile->Size();
+
+        uint32 prefix = 0, metadataSize = 0;
+        if (size < sizeof(prefix) + sizeof(metadataSize))
+            return false;
+
+        io::CodedInputStream::ReadLittleEndian32FromArray(data, &prefix);
+        io::CodedInputStream::ReadLittleEndian32FromArray(data + sizeof(prefix), &metadataSize);
+        // WriteMapped() rejects metadata of INT_MAX bytes or more, which protobuf cannot parse
+        uint64 tableOffset = sizeof(prefix) + sizeof(metadataSize) + uint64(metadataSize);
+        if (prefix != MAPPED_MAGIC_NUMBER || metadataSize >= static_cast<uint32>(INT_MAX) || size < tableOffset + sizeof(uint64))
+            return false;
+
+        m_proto = Arena::CreateMessage<proto::Dictionary>(&m_arena);
+        if (!m_proto->ParseFromArray(data + sizeof(prefix) + sizeof(metadataSize), static_cast<int>(metadataSize)))
+            return false;
+
+        uint64 numArrayViews = 0;
+        io::CodedInputStream::ReadLittleEndian64FromArray(data + tableOffset, &numArrayViews);
+        if (numArrayViews > ((size - tableOffset) / sizeof(uint64) - 1) / 2)
+            return false;
+
+        m_mappedBlobs.resize(numArrayViews);
+        for (size_t i = 0; i < numArrayViews; i++)
+        {
+            auto entry = data + tableOffset + (1 + 2 * i) * sizeof(uint64);
+            io::CodedInputStream::ReadLittleEndian64FromArray(entry, &m_mappedBlobs[i].first);
+            io::CodedInputStream::ReadLittleEndian64FromArray(entry + sizeof(uint64), &m_mappedBlobs[i].second);
+        }
+
+        // Only the metadata is parsed, the NDArrayViews are created over the mapped contents (see CreateMappedNDArrayView).
+        Copy(*dynamic_cast<proto::Dictionary*>(m_proto), dict);
+        return m_arrayViews.size() == numArrayViews;
+    }
+
     std::ostream& operator<<(std::ostream& stream, const Dictionary& dictionary)
     {
         return Serializer(dictionary).Write(stream);
@@ -925,4 +1204,17 @@ namespace CNTK
             RuntimeError("Failed to parse DictionaryValue from file (%ls).", filename.c_str());
         return dictionaryValue;
     }
+
+    void SaveMappedDictionary(const Dictionary& dictionary, const std::wstring& filename)
+    {
+        Serializer(dictionary).WriteMapped(filename);
+    }
+
+    Dictionary LoadMappedDictionary(const std::wstring& filename)
+    {
+        Dictionary dictionary;
+        if (!Serializer().ReadMapped(filename, dictionary))
+            RuntimeError("Failed to parse memory-mapped Dictionary from file (%ls).", filename.c_str());
+        return dictionary;
+    }
 }
@@ -109,4 +109,8 @@ namespace CNTK
 
         return version;
     }
+
+    // Save and load a Dictionary in the memory-mapped format of ModelFormat::CNTKv2Mapped (see Serialization.cpp).
+    void SaveMappedDictionary(const Dictionary& dictionary, const std::wstring& filename);
+    Dictionary LoadMappedDictionary(const std::wstring& filename);
 }
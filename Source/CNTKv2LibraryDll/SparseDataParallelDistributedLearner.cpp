@@ -0,0 +1,153 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "SparseDataParallelDistributedLearner.h"
+#include "Learner.h"
+#include "PerformanceProfiler.h"
+
+namespace CNTK
+{
+    using namespace Microsoft::MSR::CNTK;
+
+    // Exchanges the messages of the sparsifiers with Concatenate of the communicator. Concatenate requires inputs of
+    // the same size on all workers, so the sizes are exchanged first and the messages are padded to the largest one.
+    static SparseMessageExchange CommunicatorMessageExchange(const DistributedCommunicatorPtr& communicator)
+    {
+        return [communicator](const std::vector<char>& message, std::vector<char>& messages, std::vector<size_t>& messageSizes)
+        {
+            const auto& workers = communicator->Workers();
+
+            std::vector<NDArrayViewPtr> sizes;
+            communicator->Concatenate({ MakeSharedObject<NDArrayView>(static_cast<double>(message.size()), NDShape{ 1 }, DeviceDescriptor::CPUDevice()) }, sizes, workers);
+
+            const double* gatheredSizes = sizes.front()->DataBuffer<double>();
+            messageSizes.resize(workers.size());
+            size_t maxSize = 0;
+            for (size_t i = 0; i < messageSizes.size(); i++)
+            {
+                messageSizes[i] = static_cast<size_t>(gatheredSizes[i]);
+                maxSize = std::max(maxSize, messageSizes[i]);
+            }
+
+            // The bytes of the messages are sent as floats.
+            size_t paddedSize = std::max<size_t>(1, (maxSize + sizeof(float) - 1) / sizeof(float));
+            auto padded = MakeSharedObject<NDArrayView>(DataType::Float, NDShape{ paddedSize }, DeviceDescriptor::CPUDevice());
+            padded->SetValue(0.0f);
+            memcpy(padded->WritableDataBuffer<float>(), message.data(), message.size());
+
+            std::vector<NDArrayViewPtr> gathered;
+            communicator->Concatenate({ padded }, gathered, workers);
+
+            const char* data = reinterpret_cast<const char*>(gathered.front()->DataBuffer<float>());
+            messages.clear();
+            for (size_t i = 0; i < messageSizes.size(); i++)
+            {
+                const char* workerMessage = data + i * paddedSize * sizeof(float);
+                messages.insert(messages.end(), workerMessage, workerMessage + messageSizes[i]);
+            }
+        };
+    }
+
+    SparseDataParallelDistributedLearner::SparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributedAfterSamples, double topKRatio, double threshold)
+        : DistributedLearnerBase(communicator, learner, distributedAfterSamples),
+          m_floatSparsifier(communicator->Workers().size(), CommunicatorMessageExchange(communicator), topKRatio, threshold),
+          m_doubleSparsifier(communicator->Workers().size(), CommunicatorMessageExchange(communicator), topKRatio, threshold)
+    {
+    }
+
+    template <class ElemType>
+    void SparseDataParallelDistributedLearner::AggregateGradients(GradientSparsifier<ElemType>& sparsifier, DataType dataType)
+    {
+        std::vector<typename GradientSparsifier<ElemType>::Gradient> gradients;
+        for (size_t i = 0; i < m_gradientBuffer.size(); i++)
+        {
+            if (m_gradientBuffer[i].second->GetDataType() != dataType)
+                continue;
+
+            auto& view = (m_gradientBuffer[i].second->Device().Type() == DeviceKind::CPU) ? m_gradientBuffer[i].second : m_cpuGradients[i];
+            gradients.push_back({ view->WritableDataBuffer<ElemType>(), view->Shape().TotalSize() });
+        }
+
+        if (!gradients.empty())
+            sparsifier.AggregateInPlace(gradients);
+    }
+
+    bool SparseDataParallelDistributedLearner::Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info)
+    {
+        // sparse gradients are converted to dense for aggregation
+        std::unordered_map<Parameter, NDArrayViewPtr> convertedGradientValues = gradientValues;
+
+        if (m_sampleCount >= m_distributeAfterSamples && m_communicator->Workers().size() > 1)
+        {
+#ifndef  CNTK_UWP
+            auto profGradientAgg = Microsoft::MSR::CNTK::ScopeProfile(Microsoft::MSR::CNTK::profilerEvtMainGradient);
+#endif
+
+            if (info.IsEmpty())
+                PrepaireZeroGradients(gradientValues);
+
+            // sorts gradient buffers according to parameter uid, so that the residuals match on every call
+            ConvertToOrdered(gradientValues, m_gradientBuffer, &convertedGradientValues);
+
+            m_cpuGradients.resize(m_gradientBuffer.size());
+            size_t denseBytes = 0;
+            for (size_t i = 0; i < m_gradientBuffer.size(); i++)
+            {
+                const auto& gradient = m_gradientBuffer[i].second;
+                if (gradient->GetDataType() != DataType::Float && gradient->GetDataType() != DataType::Double)
+                    LogicError("SparseDataParallelDistributedLearner: only float and double gradients are supported.");
+
+                if (gradient->Device().Type() != DeviceKind::CPU)
+                {
+                    auto& copy = m_cpuGradients[i];
+                    if (!copy || copy->Shape() != gradient->Shape() || copy->GetDataType() != gradient->GetDataType())
+                        copy = MakeSharedObject<NDArrayView>(gradient->GetDataType(), gradient->Shape(), DeviceDescriptor::CPUDevice());
+                    copy->CopyFrom(*gradient);
+                }
+                denseBytes += gradient->Shape().TotalSize() * DataTypeSize(gradient->GetDataType());
+            }
+
+            AggregateGradients(m_floatSparsifier, DataType::Float);
+            AggregateGradients(m_doubleSparsifier, DataType::Double);
+
+            for (size_t i = 0; i < m_gradientBuffer.size(); i++)
+            {
+                if (m_gradientBuffer[i].second->Device().Type() != DeviceKind::CPU)
+                    m_gradientBuffer[i].second->CopyFrom(*m_cpuGradients[i]);
+            }
+
+            std::vector<NDArrayViewPtr> valuesToAggregate;
+            valuesToAggregate.push_back(info.evalCriterionValue);
+            valuesToAggregate.push_back(info.trainingLossValue);
+
+            auto value = MakeSharedObject<NDArrayView>(static_cast<double>(info.numberOfSamples), NDShape{}, DeviceDescriptor::CPUDevice());
+            valuesToAggregate.push_back(value);
+
+            m_communicator->AggregateInPlace(valuesToAggregate, m_communicator->Workers());
+            info.numberOfSamples = static_cast<size_t>(*valuesToAggregate.back()->WritableDataBuffer<double>());
+
+            if (GetTraceLevel() >= TraceLevel::Info)
+            {
+                size_t bytesSent = m_floatSparsifier.BytesSent() + m_doubleSparsifier.BytesSent();
+                size_t bytesReceived = m_floatSparsifier.BytesReceived() + m_doubleSparsifier.BytesReceived();
+                fprintf(stderr, "Sparse gradient aggregation: %.1f KB sent, %.1f KB received (%.2f%% of the %.1f KB of the dense gradients)\n",
+                        bytesSent / 1024.0, bytesReceived / 1024.0, denseBytes > 0 ? 100.0 * bytesSent / denseBytes : 0.0, denseBytes / 1024.0);
+            }
+        }
+
+#ifndef  CNTK_UWP
+        auto profWeights = Microsoft::MSR::CNTK::ScopeProfile(Microsoft::MSR::CNTK::profilerEvtMainWeights);
+#endif
+
+        m_sampleCount += info.numberOfSamples;
+        m_gradientBuffer.clear();
+
+        if (info.IsEmpty())
+            return false;
+
+        return m_learner->Update(convertedGradientValues, info.numberOfSamples, info.atEndOfSweep);
+    }
+}
@@ -0,0 +1,36 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma  once
+
+#include "CNTKLibrary.h"
+#include "DistributedLearnerBase.h"
+#include "GradientSparsifier.h"
+
+namespace CNTK
+{
+    ///
+    /// Data parallel distributed learner that exchanges sparsified gradients (see GradientSparsifier).
+    /// The gradients are sparsified in CPU memory, gradients on a GPU are copied to the CPU and back.
+    /// The criterion values and the number of samples are aggregated in full through the communicator.
+    ///
+    class SparseDataParallelDistributedLearner : public DistributedLearnerBase
+    {
+    public:
+        SparseDataParallelDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributedAfterSamples, double topKRatio, double threshold);
+
+        bool Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& trainingSampleCount) override;
+
+    private:
+        template <class ElemType>
+        void AggregateGradients(Microsoft::MSR::CNTK::GradientSparsifier<ElemType>& sparsifier, DataType dataType);
+
+        Microsoft::MSR::CNTK::GradientSparsifier<float> m_floatSparsifier;
+        Microsoft::MSR::CNTK::GradientSparsifier<double> m_doubleSparsifier;
+
+        // CPU copies of the gradients that are not on the CPU, by position in m_gradientBuffer
+        std::vector<NDArrayViewPtr> m_cpuGradients;
+    };
+}
@@ -40,6 +40,10 @@ namespace CNTK
     template <>
     NDArrayView* CreateDataPtr<NDArrayView>(const NDArrayView& value)
     {
+        // Views over a memory-mapped model are aliased, so that copying a loaded Dictionary does not read in the file.
+        if (auto alias = Utils::AliasIfMapped(value))
+            return alias;
+
         // TODO: replace this copy with an alias to value.
         NDArrayView* viewPtr = new NDArrayView(value.GetDataType(), value.Shape(), DeviceDescriptor::CPUDevice());
         viewPtr->CopyFrom(value);
@@ -686,6 +686,12 @@ namespace CNTK
         }
         static void VerifyVariableValueCompatibility(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape = nullptr);
 
+        // Returns a new alias of the view if it is a read-only view of a memory-mapped model file, nullptr otherwise.
+        static NDArrayView* AliasIfMapped(const NDArrayView& view)
+        {
+            return (view.IsMapped() && view.IsReadOnly()) ? view.NewAlias(/*readOnly =*/ true) : nullptr;
+        }
+
         template <typename ElementType>
         static std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, Microsoft::MSR::CNTK::MBLayoutPtr>
         GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape,
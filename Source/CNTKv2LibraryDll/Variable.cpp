@@ -548,7 +548,17 @@ namespace CNTK
 
             // TODO: this copying here is redundant, value should be moved from the dictionary to the variable.
             // Also, the correct device should be used upfront when deserializing NDArrayView.
-            Variable var(shape, kind, dataType, value.DeepClone(device, value.IsReadOnly()), needsGradient, dynamicAxis, isSparse, name, uid);
+            NDArrayViewPtr varValue;
+            if (value.IsMapped() && device.Type() == DeviceKind::CPU)
+            {
+                // The values of a memory-mapped model are used in place. The mapping is copy-on-write,
+                // so the variable's value stays writable without ever modifying the model file.
+                varValue = NDArrayViewPtr(value.NewAlias(/*readOnly =*/ false), [](NDArrayView* ptr) { delete ptr; });
+            }
+            else
+                varValue = value.DeepClone(device, value.IsReadOnly() && !value.IsMapped());
+
+            Variable var(shape, kind, dataType, varValue, needsGradient, dynamicAxis, isSparse, name, uid);
             if (var.IsParameter())
                 return Parameter(var);
             else
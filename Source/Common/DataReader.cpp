@@ -237,6 +237,12 @@ size_t DataReader::GetCurrentSamplePosition()
     return m_dataReaders[m_ioNames.back()]->GetCurrentSamplePosition();
 }
 
+std::map<std::wstring, double> DataReader::GetStatistics()
+{
+    // Same as above, only the last reader is asked.
+    return m_dataReaders[m_ioNames.back()]->GetStatistics();
+}
+
 // GetMinibatch - Get the next minibatch (features and labels)
 // matrices - [in] a map with named matrix types (i.e. 'features', 'labels') mapped to the corresponding matrix,
 //             [out] each matrix resized if necessary containing data.
@@ -43,6 +43,19 @@ int EnvironmentUtil::GetLocalMPINodeRank()
 
     return (!p) ? 0 : stoi(string(p));
 }
+
+int EnvironmentUtil::GetMPIWorldRank()
+{
+#if HAS_MPI
+    for (const char* name : { "OMPI_COMM_WORLD_RANK", "PMI_RANK", "PMIX_RANK" })
+    {
+        const char* p = getenv(name);
+        if (p)
+            return stoi(string(p));
+    }
+#endif
+    return 0;
+}
 #pragma warning(pop)
 
 }}}
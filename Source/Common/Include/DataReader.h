@@ -253,6 +253,12 @@ public:
         NOT_IMPLEMENTED;
     }
 
+    // Gets named statistics of the current epoch, e.g. of the chunk prefetching. Legacy readers have none.
+    virtual std::map<std::wstring, double> GetStatistics()
+    {
+        return std::map<std::wstring, double>();
+    }
+
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize)
     {
         if (SupportsDistributedMBRead() || (numSubsets != 1) || (subsetNum != 0))
@@ -426,6 +432,8 @@ public:
 
     size_t GetCurrentSamplePosition() override;
 
+    std::map<std::wstring, double> GetStatistics() override;
+
     // StartMinibatchLoop - Startup a minibatch loop
     // mbSize - [in] size of the minibatch (number of frames, etc.)
     // epoch - [in] epoch number for this loop
@@ -19,6 +19,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // corresponging to the rank of the local MPI node.
         // This function returns 0 if the variable is not present.
         static int GetLocalMPINodeRank();
+
+        // Reads and returns the rank of this process among all processes of the MPI job (MPI_COMM_WORLD),
+        // from the environment variables set by the launchers of Open MPI, MS-MPI, MPICH and PMIx.
+        // Unlike GetLocalMPINodeRank(), it does not depend on the MPI implementation it was built for.
+        // This function returns 0 if none of the variables is present.
+        static int GetMPIWorldRank();
     };
     
 }}}
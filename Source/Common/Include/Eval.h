@@ -296,6 +296,70 @@ class VariableSchema : public std::vector<VariableLayout>
         }
 };
 
+//
+// Options of a batcher, see IEvaluateModelExtended::CreateBatcher().
+//
+struct BatchingOptions
+{
+    // Maximum number of requests that are evaluated together in one forward pass.
+    size_t m_maxBatchRequests;
+
+    // Maximum number of samples (steps along the dynamic axis of the first input, summed over the requests)
+    // in one forward pass, 0 for no limit. A single request that exceeds it is evaluated on its own.
+    size_t m_maxBatchSamples;
+
+    // Maximum time the first request of a batch waits for more requests to arrive, in microseconds.
+    size_t m_maxLatencyMicroseconds;
+
+    BatchingOptions() : m_maxBatchRequests(64), m_maxBatchSamples(0), m_maxLatencyMicroseconds(2000) {}
+};
+
+//
+// Throughput and latency counters of a batcher, accumulated since it was created.
+//
+struct BatchingStatistics
+{
+    size_t m_numRequests;         // completed requests, including failed ones
+    size_t m_numFailedRequests;
+    size_t m_numBatches;          // forward passes
+    size_t m_numSamples;          // samples of the first input, summed over all requests
+    size_t m_numPaddingSamples;   // gaps in the minibatches of the first input, summed over all batches
+    double m_totalQueueSeconds;   // time from submission until the evaluation of its batch started, summed over all requests
+    double m_totalLatencySeconds; // time from submission until the results were available, summed over all requests
+    double m_maxLatencySeconds;
+    double m_evaluationSeconds;   // time spent evaluating batches
+    double m_elapsedSeconds;      // time since the batcher was created
+};
+
+//
+// Batching front-end for an evaluator. Requests that are submitted concurrently from several threads
+// are queued and evaluated together in a single forward pass; every request is a single sequence per
+// input, of any length, and the sequences are packed into one minibatch. A batch is evaluated once it
+// is full (see BatchingOptions) or once its first request has waited for the latency budget.
+//
+template <typename ElemType>
+class IEvaluateModelBatcher
+{
+public:
+    //
+    // ForwardPass - Evaluate a single request. Same as IEvaluateModelExtended::ForwardPass(), except that
+    // it is thread-safe and that recurrent state is always reset. Blocks until the batch containing the
+    // request has been evaluated. An error in one request (e.g. a malformed input or a too small output
+    // buffer) does not fail the other requests of the batch.
+    //
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs) = 0;
+
+    //
+    // GetStatistics - retrieve the throughput and latency counters.
+    //
+    virtual BatchingStatistics GetStatistics() const = 0;
+
+    //
+    // Destroy - evaluate the pending requests and free the batcher.
+    //
+    virtual void Destroy() = 0;
+};
+
 //
 // Extended interface, allowing for sparse input.
 // Implementation constraints: 
@@ -355,6 +419,23 @@ public:
     // resetRNN - flags whether to reset memory cells of RNN. 
     //
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) = 0;
+
+    //
+    // CreateSession - create another evaluator for the same model and outputs that shares the model parameters
+    // with this one, but has its own activations. ForwardPass() can be called concurrently on different sessions
+    // (and this evaluator), one thread per session, while only one copy of the weights is kept in memory.
+    // Must be called after StartForwardEvaluation(); the returned session is started for the same outputs.
+    // The session is a copy of the network structure, the model is not loaded again.
+    // A session is freed with Destroy(); sessions and this evaluator can be destroyed in any order.
+    //
+    virtual IEvaluateModelExtended<ElemType>* CreateSession() = 0;
+
+    //
+    // CreateBatcher - create a batching front-end that evaluates concurrent requests for the outputs of this
+    // evaluator in common forward passes. It evaluates on a session of its own (see CreateSession()) in a
+    // background thread, this evaluator stays usable. Must be called after StartForwardEvaluation().
+    //
+    virtual IEvaluateModelBatcher<ElemType>* CreateBatcher(const BatchingOptions& options) = 0;
 };
 
 template <typename ElemType>
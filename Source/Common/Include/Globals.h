@@ -29,10 +29,18 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static bool ShouldEnableShareNodeValueMatrices() { return m_enableShareNodeValueMatrices; }
 
         static void SetNodeTiming(bool enable) { m_enableNodeTiming = enable; }
-        static bool ShouldEnableNodeTiming() { return m_enableNodeTiming; }
+        static bool ShouldEnableNodeTiming() { return m_enableNodeTiming || m_enableNodeProfiling; }
+
+        // node profiling (NodeProfiler) is built on node timing, so it enables node timing as well
+        static void SetNodeProfiling(bool enable) { m_enableNodeProfiling = enable; }
+        static bool ShouldEnableNodeProfiling() { return m_enableNodeProfiling; }
 
         static void SetMPIPackThreshold(std::size_t packThreholdInBytes) { m_mpiPackThresholdInBytes = packThreholdInBytes; }
         static std::size_t GetMPIPackThreshold() { return m_mpiPackThresholdInBytes; }
+
+        // number of threads used to execute independent nodes of a network concurrently (CPU only; 0 or 1 = serial)
+        static void SetNodeExecutionThreads(std::size_t numThreads) { m_nodeExecutionThreads = numThreads; }
+        static std::size_t GetNodeExecutionThreads() { return m_nodeExecutionThreads; }
     private:
         static std::atomic<bool> m_forceDeterministicAlgorithms;
         // The global flag to enable matrices values in forward and backward prop
@@ -40,6 +48,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
         static std::atomic<bool> m_enableNodeTiming;
+        static std::atomic<bool> m_enableNodeProfiling;
         static std::atomic<std::size_t> m_mpiPackThresholdInBytes;
+        static std::atomic<std::size_t> m_nodeExecutionThreads;
     };
 }}}
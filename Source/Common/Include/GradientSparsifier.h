@@ -0,0 +1,233 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "Basics.h"
+#include "MPIWrapper.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Aggregation of gradients that exchanges only the largest values of each gradient, as (index, value) pairs
+// gathered from all workers. The values that are not sent are accumulated in a residual that is added to the
+// gradient of the next aggregation (error feedback), so no part of the gradient is lost, it is only delayed.
+//
+// A value is sent if it is one of the 'topKRatio' * N values of largest magnitude of its gradient (top-k mode,
+// topKRatio > 0) or if its magnitude is at least 'threshold' (threshold mode).
+//
+// The residuals are kept for the whole training, across epochs, so they are only lost when the process restarts.
+//
+// The gradients and residuals are in CPU memory. Each worker sends one message with the pairs of all gradients:
+//   uint32_t: number of pairs of each gradient
+//   for each gradient: uint32_t indices of the pairs, followed by the values of the pairs
+
+// Exchanges the messages of all workers: each worker passes its message and receives the messages of all workers
+// (its own included) concatenated in the order of their ranks, together with the size of each of them.
+typedef std::function<void(const std::vector<char>& message, std::vector<char>& messages, std::vector<size_t>& messageSizes)> SparseMessageExchange;
+
+// Exchanges the messages with an allgather over all the nodes in use of an MPIWrapper.
+inline SparseMessageExchange MPISparseMessageExchange(const MPIWrapperPtr& mpi)
+{
+    return [mpi](const std::vector<char>& message, std::vector<char>& messages, std::vector<size_t>& messageSizes)
+    {
+        // Exchange the sizes of the messages, then the messages.
+        size_t numWorkers = mpi->NumNodesInUse();
+        int messageSize = (int)message.size();
+        std::vector<int> sizes(numWorkers), offsets(numWorkers);
+        mpi->AllGather(&messageSize, 1, sizes.data(), 1);
+
+        size_t totalSize = 0;
+        for (size_t i = 0; i < numWorkers; i++)
+        {
+            offsets[i] = (int)totalSize;
+            totalSize += sizes[i];
+        }
+        if (totalSize > INT_MAX)
+            RuntimeError("GradientSparsifier: %zu bytes of sparse gradients exceed the size of a single MPI message.", totalSize);
+
+        messages.resize(totalSize);
+        mpi->Allgatherv(message.data(), message.size(), messages.data(), sizes.data(), offsets.data());
+        messageSizes.assign(sizes.begin(), sizes.end());
+    };
+}
+
+template <class ElemType>
+class GradientSparsifier
+{
+public:
+    struct Gradient
+    {
+        ElemType* data;
+        size_t numElements;
+    };
+
+    GradientSparsifier(size_t numWorkers, const SparseMessageExchange& exchange, double topKRatio, double threshold)
+        : m_numWorkers(numWorkers), m_exchange(exchange), m_topKRatio(topKRatio), m_threshold(threshold), m_bytesSent(0), m_bytesReceived(0)
+    {
+        if (topKRatio < 0 || topKRatio > 1)
+            InvalidArgument("GradientSparsifier: the top-k ratio must be in [0, 1], got %g.", topKRatio);
+        if (topKRatio == 0 && threshold <= 0)
+            InvalidArgument("GradientSparsifier: either a top-k ratio or a positive threshold is required.");
+    }
+
+    // Replaces the gradients by their sum over all workers. The gradients have to be passed in the same order
+    // on every call (and on all workers), their residuals are matched by position.
+    void AggregateInPlace(const std::vector<Gradient>& gradients)
+    {
+        if (m_numWorkers == 1)
+            return;
+
+        if (m_residuals.size() != gradients.size())
+        {
+            m_residuals.resize(gradients.size());
+            for (size_t i = 0; i < gradients.size(); i++)
+                m_residuals[i].assign(gradients[i].numElements, 0);
+        }
+
+        std::vector<char> message;
+        Sparsify(gradients, message);
+
+        std::vector<char> messages;
+        std::vector<size_t> messageSizes;
+        m_exchange(message, messages, messageSizes);
+        if (messageSizes.size() != m_numWorkers)
+            LogicError("GradientSparsifier: received %zu messages from %zu workers.", messageSizes.size(), m_numWorkers);
+
+        for (const auto& gradient : gradients)
+            std::fill(gradient.data, gradient.data + gradient.numElements, (ElemType)0);
+
+        size_t offset = 0;
+        for (size_t i = 0; i < m_numWorkers; i++)
+        {
+            if (messageSizes[i] > messages.size() - offset)
+                RuntimeError("GradientSparsifier: received a truncated message.");
+            Accumulate(gradients, messages.data() + offset, messageSizes[i]);
+            offset += messageSizes[i];
+        }
+
+        m_bytesSent = message.size();
+        m_bytesReceived = messages.size() - message.size();
+    }
+
+    // Bytes sent and received by this worker in the last aggregation.
+    size_t BytesSent() const { return m_bytesSent; }
+    size_t BytesReceived() const { return m_bytesReceived; }
+
+private:
+    // Adds the residuals to the gradients, selects the values to send and keeps the others as the new residuals.
+    void Sparsify(const std::vector<Gradient>& gradients, std::vector<char>& message)
+    {
+        std::vector<std::vector<uint32_t>> indices(gradients.size());
+        std::vector<ElemType> magnitudes;
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            const auto& gradient = gradients[i];
+            if (gradient.numElements > UINT32_MAX)
+                RuntimeError("GradientSparsifier: gradients of more than %u elements are not supported.", UINT32_MAX);
+
+            auto& residual = m_residuals[i];
+            if (residual.size() != gradient.numElements)
+                LogicError("GradientSparsifier: the size of gradient %zu has changed.", i);
+
+            for (size_t j = 0; j < gradient.numElements; j++)
+                residual[j] += gradient.data[j];
+
+            // In top-k mode the threshold is the k-th largest magnitude.
+            ElemType threshold = (ElemType)m_threshold;
+            size_t maxCount = gradient.numElements;
+            if (m_topKRatio > 0 && gradient.numElements > 0)
+            {
+                maxCount = std::max<size_t>(1, (size_t)std::ceil(m_topKRatio * gradient.numElements));
+                magnitudes.resize(gradient.numElements);
+                for (size_t j = 0; j < gradient.numElements; j++)
+                    magnitudes[j] = std::abs(residual[j]);
+                std::nth_element(magnitudes.begin(), magnitudes.begin() + (maxCount - 1), magnitudes.end(), std::greater<ElemType>());
+                threshold = magnitudes[maxCount - 1];
+            }
+
+            for (size_t j = 0; j < gradient.numElements && indices[i].size() < maxCount; j++)
+            {
+                if (std::abs(residual[j]) >= threshold && residual[j] != 0)
+                    indices[i].push_back((uint32_t)j);
+            }
+        }
+
+        size_t size = gradients.size() * sizeof(uint32_t);
+        for (const auto& gradientIndices : indices)
+            size += gradientIndices.size() * (sizeof(uint32_t) + sizeof(ElemType));
+        message.resize(size);
+
+        char* position = message.data();
+        for (const auto& gradientIndices : indices)
+            position = Write(position, (uint32_t)gradientIndices.size());
+
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            auto& residual = m_residuals[i];
+            for (uint32_t index : indices[i])
+                position = Write(position, index);
+            for (uint32_t index : indices[i])
+            {
+                position = Write(position, residual[index]);
+                residual[index] = 0;
+            }
+        }
+    }
+
+    // Adds the values of a message to the gradients.
+    void Accumulate(const std::vector<Gradient>& gradients, const char* message, size_t size)
+    {
+        if (size < gradients.size() * sizeof(uint32_t))
+            RuntimeError("GradientSparsifier: received a truncated message.");
+
+        const char* end = message + size;
+        const char* counts = message;
+        const char* position = message + gradients.size() * sizeof(uint32_t);
+        for (size_t i = 0; i < gradients.size(); i++)
+        {
+            uint32_t count;
+            memcpy(&count, counts + i * sizeof(count), sizeof(count));
+            if ((size_t)(end - position) < count * (sizeof(uint32_t) + sizeof(ElemType)))
+                RuntimeError("GradientSparsifier: received a truncated message.");
+
+            const char* values = position + count * sizeof(uint32_t);
+            for (uint32_t j = 0; j < count; j++)
+            {
+                uint32_t index;
+                ElemType value;
+                memcpy(&index, position + j * sizeof(index), sizeof(index));
+                memcpy(&value, values + j * sizeof(value), sizeof(value));
+                if (index >= gradients[i].numElements)
+                    RuntimeError("GradientSparsifier: received an index out of bounds.");
+                gradients[i].data[index] += value;
+            }
+            position = values + count * sizeof(ElemType);
+        }
+    }
+
+    template <class T>
+    static char* Write(char* position, const T& value)
+    {
+        memcpy(position, &value, sizeof(value));
+        return position + sizeof(value);
+    }
+
+    const size_t m_numWorkers;
+    SparseMessageExchange m_exchange;
+    const double m_topKRatio;
+    const double m_threshold;
+    std::vector<std::vector<ElemType>> m_residuals;
+    size_t m_bytesSent;
+    size_t m_bytesReceived;
+};
+
+}}}
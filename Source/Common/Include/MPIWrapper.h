@@ -101,6 +101,8 @@ public:
     virtual int Wait(MPI_Request* request, MPI_Status* status) = 0;
     virtual int Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* status) = 0;
     virtual int Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]) = 0;
+    virtual int Test(MPI_Request* request, int* flag, MPI_Status* status) = 0;
+    virtual int Testall(int count, MPI_Request array_of_requests[], int* flag, MPI_Status array_of_statuses[]) = 0;
     virtual int Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, /*MPI_Comm comm,*/ MPI_Request* request) = 0;
     virtual int Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Status* status) = 0;
     virtual int Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Request* request) = 0;
@@ -169,6 +171,8 @@ public:
     virtual void Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const = 0;
     virtual void Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const = 0;
 
+    virtual void Allgatherv(const char *sendData, size_t numSendElements, char *receiveData, int recvCounts[], int offsets[]) const = 0;
+
     // wait for all ranks to reach here
     virtual int WaitAll() = 0;
     virtual void WaitAny(MPI_Request* requests, int numRequests, int* index) = 0;
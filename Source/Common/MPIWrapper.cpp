@@ -83,6 +83,8 @@ public:
     virtual int Wait(MPI_Request* request, MPI_Status* status);
     virtual int Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* status);
     virtual int Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]);
+    virtual int Test(MPI_Request* request, int* flag, MPI_Status* status);
+    virtual int Testall(int count, MPI_Request array_of_requests[], int* flag, MPI_Status array_of_statuses[]);
     virtual int Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, /*MPI_Comm comm,*/ MPI_Request* request);
     virtual int Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Status* status);
     virtual int Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Request* request);
@@ -144,6 +146,8 @@ public:
     virtual void Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
     virtual void Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
 
+    virtual void Allgatherv(const char *sendData, size_t numSendElements, char *receiveData, int recvCounts[], int offsets[]) const;
+
     // wait for all ranks to reach here
     virtual int WaitAll();
     virtual void WaitAny(MPI_Request* requests, int numRequests, int* index);
@@ -180,6 +184,8 @@ public:
     virtual int Wait(MPI_Request* request, MPI_Status* status);
     virtual int Waitany(int count, MPI_Request array_of_requests[], int* index, MPI_Status* status);
     virtual int Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]);
+    virtual int Test(MPI_Request* request, int* flag, MPI_Status* status);
+    virtual int Testall(int count, MPI_Request array_of_requests[], int* flag, MPI_Status array_of_statuses[]);
     virtual int Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, /*MPI_Comm comm,*/ MPI_Request* request);
     virtual int Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Status* status);
     virtual int Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, /*MPI_Comm comm,*/ MPI_Request* request);
@@ -241,6 +247,8 @@ public:
     virtual void Gatherv(const float *sendData, size_t numSendElements, float *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
     virtual void Gatherv(const double *sendData, size_t numSendElements, double *receiveData, int recvCounts[], int offsets[], size_t rootRank) const;
 
+    virtual void Allgatherv(const char *sendData, size_t numSendElements, char *receiveData, int recvCounts[], int offsets[]) const;
+
     // wait for all ranks to reach here
     virtual int WaitAll();
     virtual void WaitAny(MPI_Request* requests, int numRequests, int* index);
@@ -626,6 +634,16 @@ int MPIWrapperMpi::Waitall(int count, MPI_Request array_of_requests[], MPI_Statu
     return MPI_Waitall(count, array_of_requests, array_of_statuses);
 }
 
+int MPIWrapperMpi::Test(MPI_Request* request, int* flag, MPI_Status* status)
+{
+    return MPI_Test(request, flag, status);
+}
+
+int MPIWrapperMpi::Testall(int count, MPI_Request array_of_requests[], int* flag, MPI_Status array_of_statuses[])
+{
+    return MPI_Testall(count, array_of_requests, flag, array_of_statuses);
+}
+
 int MPIWrapperMpi::Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Request* request)
 {
     return MPI_Isend(buf, count, datatype, dest, tag, m_currentComm, request);
@@ -929,6 +947,11 @@ void MPIWrapperMpi::Gatherv(const double *sendData, size_t numSendElements, doub
     MPI_Gatherv(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, recvCounts, offsets, GetDataType(receiveData), (int)rootRank, Communicator()) || MpiFail("AllReduceAsync: MPI_Gatherv");
 }
 
+void MPIWrapperMpi::Allgatherv(const char *sendData, size_t numSendElements, char *receiveData, int recvCounts[], int offsets[]) const
+{
+    MPI_Allgatherv(sendData, (int)numSendElements, GetDataType(receiveData), receiveData, recvCounts, offsets, GetDataType(receiveData), Communicator()) || MpiFail("Allgatherv: MPI_Allgatherv");
+}
+
 // wait for an async request to finish
 void MPIWrapperMpi::Wait(MPI_Request* request)
 {
@@ -1009,6 +1032,16 @@ int MPIWrapperEmpty::Waitall(int count, MPI_Request array_of_requests[], MPI_Sta
     return MPI_UNDEFINED;
 }
 
+int MPIWrapperEmpty::Test(MPI_Request* request, int* flag, MPI_Status* status)
+{
+    return MPI_UNDEFINED;
+}
+
+int MPIWrapperEmpty::Testall(int count, MPI_Request array_of_requests[], int* flag, MPI_Status array_of_statuses[])
+{
+    return MPI_UNDEFINED;
+}
+
 int MPIWrapperEmpty::Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Request* request)
 {
     return MPI_UNDEFINED;
@@ -1248,6 +1281,10 @@ void MPIWrapperEmpty::Gatherv(const double *sendData, size_t numSendElements, do
 {
 }
 
+void MPIWrapperEmpty::Allgatherv(const char *sendData, size_t numSendElements, char *receiveData, int recvCounts[], int offsets[]) const
+{
+}
+
 
 void MPIWrapperEmpty::Wait(MPI_Request* request)
 {
@@ -31,6 +31,7 @@
 #include <set>
 
 #include "ComputationGraphAlgorithms.h"
+#include "WorkStealingThreadPool.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -148,7 +149,11 @@ public:
     void PostForwardAndBackProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // 'onGradientReady' is called for each learnable parameter as soon as its gradient is complete, while the
+    // backward pass continues with the remaining nodes (used to overlap gradient aggregation with the backward pass).
+    // The parameters are notified in reverse evaluation order. When nodes execute in parallel (see
+    // Globals::GetNodeExecutionThreads()) it is called from the threads that execute them, one call at a time.
+    void Backprop(const ComputationNodeBasePtr rootNode, const std::function<void(const ComputationNodeBasePtr&)>& onGradientReady = nullptr);
 
     template <class NODESET> // version that takes multiple nodes
     void TravserseInSortedGlobalEvalOrder(const NODESET& nodes, const std::function<void(const ComputationNodeBasePtr&)>& action)
@@ -267,6 +272,7 @@ private:
     void VerifyIsCompiled(const char* where) const;
 public:
     void AllocateAllMatrices(const std::vector<ComputationNodeBasePtr>& evalRootNodes, const std::vector<ComputationNodeBasePtr>& outValueRootNodes, ComputationNodeBasePtr trainRootNode);
+    void OptimizeMemorySharingForMinibatch();
 
     // From the set of nodes extract all nodes which are used as accumulator nodes.
     std::set<ComputationNodeBasePtr> ExtractNodesWhichAccumulateResult(std::set<ComputationNodeBasePtr> nodes);
@@ -464,6 +470,7 @@ public:
     ComputationNodeBasePtr CopyNode(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toName, const CopyNodeFlags flags);
     void CopySubTree(const ComputationNetwork& fromNet, const std::wstring fromName, std::wstring toNamePrefix, const CopyNodeFlags flags);
     void CopyInputs(const std::wstring fromName, std::wstring toName);
+    ComputationNetworkPtr CloneSharingModelState() const;
     void RenameNode(const std::wstring& nodeNameOrig, const std::wstring& nodeNameNew);
     void RenameNode(ComputationNodeBasePtr node, const std::wstring& newNodeName);
     void DeleteNode(const std::wstring& nodeName);
@@ -1142,6 +1149,8 @@ protected:
         }
         virtual void EndBackprop() override;
         virtual void Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) override;
+        virtual void BeginTiming(bool backward) override;
+        virtual void EndTiming(bool backward) override;
         virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool);
         virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool);
         virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool);
@@ -1153,6 +1162,7 @@ protected:
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
         int m_loopId;                        // unique loop id, index in m_allSEQNodes array
         int m_steppingDirection;             // +1 if left to right (t=0..T-1), -1 if rightt to left (t=T-1..0)
+        std::chrono::system_clock::time_point m_timingBegin; // start of the loop, for the node profiler trace
 
         SEQTraversalFlowControlNode(int loopId, ComputationNodeBasePtr cur)
             : m_loopId(loopId),
@@ -1201,6 +1211,7 @@ protected:
         virtual void EndBackprop() override {}
 
         virtual void Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) override;
+        void Backprop(const FrameRange& fr, const std::function<void(const ComputationNodeBasePtr&)>& onGradientReady);
         virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool);
         virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool);
         virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool);
@@ -1212,6 +1223,28 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+    private:
+        // Dependencies between the top-level nodes for executing them concurrently (see Globals::GetNodeExecutionThreads()).
+        // A node depends on the nodes it consumes (forward) or that consume it (backward), and on all nodes that
+        // precede it in serial order and access one of its matrices in a conflicting way. The latter is what keeps
+        // matrices that the MatrixPool shares between nodes safe; the plan is rebuilt whenever the sharing changes.
+        struct ExecutionPlan
+        {
+            std::vector<const MatrixBase*> m_matrixAccesses; // the matrix accesses the plan was built for
+            std::vector<std::vector<size_t>> m_successors;
+            std::vector<size_t> m_numPredecessors;
+        };
+
+        bool ShouldExecuteInParallel() const;
+        void UpdateExecutionPlan(ExecutionPlan& plan, bool backward) const;
+        void Execute(const ExecutionPlan& plan, const std::function<void(size_t)>& task);
+
+        static void Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr);
+
+        ExecutionPlan m_forwardPlan;
+        ExecutionPlan m_backwardPlan;
+        std::shared_ptr<WorkStealingThreadPool> m_threadPool; // created on first use
     };
 
 public:
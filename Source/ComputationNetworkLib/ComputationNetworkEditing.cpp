@@ -103,6 +103,66 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+template <class ElemType>
+static bool TryShareValue(const ComputationNodeBasePtr& toNode, const ComputationNodeBasePtr& fromNode)
+{
+    auto typedToNode = dynamic_pointer_cast<ComputationNode<ElemType>>(toNode);
+    auto typedFromNode = dynamic_pointer_cast<ComputationNode<ElemType>>(fromNode);
+    if (!typedToNode || !typedFromNode)
+        return false;
+    typedToNode->ValuePtrRef() = typedFromNode->ValuePtrRef();
+    return true;
+}
+
+// Creates a copy of this network for evaluation, with the same nodes, input links and node groups, in which
+// the model state (learnable parameters and precomputed statistics) uses the value matrices of this network
+// instead of copies. All other values are allocated by the copy. Used to let several evaluators hold a single
+// copy of the weights; the shared values must not be modified while any of the networks is in use.
+ComputationNetworkPtr ComputationNetwork::CloneSharingModelState() const
+{
+    auto net = make_shared<ComputationNetwork>(m_deviceId);
+    net->SetTraceLevel(TraceLevel());
+    net->SetRandomSeedOffset(GetRandomSeedOffset());
+
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& fromNode = iter.second;
+        if (fromNode->RequiresPreCompute() && !dynamic_pointer_cast<IPreComputeNode>(fromNode)->HasComputed())
+            InvalidArgument("CloneSharingModelState: Node '%ls' has not been precomputed.", iter.first.c_str());
+
+        auto toNode = net->AddNodeToNet(fromNode->Duplicate(iter.first, CopyNodeFlags(CopyNodeFlags::copyNodeValue | CopyNodeFlags::copyNodeSkipValue)));
+        if (fromNode->OperationName() != OperationNameOf(LearnableParameter) && !fromNode->RequiresPreCompute())
+            continue;
+
+        if (!TryShareValue<float>(toNode, fromNode) && !TryShareValue<double>(toNode, fromNode) && !TryShareValue<half>(toNode, fromNode))
+            LogicError("CloneSharingModelState: Node '%ls' has an unexpected element type.", iter.first.c_str());
+    }
+
+    // the input links refer to the nodes of the copy
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& fromInputs = iter.second->GetInputs();
+        vector<ComputationNodeBasePtr> toInputs;
+        for (const auto& input : fromInputs)
+            toInputs.push_back(net->GetNodeFromName(input->NodeName()));
+        if (!toInputs.empty())
+            net->GetNodeFromName(iter.first)->AttachInputs(toInputs);
+    }
+
+    const pair<const wchar_t*, const vector<ComputationNodeBasePtr>*> nodeGroups[] = {
+        { L"feature", &m_featureNodes }, { L"label", &m_labelNodes }, { L"criterion", &m_criterionNodes },
+        { L"evaluation", &m_evaluationNodes }, { L"output", &m_outputNodes }
+    };
+    for (const auto& nodeGroup : nodeGroups)
+    {
+        for (const auto& node : *nodeGroup.second)
+            net->AddToNodeGroup(nodeGroup.first, net->GetNodeFromName(node->NodeName()));
+    }
+
+    net->CompileNetwork();
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
@@ -12,12 +12,15 @@
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
 #include "SpecialPurposeNodes.h"
+#include "NodeProfiler.h"
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
 #include <algorithm>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std;
 
@@ -41,6 +44,19 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
 
+    // the node profiler counts a new minibatch whenever one of the inputs has received new data
+    if (Globals::ShouldEnableNodeProfiling())
+    {
+        uint64_t inputTimeStamp = 0;
+        auto inputs = m_inputValues.find(rootNode);
+        if (inputs != m_inputValues.end())
+        {
+            for (const auto& input : inputs->second)
+                inputTimeStamp = max(inputTimeStamp, input->GetEvalTimeStamp());
+        }
+        NodeProfiler::NotifyInputTimeStamp(inputTimeStamp);
+    }
+
     // traverse all nodes in the pre-determined evaluation order
     GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
 }
@@ -73,7 +89,8 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, // training criterion to compute the gradients for
+                                  const std::function<void(const ComputationNodeBasePtr&)>& onGradientReady)
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
@@ -86,7 +103,10 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode));
+    if (!network)
+        LogicError("Backprop: The network for '%ls' is not a PAR traversal.", rootNode->NodeName().c_str());
+    network->Backprop(FrameRange(nullptr), onGradientReady);
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -162,6 +182,13 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    if (ShouldExecuteInParallel())
+    {
+        UpdateExecutionPlan(m_forwardPlan, /*backward=*/false);
+        Execute(m_forwardPlan, [this, &fr](size_t i) { ForwardProp(m_nestedNodes[i], fr); });
+        return;
+    }
+
     for (auto& node : m_nestedNodes)
         ForwardProp(node, fr);
 }
@@ -180,22 +207,229 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    Backprop(fr, nullptr);
+}
+
+// A learnable parameter is a leaf that comes before all of its consumers in evaluation order, so its gradient
+// is complete once the backward traversal reaches it.
+static bool IsGradientReady(const ComputationNodeBasePtr& node)
+{
+    return node->IsLeaf() && node->NeedsGradient();
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, const std::function<void(const ComputationNodeBasePtr&)>& onGradientReady)
+{
+    if (ShouldExecuteInParallel())
+    {
+        UpdateExecutionPlan(m_backwardPlan, /*backward=*/true);
+        if (!onGradientReady)
+        {
+            Execute(m_backwardPlan, [this, &fr](size_t i) { Backprop(m_nestedNodes[i], fr); });
+            return;
+        }
+
+        // Notify in serial order, so that the order is the same on all workers of a distributed training:
+        // a node is notified as soon as it and all nodes after it in evaluation order are done.
+        std::vector<bool> done(m_nestedNodes.size(), false);
+        size_t numNotified = 0; // counted from the end of m_nestedNodes
+        std::mutex notifyLock;
+        Execute(m_backwardPlan, [&](size_t i)
+        {
+            Backprop(m_nestedNodes[i], fr);
+
+            std::lock_guard<std::mutex> lock(notifyLock);
+            done[i] = true;
+            for (; numNotified < done.size() && done[done.size() - 1 - numNotified]; numNotified++)
+            {
+                const auto& node = m_nestedNodes[done.size() - 1 - numNotified];
+                if (IsGradientReady(node))
+                    onGradientReady(node);
+            }
+        });
+        return;
+    }
+
     // process nodes in pre-determined order
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
     {
-        auto& node = *pnode;
+        Backprop(*pnode, fr);
+        if (onGradientReady && IsGradientReady(*pnode))
+            onGradientReady(*pnode);
+    }
+}
 
-        node->BeginBackprop();
-        node->BeginTiming(true /*backward*/);
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndTiming(true /*backward*/);
-        node->EndBackprop();
+/*static*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    node->BeginBackprop();
+    node->BeginTiming(true /*backward*/);
+    node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+    node->EndTiming(true /*backward*/);
+    node->EndBackprop();
+
+    // Extreme Tracing, part 2/4
+    if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
+        DumpNode(node, /*dumpGradient=*/true);
+}
 
-        // Extreme Tracing, part 2/4
-        if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
-            DumpNode(node, /*dumpGradient=*/true);
+// -----------------------------------------------------------------------
+// parallel execution of the top-level nodes
+// -----------------------------------------------------------------------
+
+// the nodes that make up a top-level node (the loop members for a SEQTraversalFlowControlNode)
+static vector<ComputationNodeBasePtr> GetMemberNodes(const ComputationNodeBasePtr& node)
+{
+    auto flowControlNode = dynamic_pointer_cast<FlowControlNode>(node);
+    if (flowControlNode)
+        return flowControlNode->m_nestedNodes;
+    return vector<ComputationNodeBasePtr>{ node };
+}
+
+bool ComputationNetwork::PARTraversalFlowControlNode::ShouldExecuteInParallel() const
+{
+    if (Globals::GetNodeExecutionThreads() <= 1 || m_nestedNodes.size() <= 1)
+        return false;
+
+    // GPU nodes are already asynchronous on a single stream, and the node dumps must not be interleaved
+    for (const auto& nestedNode : m_nestedNodes)
+    {
+        for (const auto& node : GetMemberNodes(nestedNode))
+        {
+            if (node->GetDeviceId() != CPUDEVICE || (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode()))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Collects the matrices a top-level node accesses, as (matrix, isWrite) pairs.
+// Forward: the node writes its value and temporaries and reads the values of its inputs.
+// Backward: the node reads its value and gradient and the values of its inputs, and writes the gradients of its inputs and its temporaries.
+static void CollectMatrixAccesses(const ComputationNodeBasePtr& nestedNode, bool backward, vector<pair<const MatrixBase*, bool>>& accesses)
+{
+    auto add = [&accesses](const MatrixBasePtr& matrix, bool isWrite)
+    {
+        if (matrix)
+            accesses.push_back(make_pair(matrix.get(), isWrite));
+    };
+
+    for (const auto& node : GetMemberNodes(nestedNode))
+    {
+        if (!backward)
+            add(node->ValuePtr(), /*isWrite=*/true);
+        else
+        {
+            add(node->ValuePtr(), /*isWrite=*/false);
+            add(node->GradientPtr(), /*isWrite=*/false);
+        }
+
+        for (const auto& matrix : node->GetPooledMatrices())
+            add(matrix, /*isWrite=*/true);
+
+        for (const auto& input : node->GetInputs())
+        {
+            add(input->ValuePtr(), /*isWrite=*/false);
+            if (backward && input->NeedsGradient())
+                add(input->GradientPtr(), /*isWrite=*/true);
+        }
     }
 }
+
+void ComputationNetwork::PARTraversalFlowControlNode::UpdateExecutionPlan(ExecutionPlan& plan, bool backward) const
+{
+    size_t numTasks = m_nestedNodes.size();
+
+    vector<vector<pair<const MatrixBase*, bool>>> accesses(numTasks);
+    vector<const MatrixBase*> matrixAccesses;
+    for (size_t i = 0; i < numTasks; i++)
+    {
+        CollectMatrixAccesses(m_nestedNodes[i], backward, accesses[i]);
+        for (const auto& access : accesses[i])
+        {
+            matrixAccesses.push_back(access.first);
+            matrixAccesses.push_back(access.second ? access.first : nullptr);
+        }
+        matrixAccesses.push_back(nullptr);
+    }
+    if (!plan.m_successors.empty() && matrixAccesses == plan.m_matrixAccesses)
+        return; // nothing has changed
+
+    vector<std::set<size_t>> successors(numTasks);
+    auto addEdge = [&successors](size_t earlier, size_t later)
+    {
+        if (earlier != later && earlier != SIZE_MAX)
+            successors[earlier].insert(later);
+    };
+
+    // data flow: forward, a node runs after the nodes it consumes; backward, after the nodes that consume it
+    map<const ComputationNodeBase*, size_t> taskOf;
+    for (size_t i = 0; i < numTasks; i++)
+    {
+        for (const auto& node : GetMemberNodes(m_nestedNodes[i]))
+            taskOf[node.get()] = i;
+    }
+    for (size_t i = 0; i < numTasks; i++)
+    {
+        for (const auto& node : GetMemberNodes(m_nestedNodes[i]))
+        {
+            for (const auto& input : node->GetInputs())
+            {
+                auto iter = taskOf.find(input.get());
+                if (iter == taskOf.end())
+                    continue;
+                if (backward)
+                    addEdge(i, iter->second);
+                else
+                    addEdge(iter->second, i);
+            }
+        }
+    }
+
+    // conflicting matrix accesses, in the order of serial execution: a write waits for the preceding
+    // write and all reads since then, a read waits for the preceding write
+    struct MatrixState
+    {
+        size_t m_lastWriter = SIZE_MAX;
+        vector<size_t> m_readersSinceWrite;
+    };
+    unordered_map<const MatrixBase*, MatrixState> states;
+    for (size_t k = 0; k < numTasks; k++)
+    {
+        size_t i = backward ? numTasks - 1 - k : k;
+        for (const auto& access : accesses[i])
+        {
+            auto& state = states[access.first];
+            addEdge(state.m_lastWriter, i);
+            if (access.second)
+            {
+                for (size_t reader : state.m_readersSinceWrite)
+                    addEdge(reader, i);
+                state.m_lastWriter = i;
+                state.m_readersSinceWrite.clear();
+            }
+            else
+                state.m_readersSinceWrite.push_back(i);
+        }
+    }
+
+    plan.m_matrixAccesses = move(matrixAccesses);
+    plan.m_successors.assign(numTasks, vector<size_t>());
+    plan.m_numPredecessors.assign(numTasks, 0);
+    for (size_t i = 0; i < numTasks; i++)
+    {
+        plan.m_successors[i].assign(successors[i].begin(), successors[i].end());
+        for (size_t successor : successors[i])
+            plan.m_numPredecessors[successor]++;
+    }
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::Execute(const ExecutionPlan& plan, const std::function<void(size_t)>& task)
+{
+    size_t numThreads = Globals::GetNodeExecutionThreads();
+    if (!m_threadPool || m_threadPool->NumThreads() != numThreads)
+        m_threadPool = make_shared<WorkStealingThreadPool>(numThreads);
+
+    m_threadPool->Execute(plan.m_successors, plan.m_numPredecessors, task);
+}
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
 }
@@ -345,6 +579,19 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     }
 }
 
+// The loop as a whole is only timed for the node profiler trace, the nodes in the loop are timed individually.
+/*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::BeginTiming(bool /*backward*/) /*override*/
+{
+    if (Globals::ShouldEnableNodeProfiling())
+        m_timingBegin = NodeProfiler::Clock::now();
+}
+
+/*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndTiming(bool backward) /*override*/
+{
+    if (Globals::ShouldEnableNodeProfiling())
+        NodeProfiler::Record(*this, backward, m_timingBegin, NodeProfiler::Clock::now());
+}
+
 // called after last iteration step of ComputeGradient()
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndBackprop() /*override*/
 {
@@ -353,7 +600,9 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     for (auto nodeIter2 = m_nestedNodes.rbegin(); nodeIter2 != m_nestedNodes.rend(); ++nodeIter2)
     {
         auto& node2 = *nodeIter2;
+        node2->BeginTiming(true /*backward*/);
         node2->Backprop(FrameRange(m_nestedNodes[0]->GetMBLayout()), false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        node2->EndTiming(true /*backward*/);
     }
 
     // tell all nodes we are done for this iteraTion
@@ -1271,9 +1520,8 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     m_matrixPool.OptimizedMemoryAllocation(); 
     m_areMatricesAllocated = true;
 
-    // TO DO: At the time of AllocateAllMatrices we don't know the minibatch size. In theory one may allocate memory again once we start to receive
-    // data from the reader (and the minibatch size is known). For some problems, minibatch size can change constantly, and there needs to be a 
-    // tradeoff in deciding how frequent to run optimized memory allocation. For now, we do it only once at the very beginning for speed concerns. 
+    // At the time of AllocateAllMatrices we don't know the minibatch size. The plan is refined by OptimizeMemorySharingForMinibatch() once
+    // we start to receive data from the reader, and again whenever the minibatch grows beyond what it was planned for.
 
     // TO DO: when some matrices are sparse, the memory size request may be wrong. One may need to call OptimizedMemoryAllocation later again 
     // if the requests of sparse allocation and release are re-processed correctly. Future work. 
@@ -1283,6 +1531,38 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         PrintMemorySharingStructure(GetAllNodes());
 }
 
+// re-plan memory sharing with the actual size of the current minibatch
+// This must be called after a new minibatch has been loaded into the input nodes and before the first ForwardProp() on it,
+// since the content of shared matrices does not survive re-planning. The plan is only updated if the minibatch is larger
+// than any seen before.
+void ComputationNetwork::OptimizeMemorySharingForMinibatch()
+{
+    if (!m_areMatricesAllocated)
+        return;
+
+    // the largest number of columns over all dynamic axes (e.g. a label sequence may be longer than the feature sequence)
+    size_t numColumns = 0;
+    for (const auto& nodes : { FeatureNodes(), LabelNodes() })
+    {
+        for (const auto& node : nodes)
+        {
+            if (node->HasMBLayout())
+                numColumns = max(numColumns, node->GetMBLayout()->GetNumCols());
+        }
+    }
+
+    MemoryPlanStatistics stats;
+    if (!m_matrixPool.OptimizedMemoryAllocationForMinibatchSize(numColumns, stats))
+        return;
+
+    if (TraceLevel() > 0)
+    {
+        const double MB = 1024.0 * 1024.0;
+        fprintf(stderr, "\nMemory sharing re-planned for minibatches of up to %d columns: %.1f MB before, %.1f MB after (%.1f MB if packed into one arena per device).\n",
+                (int)numColumns, stats.previousBytes / MB, stats.plannedBytes / MB, stats.arenaBytes / MB);
+    }
+}
+
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap)
 {
     for (int i = 0; i < n->GetNumInputs(); i++)
@@ -12,6 +12,7 @@
 
 #ifndef  CNTK_UWP
 #include "PerformanceProfiler.h"
+#include "NodeProfiler.h"
 #ifdef _WIN32
 #define PERFORMANCE_PROFILER_LIB_NAME "Cntk.PerformanceProfiler-"##CNTK_COMPONENT_VERSION##".lib"
 #pragma comment(lib, PERFORMANCE_PROFILER_LIB_NAME)
@@ -798,7 +799,10 @@ template <class ElemType>
 
     int phase = (backward ? (int)TimingPhase_Backward : (int)TimingPhase_Forward);
     auto& timing = m_timing[phase];
-    timing.duration += (std::chrono::system_clock::now() - timing.beginTime);
+    auto endTime = std::chrono::system_clock::now();
+    timing.duration += (endTime - timing.beginTime);
+    if (Globals::ShouldEnableNodeProfiling())
+        NodeProfiler::Record(*this, backward, timing.beginTime, endTime);
 
 #ifndef  CNTK_UWP
     // the order must match enum
@@ -810,7 +814,8 @@ template <class ElemType>
 
     if (timing.profilerName.length() != m_nodeName.length() + strlen(postfixes[phase]))
     {
-        static char name[256];
+        // not static: nodes may finish their timing concurrently when executed in parallel
+        char name[256];
         sprintf_s(name, _countof(name), "%S%s", m_nodeName.c_str(), postfixes[phase]);
         timing.profilerName = name;
     }
@@ -15,7 +15,9 @@
 #include "Globals.h"
 
 #include <unordered_set>
+#include <set>
 #include <map>
+#include <functional>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -75,7 +77,8 @@ enum CopyNodeFlags // flags to be passed to the CopyTo() function
     copyNodeValue          = 1, // copy everything except for the input links
     copyNodeInputLinks     = 2, // copy over input links
     copyNodeAll            = 3, // copy everything
-    copyNodeAcrossNetworks = 4  // allow a cross network child copy
+    copyNodeAcrossNetworks = 4, // allow a cross network child copy
+    copyNodeSkipValue      = 8  // with copyNodeValue: don't copy the value and gradient matrices, the copy keeps its own
 };
 
 #pragma region base computation class
@@ -672,6 +675,52 @@ public:
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
     virtual MatrixBasePtr ValuePtr() const = 0; // for use in readers that pass the agnostic object around
+    virtual MatrixBasePtr GradientPtr() const = 0;
+
+    // matrices this node has requested from the MatrixPool (value, gradient and temporaries);
+    // these may be shared with other nodes, which the parallel node execution needs to know about
+    std::vector<MatrixBasePtr> GetPooledMatrices() const
+    {
+        std::vector<MatrixBasePtr> matrices;
+        for (const auto& pooledMatrix : m_pooledMatrices)
+        {
+            auto matrix = pooledMatrix.second.getMatrix();
+            if (matrix)
+                matrices.push_back(matrix);
+        }
+        return matrices;
+    }
+
+    // bytes currently allocated for the matrices this node has requested from the MatrixPool
+    size_t GetPooledMatrixBytes() const
+    {
+        std::set<const MatrixBase*> seen;
+        size_t bytes = 0;
+        for (const auto& pooledMatrix : m_pooledMatrices)
+        {
+            auto matrix = pooledMatrix.second.getMatrix();
+            if (matrix && seen.insert(matrix.get()).second)
+                bytes += pooledMatrix.second.getBytes();
+        }
+        return bytes;
+    }
+
+    // rough number of floating-point operations of ForwardProp() or Backprop() over the whole minibatch, for profiling;
+    // the default is one operation per output element (and per input gradient), nodes that do more work override this
+    virtual double EstimateFlops(bool backward) const
+    {
+        double numOutputElements = (double)GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+        if (!backward)
+            return numOutputElements;
+
+        size_t numInputGradients = 0;
+        for (const auto& input : m_inputs)
+        {
+            if (input && input->NeedsGradient())
+                numInputGradients++;
+        }
+        return numOutputElements * numInputGradients;
+    }
 
     // TODO: two sets of functions, choose one
     const std::wstring& NodeName() const { return m_nodeName; }
@@ -978,6 +1027,14 @@ protected:
     float m_learningRateMultiplier;    // update parameters? Only used for LearnableParameters.    --TODO: Should we make this a member of LearnableParameters actually? And require a type cast? Currently it is read out for all leaves.
     const ComputationNodeBase* m_gradientInitializedBy; // indicates which node initialized the gradient matrix
     bool m_outputNeededDuringBackprop; // indicates whether the output value of the node is needed during backprop
+
+    // accessors for the member matrices requested from the MatrixPool, keyed by the address of the member (not copied by CopyTo())
+    struct PooledMatrixAccessor
+    {
+        std::function<MatrixBasePtr()> getMatrix;
+        std::function<size_t()> getBytes;
+    };
+    std::map<const void*, PooledMatrixAccessor> m_pooledMatrices;
 };
 typedef ComputationNodeBase::ComputationNodeBasePtr ComputationNodeBasePtr;
 
@@ -1291,7 +1348,7 @@ public:
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
     {
         Base::CopyTo(nodeP, newName, flags);
-        if (flags & CopyNodeFlags::copyNodeValue)
+        if ((flags & CopyNodeFlags::copyNodeValue) && !(flags & CopyNodeFlags::copyNodeSkipValue))
         {
             auto node = DownCast(nodeP);
             if (m_value)
@@ -1572,7 +1629,7 @@ public:
     const Matrix<ElemType>& Gradient() const { return *m_gradient; }
     Matrix<ElemType>&       Gradient()       { return *m_gradient; }
 
-    MatrixBasePtr GradientPtr() const { return m_gradient; }
+    MatrixBasePtr GradientPtr() const override final { return m_gradient; }
     std::shared_ptr<Matrix<ElemType>>& GradientPtrRef() { return m_gradient; }
     // TODO: This is only used for testing whether a gradient has been allocated. Maybe reduce to bool HasGradient()?
 
@@ -1957,6 +2014,8 @@ protected:
     template<typename ValueType>
     void TypedRequestMatrixFromPool(shared_ptr<Matrix<ValueType>>& matrixPtr, MatrixPool& matrixPool, size_t matrixSize=0, bool mbScale=false, bool isWorkSpace=false, bool aliasing=false)
     {
+        m_pooledMatrices[&matrixPtr] = PooledMatrixAccessor{ [&matrixPtr]() -> MatrixBasePtr { return matrixPtr; },
+                                                             [&matrixPtr]() -> size_t { return matrixPtr ? matrixPtr->BufferSize() : 0; } };
         if (matrixPtr == nullptr)
         {
             if (aliasing)
@@ -2304,6 +2363,7 @@ public:
     virtual ComputationNodeBasePtr Duplicate(const std::wstring& newName, const CopyNodeFlags flags) const override { NOT_IMPLEMENTED; }
     virtual double Get00Element() const override { NOT_IMPLEMENTED; }
     virtual MatrixBasePtr ValuePtr() const override { NOT_IMPLEMENTED; }
+    virtual MatrixBasePtr GradientPtr() const override { NOT_IMPLEMENTED; }
     virtual void UpdateFunctionMBSize() override { NOT_IMPLEMENTED; }
     virtual void AttachInputs(const std::vector<ComputationNodeBasePtr>& inputs) override { NOT_IMPLEMENTED; }
     virtual void PrintSelf(bool) const override { NOT_IMPLEMENTED; }
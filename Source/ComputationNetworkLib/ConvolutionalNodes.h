@@ -502,6 +502,16 @@ public:
         return overwrite ? ParentGradientOptimization::Overwrite : ParentGradientOptimization::None;
     }
 
+    // a multiply-add per kernel element for every element of the convolved (output, or input if transposed) tensor
+    virtual double EstimateFlops(bool backward) const override
+    {
+        const auto& convolved = m_transpose ? InputRef(1) : *this;
+        double forwardFlops = 2.0 * m_kernelShape.GetNumElements() * convolved.GetSampleMatrixNumRows() * convolved.GetSampleMatrixNumCols();
+        if (!backward)
+            return forwardFlops;
+        return forwardFlops * ((InputRef(0).NeedsGradient() ? 1 : 0) + (InputRef(1).NeedsGradient() ? 1 : 0));
+    }
+
 public:
     void ForwardProp(const FrameRange& fr) override
     {
@@ -300,6 +300,16 @@ protected:
 public:
     virtual const std::wstring GetRequestedDynamicAxis() const { return m_dynamicAxisNodeName; }
 
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<InputValueBase<ElemType>>(nodeP);
+            node->m_dynamicAxisNodeName = m_dynamicAxisNodeName;
+        }
+    }
+
     virtual void Save(File& fstream) const override
     {
         Base::Save(fstream);
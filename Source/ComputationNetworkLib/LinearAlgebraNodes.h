@@ -428,6 +428,20 @@ public:
             m_inferInputRankToMap = NoInferredInputRank;
     }
 
+    // 2 * M * K * N for the product of an M x K and a K x N matrix, once more per input gradient
+    virtual double EstimateFlops(bool backward) const override
+    {
+        size_t leftRank = InputRef(0).GetSampleLayout().GetRank();
+        if (m_transpose && leftRank == 1)
+            leftRank = 2;
+        size_t m = CalcOutputMatrixSize(leftRank, InputRef(1).GetSampleLayout().GetRank(), GetSampleLayout()).first;
+        double k = m > 0 ? (double)InputRef(0).GetSampleMatrixNumRows() / m : 0;
+        double forwardFlops = 2 * k * GetSampleMatrixNumRows() * GetSampleMatrixNumCols();
+        if (!backward)
+            return forwardFlops;
+        return forwardFlops * ((InputRef(0).NeedsGradient() ? 1 : 0) + (InputRef(1).NeedsGradient() ? 1 : 0));
+    }
+
 protected:
     // if the left argument of the matrix product (A) has a time axis, it can only be applied sample by sample
     // where each sample is treated as a separate matrix object (as a consequence, it then also applies to B and the result as well)
@@ -9,11 +9,15 @@
 #include <stdexcept>
 #include <vector>
 #include <set>
+#include <map>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <algorithm>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include "Basics.h"
 #include "Matrix.h"
@@ -39,6 +43,10 @@ struct MemRequestInfo
     }
     void SetReleaseStep(int step) { releaseStep = step; }
     void SetMemoryId(int id) { memoryId = id;  }
+    // number of elements for a minibatch of numColumns columns (numColumns = 0 means unknown, then matrixSize is used as is) 
+    size_t GetSize(size_t numColumns) const { return (mbScale && numColumns > 0) ? matrixSize * numColumns : matrixSize; }
+    // a matrix that is never released must keep its identity, since others (e.g. SGD for gradients of parameters) may hold on to it 
+    bool IsPinned() const { return releaseStep == INT_MAX; }
 };
 
 template <class ElemType>
@@ -61,6 +69,19 @@ struct MemAllocInfo
     }
 };
 
+// statistics of a memory sharing plan, in bytes summed over all devices and element types
+struct MemoryPlanStatistics
+{
+    size_t numColumns;    // minibatch size (number of columns) the plan was made for
+    size_t previousBytes; // memory needed by the previous plan for this minibatch size
+    size_t plannedBytes;  // memory needed by the new plan
+    size_t arenaBytes;    // memory that would be needed if the requests of each device were packed into a single arena (for comparison only)
+    MemoryPlanStatistics(size_t numColumns = 0)
+        : numColumns(numColumns), previousBytes(0), plannedBytes(0), arenaBytes(0)
+    {
+    }
+};
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
@@ -75,6 +96,7 @@ protected:
     vector<MemRequestInfo<half>> m_memRequestInfoHalfVec;
     set<DEVICEID_TYPE> m_deviceIDSet; 
     int m_stepCounter; 
+    size_t m_plannedNumColumns = 0; // minibatch size the current plan was made for, 0 if it was made from the per-sample estimates only 
 
     template <class ElemType>
     vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec();
@@ -153,9 +175,36 @@ public:
         OptimizedMemoryAllocationFunc<float>(); 
         OptimizedMemoryAllocationFunc<double>();
         OptimizedMemoryAllocationFunc<half>();
+        m_plannedNumColumns = 0;
         return; 
     }
 
+    // At the time of OptimizedMemoryAllocation() the minibatch size is not known, so requests that scale with the minibatch
+    // size cannot be compared with those that don't. Once the actual minibatch size is known, this re-runs the sharing plan
+    // with the real memory sizes and reassigns the matrix pointers. It must be called between minibatches (the content of
+    // shared matrices is lost). To avoid re-planning constantly for varying minibatch sizes, this only does something if
+    // numColumns exceeds the size of the current plan; it returns false otherwise.
+    bool OptimizedMemoryAllocationForMinibatchSize(size_t numColumns, MemoryPlanStatistics& stats)
+    {
+        if (numColumns <= m_plannedNumColumns)
+            return false;
+
+        stats = MemoryPlanStatistics(numColumns);
+        RemoveSparseRequests<float>();
+        RemoveSparseRequests<double>();
+        RemoveSparseRequests<half>();
+        stats.previousBytes = GetPlannedBytes<float>(numColumns) + GetPlannedBytes<double>(numColumns) + GetPlannedBytes<half>(numColumns);
+
+        SizeAwareMemoryAllocationFunc<float>(numColumns);
+        SizeAwareMemoryAllocationFunc<double>(numColumns);
+        SizeAwareMemoryAllocationFunc<half>(numColumns);
+        stats.plannedBytes = GetPlannedBytes<float>(numColumns) + GetPlannedBytes<double>(numColumns) + GetPlannedBytes<half>(numColumns);
+
+        stats.arenaBytes = GetArenaBytes(numColumns);
+        m_plannedNumColumns = numColumns;
+        return true;
+    }
+
     void SetAliasInfo(
         const unordered_map<AliasNodePtr, unordered_set<AliasNodePtr>>& groupMap,
         const unordered_map<AliasNodePtr, AliasNodePtr>& rootLookupMap)
@@ -247,14 +296,11 @@ private:
         return bRet;
     }
 
+    // remove all requests that has been marked as sparse matrices, those will not participate in memory sharing 
     template <class ElemType>
-    void OptimizedMemoryAllocationFunc()
+    void RemoveSparseRequests()
     {
         vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
-        if (memInfoVec.empty())
-            return; 
-
-        // remove all requests that has been marked as sparse matrices, those will not participate in memory sharing 
         for (auto iter = memInfoVec.begin(); iter != memInfoVec.end(); )
         {
             bool hasSparse = false;
@@ -268,10 +314,20 @@ private:
             }
 
             if (hasSparse)
-                memInfoVec.erase(iter);
+                iter = memInfoVec.erase(iter);
             else
                 iter++; 
         }
+    }
+
+    template <class ElemType>
+    void OptimizedMemoryAllocationFunc()
+    {
+        vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        if (memInfoVec.empty())
+            return; 
+
+        RemoveSparseRequests<ElemType>();
 
         // sort the memory request from largest size to smallest 
         std::sort(memInfoVec.begin(), memInfoVec.end(), greater_than_mem_req_size<ElemType>());
@@ -388,6 +444,176 @@ private:
             }
         }
     }
+
+    // memory sharing with the actual sizes for a minibatch of numColumns columns
+    // All requests are placed from largest to smallest. Each request goes to the smallest buffer it does not overlap with
+    // in time; since buffers are created in order of decreasing size, that buffer is always large enough.
+    template <class ElemType>
+    void SizeAwareMemoryAllocationFunc(size_t numColumns)
+    {
+        vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        if (memInfoVec.empty())
+            return;
+
+        std::stable_sort(memInfoVec.begin(), memInfoVec.end(), [numColumns](const MemRequestInfo<ElemType>& info1, const MemRequestInfo<ElemType>& info2)
+        {
+            return info1.GetSize(numColumns) > info2.GetSize(numColumns);
+        });
+
+        std::vector<bool> workspaceFlagVec = {true, false};
+        for (auto& devId : m_deviceIDSet)
+        {
+            for (auto wsFlag : workspaceFlagVec) // as in OptimizedMemoryAllocationFunc(), workspace memory is not shared with the non-workspace memory requests
+            {
+                // memAllocInfoVec is in order of creation, i.e. from largest to smallest in memory size 
+                vector<MemAllocInfo> memAllocInfoVec;
+                for (auto& memInfo : memInfoVec)
+                {
+                    if (memInfo.deviceId != devId || memInfo.isWorkSpace != wsFlag)
+                        continue;
+
+                    auto occ = make_pair(memInfo.allocStep, memInfo.releaseStep);
+                    auto workingAlloc = memAllocInfoVec.rend();
+                    for (auto iter = memAllocInfoVec.rbegin(); iter != memAllocInfoVec.rend(); iter++)
+                    {
+                        if (!CheckOverlap(occ, iter->occupancy))
+                        {
+                            workingAlloc = iter;
+                            break;
+                        }
+                    }
+                    if (workingAlloc == memAllocInfoVec.rend())
+                    {
+                        memInfo.SetMemoryId((int) memAllocInfoVec.size());
+                        memAllocInfoVec.push_back(MemAllocInfo(memInfo.memoryId, memInfo.GetSize(numColumns), vector<pair<int, int>>(1, occ)));
+                    }
+                    else
+                    {
+                        workingAlloc->occupancy.push_back(occ);
+                        memInfo.SetMemoryId(workingAlloc->memoryId);
+                    }
+                }
+
+                // now assign the actual pointers; a buffer that holds a pinned matrix keeps using it 
+                for (auto& memAlloc : memAllocInfoVec)
+                {
+                    shared_ptr<Matrix<ElemType>> matrixPtr;
+                    for (auto& memInfo : memInfoVec)
+                    {
+                        if (memInfo.deviceId == devId && memInfo.isWorkSpace == wsFlag && memInfo.memoryId == memAlloc.memoryId && memInfo.IsPinned())
+                            matrixPtr = *memInfo.pMatrixPtrs[0];
+                    }
+                    if (!matrixPtr)
+                        matrixPtr = make_shared<Matrix<ElemType>>(devId);
+                    for (auto& memInfo : memInfoVec)
+                    {
+                        if (memInfo.deviceId == devId && memInfo.isWorkSpace == wsFlag && memInfo.memoryId == memAlloc.memoryId)
+                        {
+                            for (auto pOutMatrixPtr : memInfo.pMatrixPtrs)
+                                *pOutMatrixPtr = matrixPtr;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // memory in bytes needed by the current plan (the largest request of each buffer) for a minibatch of numColumns columns 
+    template <class ElemType>
+    size_t GetPlannedBytes(size_t numColumns)
+    {
+        map<tuple<DEVICEID_TYPE, bool, int>, size_t> bufferSizes;
+        for (const auto& memInfo : GetMemRequestInfoVec<ElemType>())
+        {
+            auto& size = bufferSizes[make_tuple(memInfo.deviceId, memInfo.isWorkSpace, memInfo.memoryId)];
+            size = max(size, memInfo.GetSize(numColumns) * sizeof(ElemType));
+        }
+        size_t bytes = 0;
+        for (const auto& bufferSize : bufferSizes)
+            bytes += bufferSize.second;
+        return bytes;
+    }
+
+public:
+    // a request as seen by the arena planner, which packs the requests of all element types of a device 
+    struct ArenaRequest
+    {
+        size_t bytes;
+        int allocStep;
+        int releaseStep;
+        size_t offset; // set by PlanArenaOffsets()
+    };
+
+    // Compute the offset of each request if all requests of a device lived in one arena, and return the total arena size.
+    // This is interval graph coloring with offsets: requests are placed from largest to smallest, each into the smallest gap
+    // between the requests already placed that overlap with it in time, or at the end if no gap is large enough.
+    // Unlike whole-matrix sharing, a buffer can then host several smaller requests at the same time.
+    static size_t PlanArenaOffsets(vector<ArenaRequest>& requests)
+    {
+        vector<ArenaRequest*> bySize;
+        for (auto& request : requests)
+            bySize.push_back(&request);
+        std::stable_sort(bySize.begin(), bySize.end(), [](const ArenaRequest* r1, const ArenaRequest* r2) { return r1->bytes > r2->bytes; });
+
+        size_t arenaBytes = 0;
+        vector<const ArenaRequest*> placed;
+        for (auto request : bySize)
+        {
+            vector<const ArenaRequest*> live;
+            for (auto other : placed)
+            {
+                if (request->allocStep <= other->releaseStep && request->releaseStep >= other->allocStep)
+                    live.push_back(other);
+            }
+            std::sort(live.begin(), live.end(), [](const ArenaRequest* r1, const ArenaRequest* r2) { return r1->offset < r2->offset; });
+
+            size_t offset = SIZE_MAX, bestGap = SIZE_MAX, end = 0;
+            for (auto other : live)
+            {
+                if (other->offset >= end + request->bytes && other->offset - end < bestGap)
+                {
+                    offset = end;
+                    bestGap = other->offset - end;
+                }
+                end = max(end, other->offset + other->bytes);
+            }
+            if (offset == SIZE_MAX)
+                offset = end;
+
+            request->offset = offset;
+            arenaBytes = max(arenaBytes, offset + request->bytes);
+            placed.push_back(request);
+        }
+        return arenaBytes;
+    }
+
+private:
+    template <class ElemType>
+    void GetArenaRequests(DEVICEID_TYPE deviceId, size_t numColumns, vector<ArenaRequest>& requests)
+    {
+        const size_t alignment = 256; // offsets are aligned as cudaMalloc() would align them 
+        for (const auto& memInfo : GetMemRequestInfoVec<ElemType>())
+        {
+            if (memInfo.deviceId == deviceId)
+                requests.push_back(ArenaRequest{ (memInfo.GetSize(numColumns) * sizeof(ElemType) + alignment - 1) / alignment * alignment, memInfo.allocStep, memInfo.releaseStep, 0 });
+        }
+    }
+
+    // The memory needed if the requests of each device were packed into a single arena, for comparison with the
+    // plan of whole-matrix sharing. The matrices are not allocated from the arena.
+    size_t GetArenaBytes(size_t numColumns)
+    {
+        size_t totalBytes = 0;
+        for (auto& devId : m_deviceIDSet)
+        {
+            vector<ArenaRequest> requests;
+            GetArenaRequests<float>(devId, numColumns, requests);
+            GetArenaRequests<double>(devId, numColumns, requests);
+            GetArenaRequests<half>(devId, numColumns, requests);
+            totalBytes += PlanArenaOffsets(requests);
+        }
+        return totalBytes;
+    }
 };
 
 }}}
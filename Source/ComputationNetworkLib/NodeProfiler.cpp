@@ -0,0 +1,231 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "NodeProfiler.h"
+#include "ComputationNode.h"
+#include "fileutil.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+NodeProfiler& NodeProfiler::Instance()
+{
+    static NodeProfiler profiler;
+    return profiler;
+}
+
+NodeProfiler::NodeProfiler()
+    : m_startTime(Clock::now()), m_lastInputTimeStamp(0), m_minibatch(0), m_maxTraceEvents(1000000), m_traceTruncated(false)
+{
+}
+
+size_t NodeProfiler::GetNodeIndex(const ComputationNodeBase& node)
+{
+    // nodes are identified by address; the name guards against a new node that reuses the address of a deleted one
+    auto iter = m_nodeIndices.find(&node);
+    if (iter != m_nodeIndices.end() && m_nodes[iter->second].name == node.NodeName())
+        return iter->second;
+
+    NodeStats stats;
+    stats.name = node.NodeName();
+    stats.operation = node.OperationName();
+    m_nodes.push_back(stats);
+    m_nodeIndices[&node] = m_nodes.size() - 1;
+    return m_nodes.size() - 1;
+}
+
+size_t NodeProfiler::GetThreadIndex()
+{
+    auto result = m_threadIndices.insert(make_pair(this_thread::get_id(), m_threadIndices.size()));
+    return result.first->second;
+}
+
+/*static*/ void NodeProfiler::Record(const ComputationNodeBase& node, bool backward, const Clock::time_point& begin, const Clock::time_point& end)
+{
+    // a recurrent loop only shows up in the trace, its members are recorded individually
+    bool isLoop = dynamic_cast<const FlowControlNode*>(&node) != nullptr;
+    double seconds = chrono::duration<double>(end - begin).count();
+
+    auto& profiler = Instance();
+    lock_guard<mutex> guard(profiler.m_lock);
+
+    size_t nodeIndex = profiler.GetNodeIndex(node);
+    auto& stats = profiler.m_nodes[nodeIndex];
+    stats.isLoop = isLoop;
+    if (!isLoop)
+    {
+        if (stats.lastMinibatch != profiler.m_minibatch)
+        {
+            // shape and memory only change between minibatches
+            stats.lastMinibatch = profiler.m_minibatch;
+            stats.numMinibatches++;
+            stats.shape = msra::strfun::strprintf("%s x %d", node.ShapeDescription().c_str(), (int)node.GetSampleMatrixNumCols());
+            stats.maxPooledBytes = max(stats.maxPooledBytes, node.GetPooledMatrixBytes());
+        }
+
+        auto& phase = stats.phase[backward ? 1 : 0];
+        if (phase.lastMinibatch != profiler.m_minibatch)
+        {
+            // the estimate covers the whole minibatch, also for nodes in loops, which are executed once per time step
+            phase.lastMinibatch = profiler.m_minibatch;
+            phase.flops += node.EstimateFlops(backward);
+        }
+        phase.count++;
+        phase.seconds += seconds;
+    }
+
+    if (profiler.m_events.size() < profiler.m_maxTraceEvents)
+    {
+        TraceEvent event;
+        event.nodeIndex = nodeIndex;
+        event.backward = backward;
+        event.thread = profiler.GetThreadIndex();
+        event.minibatch = profiler.m_minibatch;
+        event.beginMicroseconds = chrono::duration<double, micro>(begin - profiler.m_startTime).count();
+        event.durationMicroseconds = seconds * 1e6;
+        profiler.m_events.push_back(event);
+    }
+    else if (!profiler.m_traceTruncated)
+    {
+        profiler.m_traceTruncated = true;
+        fprintf(stderr, "NodeProfiler: WARNING: Trace is limited to %d node executions, further executions are only counted in the summary.\n", (int)profiler.m_maxTraceEvents);
+    }
+}
+
+/*static*/ void NodeProfiler::NotifyInputTimeStamp(uint64_t inputTimeStamp)
+{
+    auto& profiler = Instance();
+    lock_guard<mutex> guard(profiler.m_lock);
+    if (inputTimeStamp > profiler.m_lastInputTimeStamp)
+    {
+        profiler.m_lastInputTimeStamp = inputTimeStamp;
+        profiler.m_minibatch++;
+    }
+}
+
+/*static*/ vector<NodeProfiler::NodeStats> NodeProfiler::GetNodeStats()
+{
+    auto& profiler = Instance();
+    lock_guard<mutex> guard(profiler.m_lock);
+
+    vector<NodeStats> nodes;
+    for (const auto& stats : profiler.m_nodes)
+    {
+        if (!stats.isLoop)
+            nodes.push_back(stats);
+    }
+    auto totalSeconds = [](const NodeStats& stats) { return stats.phase[0].seconds + stats.phase[1].seconds; };
+    stable_sort(nodes.begin(), nodes.end(), [&](const NodeStats& a, const NodeStats& b) { return totalSeconds(a) > totalSeconds(b); });
+    return nodes;
+}
+
+/*static*/ void NodeProfiler::PrintSummary(FILE* f, size_t maxNodes)
+{
+    auto nodes = GetNodeStats();
+
+    auto totalSeconds = [](const NodeStats& stats) { return stats.phase[0].seconds + stats.phase[1].seconds; };
+    double seconds = 0;
+    size_t numMinibatches = 0;
+    for (const auto& stats : nodes)
+    {
+        seconds += totalSeconds(stats);
+        numMinibatches = max(numMinibatches, stats.numMinibatches);
+    }
+
+    fprintf(f, "\nNode profile: %d nodes, %d minibatches, %.3f seconds in ForwardProp() and Backprop()\n", (int)nodes.size(), (int)numMinibatches, seconds);
+    fprintf(f, "%10s %6s %10s %10s %9s %8s %9s  %s\n", "total ms", "%", "fwd ms", "bwd ms", "ms/mb", "GFLOP/s", "pool MB", "node");
+    for (size_t i = 0; i < nodes.size() && i < maxNodes; i++)
+    {
+        const auto& stats = nodes[i];
+        double nodeSeconds = totalSeconds(stats);
+        double flops = stats.phase[0].flops + stats.phase[1].flops;
+        fprintf(f, "%10.2f %6.2f %10.2f %10.2f %9.3f %8.2f %9.2f  %ls : %ls %s\n",
+                nodeSeconds * 1e3,
+                seconds > 0 ? 100 * nodeSeconds / seconds : 0.0,
+                stats.phase[0].seconds * 1e3,
+                stats.phase[1].seconds * 1e3,
+                stats.numMinibatches > 0 ? nodeSeconds * 1e3 / stats.numMinibatches : 0.0,
+                nodeSeconds > 0 ? flops / nodeSeconds * 1e-9 : 0.0,
+                stats.maxPooledBytes / (1024.0 * 1024.0),
+                stats.name.c_str(), stats.operation.c_str(), stats.shape.c_str());
+    }
+    if (nodes.size() > maxNodes)
+        fprintf(f, "(%d more nodes not shown)\n", (int)(nodes.size() - maxNodes));
+    fflush(f);
+}
+
+// escapes a string for use in a JSON string literal
+static string JsonEscape(const string& s)
+{
+    string result;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+            result += c;
+        }
+        else if ((unsigned char)c < 0x20)
+            result += msra::strfun::strprintf("\\u%04x", (int)c);
+        else
+            result += c;
+    }
+    return result;
+}
+
+static string JsonEscape(const wstring& s)
+{
+    return JsonEscape(ToLegacyString(ToUTF8(s)));
+}
+
+/*static*/ void NodeProfiler::WriteChromeTrace(const wstring& path)
+{
+    auto& profiler = Instance();
+    lock_guard<mutex> guard(profiler.m_lock);
+
+    FILE* f = fopenOrDie(path, L"w");
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < profiler.m_events.size(); i++)
+    {
+        const auto& event = profiler.m_events[i];
+        const auto& stats = profiler.m_nodes[event.nodeIndex];
+        fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d,"
+                   "\"args\":{\"operation\":\"%s\",\"shape\":\"%s\",\"minibatch\":%d}}\n",
+                i > 0 ? "," : "",
+                JsonEscape(stats.name).c_str(), stats.isLoop ? (event.backward ? "loop backward" : "loop forward") : (event.backward ? "backward" : "forward"),
+                event.beginMicroseconds, event.durationMicroseconds, (int)event.thread,
+                JsonEscape(stats.operation).c_str(), JsonEscape(stats.shape).c_str(), (int)event.minibatch);
+    }
+    fprintf(f, "]}\n");
+    fcloseOrDie(f);
+
+    fprintf(stderr, "NodeProfiler: Wrote %d node executions to %ls.\n", (int)profiler.m_events.size(), path.c_str());
+}
+
+/*static*/ void NodeProfiler::SetMaxTraceEvents(size_t maxTraceEvents)
+{
+    auto& profiler = Instance();
+    lock_guard<mutex> guard(profiler.m_lock);
+    profiler.m_maxTraceEvents = maxTraceEvents;
+}
+
+/*static*/ void NodeProfiler::Reset()
+{
+    auto& profiler = Instance();
+    lock_guard<mutex> guard(profiler.m_lock);
+    profiler.m_startTime = Clock::now();
+    profiler.m_lastInputTimeStamp = 0;
+    profiler.m_minibatch = 0;
+    profiler.m_nodes.clear();
+    profiler.m_nodeIndices.clear();
+    profiler.m_threadIndices.clear();
+    profiler.m_events.clear();
+    profiler.m_traceTruncated = false;
+}
+
+}}}
@@ -0,0 +1,112 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class ComputationNodeBase;
+
+// -----------------------------------------------------------------------
+// NodeProfiler -- per-node profile of forward and backward propagation
+//
+// The profile is built on node timing (ComputationNode::BeginTiming()/EndTiming()): when node profiling is
+// enabled (Globals::SetNodeProfiling(), which also enables node timing), EndTiming() passes every interval it
+// measures to Record(). For each node the profiler keeps the number and time of its executions, an estimate
+// of its floating-point operations per minibatch (ComputationNodeBase::EstimateFlops()), the bytes it holds
+// from the MatrixPool and its output shape. Nodes inside recurrent loops are timed once per time step, the
+// loop as a whole only appears in the trace.
+//
+// A new minibatch is counted whenever the network is evaluated on new input data.
+// PrintSummary() prints the nodes sorted by their total time; WriteChromeTrace() writes all recorded
+// executions in the Chrome trace event format (chrome://tracing, or https://ui.perfetto.dev).
+// The profiler is process-wide and thread-safe.
+// -----------------------------------------------------------------------
+
+class NodeProfiler
+{
+public:
+    // the clock of ComputationNode's node timing
+    typedef std::chrono::system_clock Clock;
+
+    struct PhaseStats
+    {
+        size_t count = 0;
+        double seconds = 0;
+        double flops = 0;
+        size_t lastMinibatch = SIZE_MAX;
+    };
+
+    struct NodeStats
+    {
+        std::wstring name;
+        std::wstring operation;
+        std::string shape;          // output shape in the last minibatch
+        size_t maxPooledBytes = 0;  // largest MatrixPool footprint seen
+        size_t lastMinibatch = SIZE_MAX;
+        size_t numMinibatches = 0;
+        bool isLoop = false;        // a recurrent loop (trace only)
+        PhaseStats phase[2];        // forward, backward
+    };
+
+    // Records one execution of a node, timed by node timing.
+    static void Record(const ComputationNodeBase& node, bool backward, const Clock::time_point& begin, const Clock::time_point& end);
+
+    // Called at the start of a network evaluation with the latest time stamp of its inputs; counts a new minibatch if it is newer than before.
+    static void NotifyInputTimeStamp(uint64_t inputTimeStamp);
+
+    // Returns the profile of all nodes (but not of the recurrent loops), sorted by total time (forward plus backward).
+    static std::vector<NodeStats> GetNodeStats();
+
+    // Prints the per-node summary of GetNodeStats(). maxNodes limits the number of nodes listed.
+    static void PrintSummary(FILE* f, size_t maxNodes = SIZE_MAX);
+
+    // Writes the recorded node executions as a Chrome trace JSON file.
+    static void WriteChromeTrace(const std::wstring& path);
+
+    // Bounds the number of node executions kept for the trace (the summary is not affected). Default is 1M.
+    static void SetMaxTraceEvents(size_t maxTraceEvents);
+
+    // Discards everything recorded so far.
+    static void Reset();
+
+private:
+    struct TraceEvent
+    {
+        size_t nodeIndex;
+        bool backward;
+        size_t thread;
+        size_t minibatch;
+        double beginMicroseconds;
+        double durationMicroseconds;
+    };
+
+    static NodeProfiler& Instance();
+
+    NodeProfiler();
+    size_t GetNodeIndex(const ComputationNodeBase& node);
+    size_t GetThreadIndex();
+
+    std::mutex m_lock;
+    Clock::time_point m_startTime;
+    uint64_t m_lastInputTimeStamp;
+    size_t m_minibatch;
+    std::vector<NodeStats> m_nodes;
+    std::map<const ComputationNodeBase*, size_t> m_nodeIndices;
+    std::map<std::thread::id, size_t> m_threadIndices;
+    std::vector<TraceEvent> m_events;
+    size_t m_maxTraceEvents;
+    bool m_traceTruncated;
+};
+
+}}}
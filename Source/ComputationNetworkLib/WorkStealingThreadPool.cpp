@@ -0,0 +1,202 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "Basics.h"
+#include "WorkStealingThreadPool.h"
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+WorkStealingThreadPool::WorkStealingThreadPool(size_t numThreads)
+    : m_numQueuedTasks(0), m_job(nullptr), m_shutdown(false)
+{
+    if (numThreads == 0)
+        InvalidArgument("WorkStealingThreadPool: the number of threads must be positive.");
+
+    for (size_t i = 0; i < numThreads; ++i)
+        m_queues.push_back(make_unique<TaskQueue>());
+
+    // worker 0 is the thread that calls Execute()
+    for (size_t i = 1; i < numThreads; ++i)
+        m_threads.emplace_back([this, i]() { WorkerLoop(i); });
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_shutdown = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void WorkStealingThreadPool::Execute(const vector<vector<size_t>>& successors, const vector<size_t>& numPredecessors, const function<void(size_t)>& task)
+{
+    size_t numTasks = successors.size();
+    if (numPredecessors.size() != numTasks)
+        InvalidArgument("WorkStealingThreadPool: the number of predecessor counts does not match the number of tasks.");
+    if (numTasks == 0)
+        return;
+
+    Job job;
+    job.m_successors = &successors;
+    job.m_task = &task;
+    job.m_numPendingPredecessors.reset(new atomic<size_t>[numTasks]);
+    for (size_t i = 0; i < numTasks; ++i)
+        job.m_numPendingPredecessors[i] = numPredecessors[i];
+    job.m_numRemainingTasks = numTasks;
+    job.m_failed = false;
+
+    {
+        lock_guard<mutex> guard(m_lock);
+        if (m_job != nullptr)
+            LogicError("WorkStealingThreadPool: Execute() was called while another graph is being executed.");
+        m_job = &job;
+    }
+
+    // tasks without predecessors are ready right away, they are distributed over the queues
+    // of all threads (in reverse order, so that the first ones are popped first)
+    size_t numReadyTasks = 0;
+    for (size_t i = numTasks; i-- > 0;)
+    {
+        if (numPredecessors[i] == 0)
+            Push(numReadyTasks++ % NumThreads(), i);
+    }
+    if (numReadyTasks == 0)
+        LogicError("WorkStealingThreadPool: the task graph has no task without predecessors.");
+
+    size_t taskId;
+    for (;;)
+    {
+        if (TryPop(0, taskId))
+        {
+            RunTask(0, taskId);
+            continue;
+        }
+
+        unique_lock<mutex> guard(m_lock);
+        m_wakeUp.wait(guard, [this, &job]() { return m_numQueuedTasks > 0 || job.m_numRemainingTasks == 0; });
+        if (job.m_numRemainingTasks == 0)
+        {
+            m_job = nullptr;
+            break;
+        }
+    }
+
+    if (job.m_exception)
+        rethrow_exception(job.m_exception);
+}
+
+void WorkStealingThreadPool::WorkerLoop(size_t worker)
+{
+    size_t taskId;
+    for (;;)
+    {
+        if (TryPop(worker, taskId))
+        {
+            RunTask(worker, taskId);
+            continue;
+        }
+
+        unique_lock<mutex> guard(m_lock);
+        m_wakeUp.wait(guard, [this]() { return m_numQueuedTasks > 0 || m_shutdown; });
+        if (m_shutdown)
+            return;
+    }
+}
+
+void WorkStealingThreadPool::Push(size_t worker, size_t task)
+{
+    {
+        auto& queue = *m_queues[worker];
+        lock_guard<mutex> guard(queue.m_lock);
+        queue.m_tasks.push_back(task);
+    }
+
+    {
+        // increment under the lock, so that a thread that is about to wait does not miss the notification
+        lock_guard<mutex> guard(m_lock);
+        m_numQueuedTasks++;
+    }
+    m_wakeUp.notify_one();
+}
+
+bool WorkStealingThreadPool::TryPop(size_t worker, size_t& task)
+{
+    if (m_numQueuedTasks == 0)
+        return false;
+
+    // own queue first, newest task
+    {
+        auto& queue = *m_queues[worker];
+        lock_guard<mutex> guard(queue.m_lock);
+        if (!queue.m_tasks.empty())
+        {
+            task = queue.m_tasks.back();
+            queue.m_tasks.pop_back();
+            m_numQueuedTasks--;
+            return true;
+        }
+    }
+
+    // steal the oldest task of another thread
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+        auto& queue = *m_queues[(worker + i) % m_queues.size()];
+        lock_guard<mutex> guard(queue.m_lock);
+        if (!queue.m_tasks.empty())
+        {
+            task = queue.m_tasks.front();
+            queue.m_tasks.pop_front();
+            m_numQueuedTasks--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingThreadPool::RunTask(size_t worker, size_t task)
+{
+    Job& job = *m_job;
+
+    // once a task has failed, the remaining ones are only retired to let Execute() return
+    if (!job.m_failed)
+    {
+        try
+        {
+            (*job.m_task)(task);
+        }
+        catch (...)
+        {
+            lock_guard<mutex> guard(job.m_exceptionLock);
+            if (!job.m_exception)
+                job.m_exception = current_exception();
+            job.m_failed = true;
+        }
+    }
+
+    for (size_t successor : (*job.m_successors)[task])
+    {
+        if (--job.m_numPendingPredecessors[successor] == 0)
+            Push(worker, successor);
+    }
+
+    if (--job.m_numRemainingTasks == 0)
+    {
+        // acquire the lock once, so that Execute() cannot miss the notification between checking and waiting
+        {
+            lock_guard<mutex> guard(m_lock);
+        }
+        m_wakeUp.notify_all();
+    }
+}
+
+}}}
@@ -0,0 +1,79 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// WorkStealingThreadPool -- executes a graph of dependent tasks on a fixed set of threads
+//
+// Tasks are identified by their index. A task becomes ready once all of its predecessors
+// have completed. Every thread keeps its own queue of ready tasks: tasks that are made ready
+// by a thread are pushed to its own queue and picked up from there in LIFO order (which tends
+// to keep the data of a chain of tasks in cache), idle threads steal the oldest tasks of other threads.
+// The thread that calls Execute() takes part in the execution.
+// -----------------------------------------------------------------------
+
+class WorkStealingThreadPool
+{
+public:
+    // Creates a pool that uses numThreads threads in total (including the calling thread).
+    explicit WorkStealingThreadPool(size_t numThreads);
+    ~WorkStealingThreadPool();
+
+    size_t NumThreads() const { return m_queues.size(); }
+
+    // Executes tasks [0, successors.size()). successors[i] lists the tasks that depend on task i,
+    // numPredecessors[i] is the number of tasks task i depends on. The graph must be acyclic.
+    // Returns once all tasks have completed. If a task throws, the remaining tasks are skipped
+    // and the first exception is rethrown.
+    // Only one graph can be executed at a time.
+    void Execute(const std::vector<std::vector<size_t>>& successors, const std::vector<size_t>& numPredecessors, const std::function<void(size_t)>& task);
+
+private:
+    struct TaskQueue
+    {
+        std::mutex m_lock;
+        std::deque<size_t> m_tasks;
+    };
+
+    struct Job
+    {
+        const std::vector<std::vector<size_t>>* m_successors;
+        const std::function<void(size_t)>* m_task;
+        std::unique_ptr<std::atomic<size_t>[]> m_numPendingPredecessors;
+        std::atomic<size_t> m_numRemainingTasks;
+        std::atomic<bool> m_failed;
+        std::exception_ptr m_exception;
+        std::mutex m_exceptionLock;
+    };
+
+    void WorkerLoop(size_t worker);
+    void Push(size_t worker, size_t task);
+    bool TryPop(size_t worker, size_t& task);
+    void RunTask(size_t worker, size_t task);
+
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_lock; // protects the state below, used with m_wakeUp
+    std::condition_variable m_wakeUp;
+    std::atomic<size_t> m_numQueuedTasks;
+    Job* m_job;
+    bool m_shutdown;
+};
+
+}}}
@@ -14,6 +14,7 @@
 #include "Eval.h"
 #include "Actions.h"
 #include "CNTKEval.h"
+#include "CNTKEvalBatcher.h"
 #include "CPUMatrix.h" // for SetNumThreads()
 #include "SimpleOutputWriter.h"
 #include "NDLNetworkBuilder.h"
@@ -24,6 +25,8 @@
 #include "InputAndParamNodes.h"
 #include "latticearchive.h"
 #include <limits>
+#include <algorithm>
+#include <set>
 #include "RecurrentNodes.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -255,6 +258,7 @@ template<typename ElemType>
 void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
 {
     m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
+    m_outputNodeNames = outputNodeNames;
     m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
     m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
     // allocate memory for forward computation
@@ -302,6 +306,46 @@ VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
     return inputLayouts;
 }
 
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+size_t CNTKEvalExtended<ElemType>::ValidateInput(size_t i, const ValueBuffer<ElemType, ValueContainer>& buffer) const
+{
+    auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(m_inputNodes[i]->ValuePtr());
+    auto type = matrix->GetMatrixType();
+    size_t numRows = m_inputNodes[i]->GetSampleLayout().GetNumElements();
+
+    if (buffer.m_buffer.data() == nullptr)
+        RuntimeError("Input %ls: Buffer is not allocated.", m_inputNodes[i]->GetName().c_str());
+    if (type == MatrixType::DENSE)
+    {
+        if (buffer.m_buffer.size() % numRows != 0)
+            RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
+                         m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
+        if (buffer.m_buffer.size() == 0)
+            RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
+    }
+    else if (type == MatrixType::SPARSE)
+    {
+        if (buffer.m_colIndices.data() == nullptr)
+            RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_indices.data() == nullptr)
+            RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_colIndices.size() < 2)
+            RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_colIndices[0] != 0)
+            RuntimeError("Input %ls: First element of column indices must be 0", m_inputNodes[i]->GetName().c_str());
+        if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
+            RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
+                         m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
+                         buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
+    }
+
+    int numCols = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
+    if (numCols < 1)
+        RuntimeError("Input: the number of column must be greater than or equal to 1.");
+    return numCols;
+}
+
 template<typename ElemType>
 template<template<typename> class ValueContainer>
 void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN)
@@ -324,36 +368,8 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
         auto type = matrix->GetMatrixType();
         size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+        size_t numCols = ValidateInput(i, buffer);
 
-        if (buffer.m_buffer.data() == nullptr)
-            RuntimeError("Input %ls: Buffer is not allocated.", m_inputNodes[i]->GetName().c_str());
-        if (type == MatrixType::DENSE)
-        {
-            if (buffer.m_buffer.size() % numRows != 0)
-                RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
-                             m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
-            if (buffer.m_buffer.size() == 0)
-                RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
-        }
-        else if (type == MatrixType::SPARSE)
-        {
-            if (buffer.m_colIndices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_indices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices.size() < 2)
-                RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices[0] != 0)
-                RuntimeError("Input %ls: First element of column indices must be 0", m_inputNodes[i]->GetName().c_str());
-            if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
-                RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
-                             m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
-                             buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
-        }
-
-        int numCols = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
-        if (numCols < 1)
-            RuntimeError("Input: the number of column must be greater than or equal to 1.");
         inputNode->GetMBLayout()->Init(1, numCols);
         
         // SentinelValueIndicatingUnspecifedSequenceBeginIdx is used to specify the lower bound of look-back step of recurrent nodes
@@ -431,6 +447,209 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs, resetRNN);
 }
 
+template <typename ElemType>
+IEvaluateModelExtended<ElemType>* CNTKEvalExtended<ElemType>::CreateSession()
+{
+    if (!m_started)
+        RuntimeError("CreateSession() called before StartForwardEvaluation()");
+
+    auto session = new CNTKEvalExtended<ElemType>();
+    try
+    {
+        // a network of its own that uses our parameters, so that only the activations are per session
+        session->m_config = this->m_config;
+        session->m_net = this->m_net->CloneSharingModelState();
+        session->StartForwardEvaluation(m_outputNodeNames);
+    }
+    catch (...)
+    {
+        session->Destroy();
+        throw;
+    }
+    return session;
+}
+
+template <typename ElemType>
+IEvaluateModelBatcher<ElemType>* CNTKEvalExtended<ElemType>::CreateBatcher(const BatchingOptions& options)
+{
+    auto session = static_cast<CNTKEvalExtended<ElemType>*>(CreateSession());
+    return new CNTKEvalBatcher<ElemType>(session, options);
+}
+
+template <typename ElemType>
+size_t CNTKEvalExtended<ElemType>::ForwardPassBatch(const std::vector<const Values<ElemType>*>& inputs, const std::vector<Values<ElemType>*>& outputs,
+                                                    std::vector<std::exception_ptr>& errors)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassBatch() called before StartForwardEvaluation()");
+    if (inputs.size() != outputs.size())
+        LogicError("ForwardPassBatch: Expected as many output sets as input sets.");
+
+    // validate every request on its own, so that a malformed one does not fail the others
+    size_t numRequests = inputs.size();
+    errors.assign(numRequests, nullptr);
+    std::vector<std::vector<size_t>> numSamples(numRequests); // [request][input]
+    std::vector<size_t> validRequests;
+    for (size_t r = 0; r < numRequests; r++)
+    {
+        try
+        {
+            if (inputs[r]->size() != m_inputNodes.size())
+                RuntimeError("Expected %d inputs, but got %d.", (int)m_inputNodes.size(), (int)inputs[r]->size());
+            if (outputs[r]->size() != m_outputNodes.size())
+                RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs[r]->size());
+
+            std::map<MBLayout*, size_t> layoutLengths; // inputs on the same dynamic axis must have the same length
+            for (size_t i = 0; i < m_inputNodes.size(); i++)
+            {
+                numSamples[r].push_back(ValidateInput(i, (*inputs[r])[i]));
+                auto result = layoutLengths.insert(make_pair(m_inputNodes[i]->GetMBLayout().get(), numSamples[r][i]));
+                if (result.first->second != numSamples[r][i])
+                    RuntimeError("Input %ls: Expected %d samples like the other inputs on the same dynamic axis, but got %d.",
+                                 m_inputNodes[i]->GetName().c_str(), (int)result.first->second, (int)numSamples[r][i]);
+            }
+            validRequests.push_back(r);
+        }
+        catch (...)
+        {
+            errors[r] = std::current_exception();
+        }
+    }
+    if (validRequests.empty())
+        return 0;
+
+    // pack the sequences of each dynamic axis into its MBLayout, longest first; sequence ids are request indices
+    std::set<MBLayout*> packedLayouts;
+    for (size_t i = 0; i < m_inputNodes.size(); i++)
+    {
+        auto pMBLayout = m_inputNodes[i]->GetMBLayout();
+        if (!packedLayouts.insert(pMBLayout.get()).second)
+            continue;
+
+        std::vector<MBLayout::SequenceInfo> sequences;
+        for (size_t r : validRequests)
+            sequences.push_back(MBLayout::SequenceInfo{ r, 0, 0, numSamples[r][i] });
+        std::stable_sort(sequences.begin(), sequences.end(), [](const MBLayout::SequenceInfo& a, const MBLayout::SequenceInfo& b) { return a.GetNumTimeSteps() > b.GetNumTimeSteps(); });
+        std::vector<std::pair<size_t, size_t>> placement;
+        pMBLayout->InitAsPackedSequences(sequences, placement, std::vector<size_t>());
+    }
+
+    // scatter the requests into the minibatch, gap columns are zero
+    for (size_t i = 0; i < m_inputNodes.size(); i++)
+    {
+        const auto& inputNode = m_inputNodes[i];
+        auto pMBLayout = inputNode->GetMBLayout();
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+        size_t numCols = pMBLayout->GetNumCols();
+
+        if (matrix->GetMatrixType() == MatrixType::DENSE)
+        {
+            m_batchValues.assign(numRows * numCols, 0);
+            for (const auto& seq : pMBLayout->GetAllSequences())
+            {
+                if (seq.seqId == GAP_SEQUENCE_ID)
+                    continue;
+                const auto& buffer = (*inputs[seq.seqId])[i].m_buffer;
+                for (size_t t = 0; t < seq.GetNumTimeSteps(); t++)
+                    std::copy(buffer.begin() + t * numRows, buffer.begin() + (t + 1) * numRows, m_batchValues.begin() + pMBLayout->GetColumnIndex(seq, t) * numRows);
+            }
+            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), m_batchValues.data(), matrixFlagNormal);
+        }
+        else
+        {
+            // CSC format: walk the minibatch columns in order and append the non-zeros of the sample found there
+            std::vector<std::pair<size_t, size_t>> columnSources(numCols, make_pair(SIZE_MAX, SIZE_MAX)); // [column] (request, step)
+            for (const auto& seq : pMBLayout->GetAllSequences())
+            {
+                if (seq.seqId != GAP_SEQUENCE_ID)
+                    for (size_t t = 0; t < seq.GetNumTimeSteps(); t++)
+                        columnSources[pMBLayout->GetColumnIndex(seq, t)] = make_pair((size_t)seq.seqId, t);
+            }
+            m_batchValues.clear();
+            m_batchIndices.clear();
+            m_batchColIndices.assign(1, 0);
+            for (const auto& source : columnSources)
+            {
+                if (source.first != SIZE_MAX)
+                {
+                    const auto& buffer = (*inputs[source.first])[i];
+                    size_t begin = buffer.m_colIndices[source.second], end = buffer.m_colIndices[source.second + 1];
+                    m_batchValues.insert(m_batchValues.end(), buffer.m_buffer.begin() + begin, buffer.m_buffer.begin() + end);
+                    m_batchIndices.insert(m_batchIndices.end(), buffer.m_indices.begin() + begin, buffer.m_indices.begin() + end);
+                }
+                m_batchColIndices.push_back((int)m_batchIndices.size());
+            }
+            matrix->SetMatrixFromCSCFormat(m_batchColIndices.data(), m_batchIndices.data(), m_batchValues.data(),
+                                           m_batchValues.size(), numRows, numCols);
+        }
+    }
+    size_t numPaddingSamples = m_inputNodes.empty() ? 0 : m_inputNodes[0]->GetMBLayout()->GetNumCols() - m_inputNodes[0]->GetMBLayout()->GetActualNumSamples();
+
+    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+    this->m_net->ForwardProp(m_outputNodes);
+
+    // gather the sequence of each request from the outputs
+    std::vector<bool> hasOutput(numRequests);
+    for (size_t o = 0; o < m_outputNodes.size(); ++o)
+    {
+        auto node = m_outputNodes[o];
+        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        size_t numRows = outputMatrix->GetNumRows();
+        m_batchValues.resize(outputMatrix->GetNumElements());
+        ElemType* data = m_batchValues.data();
+        size_t size = m_batchValues.size();
+        outputMatrix->CopyToArray(data, size);
+
+        auto pMBLayout = node->GetMBLayout();
+        std::fill(hasOutput.begin(), hasOutput.end(), false);
+        auto copyOutput = [&](size_t r, const MBLayout::SequenceInfo* seq)
+        {
+            if (errors[r])
+                return;
+            try
+            {
+                auto& vec = (*outputs[r])[o].m_buffer;
+                size_t numSteps = seq ? seq->GetNumTimeSteps() : outputMatrix->GetNumCols();
+                if (vec.capacity() < numRows * numSteps)
+                    RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+                vec.resize(numRows * numSteps);
+                for (size_t t = 0; t < numSteps; t++)
+                {
+                    size_t col = seq ? pMBLayout->GetColumnIndex(*seq, t) : t;
+                    std::copy(m_batchValues.begin() + col * numRows, m_batchValues.begin() + (col + 1) * numRows, vec.begin() + t * numRows);
+                }
+            }
+            catch (...)
+            {
+                errors[r] = std::current_exception();
+            }
+            hasOutput[r] = true;
+        };
+
+        if (!pMBLayout) // not per sample: every request gets all of it
+        {
+            for (size_t r : validRequests)
+                copyOutput(r, nullptr);
+            continue;
+        }
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.seqId >= numRequests || seq.tBegin < 0 || seq.tEnd > pMBLayout->GetNumTimeSteps())
+                RuntimeError("Output '%ls' cannot be evaluated in batches, its sequences do not correspond to the input sequences.", node->GetName().c_str());
+            copyOutput(seq.seqId, &seq);
+        }
+        for (size_t r : validRequests)
+        {
+            if (!hasOutput[r] && !errors[r])
+                errors[r] = std::make_exception_ptr(std::runtime_error(msra::strfun::strprintf("Output '%ls' has no sequence for this request.", node->GetName().c_str())));
+        }
+    }
+    return numPaddingSamples;
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
@@ -107,6 +107,16 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
 
+    virtual IEvaluateModelExtended<ElemType>* CreateSession() override;
+
+    virtual IEvaluateModelBatcher<ElemType>* CreateBatcher(const BatchingOptions& options) override;
+
+    // Evaluates several requests (one sequence per input each) in a single forward pass, with recurrent state reset.
+    // Errors that only concern a single request are returned in errors[request], all others are thrown.
+    // Returns the number of gaps in the minibatch of the first input.
+    size_t ForwardPassBatch(const std::vector<const Values<ElemType>*>& inputs, const std::vector<Values<ElemType>*>& outputs,
+                            std::vector<std::exception_ptr>& errors);
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
@@ -121,12 +131,22 @@ public:
 
 private:
     static VariableLayout ToVariableLayout(const ComputationNodeBasePtr n);
+    std::vector<std::wstring> m_outputNodeNames;
     std::vector<ComputationNodeBasePtr> m_outputNodes;
     std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
     std::vector<ComputationNodeBasePtr> m_inputNodes;
     StreamMinibatchInputs m_inputMatrices;
     bool m_started;
 
+    // staging buffers of ForwardPassBatch()
+    std::vector<ElemType> m_batchValues;
+    std::vector<int> m_batchColIndices;
+    std::vector<int> m_batchIndices;
+
+    // checks the input buffer for m_inputNodes[i] and returns its number of samples
+    template<template<typename> class ValueContainer>
+    size_t ValidateInput(size_t i, const ValueBuffer<ElemType, ValueContainer>& buffer) const;
+
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
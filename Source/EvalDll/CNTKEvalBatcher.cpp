@@ -0,0 +1,180 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CNTKEvalBatcher.cpp : batching front-end of the extended evaluation interface
+//
+
+#include "CNTKEvalBatcher.h"
+#include "CNTKEval.h"
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <typename ElemType>
+CNTKEvalBatcher<ElemType>::CNTKEvalBatcher(CNTKEvalExtended<ElemType>* session, const BatchingOptions& options)
+    : m_session(session), m_options(options), m_numQueuedSamples(0), m_shutdown(false), m_statistics(), m_startTime(Clock::now())
+{
+    if (m_options.m_maxBatchRequests == 0)
+    {
+        m_session->Destroy();
+        InvalidArgument("CNTKEvalBatcher: The maximum number of requests per batch must be positive.");
+    }
+    m_inputSchema = m_session->GetInputSchema();
+    m_worker = std::thread([this]() { WorkerLoop(); });
+}
+
+template <typename ElemType>
+CNTKEvalBatcher<ElemType>::~CNTKEvalBatcher()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_shutdown = true;
+    }
+    m_requestArrived.notify_all();
+    m_worker.join();
+    m_session->Destroy();
+}
+
+template <typename ElemType>
+void CNTKEvalBatcher<ElemType>::Destroy()
+{
+    delete this;
+}
+
+template <typename ElemType>
+void CNTKEvalBatcher<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs)
+{
+    Request request;
+    request.m_inputs = &inputs;
+    request.m_outputs = &outputs;
+    request.m_numSamples = 0;
+    request.m_done = false;
+    if (!inputs.empty() && !m_inputSchema.empty())
+    {
+        // malformed inputs are only counted here, they are rejected by the evaluation
+        const auto& layout = m_inputSchema[0];
+        if (layout.m_storageType == VariableLayout::Sparse)
+            request.m_numSamples = inputs[0].m_colIndices.size() > 0 ? inputs[0].m_colIndices.size() - 1 : 0;
+        else if (layout.m_numElements > 0)
+            request.m_numSamples = inputs[0].m_buffer.size() / layout.m_numElements;
+    }
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (m_shutdown)
+        RuntimeError("CNTKEvalBatcher: ForwardPass() called while the batcher is being destroyed.");
+    request.m_submitTime = Clock::now();
+    m_queue.push_back(&request);
+    m_numQueuedSamples += request.m_numSamples;
+    m_requestArrived.notify_one();
+
+    m_batchCompleted.wait(lock, [&request]() { return request.m_done; });
+    lock.unlock();
+
+    if (request.m_error)
+        std::rethrow_exception(request.m_error);
+}
+
+template <typename ElemType>
+BatchingStatistics CNTKEvalBatcher<ElemType>::GetStatistics() const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    BatchingStatistics statistics = m_statistics;
+    statistics.m_elapsedSeconds = std::chrono::duration<double>(Clock::now() - m_startTime).count();
+    return statistics;
+}
+
+template <typename ElemType>
+bool CNTKEvalBatcher<ElemType>::IsBatchFull() const
+{
+    return m_queue.size() >= m_options.m_maxBatchRequests ||
+           (m_options.m_maxBatchSamples > 0 && m_numQueuedSamples >= m_options.m_maxBatchSamples);
+}
+
+template <typename ElemType>
+void CNTKEvalBatcher<ElemType>::WorkerLoop()
+{
+    std::vector<Request*> batch;
+    for (;;)
+    {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_requestArrived.wait(lock, [this]() { return !m_queue.empty() || m_shutdown; });
+            if (m_queue.empty())
+                return; // shut down, and nothing is pending
+
+            // give the batch time to fill up, counted from the arrival of its oldest request
+            auto deadline = m_queue.front()->m_submitTime + std::chrono::microseconds(m_options.m_maxLatencyMicroseconds);
+            m_requestArrived.wait_until(lock, deadline, [this]() { return IsBatchFull() || m_shutdown; });
+
+            size_t numSamples = 0;
+            while (!m_queue.empty() && batch.size() < m_options.m_maxBatchRequests)
+            {
+                auto request = m_queue.front();
+                if (m_options.m_maxBatchSamples > 0 && !batch.empty() && numSamples + request->m_numSamples > m_options.m_maxBatchSamples)
+                    break;
+                batch.push_back(request);
+                numSamples += request->m_numSamples;
+                m_numQueuedSamples -= request->m_numSamples;
+                m_queue.pop_front();
+            }
+        }
+
+        EvaluateBatch(batch);
+    }
+}
+
+template <typename ElemType>
+void CNTKEvalBatcher<ElemType>::EvaluateBatch(const std::vector<Request*>& batch)
+{
+    std::vector<const Values<ElemType>*> inputs;
+    std::vector<Values<ElemType>*> outputs;
+    for (auto request : batch)
+    {
+        inputs.push_back(request->m_inputs);
+        outputs.push_back(request->m_outputs);
+    }
+
+    auto beginTime = Clock::now();
+    std::vector<std::exception_ptr> errors;
+    size_t numPaddingSamples = 0;
+    try
+    {
+        numPaddingSamples = m_session->ForwardPassBatch(inputs, outputs, errors);
+    }
+    catch (...)
+    {
+        errors.assign(batch.size(), std::current_exception());
+    }
+    auto endTime = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_statistics.m_numBatches++;
+        m_statistics.m_numPaddingSamples += numPaddingSamples;
+        m_statistics.m_evaluationSeconds += std::chrono::duration<double>(endTime - beginTime).count();
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            auto request = batch[i];
+            double latency = std::chrono::duration<double>(endTime - request->m_submitTime).count();
+            m_statistics.m_numRequests++;
+            m_statistics.m_numSamples += request->m_numSamples;
+            m_statistics.m_totalQueueSeconds += std::chrono::duration<double>(beginTime - request->m_submitTime).count();
+            m_statistics.m_totalLatencySeconds += latency;
+            m_statistics.m_maxLatencySeconds = std::max(m_statistics.m_maxLatencySeconds, latency);
+            if (errors[i])
+                m_statistics.m_numFailedRequests++;
+
+            // the request lives on the stack of the waiting caller, it must not be touched once done
+            request->m_error = errors[i];
+            request->m_done = true;
+        }
+    }
+    m_batchCompleted.notify_all();
+}
+
+template class CNTKEvalBatcher<float>;
+template class CNTKEvalBatcher<double>;
+
+} } }
@@ -0,0 +1,81 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CNTKEvalBatcher.h - batching front-end of the extended evaluation interface
+//
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Eval.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <typename ElemType>
+class CNTKEvalExtended;
+
+// ------------------------------------------------------------------------
+// CNTKEvalBatcher -- queues the requests of concurrent callers and evaluates them together
+//
+// A background thread takes the queued requests in arrival order and evaluates them with
+// CNTKEvalExtended::ForwardPassBatch() on a session of its own. After the first request of a batch
+// has arrived, the thread waits until the batch is full or the latency budget of that request is
+// used up, whichever comes first. Callers block until their batch has been evaluated.
+// ------------------------------------------------------------------------
+
+template <typename ElemType>
+class CNTKEvalBatcher final : public IEvaluateModelBatcher<ElemType>
+{
+public:
+    // takes ownership of the session
+    CNTKEvalBatcher(CNTKEvalExtended<ElemType>* session, const BatchingOptions& options);
+
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs) override;
+
+    virtual BatchingStatistics GetStatistics() const override;
+
+    virtual void Destroy() override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request
+    {
+        const Values<ElemType>* m_inputs;
+        Values<ElemType>* m_outputs;
+        size_t m_numSamples; // of the first input, for the batch size limit
+        Clock::time_point m_submitTime;
+        std::exception_ptr m_error;
+        bool m_done;
+    };
+
+    // only through Destroy(); the class is final, so 'delete this' there deletes the complete object
+    ~CNTKEvalBatcher();
+
+    void WorkerLoop();
+    bool IsBatchFull() const;
+    void EvaluateBatch(const std::vector<Request*>& batch);
+
+    CNTKEvalExtended<ElemType>* m_session;
+    BatchingOptions m_options;
+    VariableSchema m_inputSchema;
+    std::thread m_worker;
+
+    mutable std::mutex m_lock; // protects the state below
+    std::condition_variable m_requestArrived;
+    std::condition_variable m_batchCompleted;
+    std::deque<Request*> m_queue;
+    size_t m_numQueuedSamples;
+    bool m_shutdown;
+    BatchingStatistics m_statistics;
+    Clock::time_point m_startTime;
+};
+
+} } }
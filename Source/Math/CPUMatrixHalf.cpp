@@ -5,60 +5,168 @@
 #include "stdafx.h"
 #include "CPUMatrixImpl.h"
 
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define HALF_CONVERSION_F16C
+#include <immintrin.h>
+#endif
+
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// General conversion function with no performance optimization
-// this should only be used in CPU half precision
-// For performance on inference on CPU, user should convert fp16 model to fp32 first, unless MKL supports half precision
-template<typename SrcT, typename DstT>
-static void ConvertBuffer(DstT* dst, const SrcT* src, size_t count)
+// Conversion of a contiguous range between half and float, with F16C instructions where available
+static void ConvertHalfToFloat(float* dst, const half* src, size_t count)
 {
-    for (size_t i = 0; i < count; i++)
-    {
-        dst[i] = (DstT)src[i];
-    }
+    size_t i = 0;
+#ifdef HALF_CONVERSION_F16C
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+#endif
+    for (; i < count; i++)
+        dst[i] = (float)src[i];
+}
+
+static void ConvertFloatToHalf(half* dst, const float* src, size_t count)
+{
+    size_t i = 0;
+#ifdef HALF_CONVERSION_F16C
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for (; i < count; i++)
+        dst[i] = src[i];
 }
 
-// specialization to convert from half to float for computation, and then store in half
+// Block sizes of the half precision product. Each block of C is computed in float from blocks of A and B
+// that are converted to float when they are needed, so no full-size float copies of the operands are made.
+static const int HalfGemmBlockRows = 256;
+static const int HalfGemmBlockCols = 256;
+static const int HalfGemmBlockInner = 256;
+
+// specialization to compute in float, block by block, and store in half
 template <>
 void CPUMatrix<half>::MultiplyAndWeightedAdd(half alpha, const CPUMatrix<half>& a, const bool transposeA, const CPUMatrix<half>& b, const bool transposeB,
     half beta, CPUMatrix<half>& c, shared_ptr<QuantizedMultiplier<half>> pQuantizedMultiplier)
 {
-    CPUMatrix<float> af(a.GetNumRows(), a.GetNumCols());
-    CPUMatrix<float> bf(b.GetNumRows(), b.GetNumCols());
-    CPUMatrix<float> cf(c.GetNumRows(), c.GetNumCols());
-
-    if (alpha != 0)
-    {
-        ConvertBuffer<half, float>(af.Data(), a.Data(), a.GetNumElements());
-        ConvertBuffer<half, float>(bf.Data(), b.Data(), b.GetNumElements());
-    }
-
-    if (beta != 0)
-    {
-        ConvertBuffer<half, float>(cf.Data(), c.Data(), c.GetNumElements());
-    }
-
     if (pQuantizedMultiplier)
         RuntimeError("Quantized matrix multiply not supported for Half");
 
-    CPUMatrix<float>::MultiplyAndWeightedAdd((float)alpha, af, transposeA, bf, transposeB, (float)beta, cf, nullptr);
-
-    ConvertBuffer<float, half>(c.Data(), cf.Data(), c.GetNumElements());
+    if (a.IsEmpty() || b.IsEmpty())
+        return;
+
+    // op(A) is m x k, op(B) is k x n
+    int m = (int)(transposeA ? a.GetNumCols() : a.GetNumRows());
+    int k = (int)(transposeA ? a.GetNumRows() : a.GetNumCols());
+    int l = (int)(transposeB ? b.GetNumCols() : b.GetNumRows());
+    int n = (int)(transposeB ? b.GetNumRows() : b.GetNumCols());
+
+    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to int may cause overflow
+    if (k != l)
+        InvalidArgument("CPUMatrix<ElemType>::MultiplyAndWeightedAdd : The inner dimensions of a and b must match.");
+
+    if (beta == 0)
+        c.RequireSize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    float alphaF = (float)alpha, betaF = (float)beta;
+    const half* aData = a.Data();
+    const half* bData = b.Data();
+    half* cData = c.Data();
+    int lda = (int)a.GetNumRows(), ldb = (int)b.GetNumRows(), ldc = (int)c.GetNumRows();
+
+    int numRowBlocks = (m + HalfGemmBlockRows - 1) / HalfGemmBlockRows;
+    int numColBlocks = (n + HalfGemmBlockCols - 1) / HalfGemmBlockCols;
+    int numBlocks = numRowBlocks * numColBlocks;
+
+    // with a single block, sgemm uses all threads; with several, every thread computes its own blocks
+#pragma omp parallel for schedule(dynamic) if (numBlocks > 1)
+    for (int block = 0; block < numBlocks; block++)
+    {
+        // float buffers, reused across calls
+        static thread_local vector<float> aBlock, bBlock, cBlock;
+        aBlock.resize(HalfGemmBlockRows * HalfGemmBlockInner);
+        bBlock.resize(HalfGemmBlockInner * HalfGemmBlockCols);
+        cBlock.resize(HalfGemmBlockRows * HalfGemmBlockCols);
+
+        int i0 = (block % numRowBlocks) * HalfGemmBlockRows, rows = min(HalfGemmBlockRows, m - i0);
+        int j0 = (block / numRowBlocks) * HalfGemmBlockCols, cols = min(HalfGemmBlockCols, n - j0);
+
+        for (int j = 0; j < cols; j++)
+        {
+            float* cColumn = cBlock.data() + (size_t)j * rows;
+            if (betaF == 0)
+                fill(cColumn, cColumn + rows, 0.0f);
+            else
+            {
+                ConvertHalfToFloat(cColumn, cData + i0 + (size_t)(j0 + j) * ldc, rows);
+                for (int i = 0; i < rows; i++)
+                    cColumn[i] *= betaF;
+            }
+        }
+
+        for (int k0 = 0; k0 < k; k0 += HalfGemmBlockInner)
+        {
+            int inner = min(HalfGemmBlockInner, k - k0);
+
+            // the blocks keep the orientation of the operands, sgemm transposes them as needed
+            if (!transposeA) // rows x inner
+                for (int kk = 0; kk < inner; kk++)
+                    ConvertHalfToFloat(aBlock.data() + (size_t)kk * rows, aData + i0 + (size_t)(k0 + kk) * lda, rows);
+            else // inner x rows
+                for (int i = 0; i < rows; i++)
+                    ConvertHalfToFloat(aBlock.data() + (size_t)i * inner, aData + k0 + (size_t)(i0 + i) * lda, inner);
+
+            if (!transposeB) // inner x cols
+                for (int j = 0; j < cols; j++)
+                    ConvertHalfToFloat(bBlock.data() + (size_t)j * inner, bData + k0 + (size_t)(j0 + j) * ldb, inner);
+            else // cols x inner
+                for (int kk = 0; kk < inner; kk++)
+                    ConvertHalfToFloat(bBlock.data() + (size_t)kk * cols, bData + j0 + (size_t)(k0 + kk) * ldb, cols);
+
+            cblas_sgemm((CBLAS_ORDER)(int)MatrixOrder::ColMajor,
+                        transposeA ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans,
+                        transposeB ? CBLAS_TRANSPOSE::CblasTrans : CBLAS_TRANSPOSE::CblasNoTrans,
+                        rows, cols, inner, alphaF,
+                        aBlock.data(), transposeA ? inner : rows,
+                        bBlock.data(), transposeB ? cols : inner,
+                        1.0f, cBlock.data(), rows);
+        }
+
+        for (int j = 0; j < cols; j++)
+            ConvertFloatToHalf(cData + i0 + (size_t)(j0 + j) * ldc, cBlock.data() + (size_t)j * rows, rows);
+    }
 }
 
-// specialization to RunTimeError for now due to omp implementation only support build-in type
+// specializations that accumulate in float, since omp reductions only support built-in types
 template <>
 void CPUMatrix<half>::AssignSoftmaxSum(const CPUMatrix<half>& softmax, CPUMatrix<half>& c)
 {
-    RuntimeError("half AssignSoftmaxSum not supported.");
+    float log_likelihood = 0.0;
+    size_t batch_size = GetNumCols();
+#pragma omp parallel for reduction(+ : log_likelihood)
+    for (int instance_id = 0; instance_id < batch_size; instance_id++)
+    {
+        int sample = (int) (float) (*this)(0, instance_id);
+        log_likelihood += (float) softmax(instance_id, sample);
+    }
+    c(0, 0) = -log_likelihood;
 }
 
 template <>
 void CPUMatrix<half>::AssignNCEUnnormalizedEval(const CPUMatrix<half>& a,
                                                 const CPUMatrix<half>& b, const CPUMatrix<half>& bias, CPUMatrix<half>& c)
 {
-    RuntimeError("half AssignNCEUnnormalizedEval not supported.");
+    float log_likelihood = 0.0;
+    size_t batch_size = GetNumCols();
+#pragma omp parallel for reduction(+ : log_likelihood)
+    for (int instance_id = 0; instance_id < batch_size; instance_id++)
+    {
+        int sample = -(int) (float) (*this)(0, instance_id);
+        float score = (float) bias(sample, 0);
+        for (int dim = 0; dim < b.GetNumRows(); dim++)
+            score += (float) b(dim, sample) * (float) a(dim, instance_id);
+        log_likelihood += score;
+    }
+    c(0, 0) = -log_likelihood;
 }
 
 template <>
@@ -11,7 +11,9 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPURNN.h"
 #include "TensorOps.h"
+#include "LogSumExp.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -5131,6 +5133,35 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+#pragma region RNN Functions
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    // numLayers, hiddenSize are input parameters
+    if (!m_rnnExecutor)
+        m_rnnExecutor = std::make_shared<CPURNNExecutor<ElemType>>(xDim, yDim, rnnAttributes);
+    m_rnnExecutor->ForwardCore(paramW, inputX, *this, numSequencesForFrame, rnnAttributes, reserve, workspace);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardData(const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& paramW, CPUMatrix<ElemType>& outputDX, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    if (!m_rnnExecutor)
+        LogicError("RNNBackwardData called, but RNNWrapper object is not yet initialized");
+    m_rnnExecutor->BackwardDataCore(*this, outputDY, paramW, outputDX, rnnAttributes, reserve, workspace);
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardWeights(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    if (!m_rnnExecutor)
+        LogicError("RNNBackwardWeights called, but RNNWrapper object is not yet initialized");
+    m_rnnExecutor->BackwardWeightsCore(inputX, outputY, dw, rnnAttributes, reserve, workspace);
+}
+
+#pragma endregion RNN Functions
+
 
 #pragma region Static BLAS Functions
 
@@ -6508,19 +6539,22 @@ void CPUMatrix<ElemType>::RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha,
     }
 };
 
-// Calculate alpha in forward-backward calculation. equation (6), (7) in ftp://ftp.idsia.ch/pub/juergen/icml2006.pdf
-// GPU x dimension corresponds to utterances, y dimension corresponds to phone sequence in each utterance
+// CTC forward-backward of one utterance: alpha, equations (6), (7), beta, equations (10), (11), the total score,
+// equation (8), and the derivative, equation (15) in ftp://ftp.idsia.ch/pub/juergen/icml2006.pdf
+// The utterances of a minibatch occupy different frames of alpha, beta and CTCscore, so they can be processed
+// concurrently. Within a frame the scores of all label positions are computed at once by LogSumExp3().
+// Returns the total score (log probability of the label sequence) of the utterance.
+// CTCscore (output): derivative, must be initialized to LZERO
 // prob (input): the posterior output from the network
-// alpha (output): alpha for forward-backward calculation.
+// alphaScore, betaScore (output): alpha and beta for forward-backward calculation, must be initialized to LZERO
 // phoneSeq (input): phone ID sequence for each utterance in this minibatch, each col is one utterance
 // phoneBound (input): phone boundary (frame index) of each phone for each utterance in this minibatch, each col is one utterance
-// uttToChanInd (input):  map from utterance ID to minibatch channel ID. We need this because each channel may contain more than one utterance.
-// uttFrameNum (input): the frame number of each utterance. The size of this vector =  the number of all utterances in this minibatch
-// uttBeginFrame(input): the position of the first frame of each utterance in the minibatch channel. We need this because each channel may contain more than one utterance.
-// uttPhoneNum (input): the phone number of each utterance. The size of this vector =  the number of all utterances in this minibatch
+// uttId (input): index of the utterance in phoneSeq and phoneBound
+// chanId (input): minibatch channel of the utterance
+// beginFrame (input): the position of the first frame of the utterance in its minibatch channel
+// frameNum (input): the frame number of the utterance
+// phoneNum (input): the phone number of the utterance (including the first and last positions, which are not labels)
 // numChannels (input): channel number in this minibatch
-// uttNum (input): number of utterances
-// t (input): time stamp to process
 // maxPhoneNum (input): the max number of phones between utterances
 // totalPhoneNum (input): the total number of phones of all utterances
 // blankTokenId (input): id of the CTC blank token
@@ -6529,280 +6563,155 @@ void CPUMatrix<ElemType>::RCRFBackwardCompute(const CPUMatrix<ElemType>& alpha,
 //      Setting this parameter smaller will result in shorted delay between label output during decoding.
 //      delayConstraint=-1 means no constraint
 template<class ElemType>
-void _assignAlphaScore(
+ElemType _assignUtteranceCTCScore(
+    ElemType *CTCscore,
     const ElemType *prob,
     ElemType *alphaScore,
-    ElemType *phoneSeq,
-    ElemType *phoneBound,
-    const std::vector<size_t>& uttToChanInd,
-    const std::vector<size_t>& uttFrameNum,
-    const std::vector<size_t>& uttBeginFrame,
-    const std::vector<size_t>& uttPhoneNum,
-    size_t numChannels,
-    const size_t uttNum,
-    const size_t  t,
-    const size_t maxPhoneNum, // Maximum length of utterance in this MB
-    const size_t totalPhoneNum, // Total number of phones
-    const size_t blankTokenId,
-    const int delayConstraint)
-{
-    for (size_t uttId = 0;uttId < uttNum;uttId++) {
-
-        // Number of phones and frames in this utterance
-        size_t frameNum = uttFrameNum[uttId];
-        if (t >= frameNum) continue;
-
-        size_t phoneNum = uttPhoneNum[uttId];
-
-#pragma omp parallel for
-        for (int phoneSeqId = 1;phoneSeqId < phoneNum - 1;phoneSeqId++) {
-            // Index of the label in the sequence
-
-            // Current and previous phone indices in phoneSeq matrix
-            size_t labelid = uttId*maxPhoneNum + phoneSeqId;
-
-            // Actual current phone label
-            size_t phoneId = (size_t)(phoneSeq[labelid]);
-
-            // Index of the current frame in minibatch
-            size_t timeId = (t + uttBeginFrame[uttId])*numChannels + uttToChanInd[uttId];
-
-            // Index of probability of observing phoneId at frame timeId
-            size_t probId = timeId*totalPhoneNum + phoneId;
-
-            size_t alphaId = maxPhoneNum* timeId + phoneSeqId; // alpha_t(s)
-
-            if (t == 0)
-            {
-                // Initialize recursion
-                if (phoneSeqId == 1 || phoneSeqId == 2)
-                {
-                    alphaScore[alphaId] = prob[probId];
-                }
-            }
-            else
-            {
-                if (phoneSeqId >= 1)
-                {
-                    size_t timeId_1 = timeId - numChannels; // Index corresponding to (t-1)
-                    size_t alphaId_0 = maxPhoneNum* timeId_1 + phoneSeqId; // alpha_{t-1}(s)
-                    size_t alphaId_1 = alphaId_0 - 1; // alpha_{t-1}(s-1)
-                    size_t alphaId_2 = alphaId_0 - 2; // alpha_{t-1}(s-2)
-                    ElemType x = LZERO;
-
-                    ElemType ascore;
-                    if (phoneSeqId > 2)
-                    {
-                        size_t labelid_2 = labelid - 2;
-                        // if current label is not blank and not equal prev non-blank label
-                        if ((size_t)(phoneSeq[labelid]) != blankTokenId && phoneId != (size_t)(phoneSeq[labelid_2]))
-                        {
-                            x = LogAdd(x, alphaScore[alphaId_2]);
-                        }
-                    }
-
-                    if (phoneSeqId > 1)
-                    {
-                        x = LogAdd(x, alphaScore[alphaId_1]);
-                    }
-
-                    x = LogAdd(x, alphaScore[alphaId_0]);
-
-                    if (phoneId != SIZE_MAX)
-                        ascore = prob[probId]; // Probability of observing given label at given time
-                    else
-                        ascore = 0;
-                    alphaScore[alphaId] = (ElemType)x + ascore;
-                    if (delayConstraint != -1)
-                    {
-                        size_t labelid_r = labelid + 2;
-                        size_t phoneBoundId_r = (size_t)(phoneBound[labelid_r]);
-                        if (phoneId == blankTokenId)
-                        {
-                            // only constraint right side
-                            if (t > phoneBoundId_r + delayConstraint - 1)
-                                alphaScore[alphaId] = LZERO;
-                        }
-                        else if (phoneId != blankTokenId)
-                        {
-                            if (t > phoneBoundId_r + delayConstraint)
-                                alphaScore[alphaId] = LZERO;
-                        }
-                    }
-                }
-
-            }
-        }
-    }
-}
-
-// Calculate beta in forward-backward calculation, equation (10), (11) in ftp://ftp.idsia.ch/pub/juergen/icml2006.pdf
-// See _assignAlphaScore for the explanation of parameters
-template<class ElemType>
-void _assignBetaScore(
-    const ElemType *prob,
     ElemType *betaScore,
-    ElemType *phoneSeq,
-    ElemType *phoneBound,
-    const std::vector<size_t>& uttToChanInd,
-    const std::vector<size_t>& uttFrameNum,
-    const std::vector<size_t>& uttBeginFrame,
-    const std::vector<size_t>& uttPhoneNum,
+    const ElemType *phoneSeq,
+    const ElemType *phoneBound,
+    const size_t uttId,
+    const size_t chanId,
+    const size_t beginFrame,
+    const size_t frameNum,
+    const size_t phoneNum,
     const size_t numChannels,
-    const size_t uttNum,
-    const long  t,
     const size_t maxPhoneNum,
     const size_t totalPhoneNum,
     const size_t blankTokenId,
     const int delayConstraint)
 {
-    for (size_t uttId = 0;uttId < uttNum;uttId++) {
-
-        // Number of phones and frames in this utterance
-        size_t frameNum = uttFrameNum[uttId];
-        if (t >= frameNum) continue;
-
-        size_t phoneNum = uttPhoneNum[uttId];
-
-#pragma omp parallel for
-        for (int phoneSeqId = 1;phoneSeqId < phoneNum - 1;phoneSeqId++) {
-
-            size_t labelid = uttId*maxPhoneNum + phoneSeqId;
-            size_t labelid_2 = labelid + 2;
-            size_t phoneId = (LONG64)(phoneSeq[labelid]);
-            size_t timeId = (t + uttBeginFrame[uttId])*numChannels + uttToChanInd[uttId];
-            size_t probId = timeId*totalPhoneNum + phoneId;
-            size_t betaid = maxPhoneNum* timeId + phoneSeqId;
-            size_t timeId_1 = timeId + numChannels;
-            size_t betaid_0 = maxPhoneNum* timeId_1 + phoneSeqId;
-            size_t betaid_1 = betaid_0 + 1;
-            size_t betaid_2 = betaid_0 + 2;
+    // Per label position s: the label, the penalty (0 or LZERO) for skipping the blank between the label at s
+    // and the one at s - 2 (alpha) or s + 2 (beta), and the last frame allowed by the delay constraint
+    // The first and last positions are not labels. phoneSeq holds SIZE_MAX there, which is out of the range of
+    // size_t once stored as ElemType, so they are not converted.
+    std::vector<size_t> phoneIds(phoneNum, SIZE_MAX);
+    std::vector<ElemType> noPenalty(phoneNum, 0);
+    std::vector<ElemType> alphaSkipPenalty(phoneNum, (ElemType)LZERO);
+    std::vector<ElemType> betaSkipPenalty(phoneNum, (ElemType)LZERO);
+    std::vector<size_t> lastFrame(phoneNum, SIZE_MAX);
+    for (size_t s = 1; s + 1 < phoneNum; s++)
+        phoneIds[s] = (size_t)phoneSeq[uttId * maxPhoneNum + s];
+    for (size_t s = 1; s + 1 < phoneNum; s++)
+    {
+        // if current label is not blank and not equal prev (next) non-blank label
+        if (s > 2 && phoneIds[s] != blankTokenId && phoneIds[s] != phoneIds[s - 2])
+            alphaSkipPenalty[s] = 0;
+        if (s + 3 < phoneNum && phoneIds[s] != blankTokenId && phoneIds[s] != phoneIds[s + 2])
+            betaSkipPenalty[s] = 0;
+        if (delayConstraint != -1)
+        {
+            // the final blank has no label after it, it is not constrained
+            size_t phoneBoundId_r = (s + 2 < phoneNum) ? (size_t)phoneBound[uttId * maxPhoneNum + s + 2] : frameNum;
+            if (phoneIds[s] == blankTokenId)
+                lastFrame[s] = phoneBoundId_r + delayConstraint - 1; // only constraint right side
+            else
+                lastFrame[s] = phoneBoundId_r + delayConstraint;
+        }
+    }
 
-            if (t == frameNum - 1)
+    // Probability of observing the label at each position at frame t
+    std::vector<ElemType> ascore(phoneNum, 0);
+    auto getFrameScores = [&](size_t timeId)
+    {
+        const ElemType* frameProb = prob + timeId * totalPhoneNum;
+        for (size_t s = 1; s + 1 < phoneNum; s++)
+            ascore[s] = (phoneIds[s] != SIZE_MAX) ? frameProb[phoneIds[s]] : (ElemType)0;
+    };
+    auto applyDelayConstraint = [&](ElemType* score, size_t t)
+    {
+        if (delayConstraint != -1)
+        {
+            for (size_t s = 1; s + 1 < phoneNum; s++)
             {
-                if (phoneSeqId == phoneNum - 3 || phoneSeqId == phoneNum - 2)
-                {
-                    betaScore[betaid] = prob[probId];
-                }
+                if (t > lastFrame[s])
+                    score[s] = LZERO;
             }
-            else
-            {
-                if (phoneSeqId >= 1)
-                {
-                    ElemType x = LZERO;
-                    ElemType ascore;
-                    if (phoneSeqId < phoneNum - 3)
-                    {
-                        if (phoneSeq[labelid] != blankTokenId && phoneId != phoneSeq[labelid_2])
-                        {
-                            x = LogAdd(x, betaScore[betaid_2]);
-                        }
-                    }
-
-                    if (phoneSeqId < phoneNum - 2)
-                    {
-                        x = LogAdd(x, betaScore[betaid_1]);
-                    }
+        }
+    };
 
-                    x = LogAdd(x, betaScore[betaid_0]);
+    // Index of frame t of the utterance in the minibatch
+    auto getTimeId = [&](size_t t) { return (t + beginFrame) * numChannels + chanId; };
 
-                    if (phoneId != SIZE_MAX)
-                        ascore = prob[probId];
-                    else
-                        ascore = 0;
-                    betaScore[betaid] = (ElemType)x + ascore;
-                    if (delayConstraint != -1)
-                    {
-                        size_t phoneBoundId_r = (size_t)(phoneBound[labelid_2]);
-                        if (phoneId == blankTokenId)
-                        {
-                            if (t > phoneBoundId_r + delayConstraint - 1)
-                                betaScore[betaid] = LZERO;
-                        }
-                        else if (phoneId != blankTokenId)
-                        {
-                            if (t > phoneBoundId_r + delayConstraint)
-                                betaScore[betaid] = LZERO;
-                        }
-                    }
-                }
-            }
+    // alpha_t(s) = log(alpha_{t-1}(s) + alpha_{t-1}(s-1) + alpha_{t-1}(s-2)) + ascore_t(s)
+    for (size_t t = 0; t < frameNum; t++)
+    {
+        size_t timeId = getTimeId(t);
+        ElemType* alpha = alphaScore + timeId * maxPhoneNum;
+        getFrameScores(timeId);
+        if (t == 0)
+        {
+            // Initialize recursion
+            alpha[1] = ascore[1];
+            if (phoneNum > 3)
+                alpha[2] = ascore[2];
+        }
+        else
+        {
+            const ElemType* alphaPrev = alpha - numChannels * maxPhoneNum;
+            alpha[1] = alphaPrev[1] + ascore[1];
+            if (phoneNum > 3)
+                LogSumExp3(alphaPrev + 2, alphaPrev + 1, noPenalty.data() + 2, alphaPrev, alphaSkipPenalty.data() + 2, ascore.data() + 2, alpha + 2, phoneNum - 3);
+            applyDelayConstraint(alpha, t);
         }
     }
-}
 
-// Calculate CTC score. equation (8) in ftp://ftp.idsia.ch/pub/juergen/icml2006.pdf
-template<class ElemType>
-void _assignTotalScore(ElemType *betaScore,
-    std::vector<ElemType>& totalScore,
-    const size_t uttNum,
-    const std::vector<size_t>& uttToChanInd,
-    const std::vector<size_t>& uttBeginFrame,
-    const size_t numChannels,
-    const size_t maxPhoneNum)
-{
-#pragma omp parallel for
-    for (int uttId = 0; uttId < uttNum; uttId++) {
-        if (uttId < uttNum)
+    // beta_t(s) = log(beta_{t+1}(s) + beta_{t+1}(s+1) + beta_{t+1}(s+2)) + ascore_t(s)
+    for (size_t t = frameNum; t-- > 0;)
+    {
+        size_t timeId = getTimeId(t);
+        ElemType* beta = betaScore + timeId * maxPhoneNum;
+        getFrameScores(timeId);
+        if (t == frameNum - 1)
         {
-            LONG64 alphaId_0 = (uttBeginFrame[uttId] * numChannels + uttToChanInd[uttId]) * maxPhoneNum;
-
-            betaScore[alphaId_0] = LogAdd(betaScore[alphaId_0 + 1], betaScore[alphaId_0 + 2]);
-            totalScore[uttId] = betaScore[alphaId_0];
+            beta[phoneNum - 2] = ascore[phoneNum - 2];
+            if (phoneNum > 3)
+                beta[phoneNum - 3] = ascore[phoneNum - 3];
+        }
+        else
+        {
+            const ElemType* betaNext = beta + numChannels * maxPhoneNum;
+            beta[phoneNum - 2] = betaNext[phoneNum - 2] + ascore[phoneNum - 2];
+            if (phoneNum > 3)
+                LogSumExp3(betaNext + 1, betaNext + 2, noPenalty.data() + 1, betaNext + 3, betaSkipPenalty.data() + 1, ascore.data() + 1, beta + 1, phoneNum - 3);
+            applyDelayConstraint(beta, t);
         }
     }
-}
 
-// Calculate derivative, equation (15) in ftp://ftp.idsia.ch/pub/juergen/icml2006.pdf
-// See _assignAlphaScore for the explanation of parameters
-template<class ElemType>
-void _assignCTCScore(
-    ElemType *CTCscore,
-    ElemType *prob,
-    ElemType *alphaScore,
-    ElemType *betaScore,
-    ElemType *phoneSeq,
-    const size_t uttNum,
-    const std::vector<size_t>& uttToChanInd,
-    const std::vector<size_t>& uttBeginFrame,
-    const std::vector<size_t>& uttPhoneNum,
-    const std::vector<size_t>& uttFrameNum,
-    const size_t numChannels,
-    const size_t maxPhoneNum,
-    const size_t totalPhoneNum)
-{
-    for (size_t uttId = 0;uttId < uttNum;uttId++) {
-#pragma omp parallel for
-        for (int t = 0; t < uttFrameNum[uttId]; t++) {
-            size_t phoneNum = uttPhoneNum[uttId];
-            size_t alphaId_0 = (uttBeginFrame[uttId] * numChannels + uttToChanInd[uttId]) * maxPhoneNum;
-            size_t timeId = (t + uttBeginFrame[uttId])*numChannels + uttToChanInd[uttId];
-            ElemType P_lx = betaScore[alphaId_0];
+    // Total score, stored in beta at the first frame and position 0
+    ElemType* betaFirst = betaScore + getTimeId(0) * maxPhoneNum;
+    betaFirst[0] = LogAdd(betaFirst[1], betaFirst[2]);
+    ElemType P_lx = betaFirst[0];
 
-            for (int s = 1; s < phoneNum - 1; s++)
+    // Derivative: occupancy of each label, summed over the positions of the label
+    for (size_t t = 0; t < frameNum; t++)
+    {
+        size_t timeId = getTimeId(t);
+        const ElemType* alpha = alphaScore + timeId * maxPhoneNum;
+        const ElemType* beta = betaScore + timeId * maxPhoneNum;
+        const ElemType* frameProb = prob + timeId * totalPhoneNum;
+        ElemType* frameCTCscore = CTCscore + timeId * totalPhoneNum;
+        for (size_t s = 1; s + 1 < phoneNum; s++)
+        {
+            size_t phoneId = phoneIds[s];
+            if (phoneId != SIZE_MAX)
             {
-                long phoneId = phoneSeq[uttId*maxPhoneNum + s];
-                size_t alphaId = maxPhoneNum* timeId + s;
-                size_t probId = timeId*totalPhoneNum + phoneId;
-
-                if (phoneId != SIZE_MAX)
-                {
-                    ElemType logoccu = alphaScore[alphaId] + betaScore[alphaId] - prob[probId] - (ElemType)P_lx;
-                    CTCscore[probId] = LogAdd(CTCscore[probId], logoccu);
-                }
+                ElemType logoccu = alpha[s] + beta[s] - frameProb[phoneId] - P_lx;
+                frameCTCscore[phoneId] = LogAdd(frameCTCscore[phoneId], logoccu);
             }
+        }
 
-            for (int s = 0; s < totalPhoneNum; s++)
-            {
-                size_t probId = timeId*totalPhoneNum + s;
-                ElemType logoccu = CTCscore[probId];
-                if (logoccu < LZERO)
-                    CTCscore[probId] = 0.0f;
-                else
-                    CTCscore[probId] = exp(logoccu);
-            }
+        for (size_t s = 0; s < totalPhoneNum; s++)
+        {
+            ElemType logoccu = frameCTCscore[s];
+            if (logoccu < LZERO)
+                frameCTCscore[s] = 0.0f;
+            else
+                frameCTCscore[s] = exp(logoccu);
         }
     }
+
+    return P_lx;
 }
 
 template<class ElemType>
@@ -6821,24 +6730,16 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignCTCScore(
         // Max number of phones in utterances in this minibatch
         size_t maxPhoneNum = phoneSeq.GetNumRows();
 
-        for (size_t t = 0; t < maxFrameNum; t++)
-        {
-            _assignAlphaScore(prob.Data(), alpha.Data(), phoneSeq.Data(), phoneBoundary.Data(), uttToChanInd,
-                uttFrameNum, uttBeginFrame, uttPhoneNum, numParallelSequences, uttNum, t, maxPhoneNum, totalPhoneNum, blankTokenId, delayConstraint);
-        }
-
-        for (LONG64 t = maxFrameNum - 1; t >= 0; t--)
+        // The utterances are independent, each is processed by one thread.
+        std::vector<ElemType> scores(uttNum);
+#pragma omp parallel for schedule(dynamic)
+        for (int uttId = 0; uttId < (int)uttNum; uttId++)
         {
-            _assignBetaScore(prob.Data(), beta.Data(), phoneSeq.Data(), phoneBoundary.Data(), uttToChanInd,
-                uttFrameNum, uttBeginFrame, uttPhoneNum, numParallelSequences, uttNum, t, maxPhoneNum, totalPhoneNum, blankTokenId, delayConstraint);
+            scores[uttId] = _assignUtteranceCTCScore(Data(), prob.Data(), alpha.Data(), beta.Data(), phoneSeq.Data(), phoneBoundary.Data(),
+                uttId, uttToChanInd[uttId], uttBeginFrame[uttId], uttFrameNum[uttId], uttPhoneNum[uttId],
+                numParallelSequences, maxPhoneNum, totalPhoneNum, blankTokenId, delayConstraint);
         }
 
-        std::vector<ElemType> scores(uttNum);
-        _assignTotalScore(beta.Data(), scores, uttNum, uttToChanInd, uttBeginFrame, numParallelSequences, maxPhoneNum);
-
-        _assignCTCScore(Data(), prob.Data(), alpha.Data(), beta.Data(), phoneSeq.Data(), uttNum, uttToChanInd,
-            uttBeginFrame, uttPhoneNum, uttFrameNum, numParallelSequences, maxPhoneNum, totalPhoneNum);
-
         totalScore(0, 0) = 0.0;
         for (size_t utt = 0; utt < uttNum; utt++)
         {
@@ -2,6 +2,8 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include <climits>
+#include <omp.h>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -15,6 +17,16 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // function to compute the value for a given output location (perform reduction if needed)
 // -----------------------------------------------------------------------
 
+// Reductions over fewer elements than this (summed over all output locations) are run on a single thread,
+// since the OMP overhead would dominate.
+static const size_t TensorOpParallelReductionMinElements = 16384;
+// With fewer output locations than this, each output location is reduced by multiple threads instead.
+static const size_t TensorOpParallelReductionMinOutputs = 64;
+// When a single output location is reduced by multiple threads, the reduction is cut into tiles of roughly
+// this many elements. Neither the tiling nor the choice of strategy depend on the number of threads, so the
+// results are the same for any number of threads.
+static const size_t TensorOpReductionTileElements = 4096;
+
 // perform loop over reduction index m
 // This function is declared inside a wrapper struct to allow partial specialization (m = -1).
 template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int m>
@@ -23,13 +35,33 @@ struct TensorOpReduction
     // reduction case (non-reduction case is specialized)
     static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn, const ReductionOp& reductionOp,
                                 const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        double aggregate = Range(pointers, 0, reducingOpDims[(size_t) m], opfn, reductionOp, reducingOpDims, reducingStrides, false /*reorder*/);
+        // Actually it would be nicer to return double but we keep ElementType so that test don't return different numbers than previous implementation.
+        return static_cast<ElemType>(aggregate);
+    }
+
+    // reduce over the index range [begin, end) of reduction index m (end > begin)
+    // If 'reorder' is set, a contiguous innermost reduction may aggregate the elements in a different order (see ContiguousRange).
+    // This is only done by the parallel reduction, which changes the order anyway, so that small reductions, which are
+    // run serially, give the same results as before.
+    static inline double Range(array<ElemType*, N> pointers, size_t begin, size_t end, const OPFN& opfn, const ReductionOp& reductionOp,
+                               const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides, bool reorder)
     {
         array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
+        bool contiguous = true;
         for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
+        {
             strides[i] = reducingStrides[i][(size_t) m];
+            pointers[i] += (ptrdiff_t) begin * strides[i];
+            contiguous &= strides[i] == 1;
+        }
+
+        if (reorder && m == 0 && contiguous && end - begin >= 8)
+            return ContiguousRange(pointers, end - begin, opfn, reductionOp);
 
         double aggregate = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
-        for (size_t dim = reducingOpDims[(size_t)m] - 1; dim-- > 0;)
+        for (size_t dim = end - begin - 1; dim-- > 0;)
         {
             // advance the pointers
             for (size_t i = 0; i < N - 1; i++)
@@ -38,8 +70,32 @@ struct TensorOpReduction
             // need to descend into one loop deeper
             aggregate = reductionOp(aggregate, TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides));
         }
-        // Actually it would be nicer to return double but we keep ElementType so that test don't return different numbers than previous implementation.
-        return static_cast<ElemType>(aggregate);
+        return aggregate;
+    }
+
+    // Special version for the innermost reduction with strides all being 1. Four independent aggregates break the
+    // dependency chain between consecutive elements, so that the compiler can use SSE.
+    static inline double ContiguousRange(const array<ElemType*, N>& pointers, size_t count, const OPFN& opfn, const ReductionOp& reductionOp)
+    {
+        auto at = [&pointers](size_t j)
+        {
+            array<ElemType*, N> pp = pointers;
+            for (size_t i = 0; i < N - 1; i++)
+                pp[i] += j;
+            return pp;
+        };
+        double a0 = opfn(at(0)), a1 = opfn(at(1)), a2 = opfn(at(2)), a3 = opfn(at(3));
+        size_t j = 4;
+        for (; j + 4 <= count; j += 4)
+        {
+            a0 = reductionOp(a0, opfn(at(j)));
+            a1 = reductionOp(a1, opfn(at(j + 1)));
+            a2 = reductionOp(a2, opfn(at(j + 2)));
+            a3 = reductionOp(a3, opfn(at(j + 3)));
+        }
+        for (; j < count; j++)
+            a0 = reductionOp(a0, opfn(at(j)));
+        return reductionOp(reductionOp(a0, a1), reductionOp(a2, a3));
     }
 };
 
@@ -55,6 +111,57 @@ struct TensorOpReduction<ElemType, OPFN, ReductionOp, N, -1>
     }
 };
 
+// number of tiles and number of indices per tile when splitting the outermost reduction index m across threads
+static inline std::pair<size_t, size_t> TensorOpReductionTiles(const SmallVector<size_t>& reducingOpDims, int m)
+{
+    size_t innerElements = 1;
+    for (size_t i = 0; i < (size_t) m; i++)
+        innerElements *= reducingOpDims[i];
+    size_t tileSize = max(TensorOpReductionTileElements / innerElements, (size_t) 1);
+    size_t numTiles = (reducingOpDims[(size_t) m] + tileSize - 1) / tileSize;
+    return make_pair(numTiles, tileSize);
+}
+
+// perform the reduction for a single output location with multiple threads
+// The outermost reduction index m is cut into tiles, each tile is reduced by one thread, and the partial
+// aggregates are then combined pairwise in a fixed order.
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int m>
+struct TensorOpParallelReduction
+{
+    static ElemType Loop(const array<ElemType*, N>& pointers, const OPFN& opfn, const ReductionOp& reductionOp,
+                         const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+    {
+        auto tiles = TensorOpReductionTiles(reducingOpDims, m);
+        size_t numTiles = tiles.first, tileSize = tiles.second;
+        size_t dim = reducingOpDims[(size_t) m];
+
+        vector<double> partials(numTiles);
+#pragma omp parallel for
+        for (int t = 0; t < (int) numTiles; t++)
+            partials[t] = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m>::Range(pointers, t * tileSize, min((t + 1) * tileSize, dim), opfn, reductionOp, reducingOpDims, reducingStrides, true /*reorder*/);
+
+        for (size_t step = 1; step < numTiles; step *= 2)
+            for (size_t t = 0; t + step < numTiles; t += 2 * step)
+                partials[t] = reductionOp(partials[t], partials[t + step]);
+        return static_cast<ElemType>(partials[0]);
+    }
+};
+
+// true if 'val' replaces 'aggregate' as the result of an arg reduction. Ties keep the earlier element.
+template <class ElemType>
+static inline bool TensorArgOpUpdate(ElemType aggregate, ElemType val, ElementWiseOperator reductionOp)
+{
+    switch (reductionOp)
+    {
+    case ElementWiseOperator::opArgmin:
+        return aggregate > val;
+    case ElementWiseOperator::opArgmax:
+        return aggregate < val;
+    default:
+        return false;
+    }
+}
+
 // perform loop over reduction index m, while keeping track of the number of elements and their corresponding indices.
 // This function is declared inside a wrapper struct to allow partial specialization (m = -1).
 template <class ElemType, size_t N, int m>
@@ -64,63 +171,50 @@ struct TensorArgOpReduction
         ElementWiseOperator reductionOp)
     {
         size_t counter = 0;
-        size_t index = 0;
-        ElemType val = (ElemType)0;
-
         switch (reducingOpDims.size())
         {
         case 3:
-            val = TensorArgOpReduction<ElemType, N, 2>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter, index);
-            break;
+            return TensorArgOpReduction<ElemType, N, 2>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter);
         case 2:
-            val = TensorArgOpReduction<ElemType, N, 1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter, index);
-            break;
+            return TensorArgOpReduction<ElemType, N, 1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter);
         case 1:
-            val = TensorArgOpReduction<ElemType, N, 0>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter, index);
-            break;
+            return TensorArgOpReduction<ElemType, N, 0>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter);
         case 0:
-            val = TensorArgOpReduction<ElemType, N, -1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter, index);
-            break;
+            return TensorArgOpReduction<ElemType, N, -1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter);
         default:
             LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int)reducingOpDims.size());
         }
-
-        return make_pair(val, index);
     }
 
     // reduction case (non-reduction case is specialized)
-    static inline ElemType Loop(array<ElemType*, N> pointers, const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides,
-                                ElementWiseOperator reductionOp, size_t& counter, size_t& index)
+    // Returns the aggregate and the running index of the element it was taken from.
+    static inline std::pair<ElemType, size_t> Loop(array<ElemType*, N> pointers, const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides,
+                                                   ElementWiseOperator reductionOp, size_t& counter)
+    {
+        return Range(pointers, 0, reducingOpDims[(size_t)m], reducingOpDims, reducingStrides, reductionOp, counter);
+    }
+
+    // reduce over the index range [begin, end) of reduction index m (end > begin)
+    static inline std::pair<ElemType, size_t> Range(array<ElemType*, N> pointers, size_t begin, size_t end, const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides,
+                                                    ElementWiseOperator reductionOp, size_t& counter)
     {
         array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
         for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
+        {
             strides[i] = reducingStrides[i][(size_t)m];
+            pointers[i] += (ptrdiff_t) begin * strides[i];
+        }
 
-        ElemType aggregate = TensorArgOpReduction<ElemType, N, m - 1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter, index);
-        for (size_t dim = reducingOpDims[(size_t)m] - 1; dim-- > 0;)
+        auto aggregate = TensorArgOpReduction<ElemType, N, m - 1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter);
+        for (size_t dim = end - begin - 1; dim-- > 0;)
         {
             // advance the pointers
             for (size_t i = 0; i < N - 1; i++)
                 pointers[i] += strides[i]; // note: last pointer (result) is unused and untouched here
 
-            ElemType val = TensorArgOpReduction<ElemType, N, m - 1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter, index);
-
-            bool update = false;
-            switch (reductionOp)
-            {
-            case ElementWiseOperator::opArgmin:
-                update = (aggregate > val);
-                break;
-            case ElementWiseOperator::opArgmax:
-                update = (aggregate < val);
-                break;
-            }
-
-            if (update)
-            {
+            auto val = TensorArgOpReduction<ElemType, N, m - 1>::Loop(pointers, reducingOpDims, reducingStrides, reductionOp, counter);
+            if (TensorArgOpUpdate(aggregate.first, val.first, reductionOp))
                 aggregate = val;
-                index = counter - 1;
-            }
         }
 
         return aggregate;
@@ -132,11 +226,41 @@ struct TensorArgOpReduction
 template <class ElemType, size_t N>
 struct TensorArgOpReduction<ElemType, N, -1>
 {
-    static inline ElemType Loop(array<ElemType*, N> pointers,
-        const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&, ElementWiseOperator /*reductionOp*/, size_t& counter, size_t& /*index*/)
+    static inline std::pair<ElemType, size_t> Loop(array<ElemType*, N> pointers,
+        const SmallVector<size_t>&, const array<SmallVector<ptrdiff_t>, N>&, ElementWiseOperator /*reductionOp*/, size_t& counter)
     {
-        counter++;
-        return *pointers[0]; // finally we are doing some work!!!
+        return make_pair(*pointers[0], counter++); // finally we are doing some work!!!
+    }
+};
+
+// perform the arg reduction for a single output location with multiple threads, see TensorOpParallelReduction
+template <class ElemType, size_t N, int m>
+struct TensorArgOpParallelReduction
+{
+    static std::pair<ElemType, size_t> Loop(const array<ElemType*, N>& pointers, const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides,
+                                            ElementWiseOperator reductionOp)
+    {
+        auto tiles = TensorOpReductionTiles(reducingOpDims, m);
+        size_t numTiles = tiles.first, tileSize = tiles.second;
+        size_t dim = reducingOpDims[(size_t) m];
+        size_t innerElements = 1;
+        for (size_t i = 0; i < (size_t) m; i++)
+            innerElements *= reducingOpDims[i];
+
+        vector<std::pair<ElemType, size_t>> partials(numTiles);
+#pragma omp parallel for
+        for (int t = 0; t < (int) numTiles; t++)
+        {
+            size_t counter = t * tileSize * innerElements; // running index of the first element of the tile
+            partials[t] = TensorArgOpReduction<ElemType, N, m>::Range(pointers, t * tileSize, min((t + 1) * tileSize, dim), reducingOpDims, reducingStrides, reductionOp, counter);
+        }
+
+        // combine in tile order, so that ties are resolved towards the lowest index as in the serial version
+        auto aggregate = partials[0];
+        for (size_t t = 1; t < numTiles; t++)
+            if (TensorArgOpUpdate(aggregate.first, partials[t].first, reductionOp))
+                aggregate = partials[t];
+        return aggregate;
     }
 };
 
@@ -234,15 +358,18 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, N, vectorizable, m, -1>
     {
         // we are at element level for the result: perform the op (there may still be reduction)
         ElemType val = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
+        Store(beta, val, alpha, pointers.back());
+    }
+
+    static inline void Store(ElemType beta, ElemType val, ElemType alpha, ElemType* pout)
+    {
         // scale
         val *= alpha;
         // combine with previous value in target matrix, then write it out
-        auto* pout = pointers.back();
         if (beta != 0)
             val += beta * *pout;
         // save
         *pout = val;
-        return;
     }
 };
 
@@ -287,6 +414,80 @@ struct TensorArgOpIteration<ElemType, N, -1>
     }
 };
 
+// -----------------------------------------------------------------------
+// parallel loops over the output locations of reductions
+// -----------------------------------------------------------------------
+
+// pointers for the output location with linear index 'index' (first regular dimension varying fastest)
+template <class ElemType, size_t N>
+static inline array<ElemType*, N> TensorOpPointersAt(array<ElemType*, N> pointers, size_t index,
+                                                     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides)
+{
+    for (size_t k = 0; k < regularOpDims.size(); k++)
+    {
+        ptrdiff_t i = (ptrdiff_t) (index % regularOpDims[k]);
+        index /= regularOpDims[k];
+        for (size_t n = 0; n < N; n++)
+            pointers[n] += i * regularStrides[n][k];
+    }
+    return pointers;
+}
+
+enum class TensorReductionParallelism
+{
+    none,           // small problem, run the regular loops on one thread
+    overOutput,     // enough output locations to give each thread its own
+    withinReduction // few output locations, each one is reduced by all threads
+};
+
+static inline TensorReductionParallelism GetTensorReductionParallelism(const SmallVector<size_t>& regularOpDims, const SmallVector<size_t>& reducingOpDims)
+{
+    size_t numOutputs = 1, numReduced = 1;
+    for (size_t k = 0; k < regularOpDims.size(); k++)
+        numOutputs *= regularOpDims[k];
+    for (size_t m = 0; m < reducingOpDims.size(); m++)
+        numReduced *= reducingOpDims[m];
+
+    if (numReduced <= 1 || numOutputs * numReduced < TensorOpParallelReductionMinElements || numOutputs > INT_MAX)
+        return TensorReductionParallelism::none;
+    // Note: the tiled reduction changes the order of summation, so it is also used with a single thread.
+    if (numOutputs < TensorOpParallelReductionMinOutputs && TensorOpReductionTiles(reducingOpDims, (int) reducingOpDims.size() - 1).first >= 2)
+        return TensorReductionParallelism::withinReduction;
+    // same results as the regular loops, just computed on multiple threads
+    return omp_get_max_threads() > 1 ? TensorReductionParallelism::overOutput : TensorReductionParallelism::none;
+}
+
+// tensor operation with reduction over indices 0..m and k+1 regular dimensions (-1 means scalar)
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int m, int k>
+static void TensorOpWithReduction(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ReductionOp reductionOp,
+                                  const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                  const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    typedef TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, m, -1 /*scalar*/> ElementIteration;
+    int numOutputs = 1;
+    for (size_t i = 0; i < regularOpDims.size(); i++)
+        numOutputs *= (int) regularOpDims[i];
+
+    switch (GetTensorReductionParallelism(regularOpDims, reducingOpDims))
+    {
+    case TensorReductionParallelism::overOutput:
+#pragma omp parallel for
+        for (int j = 0; j < numOutputs; j++)
+            ElementIteration::Loop(beta, TensorOpPointersAt(pointers, j, regularOpDims, regularStrides), alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return;
+    case TensorReductionParallelism::withinReduction:
+        for (int j = 0; j < numOutputs; j++)
+        {
+            auto elementPointers = TensorOpPointersAt(pointers, j, regularOpDims, regularStrides);
+            ElemType val = TensorOpParallelReduction<ElemType, OPFN, ReductionOp, N, m>::Loop(elementPointers, opfn, reductionOp, reducingOpDims, reducingStrides);
+            ElementIteration::Store(beta, val, alpha, elementPointers.back());
+        }
+        return;
+    default:
+        return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, m, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    }
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -301,9 +502,9 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
     switch (dims)
     {
     case 2:
-        return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithReduction<ElemType, OPFN, ReductionOp, N, 1, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithReduction<ElemType, OPFN, ReductionOp, N, 0, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
     {
         // if all leading dimensions are 1, we can let the compiler do some unrolling
@@ -536,6 +737,46 @@ void CPUMatrixTensorArgOpImpl(const CPUMatrix<ElemType>& a, CPUMatrix<ElemType>&
         for (size_t i = 0; i < N; i++)
             pointers[i] += offsets[i];
 
+        if (regularOpDims.size() > 2)
+            LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int)regularOpDims.size());
+        if (reducingOpDims.size() > 3)
+            LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int)reducingOpDims.size());
+
+        int numOutputs = 1;
+        for (size_t i = 0; i < regularOpDims.size(); i++)
+            numOutputs *= (int) regularOpDims[i];
+
+        auto parallelism = GetTensorReductionParallelism(regularOpDims, reducingOpDims);
+        if (parallelism == TensorReductionParallelism::overOutput)
+        {
+#pragma omp parallel for
+            for (int j = 0; j < numOutputs; j++)
+                TensorArgOpIteration<ElemType, N, -1>::Loop(TensorOpPointersAt(pointers, j, regularOpDims, regularStrides), regularOpDims, regularStrides, reducingOpDims, reducingStrides, reductionOp);
+            return;
+        }
+        else if (parallelism == TensorReductionParallelism::withinReduction)
+        {
+            for (int j = 0; j < numOutputs; j++)
+            {
+                auto elementPointers = TensorOpPointersAt(pointers, j, regularOpDims, regularStrides);
+                std::pair<ElemType, size_t> val;
+                switch (reducingOpDims.size())
+                {
+                case 3:
+                    val = TensorArgOpParallelReduction<ElemType, N, 2>::Loop(elementPointers, reducingOpDims, reducingStrides, reductionOp);
+                    break;
+                case 2:
+                    val = TensorArgOpParallelReduction<ElemType, N, 1>::Loop(elementPointers, reducingOpDims, reducingStrides, reductionOp);
+                    break;
+                default:
+                    val = TensorArgOpParallelReduction<ElemType, N, 0>::Loop(elementPointers, reducingOpDims, reducingStrides, reductionOp);
+                    break;
+                }
+                *elementPointers.back() = (ElemType)val.second;
+            }
+            return;
+        }
+
         switch (regularOpDims.size())
         {
             case 2:
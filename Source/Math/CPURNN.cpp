@@ -0,0 +1,558 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPURNN.cpp -- CPU implementation of OptimizedRNNStack, see CPURNN.h
+//
+#include "stdafx.h"
+#include "CPURNN.h"
+#include "half.hpp"
+#include <omp.h>
+#include <math.h>
+#include <algorithm>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// the elementwise part of the cells is computed in float for half, and in ElemType otherwise
+template <class ElemType> struct RNNComputeType         { typedef ElemType type; };
+template <>               struct RNNComputeType<half>   { typedef float    type; };
+
+template <class T>
+static inline T RNNSigmoid(T x)
+{
+    // numerically stable form, as in StableSigmoid() in TensorOps.h
+    if (x >= 0)
+        return 1 / (1 + exp(-x));
+    T e = exp(x);
+    return e / (1 + e);
+}
+
+template <class ElemType>
+CPURNNExecutor<ElemType>::CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes)
+    : m_xDim(xDim), m_yDim(yDim),
+      m_rnnAttributes(rnnAttributes),
+      m_numDirections(rnnAttributes.m_bidirectional ? 2 : 1),
+      m_numLayers(rnnAttributes.m_numLayers),
+      m_hiddenSize(rnnAttributes.m_hiddenSize),
+      m_numSamples(0),
+      m_BackwardDataCalledYet(false)
+{
+    if      (rnnAttributes.m_recurrentOp == wstring(L"lstm"))    m_cellType = CellType::LSTM,    m_numGates = 4;
+    else if (rnnAttributes.m_recurrentOp == wstring(L"gru"))     m_cellType = CellType::GRU,     m_numGates = 3;
+    else if (rnnAttributes.m_recurrentOp == wstring(L"rnnTanh")) m_cellType = CellType::RNNTanh, m_numGates = 1;
+    else if (rnnAttributes.m_recurrentOp == wstring(L"rnnReLU")) m_cellType = CellType::RNNReLU, m_numGates = 1;
+    else InvalidArgument("Unknown cell type '%ls'. Supported values are 'lstm', 'gru', 'rnnReLU', 'rnnTanh'.", rnnAttributes.m_recurrentOp.c_str());
+
+    if (m_numLayers == 0 || m_hiddenSize == 0)
+        InvalidArgument("CPURNNExecutor: numLayers and hiddenSize must be positive.");
+}
+
+// -----------------------------------------------------------------------
+// layout of parameters, reserve and workspace
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::NumParameters() const
+{
+    // same as RnnAttributes::GetNumParameters()
+    return WeightOffset(m_numLayers, 0) + m_numLayers * m_numDirections * 2 * m_numGates * m_hiddenSize;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::WeightOffset(size_t layer, size_t dir) const
+{
+    size_t offset = 0;
+    for (size_t l = 0; l < layer; l++)
+        offset += m_numDirections * m_numGates * m_hiddenSize * (LayerInputDim(l) + m_hiddenSize);
+    if (layer < m_numLayers)
+        offset += dir * m_numGates * m_hiddenSize * (LayerInputDim(layer) + m_hiddenSize);
+    return offset;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::BiasOffset(size_t layer, size_t dir) const
+{
+    return WeightOffset(m_numLayers, 0) + (layer * m_numDirections + dir) * 2 * m_numGates * m_hiddenSize;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::LayerOutputOffset(size_t layer) const
+{
+    assert(layer + 1 < m_numLayers); // the output of the last layer goes directly to outputY
+    return GatesOffset(m_numLayers, 0) + layer * m_yDim * m_numSamples;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::ReserveSize() const
+{
+    return GatesOffset(m_numLayers, 0) + (m_numLayers - 1) * m_yDim * m_numSamples;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::GradOffset(size_t layer, size_t dir) const
+{
+    size_t perDirection = m_numGates * m_hiddenSize * m_numSamples * (m_cellType == CellType::GRU ? 2 : 1);
+    return (layer * m_numDirections + dir) * perDirection;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::RecurrentGradOffset(size_t layer, size_t dir) const
+{
+    // for all but GRU the gradients of the recurrent-side pre-activations are identical to the input side
+    if (m_cellType != CellType::GRU)
+        return GradOffset(layer, dir);
+    return GradOffset(layer, dir) + m_numGates * m_hiddenSize * m_numSamples;
+}
+
+template <class ElemType>
+size_t CPURNNExecutor<ElemType>::WorkspaceSizeForBackward() const
+{
+    // scratch: gradient w.r.t. the output of two adjacent layers, plus the recurrent hidden and cell gradients
+    return ScratchOffset() + 2 * m_yDim * m_numSamples + 2 * m_hiddenSize * m_numSamples;
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::SetFrameLayout(const vector<size_t>& numSequencesForFrame)
+{
+    m_numSequencesForFrame = numSequencesForFrame;
+    m_frameOffsets.resize(numSequencesForFrame.size() + 1);
+    m_frameOffsets[0] = 0;
+    for (size_t t = 0; t < numSequencesForFrame.size(); t++)
+    {
+        if (t > 0 && numSequencesForFrame[t] > numSequencesForFrame[t - 1])
+            InvalidArgument("CPURNNExecutor: sequences must be sorted by decreasing length.");
+        m_frameOffsets[t + 1] = m_frameOffsets[t] + numSequencesForFrame[t];
+    }
+    m_numSamples = m_frameOffsets.back();
+}
+
+// Returns the time steps of one direction in processing order. In forward direction the recurrent input
+// of frame t comes from frame t-1, which has at least as many sequences. In backward direction it comes
+// from frame t+1, which holds only the first numSequencesForFrame[t+1] sequences; the others start there.
+template <class ElemType>
+vector<typename CPURNNExecutor<ElemType>::Step> CPURNNExecutor<ElemType>::GetSteps(size_t dir) const
+{
+    size_t numFrames = m_numSequencesForFrame.size();
+    vector<Step> steps(numFrames);
+    for (size_t s = 0; s < numFrames; s++)
+    {
+        Step& step = steps[s];
+        if (dir == 0)
+        {
+            step.t = s;
+            step.prev = s - 1;
+            step.numPrev = s > 0 ? m_numSequencesForFrame[s] : 0;
+        }
+        else
+        {
+            step.t = numFrames - 1 - s;
+            step.prev = step.t + 1;
+            step.numPrev = s > 0 ? m_numSequencesForFrame[step.t + 1] : 0;
+        }
+    }
+    return steps;
+}
+
+// -----------------------------------------------------------------------
+// fused elementwise kernels
+// -----------------------------------------------------------------------
+
+// Computes one time step of one pseudo-layer, given the input-side pre-activations (already in 'gates')
+// and the recurrent-side pre-activations 'rec' [numGates * hidden x numPrev].
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardStep(const Step& step, const ElemType* bW, const ElemType* bR, const ElemType* rec,
+                                           ElemType* gates, ElemType* extra, ElemType* hidden, ElemType* output, size_t outputOffset) const
+{
+    typedef typename RNNComputeType<ElemType>::type comp_t;
+
+    const size_t H = m_hiddenSize;
+    const size_t GH = m_numGates * H;
+    const size_t col0 = m_frameOffsets[step.t];
+    const size_t prevCol0 = step.numPrev > 0 ? m_frameOffsets[step.prev] : 0;
+    const long numCols = (long) m_numSequencesForFrame[step.t];
+
+#pragma omp parallel for
+    for (long j = 0; j < numCols; j++)
+    {
+        const bool hasPrev = (size_t) j < step.numPrev;
+        ElemType* z = gates + (col0 + j) * GH;
+        const ElemType* r = hasPrev ? rec + j * GH : nullptr;
+        ElemType* h = hidden + (col0 + j) * H;
+        ElemType* y = output + (col0 + j) * m_yDim + outputOffset;
+
+        switch (m_cellType)
+        {
+        case CellType::LSTM:
+        {
+            ElemType* c = extra + (col0 + j) * H;
+            const ElemType* cPrev = hasPrev ? extra + (prevCol0 + j) * H : nullptr;
+            for (size_t k = 0; k < H; k++)
+            {
+                comp_t ai = (comp_t) z[k]         + (comp_t) bW[k]         + (comp_t) bR[k];
+                comp_t af = (comp_t) z[H + k]     + (comp_t) bW[H + k]     + (comp_t) bR[H + k];
+                comp_t ag = (comp_t) z[2 * H + k] + (comp_t) bW[2 * H + k] + (comp_t) bR[2 * H + k];
+                comp_t ao = (comp_t) z[3 * H + k] + (comp_t) bW[3 * H + k] + (comp_t) bR[3 * H + k];
+                if (hasPrev)
+                {
+                    ai += (comp_t) r[k];
+                    af += (comp_t) r[H + k];
+                    ag += (comp_t) r[2 * H + k];
+                    ao += (comp_t) r[3 * H + k];
+                }
+                comp_t i = RNNSigmoid(ai);
+                comp_t f = RNNSigmoid(af);
+                comp_t g = tanh(ag);
+                comp_t o = RNNSigmoid(ao);
+                comp_t cv = i * g + (hasPrev ? f * (comp_t) cPrev[k] : 0);
+                comp_t hv = o * tanh(cv);
+                z[k] = (ElemType) i;
+                z[H + k] = (ElemType) f;
+                z[2 * H + k] = (ElemType) g;
+                z[3 * H + k] = (ElemType) o;
+                c[k] = (ElemType) cv;
+                h[k] = y[k] = (ElemType) hv;
+            }
+            break;
+        }
+        case CellType::GRU:
+        {
+            // cuDNN variant: the reset gate is applied after the recurrent matrix product, h' = tanh(Wx + bW + r .* (Rh + bR))
+            ElemType* hn = extra + (col0 + j) * H;
+            const ElemType* hPrev = hasPrev ? hidden + (prevCol0 + j) * H : nullptr;
+            for (size_t k = 0; k < H; k++)
+            {
+                comp_t ar = (comp_t) z[k]     + (comp_t) bW[k]     + (comp_t) bR[k];
+                comp_t az = (comp_t) z[H + k] + (comp_t) bW[H + k] + (comp_t) bR[H + k];
+                comp_t rn = (comp_t) bR[2 * H + k];
+                if (hasPrev)
+                {
+                    ar += (comp_t) r[k];
+                    az += (comp_t) r[H + k];
+                    rn += (comp_t) r[2 * H + k];
+                }
+                comp_t rv = RNNSigmoid(ar);
+                comp_t zv = RNNSigmoid(az);
+                comp_t nv = tanh((comp_t) z[2 * H + k] + (comp_t) bW[2 * H + k] + rv * rn);
+                comp_t hv = (1 - zv) * nv + (hasPrev ? zv * (comp_t) hPrev[k] : 0);
+                z[k] = (ElemType) rv;
+                z[H + k] = (ElemType) zv;
+                z[2 * H + k] = (ElemType) nv;
+                hn[k] = (ElemType) rn;
+                h[k] = y[k] = (ElemType) hv;
+            }
+            break;
+        }
+        case CellType::RNNTanh:
+        case CellType::RNNReLU:
+        {
+            for (size_t k = 0; k < H; k++)
+            {
+                comp_t a = (comp_t) z[k] + (comp_t) bW[k] + (comp_t) bR[k] + (hasPrev ? (comp_t) r[k] : 0);
+                comp_t hv = m_cellType == CellType::RNNTanh ? tanh(a) : std::max(a, (comp_t) 0);
+                z[k] = h[k] = y[k] = (ElemType) hv;
+            }
+            break;
+        }
+        }
+    }
+}
+
+// Back-propagates one time step of one pseudo-layer. The gradient w.r.t. the hidden state of frame t is the
+// sum of the output gradient and the recurrent gradient dHidden that the later step has left for this frame.
+// Produces the pre-activation gradients of the frame, and the direct (non-matrix) parts of the recurrent
+// gradients of the previous frame; the caller adds R * dRecurrentGates to dHidden of the previous frame.
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardStep(const Step& step, const ElemType* gates, const ElemType* extra, const ElemType* hidden, const ElemType* dOutput, size_t dOutputOffset,
+                                            ElemType* dHidden, ElemType* dCell, ElemType* dGates, ElemType* dRecurrentGates) const
+{
+    typedef typename RNNComputeType<ElemType>::type comp_t;
+
+    const size_t H = m_hiddenSize;
+    const size_t GH = m_numGates * H;
+    const size_t col0 = m_frameOffsets[step.t];
+    const size_t prevCol0 = step.numPrev > 0 ? m_frameOffsets[step.prev] : 0;
+    const long numCols = (long) m_numSequencesForFrame[step.t];
+
+#pragma omp parallel for
+    for (long j = 0; j < numCols; j++)
+    {
+        const bool hasPrev = (size_t) j < step.numPrev;
+        const size_t col = col0 + j;
+        const ElemType* z = gates + col * GH;
+        const ElemType* dy = dOutput + col * m_yDim + dOutputOffset;
+        const ElemType* dhRec = dHidden + col * H;
+        ElemType* dz = dGates + col * GH;
+
+        switch (m_cellType)
+        {
+        case CellType::LSTM:
+        {
+            const ElemType* c = extra + col * H;
+            const ElemType* cPrev = hasPrev ? extra + (prevCol0 + j) * H : nullptr;
+            const ElemType* dcRec = dCell + col * H;
+            ElemType* dcPrev = hasPrev ? dCell + (prevCol0 + j) * H : nullptr;
+            for (size_t k = 0; k < H; k++)
+            {
+                comp_t i = (comp_t) z[k], f = (comp_t) z[H + k], g = (comp_t) z[2 * H + k], o = (comp_t) z[3 * H + k];
+                comp_t tc = tanh((comp_t) c[k]);
+                comp_t dh = (comp_t) dy[k] + (comp_t) dhRec[k];
+                comp_t dc = dh * o * (1 - tc * tc) + (comp_t) dcRec[k];
+                dz[k]         = (ElemType) (dc * g * i * (1 - i));
+                dz[H + k]     = (ElemType) (hasPrev ? dc * (comp_t) cPrev[k] * f * (1 - f) : 0);
+                dz[2 * H + k] = (ElemType) (dc * i * (1 - g * g));
+                dz[3 * H + k] = (ElemType) (dh * tc * o * (1 - o));
+                if (hasPrev)
+                    dcPrev[k] = (ElemType) (dc * f);
+            }
+            break;
+        }
+        case CellType::GRU:
+        {
+            const ElemType* hn = extra + col * H;
+            const ElemType* hPrev = hasPrev ? hidden + (prevCol0 + j) * H : nullptr;
+            ElemType* dhPrev = hasPrev ? dHidden + (prevCol0 + j) * H : nullptr;
+            ElemType* dzRec = dRecurrentGates + col * GH;
+            for (size_t k = 0; k < H; k++)
+            {
+                comp_t r = (comp_t) z[k], u = (comp_t) z[H + k], n = (comp_t) z[2 * H + k];
+                comp_t dh = (comp_t) dy[k] + (comp_t) dhRec[k];
+                comp_t hp = hasPrev ? (comp_t) hPrev[k] : 0;
+                comp_t dan = dh * (1 - u) * (1 - n * n);
+                comp_t dar = dan * (comp_t) hn[k] * r * (1 - r);
+                comp_t dau = dh * (hp - n) * u * (1 - u);
+                dz[k] = dzRec[k] = (ElemType) dar;
+                dz[H + k] = dzRec[H + k] = (ElemType) dau;
+                dz[2 * H + k] = (ElemType) dan;
+                dzRec[2 * H + k] = (ElemType) (dan * r);
+                if (hasPrev)
+                    dhPrev[k] = (ElemType) (dh * u);
+            }
+            break;
+        }
+        case CellType::RNNTanh:
+        case CellType::RNNReLU:
+        {
+            for (size_t k = 0; k < H; k++)
+            {
+                comp_t hv = (comp_t) z[k];
+                comp_t dh = (comp_t) dy[k] + (comp_t) dhRec[k];
+                comp_t da = m_cellType == CellType::RNNTanh ? dh * (1 - hv * hv) : (hv > 0 ? dh : 0);
+                dz[k] = (ElemType) da;
+            }
+            break;
+        }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// forward and backward
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY,
+                                           const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes,
+                                           CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    // test that the RNN shape is correct
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+
+    if (m_yDim != m_numDirections * m_hiddenSize)
+        InvalidArgument("CPURNNExecutor ForwardCore: Output leading dimension must be twice hidden size for bidirectional networks");
+
+    if (NumParameters() != weightsW.GetNumElements())
+        InvalidArgument("RNN needs %ld parameters, but %ld were allocated", (long) NumParameters(), (long) weightsW.GetNumElements());
+
+    SetFrameLayout(numSequencesForFrame);
+    if (inputX.GetNumRows() != m_xDim || inputX.GetNumCols() != m_numSamples)
+        InvalidArgument("CPURNNExecutor ForwardCore: Input must be [%d x %d], but is [%d x %d].", (int) m_xDim, (int) m_numSamples, (int) inputX.GetNumRows(), (int) inputX.GetNumCols());
+
+    const size_t H = m_hiddenSize;
+    const size_t GH = m_numGates * H;
+    const size_t maxSequences = m_numSequencesForFrame.empty() ? 0 : m_numSequencesForFrame[0];
+
+    outputY.RequireSize(m_yDim, m_numSamples);
+    reserve.Resize(ReserveSize(), 1);
+    workspace.Resize(std::max<size_t>(GH * maxSequences, 1), 1); // recurrent pre-activations of one step
+    m_BackwardDataCalledYet = false;
+    if (m_numSamples == 0)
+        return;
+
+    for (size_t layer = 0; layer < m_numLayers; layer++)
+    {
+        const size_t inputDim = LayerInputDim(layer);
+        CPUMatrix<ElemType> layerInput = layer == 0 ? View(inputX, 0, m_xDim, m_numSamples) : View(reserve, LayerOutputOffset(layer - 1), inputDim, m_numSamples);
+        ElemType* layerOutput = layer + 1 == m_numLayers ? outputY.Data() : reserve.Data() + LayerOutputOffset(layer);
+
+        for (size_t dir = 0; dir < m_numDirections; dir++)
+        {
+            CPUMatrix<ElemType> W = View(weightsW, WeightOffset(layer, dir), inputDim, GH);
+            CPUMatrix<ElemType> R = View(weightsW, WeightOffset(layer, dir) + inputDim * GH, H, GH);
+            const ElemType* bW = weightsW.Data() + BiasOffset(layer, dir);
+            const ElemType* bR = bW + GH;
+
+            // input projections for all frames in a single GEMM
+            CPUMatrix<ElemType> gates = View(reserve, GatesOffset(layer, dir), GH, m_numSamples);
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, W, true, layerInput, false, 0, gates);
+
+            ElemType* extra = reserve.Data() + ExtraStateOffset(layer, dir);
+            ElemType* hidden = reserve.Data() + HiddenOffset(layer, dir);
+            for (const auto& step : GetSteps(dir))
+            {
+                if (step.numPrev > 0)
+                {
+                    CPUMatrix<ElemType> hPrev = View(reserve, HiddenOffset(layer, dir) + m_frameOffsets[step.prev] * H, H, step.numPrev);
+                    CPUMatrix<ElemType> rec = View(workspace, 0, GH, step.numPrev);
+                    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, R, true, hPrev, false, 0, rec);
+                }
+                ForwardStep(step, bW, bR, workspace.Data(), gates.Data(), extra, hidden, layerOutput, dir * H);
+            }
+        }
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardDataCore(const CPUMatrix<ElemType>& outputY, const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& weightsW, CPUMatrix<ElemType>& dx,
+                                                const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    UNUSED(outputY); // the hidden states are kept in reserve
+    // test that the RNN shape is correct
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+    if (m_BackwardDataCalledYet)
+        return;
+
+    if (outputDY.GetNumRows() != m_yDim || outputDY.GetNumCols() != m_numSamples)
+        LogicError("CPURNNExecutor BackwardDataCore: Output gradient does not match the last forward pass.");
+    if (reserve.GetNumElements() < ReserveSize())
+        LogicError("CPURNNExecutor BackwardDataCore: Reserve has been modified since the forward pass.");
+
+    const size_t H = m_hiddenSize;
+    const size_t GH = m_numGates * H;
+
+    dx.RequireSize(m_xDim, m_numSamples);
+    workspace.Resize(WorkspaceSizeForBackward(), 1);
+    m_BackwardDataCalledYet = true;
+    if (m_numSamples == 0)
+        return;
+
+    const size_t dLayerOutputOffset[2] = { ScratchOffset(), ScratchOffset() + m_yDim * m_numSamples };
+    const size_t dHiddenOffset = ScratchOffset() + 2 * m_yDim * m_numSamples;
+    const size_t dCellOffset = dHiddenOffset + H * m_numSamples;
+
+    for (size_t layer = m_numLayers; layer-- > 0;)
+    {
+        const size_t inputDim = LayerInputDim(layer);
+        const ElemType* dLayerOutput = layer + 1 == m_numLayers ? outputDY.Data() : workspace.Data() + dLayerOutputOffset[layer % 2];
+        CPUMatrix<ElemType> dLayerInput = layer == 0 ? View(dx, 0, m_xDim, m_numSamples) : View(workspace, dLayerOutputOffset[(layer - 1) % 2], inputDim, m_numSamples);
+
+        for (size_t dir = 0; dir < m_numDirections; dir++)
+        {
+            CPUMatrix<ElemType> W = View(weightsW, WeightOffset(layer, dir), inputDim, GH);
+            CPUMatrix<ElemType> R = View(weightsW, WeightOffset(layer, dir) + inputDim * GH, H, GH);
+            CPUMatrix<ElemType> dGates = View(workspace, GradOffset(layer, dir), GH, m_numSamples);
+
+            const ElemType* gates = reserve.Data() + GatesOffset(layer, dir);
+            const ElemType* extra = reserve.Data() + ExtraStateOffset(layer, dir);
+            const ElemType* hidden = reserve.Data() + HiddenOffset(layer, dir);
+            ElemType* dHidden = workspace.Data() + dHiddenOffset;
+            ElemType* dCell = workspace.Data() + dCellOffset;
+            ElemType* dRecurrentGates = workspace.Data() + RecurrentGradOffset(layer, dir);
+            std::fill(dHidden, dHidden + 2 * H * m_numSamples, (ElemType) 0); // dHidden and dCell
+
+            auto steps = GetSteps(dir);
+            for (auto step = steps.rbegin(); step != steps.rend(); ++step)
+            {
+                BackwardStep(*step, gates, extra, hidden, dLayerOutput, dir * H, dHidden, dCell, dGates.Data(), dRecurrentGates);
+                if (step->numPrev > 0)
+                {
+                    CPUMatrix<ElemType> dRec = View(workspace, RecurrentGradOffset(layer, dir) + m_frameOffsets[step->t] * GH, GH, step->numPrev);
+                    CPUMatrix<ElemType> dhPrev = View(workspace, dHiddenOffset + m_frameOffsets[step->prev] * H, H, step->numPrev);
+                    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, R, false, dRec, false, 1, dhPrev);
+                }
+            }
+
+            // gradient w.r.t. the layer input, summed over both directions
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, W, false, dGates, false, dir == 0 ? 0 : 1, dLayerInput);
+        }
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::BackwardWeightsCore(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw,
+                                                   const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    typedef typename RNNComputeType<ElemType>::type comp_t;
+    UNUSED(outputY);
+
+    // test that the RNN shape is correct
+    if (!(m_rnnAttributes == rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+    if (!m_BackwardDataCalledYet)
+        LogicError("CPURNNExecutor: BackwardWeightsCore called before BackwardDataCore");
+    if (dw.GetNumElements() != NumParameters())
+        InvalidArgument("RNN needs %ld parameters, but %ld were allocated", (long) NumParameters(), (long) dw.GetNumElements());
+    if (m_numSamples == 0)
+        return;
+
+    const size_t H = m_hiddenSize;
+    const size_t GH = m_numGates * H;
+    const size_t hPrevOffset = ScratchOffset(); // reuses the scratch area of BackwardDataCore
+
+    // like cuDNN, gradients are accumulated into dw
+    for (size_t layer = 0; layer < m_numLayers; layer++)
+    {
+        const size_t inputDim = LayerInputDim(layer);
+        CPUMatrix<ElemType> layerInput = layer == 0 ? View(inputX, 0, m_xDim, m_numSamples) : View(reserve, LayerOutputOffset(layer - 1), inputDim, m_numSamples);
+
+        for (size_t dir = 0; dir < m_numDirections; dir++)
+        {
+            CPUMatrix<ElemType> dW = View(dw, WeightOffset(layer, dir), inputDim, GH);
+            CPUMatrix<ElemType> dR = View(dw, WeightOffset(layer, dir) + inputDim * GH, H, GH);
+            CPUMatrix<ElemType> dGates = View(workspace, GradOffset(layer, dir), GH, m_numSamples);
+            CPUMatrix<ElemType> dRecurrentGates = View(workspace, RecurrentGradOffset(layer, dir), GH, m_numSamples);
+            CPUMatrix<ElemType> hPrev = View(workspace, hPrevOffset, H, m_numSamples);
+
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, layerInput, false, dGates, true, 1, dW);
+
+            // gather the recurrent input of every sample, so that dR is a single GEMM as well
+            const ElemType* hidden = reserve.Data() + HiddenOffset(layer, dir);
+            for (const auto& step : GetSteps(dir))
+            {
+                ElemType* dst = hPrev.Data() + m_frameOffsets[step.t] * H;
+                if (step.numPrev > 0)
+                {
+                    const ElemType* src = hidden + m_frameOffsets[step.prev] * H;
+                    std::copy(src, src + H * step.numPrev, dst);
+                }
+                std::fill(dst + H * step.numPrev, dst + H * m_numSequencesForFrame[step.t], (ElemType) 0);
+            }
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, hPrev, false, dRecurrentGates, true, 1, dR);
+
+            // bias gradients are the row sums of the pre-activation gradients
+            ElemType* dbW = dw.Data() + BiasOffset(layer, dir);
+            ElemType* dbR = dbW + GH;
+            const ElemType* dz = dGates.Data();
+            const ElemType* dzRec = dRecurrentGates.Data();
+#pragma omp parallel for
+            for (long k = 0; k < (long) GH; k++)
+            {
+                comp_t sumW = 0, sumR = 0;
+                for (size_t col = 0; col < m_numSamples; col++)
+                {
+                    sumW += (comp_t) dz[col * GH + k];
+                    sumR += (comp_t) dzRec[col * GH + k];
+                }
+                dbW[k] = (ElemType) ((comp_t) dbW[k] + sumW);
+                dbR[k] = (ElemType) ((comp_t) dbR[k] + sumR);
+            }
+        }
+    }
+}
+
+template class CPURNNExecutor<float>;
+template class CPURNNExecutor<double>;
+template class CPURNNExecutor<half>;
+
+}}}
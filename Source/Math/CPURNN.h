@@ -0,0 +1,108 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "Basics.h"
+#include "CPUMatrix.h"
+#include "RNNCommon.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// CPURNNExecutor is the CPU counterpart of CuDnnRNNExecutor. It holds the configuration and the
+// per-minibatch frame layout of an OptimizedRNNStack, and is attached to the CPUMatrix that receives
+// the output, in the same way CuDnnRNNExecutor is attached to a GPUMatrix.
+//
+// The parameters use the cuDNN CUDNN_LINEAR_INPUT layout, so that models can be moved freely between
+// the two implementations. For every layer and direction ("pseudo-layer") there is an input matrix W
+// [numGates * hidden x inputDim] followed by a recurrent matrix R [numGates * hidden x hidden], both
+// row-major. The biases of all pseudo-layers follow the weights of all pseudo-layers, again two per
+// pseudo-layer (bW, then bR). Gate order is i, f, c, o for LSTM and r, z, h for GRU.
+//
+// Input and output are expected in the dense "cuDNN packing" produced by OptimizedRNNStackNode:
+// frames are stored time-major, frame t has numSequencesForFrame[t] columns and sequences are sorted
+// by decreasing length, so the sequences active at frame t are always the first columns of that frame.
+//
+// Per pseudo-layer, the input projections of all frames are computed with one GEMM. Each time step
+// then does a single recurrent GEMM and one fused pass that adds the biases, applies the gate
+// nonlinearities and updates the cell and hidden state.
+template <class ElemType>
+class CPURNNExecutor
+{
+public:
+    CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes);
+
+    void ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+    void BackwardDataCore(const CPUMatrix<ElemType>& outputY, const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& weightsW, CPUMatrix<ElemType>& dx, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+    void BackwardWeightsCore(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace);
+
+private:
+    enum class CellType
+    {
+        LSTM,
+        GRU,
+        RNNTanh,
+        RNNReLU
+    };
+
+    // a step of the recurrence in processing order: the frame that is computed, and the frame its
+    // recurrent input comes from (only the first numPrev sequences of frame t have one)
+    struct Step
+    {
+        size_t t;
+        size_t prev;
+        size_t numPrev;
+    };
+
+    size_t LayerInputDim(size_t layer) const { return layer == 0 ? m_xDim : m_numDirections * m_hiddenSize; }
+    size_t NumParameters() const;
+    size_t WeightOffset(size_t layer, size_t dir) const;
+    size_t BiasOffset(size_t layer, size_t dir) const;
+
+    // reserve holds, per pseudo-layer, the gate activations, the cell state (LSTM), the recurrent part
+    // of the GRU candidate, and the hidden state, followed by the outputs of all but the last layer
+    size_t NumCacheRows() const { return m_numGates * m_hiddenSize + m_hiddenSize + (HasExtraState() ? m_hiddenSize : 0); }
+    bool HasExtraState() const { return m_cellType == CellType::LSTM || m_cellType == CellType::GRU; }
+    size_t GatesOffset(size_t layer, size_t dir) const { return (layer * m_numDirections + dir) * NumCacheRows() * m_numSamples; }
+    size_t ExtraStateOffset(size_t layer, size_t dir) const { return GatesOffset(layer, dir) + m_numGates * m_hiddenSize * m_numSamples; }
+    size_t HiddenOffset(size_t layer, size_t dir) const { return GatesOffset(layer, dir) + (NumCacheRows() - m_hiddenSize) * m_numSamples; }
+    size_t LayerOutputOffset(size_t layer) const;
+    size_t ReserveSize() const;
+
+    // workspace holds, per pseudo-layer, the gradients of the gate pre-activations on the input side
+    // and (GRU only) on the recurrent side, followed by scratch buffers shared by all pseudo-layers
+    size_t GradOffset(size_t layer, size_t dir) const;
+    size_t RecurrentGradOffset(size_t layer, size_t dir) const;
+    size_t ScratchOffset() const { return GradOffset(m_numLayers, 0); }
+    size_t WorkspaceSizeForBackward() const;
+
+    void SetFrameLayout(const vector<size_t>& numSequencesForFrame);
+    vector<Step> GetSteps(size_t dir) const;
+
+    void ForwardStep(const Step& step, const ElemType* bW, const ElemType* bR, const ElemType* rec, ElemType* gates, ElemType* extra, ElemType* hidden, ElemType* output, size_t outputOffset) const;
+    void BackwardStep(const Step& step, const ElemType* gates, const ElemType* extra, const ElemType* hidden, const ElemType* dOutput, size_t dOutputOffset,
+                      ElemType* dHidden, ElemType* dCell, ElemType* dGates, ElemType* dRecurrentGates) const;
+
+    static CPUMatrix<ElemType> View(const CPUMatrix<ElemType>& buffer, size_t offset, size_t numRows, size_t numCols)
+    {
+        return CPUMatrix<ElemType>(numRows, numCols, buffer.Data() + offset, matrixFlagDontOwnBuffer);
+    }
+
+private:
+    size_t m_xDim, m_yDim;
+    RnnAttributes m_rnnAttributes;
+    CellType m_cellType;
+    size_t m_numGates;
+    size_t m_numDirections;
+    size_t m_numLayers;
+    size_t m_hiddenSize;
+
+    vector<size_t> m_numSequencesForFrame;
+    vector<size_t> m_frameOffsets; // column of the first sequence of each frame
+    size_t m_numSamples;           // total number of columns over all frames
+    bool m_BackwardDataCalledYet;
+};
+
+}}}
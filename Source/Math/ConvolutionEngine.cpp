@@ -7,6 +7,10 @@
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
 #include "MklDnnCommon.h"
+#include "CPUMatrix.h"
+#include "ConvolutionTuningCache.h"
+#include <chrono>
+#include <limits>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -565,8 +569,10 @@ public:
     using typename Base::Mat;
 
 public:
-    GemmConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad)
-        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad)
+    // useMkl: whether to use MKL 2017 DNN for the configurations it supports, if CNTK is built with it.
+    GemmConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad,
+                          bool useMkl = true)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), m_useMkl(useMkl)
     {
     }
 
@@ -614,7 +620,7 @@ protected:
     void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
     {
 #ifdef USE_MKL2017DNN
-        if (ForwardCoreMKL(in, kernel, out)) return;
+        if (m_useMkl && ForwardCoreMKL(in, kernel, out)) return;
 #endif
 
         size_t batchSize = in.GetNumCols();
@@ -689,7 +695,7 @@ protected:
     void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace) override
     {
 #ifdef USE_MKL2017DNN
-        if (BackwardDataMKL(srcGrad, kernel, grad, accumulateGradient, workspace)) return;
+        if (m_useMkl && BackwardDataMKL(srcGrad, kernel, grad, accumulateGradient, workspace)) return;
 #else
         UNUSED(accumulateGradient);
 #endif
@@ -788,7 +794,7 @@ protected:
     void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool /*allowReuse*/, Mat& workspace) override
     {
 #ifdef USE_MKL2017DNN
-        if (BackwardKernelMKL(srcGrad, in, kernelGrad, accumulateGradient, workspace)) return;
+        if (m_useMkl && BackwardKernelMKL(srcGrad, in, kernelGrad, accumulateGradient, workspace)) return;
 #else
         UNUSED(accumulateGradient);
 #endif
@@ -1134,6 +1140,8 @@ protected:
 
 #endif
 
+    bool m_useMkl;
+
 public:
     static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
     {
@@ -1151,6 +1159,774 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Winograd convolution engine implementation.
+// This engine supports 2D 3x3 convolutions with unit stride and full
+// sharing, and implements the forward pass with Winograd minimal filtering
+// F(2x2,3x3) or F(4x4,3x3) (Fast Algorithms for Convolutional Neural Networks; Lavin, Gray)
+// which, unlike unrolling, does not replicate the input 9 times.
+// Uses GEMM engine for backward passes and reference engine for pooling operations.
+//------------------------------------------------------------------
+template <class ElemType>
+class WinogradConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    WinogradConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad,
+                              size_t tileSize)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), m_tileSize(tileSize)
+    {
+        if (m_tileSize != 2 && m_tileSize != 4)
+            InvalidArgument("Winograd convolution engine supports only 2x2 and 4x4 output tiles.");
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_maxTempMemSizeInSamples;
+
+    void EnsureCompatible() override
+    {
+        Base::EnsureCompatible();
+        if (!IsSupported(m_deviceId, m_geometry))
+            LogicError("Winograd convolution engine does not support this convolution configuration. Geometry: %s", ((string)*m_geometry).c_str());
+    }
+
+    // Notation follows the GEMM engine. In addition, m is the size of an output tile (2 or 4),
+    // a = m + 2 is the size of the input tile it is computed from and T is the number of output tiles in the sub-batch.
+    // The forward method consists of 4 parts:
+    // 1. Transforming kernels: [3 x 3] -> G g G^T [a x a], stored as a*a matrices U of [K x C].
+    // 2. Transforming input tiles (zero-padded at the borders): [a x a] -> B^T d B [a x a], stored as a*a matrices V of [C x T].
+    // 3. Performing a*a matrix multiplications: [K x C] * [C x T] -> M [K x T].
+    // 4. Transforming output tiles: [a x a] -> A^T M A [m x m] and storing the ones inside W'H' in the output (out).
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        const auto& inT = m_geometry->InputShape();
+        const auto& outT = m_geometry->OutputShape();
+        size_t mapInCount = inT[2];
+        size_t mapOutCount = outT[2];
+
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+
+        size_t tileSize = m_tileSize;
+        size_t points = (tileSize + 2) * (tileSize + 2);
+        size_t tilesPerSample = ((outT[0] + tileSize - 1) / tileSize) * ((outT[1] + tileSize - 1) / tileSize);
+        size_t tileCount = tilesPerSample * subBatchSize;
+
+        // Reserve space for transformed kernels, transformed inputs and products, each as a*a consecutive matrices.
+        size_t kernSize = mapOutCount * mapInCount;
+        size_t inSize = mapInCount * tileCount;
+        size_t prodSize = mapOutCount * tileCount;
+        workspace.Resize(1, points * (kernSize + inSize + prodSize));
+        size_t inOffset = points * kernSize;
+        size_t prodOffset = points * (kernSize + inSize);
+
+        TransformKernels(kernel.Data(), workspace.Data(), kernSize);
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            size_t curTileCount = tilesPerSample * curBatchSize;
+
+            TransformInput(in.Data() + start * in.GetNumRows(), curTileCount, workspace.Data() + inOffset, inSize);
+
+            for (size_t i = 0; i < points; i++)
+            {
+                auto u = workspace.ColumnSlice(i * kernSize, kernSize);
+                u.Reshape(mapOutCount, mapInCount);
+                auto v = workspace.ColumnSlice(inOffset + i * inSize, mapInCount * curTileCount);
+                v.Reshape(mapInCount, curTileCount);
+                auto prod = workspace.ColumnSlice(prodOffset + i * prodSize, mapOutCount * curTileCount);
+                prod.Reshape(mapOutCount, curTileCount);
+                Mat::Multiply(u, false, v, false, prod);
+            }
+
+            TransformOutput(workspace.Data() + prodOffset, prodSize, curTileCount, out.Data() + start * out.GetNumRows());
+        }
+    }
+
+private:
+    static const size_t MaxInputTileSize = 6;
+
+    // Transformation matrices B^T [a x a], G [a x 3] and A^T [m x a], row-major.
+    const float* InputTransform() const
+    {
+        static const float bt2[] = {
+            1,  0, -1,  0,
+            0,  1,  1,  0,
+            0, -1,  1,  0,
+            0,  1,  0, -1 };
+        static const float bt4[] = {
+            4,  0, -5,  0, 1, 0,
+            0, -4, -4,  1, 1, 0,
+            0,  4, -4, -1, 1, 0,
+            0, -2, -1,  2, 1, 0,
+            0,  2, -1, -2, 1, 0,
+            0,  4,  0, -5, 0, 1 };
+        return m_tileSize == 2 ? bt2 : bt4;
+    }
+
+    const float* KernelTransform() const
+    {
+        static const float g2[] = {
+            1.0f,  0.0f, 0.0f,
+            0.5f,  0.5f, 0.5f,
+            0.5f, -0.5f, 0.5f,
+            0.0f,  0.0f, 1.0f };
+        static const float g4[] = {
+             1.0f / 4,   0.0f,       0.0f,
+            -1.0f / 6,  -1.0f / 6,  -1.0f / 6,
+            -1.0f / 6,   1.0f / 6,  -1.0f / 6,
+             1.0f / 24,  1.0f / 12,  1.0f / 6,
+             1.0f / 24, -1.0f / 12,  1.0f / 6,
+             0.0f,       0.0f,       1.0f };
+        return m_tileSize == 2 ? g2 : g4;
+    }
+
+    const float* OutputTransform() const
+    {
+        static const float at2[] = {
+            1, 1,  1,  0,
+            0, 1, -1, -1 };
+        static const float at4[] = {
+            1, 1,  1, 1,  1, 0,
+            0, 1, -1, 2, -2, 0,
+            0, 1,  1, 4,  4, 0,
+            0, 1, -1, 8, -8, 1 };
+        return m_tileSize == 2 ? at2 : at4;
+    }
+
+    // Computes y = t x t^T, where t is [rows x cols], x is [cols x cols] and y is [rows x rows], all row-major.
+    static void Sandwich(const float* t, size_t rows, size_t cols, const ElemType* x, ElemType* y)
+    {
+        ElemType tx[MaxInputTileSize * MaxInputTileSize];
+        for (size_t i = 0; i < rows; i++)
+        {
+            for (size_t j = 0; j < cols; j++)
+            {
+                ElemType sum = 0;
+                for (size_t k = 0; k < cols; k++)
+                    sum += t[i * cols + k] * x[k * cols + j];
+                tx[i * cols + j] = sum;
+            }
+        }
+        for (size_t i = 0; i < rows; i++)
+        {
+            for (size_t j = 0; j < rows; j++)
+            {
+                ElemType sum = 0;
+                for (size_t k = 0; k < cols; k++)
+                    sum += tx[i * cols + k] * t[j * cols + k];
+                y[i * rows + j] = sum;
+            }
+        }
+    }
+
+    // Transforms the [3 x 3] kernel for every output/input map pair; point i of the pair (k, c) goes to u[i * kernSize + k + c * K].
+    void TransformKernels(const ElemType* kernel, ElemType* u, size_t kernSize) const
+    {
+        size_t mapOutCount = m_geometry->OutputShape()[2];
+        size_t alpha = m_tileSize + 2;
+        const float* g = KernelTransform();
+#pragma omp parallel for
+        for (int64_t pair = 0; pair < (int64_t)kernSize; pair++)
+        {
+            size_t k = pair % mapOutCount;
+            size_t c = pair / mapOutCount;
+            // cudnn layout uses row-major kernel weight matrix, so each kernel is [XYC] contiguous.
+            const ElemType* src = kernel + (k * (kernSize / mapOutCount) + c) * 9;
+            ElemType ut[MaxInputTileSize * MaxInputTileSize];
+            Sandwich(g, alpha, 3, src, ut);
+            for (size_t i = 0; i < alpha * alpha; i++)
+                u[i * kernSize + pair] = ut[i];
+        }
+    }
+
+    // Transforms input tiles of every map; point i of tile t and map c goes to v[i * inSize + c + t * C].
+    void TransformInput(const ElemType* in, size_t tileCount, ElemType* v, size_t inSize) const
+    {
+        const auto& inT = m_geometry->InputShape();
+        const auto& outT = m_geometry->OutputShape();
+        int inW = (int)inT[0], inH = (int)inT[1];
+        size_t mapInCount = inT[2];
+        size_t tilesW = (outT[0] + m_tileSize - 1) / m_tileSize;
+        size_t tilesPerSample = tilesW * ((outT[1] + m_tileSize - 1) / m_tileSize);
+        int padW = m_geometry->GetLowerPad(0);
+        int padH = m_geometry->GetLowerPad(1);
+        int alpha = (int)m_tileSize + 2;
+        const float* bt = InputTransform();
+#pragma omp parallel for
+        for (int64_t t = 0; t < (int64_t)tileCount; t++)
+        {
+            size_t sample = t / tilesPerSample;
+            int x0 = (int)(((t % tilesPerSample) % tilesW) * m_tileSize) - padW;
+            int y0 = (int)(((t % tilesPerSample) / tilesW) * m_tileSize) - padH;
+            ElemType d[MaxInputTileSize * MaxInputTileSize];
+            ElemType vt[MaxInputTileSize * MaxInputTileSize];
+            for (size_t c = 0; c < mapInCount; c++)
+            {
+                const ElemType* src = in + sample * inT.GetNumElements() + c * inW * inH;
+                for (int y = 0; y < alpha; y++)
+                {
+                    for (int x = 0; x < alpha; x++)
+                    {
+                        int ix = x0 + x, iy = y0 + y;
+                        d[y * alpha + x] = (0 <= ix && ix < inW && 0 <= iy && iy < inH) ? src[iy * inW + ix] : 0;
+                    }
+                }
+                Sandwich(bt, alpha, alpha, d, vt);
+                for (int i = 0; i < alpha * alpha; i++)
+                    v[i * inSize + c + t * mapInCount] = vt[i];
+            }
+        }
+    }
+
+    // Transforms products back to output tiles; point i of tile t and map k is read from prod[i * prodSize + k + t * K].
+    void TransformOutput(const ElemType* prod, size_t prodSize, size_t tileCount, ElemType* out) const
+    {
+        const auto& outT = m_geometry->OutputShape();
+        size_t outW = outT[0], outH = outT[1], mapOutCount = outT[2];
+        size_t tilesW = (outW + m_tileSize - 1) / m_tileSize;
+        size_t tilesPerSample = tilesW * ((outH + m_tileSize - 1) / m_tileSize);
+        size_t alpha = m_tileSize + 2;
+        const float* at = OutputTransform();
+#pragma omp parallel for
+        for (int64_t t = 0; t < (int64_t)tileCount; t++)
+        {
+            size_t sample = t / tilesPerSample;
+            size_t x0 = ((t % tilesPerSample) % tilesW) * m_tileSize;
+            size_t y0 = ((t % tilesPerSample) / tilesW) * m_tileSize;
+            size_t w = min(m_tileSize, outW - x0);
+            size_t h = min(m_tileSize, outH - y0);
+            ElemType mt[MaxInputTileSize * MaxInputTileSize];
+            ElemType yt[MaxInputTileSize * MaxInputTileSize];
+            for (size_t k = 0; k < mapOutCount; k++)
+            {
+                for (size_t i = 0; i < alpha * alpha; i++)
+                    mt[i] = prod[i * prodSize + k + t * mapOutCount];
+                Sandwich(at, m_tileSize, alpha, mt, yt);
+                ElemType* dst = out + sample * outT.GetNumElements() + k * outW * outH;
+                for (size_t y = 0; y < h; y++)
+                    for (size_t x = 0; x < w; x++)
+                        dst[(y0 + y) * outW + x0 + x] = yt[y * m_tileSize + x];
+            }
+        }
+    }
+
+    size_t m_tileSize;
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        return Base::IsSupported(deviceId, geometry) && geometry->Groups() == 1 &&
+               inT.GetRank() == 3 && kernT[0] == 3 && kernT[1] == 3 && kernT[2] == inT[2] &&
+               outT[2] == geometry->GetMapCount(2) && geometry->GetMapCount(0) == 1 && geometry->GetMapCount(1) == 1 &&
+               geometry->GetStride(0) == 1 && geometry->GetStride(1) == 1 &&
+               geometry->GetDilation(0) == 1 && geometry->GetDilation(1) == 1 && geometry->GetLowerPad(2) == 0;
+    }
+};
+
+//------------------------------------------------------------------
+// Direct convolution engine implementation.
+// This engine supports 2D convolutions with full sharing of two kinds
+// that the GEMM engine handles poorly, and implements them without unrolling:
+// - pointwise (1x1 with unit stride): CHW input of a sample is a [WH x C]
+//   matrix, so each sample is a single GEMM with the [C x K] weights;
+// - depthwise (groups equal to input channels): each output map depends on
+//   one input map, which is contiguous in CHW layout, and is computed with direct loops.
+// Uses reference engine for pooling operations.
+//------------------------------------------------------------------
+template <class ElemType>
+class DirectConvolutionEngine : public ReferenceConvolutionEngine<ElemType>
+{
+public:
+    using Base = ReferenceConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    DirectConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), m_isPointwise(IsPointwise(geometry))
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Direct convolution engine supports only CHW/cudnn layout.");
+        if (!IsSupported(m_deviceId, m_geometry))
+            LogicError("Direct convolution engine does not support this convolution configuration. Geometry: %s", ((string)*m_geometry).c_str());
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& /*workspace*/) override
+    {
+        if (m_isPointwise)
+        {
+            // [WH x C] * [C x K] -> [WH x K] for each sample.
+            auto kern = PointwiseKernel(kernel);
+            for (size_t i = 0; i < in.GetNumCols(); i++)
+            {
+                auto inSlice = PointwiseSample(in, i, kern.GetNumRows());
+                auto outSlice = PointwiseSample(out, i, kern.GetNumCols());
+                Mat::Multiply(inSlice, false, kern, false, outSlice);
+            }
+            return;
+        }
+
+        Depthwise d(*m_geometry);
+        const ElemType* inData = in.Data();
+        const ElemType* kernData = kernel.Data();
+        ElemType* outData = out.Data();
+        int64_t planes = (int64_t)(in.GetNumCols() * d.mapOutCount);
+#pragma omp parallel for
+        for (int64_t plane = 0; plane < planes; plane++)
+        {
+            size_t sample = plane / d.mapOutCount;
+            size_t k = plane % d.mapOutCount;
+            const ElemType* src = inData + sample * d.inSize + (k / d.multiplier) * d.inW * d.inH;
+            const ElemType* w = kernData + k * d.kW * d.kH;
+            ElemType* dst = outData + sample * d.outSize + k * d.outW * d.outH;
+            for (int oy = 0; oy < d.outH; oy++)
+            {
+                for (int ox = 0; ox < d.outW; ox++)
+                {
+                    ElemType sum = 0;
+                    for (int ky = 0; ky < d.kH; ky++)
+                    {
+                        int iy = oy * d.strideH - d.padH + ky * d.dilationH;
+                        if (iy < 0 || iy >= d.inH)
+                            continue;
+                        for (int kx = 0; kx < d.kW; kx++)
+                        {
+                            int ix = ox * d.strideW - d.padW + kx * d.dilationW;
+                            if (0 <= ix && ix < d.inW)
+                                sum += w[ky * d.kW + kx] * src[iy * d.inW + ix];
+                        }
+                    }
+                    dst[oy * d.outW + ox] = sum;
+                }
+            }
+        }
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& /*workspace*/) override
+    {
+        ElemType beta = accumulateGradient ? 1 : 0;
+        if (m_isPointwise)
+        {
+            // [WH x K] * [C x K]^T -> [WH x C] for each sample.
+            auto kern = PointwiseKernel(kernel);
+            for (size_t i = 0; i < srcGrad.GetNumCols(); i++)
+            {
+                auto srcGradSlice = PointwiseSample(srcGrad, i, kern.GetNumCols());
+                auto gradSlice = PointwiseSample(grad, i, kern.GetNumRows());
+                Mat::MultiplyAndWeightedAdd(1, srcGradSlice, false, kern, true, beta, gradSlice);
+            }
+            return;
+        }
+
+        // Each input map receives gradients only from the output maps of its group, so samples and input maps are independent.
+        Depthwise d(*m_geometry);
+        const ElemType* srcGradData = srcGrad.Data();
+        const ElemType* kernData = kernel.Data();
+        ElemType* gradData = grad.Data();
+        int64_t planes = (int64_t)(srcGrad.GetNumCols() * d.mapInCount);
+#pragma omp parallel for
+        for (int64_t plane = 0; plane < planes; plane++)
+        {
+            size_t sample = plane / d.mapInCount;
+            size_t c = plane % d.mapInCount;
+            ElemType* dst = gradData + sample * d.inSize + c * d.inW * d.inH;
+            if (!accumulateGradient)
+                std::fill(dst, dst + d.inW * d.inH, (ElemType)0);
+            for (size_t k = c * d.multiplier; k < (c + 1) * d.multiplier; k++)
+            {
+                const ElemType* src = srcGradData + sample * d.outSize + k * d.outW * d.outH;
+                const ElemType* w = kernData + k * d.kW * d.kH;
+                for (int oy = 0; oy < d.outH; oy++)
+                {
+                    for (int ox = 0; ox < d.outW; ox++)
+                    {
+                        ElemType g = src[oy * d.outW + ox];
+                        for (int ky = 0; ky < d.kH; ky++)
+                        {
+                            int iy = oy * d.strideH - d.padH + ky * d.dilationH;
+                            if (iy < 0 || iy >= d.inH)
+                                continue;
+                            for (int kx = 0; kx < d.kW; kx++)
+                            {
+                                int ix = ox * d.strideW - d.padW + kx * d.dilationW;
+                                if (0 <= ix && ix < d.inW)
+                                    dst[iy * d.inW + ix] += w[ky * d.kW + kx] * g;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool /*allowReuse*/, Mat& /*workspace*/) override
+    {
+        if (m_isPointwise)
+        {
+            // Sum of [WH x C]^T * [WH x K] -> [C x K] over samples.
+            auto kernGrad = PointwiseKernel(kernelGrad);
+            for (size_t i = 0; i < srcGrad.GetNumCols(); i++)
+            {
+                auto inSlice = PointwiseSample(in, i, kernGrad.GetNumRows());
+                auto srcGradSlice = PointwiseSample(srcGrad, i, kernGrad.GetNumCols());
+                Mat::MultiplyAndWeightedAdd(1, inSlice, true, srcGradSlice, false, (i > 0 || accumulateGradient) ? 1 : 0, kernGrad);
+            }
+            return;
+        }
+
+        Depthwise d(*m_geometry);
+        const ElemType* srcGradData = srcGrad.Data();
+        const ElemType* inData = in.Data();
+        ElemType* kernGradData = kernelGrad.Data();
+        size_t batchSize = srcGrad.GetNumCols();
+#pragma omp parallel for
+        for (int64_t k = 0; k < (int64_t)d.mapOutCount; k++)
+        {
+            ElemType* dst = kernGradData + k * d.kW * d.kH;
+            for (int ky = 0; ky < d.kH; ky++)
+            {
+                for (int kx = 0; kx < d.kW; kx++)
+                {
+                    ElemType sum = 0;
+                    for (size_t sample = 0; sample < batchSize; sample++)
+                    {
+                        const ElemType* src = srcGradData + sample * d.outSize + k * d.outW * d.outH;
+                        const ElemType* x = inData + sample * d.inSize + (k / d.multiplier) * d.inW * d.inH;
+                        for (int oy = 0; oy < d.outH; oy++)
+                        {
+                            int iy = oy * d.strideH - d.padH + ky * d.dilationH;
+                            if (iy < 0 || iy >= d.inH)
+                                continue;
+                            for (int ox = 0; ox < d.outW; ox++)
+                            {
+                                int ix = ox * d.strideW - d.padW + kx * d.dilationW;
+                                if (0 <= ix && ix < d.inW)
+                                    sum += src[oy * d.outW + ox] * x[iy * d.inW + ix];
+                            }
+                        }
+                    }
+                    dst[ky * d.kW + kx] = accumulateGradient ? dst[ky * d.kW + kx] + sum : sum;
+                }
+            }
+        }
+    }
+
+private:
+    // Sizes of a depthwise convolution; every input map produces 'multiplier' consecutive output maps.
+    struct Depthwise
+    {
+        Depthwise(const ConvolveGeometry& g)
+            : inW((int)g.InputShape()[0]), inH((int)g.InputShape()[1]), mapInCount(g.InputShape()[2]),
+              outW((int)g.OutputShape()[0]), outH((int)g.OutputShape()[1]), mapOutCount(g.OutputShape()[2]),
+              kW((int)g.KernelShape()[0]), kH((int)g.KernelShape()[1]),
+              strideW((int)g.GetStride(0)), strideH((int)g.GetStride(1)),
+              dilationW((int)g.GetDilation(0)), dilationH((int)g.GetDilation(1)),
+              padW(g.GetLowerPad(0)), padH(g.GetLowerPad(1)),
+              multiplier(mapOutCount / mapInCount), inSize(g.InputShape().GetNumElements()), outSize(g.OutputShape().GetNumElements())
+        {
+        }
+
+        int inW, inH;
+        size_t mapInCount;
+        int outW, outH;
+        size_t mapOutCount;
+        int kW, kH;
+        int strideW, strideH;
+        int dilationW, dilationH;
+        int padW, padH;
+        size_t multiplier;
+        size_t inSize, outSize;
+    };
+
+    // cudnn layout uses row-major kernel weight matrix, which for 1x1 kernels is [C x K].
+    Mat PointwiseKernel(const Mat& kernel) const
+    {
+        auto kern = kernel.ColumnSlice(0, kernel.GetNumCols());
+        kern.Reshape(m_geometry->KernelShape()[2], kernel.GetNumElements() / m_geometry->KernelShape()[2]);
+        return kern;
+    }
+
+    // One sample of a CHW tensor as a [WH x maps] matrix.
+    static Mat PointwiseSample(const Mat& m, size_t sample, size_t mapCount)
+    {
+        auto slice = m.ColumnSlice(sample, 1);
+        slice.Reshape(m.GetNumRows() / mapCount, mapCount);
+        return slice;
+    }
+
+    static bool IsPointwise(ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        return geometry->Groups() == 1 && kernT[0] == 1 && kernT[1] == 1 && kernT[2] == inT[2] &&
+               geometry->GetStride(0) == 1 && geometry->GetStride(1) == 1 &&
+               outT[0] == inT[0] && outT[1] == inT[1] && geometry->GetLowerPad(0) == 0 && geometry->GetLowerPad(1) == 0;
+    }
+
+    static bool IsDepthwise(ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        const auto& kernT = geometry->KernelShape();
+        const auto& outT = geometry->OutputShape();
+        return geometry->Groups() == inT[2] && kernT[2] == 1 && outT[2] % inT[2] == 0;
+    }
+
+    bool m_isPointwise;
+
+public:
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry)
+    {
+        const auto& inT = geometry->InputShape();
+        return deviceId < 0 && inT.GetRank() == 3 &&
+               find(begin(geometry->Sharing()), end(geometry->Sharing()), false) == end(geometry->Sharing()) &&
+               geometry->OutputShape()[2] == geometry->GetMapCount(2) && geometry->GetMapCount(0) == 1 && geometry->GetMapCount(1) == 1 &&
+               geometry->GetDilation(2) == 1 && geometry->GetLowerPad(2) == 0 &&
+               (IsPointwise(geometry) || IsDepthwise(geometry));
+    }
+};
+
+//------------------------------------------------------------------
+// Auto-tuning convolution engine implementation.
+// Wraps the engines that support a convolution configuration. For each minibatch size
+// (rounded up to a power of two) it measures the forward pass of every engine with every
+// workspace size (maxTempMemSizeInSamples, which bounds the sizes tried if it is not 0)
+// and from then on uses the fastest combination for all operations with that minibatch size.
+// Decisions are shared through ConvolutionTuningCache with other engines of the same
+// configuration and, if a cache file is set, with later runs.
+// The first engine, with the configured workspace size, is used for minibatch sizes
+// that have not been tuned yet in backward passes (e.g. transposed convolution).
+//------------------------------------------------------------------
+template <class ElemType>
+class AutoTuningConvolutionEngine : public ConvolutionEngine<ElemType>
+{
+public:
+    using Base = ConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+    using EnginePtr = std::unique_ptr<ConvolutionEngine<ElemType>>;
+
+    struct Candidate
+    {
+        std::string name; // must not contain whitespace, it is persisted
+        EnginePtr engine;
+        bool usesWorkspace;
+    };
+
+public:
+    AutoTuningConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind, bool poolIncludePad,
+                                std::vector<Candidate>&& candidates, const std::wstring& logPrefix)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), m_candidates(std::move(candidates)), m_logPrefix(logPrefix)
+    {
+        assert(!m_candidates.empty());
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_maxTempMemSizeInSamples;
+
+    void EnsureCompatible() override
+    {
+    }
+
+    void EnsureConvolutionInitialized() override
+    {
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        size_t bucket = BatchSizeBucket(in.GetNumCols());
+        if (m_decisions.find(bucket) == m_decisions.end())
+            m_decisions[bucket] = Decide(bucket, in, kernel, out, workspace);
+        Engine(in.GetNumCols()).Forward(in, kernel, out, workspace);
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace) override
+    {
+        Engine(srcGrad.GetNumCols()).BackwardData(srcGrad, kernel, grad, accumulateGradient, workspace);
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool allowReuse, Mat& workspace) override
+    {
+        Engine(srcGrad.GetNumCols()).BackwardKernel(srcGrad, in, kernelGrad, accumulateGradient, allowReuse, workspace);
+    }
+
+    void EnsurePoolingInitialized() override
+    {
+    }
+
+    void ForwardPoolingCore(const Mat& in, Mat& out) override
+    {
+        Engine(in.GetNumCols()).ForwardPooling(in, out);
+    }
+
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad, bool accumulateGradient) override
+    {
+        Engine(srcGrad.GetNumCols()).BackwardPooling(out, srcGrad, in, grad, accumulateGradient);
+    }
+
+    void MaxUnpoolingCore(const Mat& out, const Mat& poolIn, Mat& in) override
+    {
+        Engine(out.GetNumCols()).MaxUnpooling(out, poolIn, in);
+    }
+
+private:
+    struct Decision
+    {
+        size_t candidate;
+        size_t maxTempMemSizeInSamples;
+    };
+
+    static size_t BatchSizeBucket(size_t batchSize)
+    {
+        size_t bucket = 1;
+        while (bucket < batchSize)
+            bucket *= 2;
+        return bucket;
+    }
+
+    // Returns the engine for the minibatch size, configured with the workspace size it was tuned with.
+    ConvolutionEngine<ElemType>& Engine(size_t batchSize)
+    {
+        auto decision = m_decisions.find(BatchSizeBucket(batchSize));
+        if (decision == m_decisions.end())
+        {
+            m_candidates[0].engine->SetmMaxTempMemSizeInSamples(m_maxTempMemSizeInSamples);
+            return *m_candidates[0].engine;
+        }
+        auto& engine = *m_candidates[decision->second.candidate].engine;
+        engine.SetmMaxTempMemSizeInSamples(decision->second.maxTempMemSizeInSamples);
+        return engine;
+    }
+
+    // FNV-1a hash; unlike std::hash it does not depend on the standard library, the keys are persisted.
+    static uint64_t Hash(const std::string& value)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : value)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // Everything the best choice depends on: configuration, precision, minibatch size, memory limit and threads.
+    std::string Key(size_t bucket) const
+    {
+        std::string configuration = (std::string)*m_geometry;
+        for (size_t i = 0; i < m_geometry->InputShape().GetRank(); i++)
+            configuration += " " + std::to_string(m_geometry->GetDilation(i));
+        configuration += " " + std::to_string(m_geometry->Groups());
+        return msra::strfun::strprintf("%s/%016llx/%d/%d/%d", sizeof(ElemType) == sizeof(float) ? "float" : "double",
+                                       (unsigned long long)Hash(configuration),
+                                       (int)bucket, (int)m_maxTempMemSizeInSamples, CPUMatrix<ElemType>::GetMaxNumThreads());
+    }
+
+    Decision Decide(size_t bucket, const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        auto key = Key(bucket);
+        std::string stored;
+        if (ConvolutionTuningCache::Instance().TryGet(key, stored))
+        {
+            // A decision for a candidate that is not available in this run (e.g. disabled engine) is tuned again.
+            char name[256];
+            size_t maxTempMemSizeInSamples;
+            if (sscanf(stored.c_str(), "%255s %zu", name, &maxTempMemSizeInSamples) == 2)
+            {
+                for (size_t i = 0; i < m_candidates.size(); i++)
+                    if (m_candidates[i].name == name)
+                        return Decision{ i, maxTempMemSizeInSamples };
+            }
+        }
+
+        auto decision = Tune(in, kernel, out, workspace);
+        ConvolutionTuningCache::Instance().Add(key, m_candidates[decision.candidate].name + " " + std::to_string(decision.maxTempMemSizeInSamples));
+        return decision;
+    }
+
+    std::vector<size_t> WorkspaceSizes(const Candidate& candidate, size_t batchSize) const
+    {
+        if (!candidate.usesWorkspace)
+            return { m_maxTempMemSizeInSamples };
+
+        // 0 is the whole minibatch.
+        std::vector<size_t> res;
+        if (m_maxTempMemSizeInSamples == 0)
+            res.push_back(0);
+        for (size_t size : { 1, 4, 16, 64 })
+        {
+            if (size < batchSize && (m_maxTempMemSizeInSamples == 0 || size < m_maxTempMemSizeInSamples))
+                res.push_back(size);
+        }
+        if (m_maxTempMemSizeInSamples != 0)
+            res.push_back(m_maxTempMemSizeInSamples);
+        return res;
+    }
+
+    double TimeForward(ConvolutionEngine<ElemType>& engine, const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        engine.Forward(in, kernel, out, workspace);
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Every combination runs twice and the second run is timed, the first one allocates the workspace.
+    // Combinations whose first run is already much slower than the best time so far are not run again.
+    Decision Tune(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        Decision best{ 0, m_maxTempMemSizeInSamples };
+        double bestTime = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < m_candidates.size(); i++)
+        {
+            auto& engine = *m_candidates[i].engine;
+            for (size_t maxTempMemSizeInSamples : WorkspaceSizes(m_candidates[i], in.GetNumCols()))
+            {
+                engine.SetmMaxTempMemSizeInSamples(maxTempMemSizeInSamples);
+                if (TimeForward(engine, in, kernel, out, workspace) > 4 * bestTime)
+                    continue;
+                double time = TimeForward(engine, in, kernel, out, workspace);
+                if (time < bestTime)
+                {
+                    best = Decision{ i, maxTempMemSizeInSamples };
+                    bestTime = time;
+                }
+            }
+        }
+
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsauto-tuning selected %s convolution engine with maxTempMemSizeInSamples %d (%.3f ms) for minibatch size %d and geometry: %s.\n",
+                    m_logPrefix.c_str(), m_candidates[best.candidate].name.c_str(), (int)best.maxTempMemSizeInSamples, bestTime * 1000,
+                    (int)in.GetNumCols(), ((string)*m_geometry).c_str());
+        return best;
+    }
+
+    std::vector<Candidate> m_candidates;
+    std::map<size_t, Decision> m_decisions; // by minibatch size bucket
+    std::wstring m_logPrefix;
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -1189,6 +1965,55 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
                                                                forceDeterministicAlgorithms, poolIncludePad, inputHasFreeDimension);
     }
 
+    // On CPU several engines may support the geometry and which of them is the fastest depends on the geometry,
+    // the minibatch size and the machine, so the candidates are measured on the first minibatch of every size bucket
+    // and the decisions are kept in the tuning cache (see SetConvolutionTuningCachePath).
+    if (poolKind == PoolKind::None && deviceId < 0)
+    {
+        using Candidate = typename AutoTuningConvolutionEngine<ElemType>::Candidate;
+        std::vector<Candidate> candidates;
+        bool groupsOnCpu = geometry->Groups() == 1 || (GemmConvolutionEngine<ElemType>::IsMklEnabled() && geometry->InputShape().GetRank() < 4);
+        if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry) && groupsOnCpu)
+        {
+            if (GemmConvolutionEngine<ElemType>::IsMklEnabled())
+            {
+                candidates.push_back(Candidate{ "GemmMkl", std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad, true), false });
+                // Without MKL-DNN group convolution is not supported by the GEMM engine.
+                if (geometry->Groups() == 1)
+                    candidates.push_back(Candidate{ "Gemm", std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad, false), true });
+            }
+            else
+                candidates.push_back(Candidate{ "Gemm", std::make_unique<GemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), true });
+        }
+        if (isEnabled(ConvolutionEngineKind::Direct) && DirectConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+            candidates.push_back(Candidate{ "Direct", std::make_unique<DirectConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), false });
+        if (isEnabled(ConvolutionEngineKind::Winograd) && WinogradConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+        {
+            candidates.push_back(Candidate{ "WinogradF4", std::make_unique<WinogradConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad, 4), true });
+            candidates.push_back(Candidate{ "WinogradF2", std::make_unique<WinogradConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad, 2), true });
+        }
+        // The reference engine is by far the slowest, it is only a candidate if no other engine is.
+        if (candidates.empty() && isEnabled(ConvolutionEngineKind::Reference) && geometry->Groups() == 1)
+            candidates.push_back(Candidate{ "Reference", std::make_unique<ReferenceConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad), false });
+
+        // Timing based selection is not reproducible, so deterministic runs always take the first candidate.
+        if (candidates.size() == 1 || (!candidates.empty() && forceDeterministicAlgorithms))
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing %s convolution engine for geometry: %s.\n", logPrefix.c_str(), candidates[0].name.c_str(), engStr.c_str());
+
+            return std::move(candidates[0].engine);
+        }
+        if (!candidates.empty())
+        {
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "%lsusing auto-tuned convolution engine (%d candidates) for geometry: %s.\n", logPrefix.c_str(), (int)candidates.size(), engStr.c_str());
+
+            return std::make_unique<AutoTuningConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad,
+                                                                           std::move(candidates), logPrefix);
+        }
+    }
+
     if (geometry->Groups() == 1)
     {
         if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
@@ -22,8 +22,10 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Winograd  = 1 << 4, // Winograd minimal filtering, auto-tuned against GEMM. Works only for 2D 3x3 convos with unit stride and full sharing on CPU.
+    Direct    = 1 << 5, // Direct implementation without unrolling. Works only for 2D 1x1 (unit stride) and depthwise convos with full sharing on CPU.
 
-    All       = Reference | CuDnn | Legacy | Gemm
+    All       = Reference | CuDnn | Legacy | Gemm | Winograd | Direct
 };
 
 enum class PoolKind
@@ -122,4 +124,7 @@ static inline PoolKind PoolKindFrom(const wstring& s)
     InvalidArgument("Unknown pooling kind: '%ls'. Supported values: 'none', 'max', 'average'.", s.c_str());
 }
 
+// Sets the file in which the CPU convolution engine auto-tuner keeps its decisions across runs.
+MATH_API void SetConvolutionTuningCachePath(const std::wstring& path);
+
 } } }
@@ -0,0 +1,86 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "ConvolutionTuningCache.h"
+#include "ConvolutionEngine.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+ConvolutionTuningCache& ConvolutionTuningCache::Instance()
+{
+    static ConvolutionTuningCache instance;
+    return instance;
+}
+
+void ConvolutionTuningCache::SetPath(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = path;
+    m_decisions.clear();
+    if (m_path.empty())
+        return;
+
+    // A missing file is not an error, it is created with the first decision.
+    FILE* f = _wfopen(m_path.c_str(), L"r");
+    if (f == nullptr)
+        return;
+
+    size_t count = 0;
+    char line[4096];
+    while (fgets(line, sizeof(line), f) != nullptr)
+    {
+        std::string entry(line);
+        while (!entry.empty() && (entry.back() == '\n' || entry.back() == '\r'))
+            entry.pop_back();
+        size_t separator = entry.find(' ');
+        // Lines without a decision are written by a process that was interrupted, skip them.
+        if (separator == std::string::npos || separator == 0 || separator + 1 == entry.size())
+            continue;
+        m_decisions[entry.substr(0, separator)] = entry.substr(separator + 1);
+        count++;
+    }
+    fclose(f);
+
+    if (GetMathLibTraceLevel() > 0)
+        fprintf(stderr, "Loaded %d convolution auto-tuning decisions from '%ls'.\n", (int)count, m_path.c_str());
+}
+
+bool ConvolutionTuningCache::TryGet(const std::string& key, std::string& decision)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto entry = m_decisions.find(key);
+    if (entry == m_decisions.end())
+        return false;
+    decision = entry->second;
+    return true;
+}
+
+void ConvolutionTuningCache::Add(const std::string& key, const std::string& decision)
+{
+    assert(key.find_first_of(" \t\r\n") == std::string::npos);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_decisions[key] = decision;
+    if (m_path.empty())
+        return;
+
+    // Decisions are appended one line at a time, so processes sharing the file lose nothing but duplicate work.
+    FILE* f = _wfopen(m_path.c_str(), L"a");
+    if (f == nullptr)
+    {
+        fprintf(stderr, "WARNING: cannot write convolution auto-tuning cache '%ls', decisions will not be persisted.\n", m_path.c_str());
+        m_path.clear();
+        return;
+    }
+    fprintf(f, "%s %s\n", key.c_str(), decision.c_str());
+    fclose(f);
+}
+
+void SetConvolutionTuningCachePath(const std::wstring& path)
+{
+    ConvolutionTuningCache::Instance().SetPath(path);
+}
+
+} } }
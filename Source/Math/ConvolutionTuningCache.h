@@ -0,0 +1,41 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+//-------------------------------------------------------------
+// Decisions of the convolution engine auto-tuner, shared by all engines in the process.
+// If a cache file is set, decisions are loaded from it and new ones are appended to it,
+// one "<key> <decision>" line each, so the next run does not have to tune again.
+// Keys must not contain whitespace. When a key occurs more than once, the last line wins.
+//-------------------------------------------------------------
+class ConvolutionTuningCache
+{
+public:
+    static ConvolutionTuningCache& Instance();
+
+    // Sets the cache file and replaces the decisions in memory with the ones stored in it.
+    // An empty path keeps decisions in memory only.
+    void SetPath(const std::wstring& path);
+
+    bool TryGet(const std::string& key, std::string& decision);
+
+    void Add(const std::string& key, const std::string& decision);
+
+private:
+    ConvolutionTuningCache() = default;
+
+    std::mutex m_mutex;
+    std::wstring m_path;
+    std::map<std::string, std::string> m_decisions;
+};
+
+} } }
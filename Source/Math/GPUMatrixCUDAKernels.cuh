@@ -5598,7 +5598,8 @@ __global__ void _assignAlphaScore(
             if (delayConstraint != -1)
             {
                 LONG64 labelid_r = labelid + 2;
-                LONG64 phoneBoundId_r = (LONG64)(phoneBound[labelid_r]);
+                // the final blank has no label after it, it is not constrained
+                LONG64 phoneBoundId_r = (phoneSeqId + 2 < phoneNum) ? (LONG64)(phoneBound[labelid_r]) : frameNum;
                 if (phoneId == blankTokenId)
                 {
                     // only constraint right side
@@ -5690,7 +5691,7 @@ __global__ void _assignBetaScore(
             betaScore[betaid] = x + ascore;
             if (delayConstraint != -1)
             {
-                LONG64 phoneBoundId_r = (LONG64)(phoneBound[labelid_2]);
+                LONG64 phoneBoundId_r = (phoneSeqId + 2 < phoneNum) ? (LONG64)(phoneBound[labelid_2]) : frameNum;
                 if (phoneId == blankTokenId)
                 {
                     if (t > phoneBoundId_r + delayConstraint - 1)
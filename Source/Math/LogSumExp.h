@@ -0,0 +1,121 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+#include "TensorOps.h"
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOGSUMEXP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// LogSumExp3 -- element-wise sum of three vectors in the log domain
+//
+//   out[i] = log(exp(a[i]) + exp(b[i] + pb[i]) + exp(c[i] + pc[i])) + add[i]
+//
+// This is the recursion step of the CTC forward-backward (see CPUMatrix::AssignCTCScore): a, b and c are
+// the scores of a label and of its neighbors in the previous frame, pb and pc are 0 for allowed transitions
+// and LZERO for the others, and add is the score of observing the label.
+// The largest of the three terms is factored out, so a single exp per term and a single log of a value in
+// [1, 3] are needed. For float, 4 elements are computed at once with SSE2 and the polynomial approximations
+// of exp and log of the Cephes library (relative error about 1e-7); other types use exp_() and log_().
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+inline ElemType LogSumExp3(ElemType a, ElemType b, ElemType c)
+{
+    ElemType m = a > b ? a : b;
+    m = m > c ? m : c;
+    return m + log_(exp_(a - m) + exp_(b - m) + exp_(c - m));
+}
+
+template <class ElemType>
+inline void LogSumExp3(const ElemType* a, const ElemType* b, const ElemType* pb, const ElemType* c, const ElemType* pc,
+                       const ElemType* add, ElemType* out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = LogSumExp3(a[i], b[i] + pb[i], c[i] + pc[i]) + add[i];
+}
+
+#ifdef LOGSUMEXP_SSE2
+
+// exp(x) for x <= 0; values below -87 (where exp(x) is about the smallest normal float) are clamped
+inline __m128 ExpOfNonPositive(__m128 x)
+{
+    x = _mm_max_ps(x, _mm_set1_ps(-87.0f));
+
+    // exp(x) = 2^n * exp(r) with n = floor(x / log(2) + 1/2) and r = x - n * log(2), |r| <= log(2) / 2
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+    __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, fx), _mm_set1_ps(1.0f))); // truncation -> floor
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));           // log(2) in two parts for precision
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+
+    __m128 y = _mm_set1_ps(1.9875691500e-4f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+    y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), x), _mm_set1_ps(1.0f));
+
+    // 2^n, n >= -126 is a normal float
+    __m128i pow2n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+}
+
+// log(x) for normal, positive x
+inline __m128 LogOfPositive(__m128 x)
+{
+    // x = m * 2^e with m in [sqrt(1/2), sqrt(2)), log(x) = log(m) + e * log(2)
+    __m128i bits = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+    __m128 m = _mm_or_ps(_mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x007fffff))), _mm_set1_ps(0.5f)); // in [1/2, 1)
+    __m128 belowSqrtHalf = _mm_cmplt_ps(m, _mm_set1_ps(0.707106781186547524f));
+    e = _mm_sub_ps(e, _mm_and_ps(belowSqrtHalf, _mm_set1_ps(1.0f)));
+    m = _mm_add_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_and_ps(belowSqrtHalf, m)); // m - 1, or 2m - 1 if m < sqrt(1/2)
+
+    __m128 z = _mm_mul_ps(m, m);
+    __m128 y = _mm_set1_ps(7.0376836292e-2f);
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-1.1514610310e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.1676998740e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-1.2420140846e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(1.4249322787e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-1.6668057665e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(2.0000714765e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(-2.4999993993e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(3.3333331174e-1f));
+    y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+}
+
+template <>
+inline void LogSumExp3<float>(const float* a, const float* b, const float* pb, const float* c, const float* pc,
+                              const float* add, float* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_add_ps(_mm_loadu_ps(b + i), _mm_loadu_ps(pb + i));
+        __m128 vc = _mm_add_ps(_mm_loadu_ps(c + i), _mm_loadu_ps(pc + i));
+        __m128 m = _mm_max_ps(va, _mm_max_ps(vb, vc));
+        __m128 sum = _mm_add_ps(_mm_add_ps(ExpOfNonPositive(_mm_sub_ps(va, m)), ExpOfNonPositive(_mm_sub_ps(vb, m))),
+                                ExpOfNonPositive(_mm_sub_ps(vc, m))); // in [1, 3]
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(m, LogOfPositive(sum)), _mm_loadu_ps(add + i)));
+    }
+    for (; i < n; i++)
+        out[i] = LogSumExp3(a[i], b[i] + pb[i], c[i] + pc[i]) + add[i];
+}
+
+#endif
+
+}}}
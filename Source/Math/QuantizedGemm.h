@@ -0,0 +1,216 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+#include "Basics.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// QuantizedGemm -- product of two integer matrices with 32-bit accumulation
+//
+// Computes C[m,n] = A[m,k] * B[k,n] for column-major matrices of 8- or 16-bit integers.
+// Both operands are first packed into panels: A into panels of PanelRows rows, B into panels of
+// PanelCols columns, each panel stored as consecutive pairs along k (zero-padded at the edges),
+// so that the kernel multiplies and adds two products per 32-bit lane (pmaddwd / vpdpwssd).
+// A packed operand can be kept and reused as long as its values do not change (e.g. weights).
+// Tiles of the result are distributed over OMP threads.
+//
+// The kernel is selected at compile time: AVX-512 VNNI, AVX2, SSE2, or portable C++.
+// Each product of two 16-bit values and the sum of each pair of them must fit into 32 bits;
+// see SymmetricQuantizer's bitShift for keeping values in that range.
+// -----------------------------------------------------------------------
+
+class QuantizedGemm
+{
+public:
+    static const size_t PanelRows = 16;
+    static const size_t PanelCols = 4;
+
+    // Packs column-major A[m,k] into row panels.
+    template <class QuantizedType>
+    static void PackA(const QuantizedType* a, size_t m, size_t k, std::vector<short>& packed)
+    {
+        size_t numPanels = (m + PanelRows - 1) / PanelRows;
+        size_t numPairs = (k + 1) / 2;
+        packed.assign(numPanels * numPairs * PanelRows * 2, 0);
+        for (size_t panel = 0; panel < numPanels; panel++)
+        {
+            short* dst = packed.data() + panel * numPairs * PanelRows * 2;
+            size_t rowEnd = std::min(m, (panel + 1) * PanelRows);
+            for (size_t l = 0; l < k; l++)
+            {
+                // element (i, l) goes to pair l / 2 of row i, at position l % 2
+                short* pair = dst + (l / 2) * PanelRows * 2 + l % 2;
+                for (size_t i = panel * PanelRows; i < rowEnd; i++)
+                    pair[(i - panel * PanelRows) * 2] = (short)a[i + l * m];
+            }
+        }
+    }
+
+    // Packs column-major B[k,n] into column panels.
+    template <class QuantizedType>
+    static void PackB(const QuantizedType* b, size_t k, size_t n, std::vector<short>& packed)
+    {
+        size_t numPanels = (n + PanelCols - 1) / PanelCols;
+        size_t numPairs = (k + 1) / 2;
+        packed.assign(numPanels * numPairs * PanelCols * 2, 0);
+        for (size_t j = 0; j < n; j++)
+        {
+            short* dst = packed.data() + (j / PanelCols) * numPairs * PanelCols * 2 + (j % PanelCols) * 2;
+            const QuantizedType* src = b + j * k;
+            for (size_t l = 0; l < k; l++)
+                dst[(l / 2) * PanelCols * 2 + l % 2] = (short)src[l];
+        }
+    }
+
+    // C[m,n] = A[m,k] * B[k,n] with packed A and B, C is column-major.
+    template <class ElemType>
+    static void Multiply(const std::vector<short>& packedA, const std::vector<short>& packedB, size_t m, size_t n, size_t k, ElemType* c)
+    {
+        size_t numPairs = (k + 1) / 2;
+        size_t numRowPanels = (m + PanelRows - 1) / PanelRows;
+        size_t numColPanels = (n + PanelCols - 1) / PanelCols;
+        if (packedA.size() != numRowPanels * numPairs * PanelRows * 2 || packedB.size() != numColPanels * numPairs * PanelCols * 2)
+            LogicError("QuantizedGemm: The packed operands do not match the dimensions of the product.");
+
+        // a tile is a block of row panels by a block of column panels; the A panels of a tile are
+        // reused for all of its column panels while they are in cache
+        const size_t tileRowPanels = 4, tileColPanels = 16;
+        size_t numTileRows = (numRowPanels + tileRowPanels - 1) / tileRowPanels;
+        size_t numTileCols = (numColPanels + tileColPanels - 1) / tileColPanels;
+        int numTiles = (int)(numTileRows * numTileCols);
+        bool parallel = numTiles > 1 && (double)m * n * k >= 1e6;
+
+#pragma omp parallel for schedule(dynamic) if (parallel)
+        for (int tile = 0; tile < numTiles; tile++)
+        {
+            int32_t acc[PanelRows * PanelCols];
+            size_t rowPanelBegin = (tile % numTileRows) * tileRowPanels;
+            size_t colPanelBegin = (tile / numTileRows) * tileColPanels;
+            size_t rowPanelEnd = std::min(numRowPanels, rowPanelBegin + tileRowPanels);
+            size_t colPanelEnd = std::min(numColPanels, colPanelBegin + tileColPanels);
+            for (size_t colPanel = colPanelBegin; colPanel < colPanelEnd; colPanel++)
+            {
+                const short* b = packedB.data() + colPanel * numPairs * PanelCols * 2;
+                for (size_t rowPanel = rowPanelBegin; rowPanel < rowPanelEnd; rowPanel++)
+                {
+                    const short* a = packedA.data() + rowPanel * numPairs * PanelRows * 2;
+                    Kernel(a, b, numPairs, acc);
+
+                    size_t rowBegin = rowPanel * PanelRows, rowEnd = std::min(m, rowBegin + PanelRows);
+                    size_t colBegin = colPanel * PanelCols, colEnd = std::min(n, colBegin + PanelCols);
+                    for (size_t j = colBegin; j < colEnd; j++)
+                        for (size_t i = rowBegin; i < rowEnd; i++)
+                            c[i + j * m] = (ElemType)acc[(j - colBegin) * PanelRows + (i - rowBegin)];
+                }
+            }
+        }
+    }
+
+    // Name of the kernel this build uses.
+    static const char* KernelName()
+    {
+#if defined(__AVX512VNNI__) && defined(__AVX512F__)
+        return "AVX-512 VNNI";
+#elif defined(__AVX2__)
+        return "AVX2";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        return "SSE2";
+#else
+        return "portable";
+#endif
+    }
+
+private:
+    // acc[j * PanelRows + i] = sum over the pairs p of a[p][i] . b[p][j], where a[p][i] and b[p][j] are pairs of 16-bit values
+    static void Kernel(const short* a, const short* b, size_t numPairs, int32_t* acc)
+    {
+#if defined(__AVX512VNNI__) && defined(__AVX512F__)
+        __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512(), c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+        for (size_t p = 0; p < numPairs; p++)
+        {
+            __m512i va = _mm512_loadu_si512(a + p * PanelRows * 2);
+            const short* pb = b + p * PanelCols * 2;
+            c0 = _mm512_dpwssd_epi32(c0, va, _mm512_set1_epi32(LoadPair(pb + 0)));
+            c1 = _mm512_dpwssd_epi32(c1, va, _mm512_set1_epi32(LoadPair(pb + 2)));
+            c2 = _mm512_dpwssd_epi32(c2, va, _mm512_set1_epi32(LoadPair(pb + 4)));
+            c3 = _mm512_dpwssd_epi32(c3, va, _mm512_set1_epi32(LoadPair(pb + 6)));
+        }
+        _mm512_storeu_si512(acc + 0 * PanelRows, c0);
+        _mm512_storeu_si512(acc + 1 * PanelRows, c1);
+        _mm512_storeu_si512(acc + 2 * PanelRows, c2);
+        _mm512_storeu_si512(acc + 3 * PanelRows, c3);
+#elif defined(__AVX2__)
+        __m256i c[PanelCols][2];
+        for (size_t j = 0; j < PanelCols; j++)
+            c[j][0] = c[j][1] = _mm256_setzero_si256();
+        for (size_t p = 0; p < numPairs; p++)
+        {
+            __m256i va0 = _mm256_loadu_si256((const __m256i*)(a + p * PanelRows * 2));
+            __m256i va1 = _mm256_loadu_si256((const __m256i*)(a + p * PanelRows * 2 + 16));
+            const short* pb = b + p * PanelCols * 2;
+            for (size_t j = 0; j < PanelCols; j++)
+            {
+                __m256i vb = _mm256_set1_epi32(LoadPair(pb + j * 2));
+                c[j][0] = _mm256_add_epi32(c[j][0], _mm256_madd_epi16(va0, vb));
+                c[j][1] = _mm256_add_epi32(c[j][1], _mm256_madd_epi16(va1, vb));
+            }
+        }
+        for (size_t j = 0; j < PanelCols; j++)
+        {
+            _mm256_storeu_si256((__m256i*)(acc + j * PanelRows), c[j][0]);
+            _mm256_storeu_si256((__m256i*)(acc + j * PanelRows + 8), c[j][1]);
+        }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        __m128i c[PanelCols][4];
+        for (size_t j = 0; j < PanelCols; j++)
+            c[j][0] = c[j][1] = c[j][2] = c[j][3] = _mm_setzero_si128();
+        for (size_t p = 0; p < numPairs; p++)
+        {
+            __m128i va[4];
+            for (size_t h = 0; h < 4; h++)
+                va[h] = _mm_loadu_si128((const __m128i*)(a + p * PanelRows * 2 + h * 8));
+            const short* pb = b + p * PanelCols * 2;
+            for (size_t j = 0; j < PanelCols; j++)
+            {
+                __m128i vb = _mm_set1_epi32(LoadPair(pb + j * 2));
+                for (size_t h = 0; h < 4; h++)
+                    c[j][h] = _mm_add_epi32(c[j][h], _mm_madd_epi16(va[h], vb));
+            }
+        }
+        for (size_t j = 0; j < PanelCols; j++)
+            for (size_t h = 0; h < 4; h++)
+                _mm_storeu_si128((__m128i*)(acc + j * PanelRows + h * 4), c[j][h]);
+#else
+        std::fill(acc, acc + PanelRows * PanelCols, 0);
+        for (size_t p = 0; p < numPairs; p++)
+        {
+            const short* pa = a + p * PanelRows * 2;
+            const short* pb = b + p * PanelCols * 2;
+            for (size_t j = 0; j < PanelCols; j++)
+                for (size_t i = 0; i < PanelRows; i++)
+                    acc[j * PanelRows + i] += (int32_t)pa[i * 2] * pb[j * 2] + (int32_t)pa[i * 2 + 1] * pb[j * 2 + 1];
+        }
+#endif
+    }
+
+    // a pair of 16-bit values as one 32-bit value, for broadcasting
+    static int32_t LoadPair(const short* pair)
+    {
+        int32_t value;
+        memcpy(&value, pair, sizeof(value));
+        return value;
+    }
+};
+
+}}}
@@ -9,20 +9,85 @@
 #include "BinaryChunkDeserializer.h"
 #include "BinaryDataChunk.h"
 #include "CBFUtils.h"
+#include "ChunkCompressor.h"
 #include "FileWrapper.h"
 #include <vector>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace CNTK {
 
 using namespace Microsoft::MSR::CNTK;
 
-enum class MatrixEncodingType : unsigned char
+// A read-only memory mapping of the whole input file.
+class BinaryChunkDeserializer::MappedFile
 {
-    dense = 0,
-    sparse_csc = 1,
-    // TODO: compressed_sparse_csc = 2, // indices are encoded as var-ints
-};
+public:
+    explicit MappedFile(const FileWrapper& file)
+        : m_base(nullptr), m_size(file.Filesize())
+    {
+#ifdef _WIN32
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file.File()));
+        HANDLE mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+            RuntimeError("Cannot create a mapping of the input file, error code %d.", (int)GetLastError());
+
+        m_base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        // The view keeps a reference to the mapping object.
+        CloseHandle(mapping);
+        if (m_base == NULL)
+            RuntimeError("Cannot map a view of the input file, error code %d.", (int)GetLastError());
+#else
+        void* base = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fileno(file.File()), 0);
+        if (base == MAP_FAILED)
+            RuntimeError("Cannot map the input file: %s.", strerror(errno));
+        m_base = base;
+
+        // Chunks are visited in the order chosen by the randomizer and are read ahead explicitly (see WillNeed),
+        // the sequential readahead of the kernel would only fetch pages of chunks that are not needed yet.
+        madvise(m_base, m_size, MADV_RANDOM);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_base);
+#else
+        munmap(m_base, m_size);
+#endif
+    }
+
+    uint8_t* Data() const { return static_cast<uint8_t*>(m_base); }
+
+    size_t Size() const { return m_size; }
+
+    // Asks the OS to start reading the given range of the file in background.
+    void WillNeed(uint64_t offset, size_t size)
+    {
+#ifdef _WIN32
+#if _WIN32_WINNT >= _WIN32_WINNT_WIN8
+        WIN32_MEMORY_RANGE_ENTRY range = { Data() + offset, size };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+        uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+        uint64_t alignedOffset = offset - offset % pageSize;
+        madvise(Data() + alignedOffset, size + (offset - alignedOffset), MADV_WILLNEED);
+#endif
+    }
+
+private:
+    void* m_base;
+    size_t m_size;
 
+    DISABLE_COPY_AND_MOVE(MappedFile);
+};
 
 void BinaryChunkDeserializer::ReadChunkTable()
 {
@@ -52,6 +117,9 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helpe
     SetTraceLevel(helper.GetTraceLevel());
 
     Initialize(helper.GetRename(), helper.GetElementType());
+
+    if (helper.UseMemoryMapping())
+        m_mappedFile = make_shared<MappedFile>(m_file);
 }
 
 
@@ -60,6 +128,8 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const std::wstring& filename) :
     m_file(FileWrapper::OpenOrDie(filename, L"rb")),
     m_headerOffset(0),
     m_chunkTableOffset(0),
+    m_chunkCompression(ChunkCompressionType::none),
+    m_hasCompactStreams(false),
     m_traceLevel(0)
 {
 }
@@ -71,9 +141,9 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     // First, verify the magic number.
     CBFUtils::FindMagicOrDie(m_file);
     
-    // Second, read the version number of the data file, and (for now) make sure the reader version is the same.
+    // Second, read the version number of the data file, and make sure the reader supports it.
     uint32_t versionNumber = CBFUtils::GetVersionNumber(m_file);
-    if (versionNumber != s_currentVersion)
+    if (versionNumber == 0 || versionNumber > s_currentVersion)
         LogicError("The reader version is %" PRIu32 ", but the data file was created for version %" PRIu32 ".",
             s_currentVersion, versionNumber);
 
@@ -102,9 +172,16 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
             m_deserializers[i] = make_shared<DenseBinaryDataDeserializer>(m_file, precision);
         else if (type == MatrixEncodingType::sparse_csc)
             m_deserializers[i] = make_shared<SparseBinaryDataDeserializer>(m_file, precision);
+        else if (type == MatrixEncodingType::compressed_sparse_csc && versionNumber >= 2)
+            m_deserializers[i] = make_shared<CompressedSparseBinaryDataDeserializer>(m_file, precision);
+        else if (type == MatrixEncodingType::dense_fp16 && versionNumber >= 2)
+            m_deserializers[i] = make_shared<HalfDenseBinaryDataDeserializer>(m_file, precision);
         else
             RuntimeError("Unknown encoding type %u requested.", (unsigned int)type);
 
+        if (type != MatrixEncodingType::dense && type != MatrixEncodingType::sparse_csc)
+            m_hasCompactStreams = true;
+
         auto description = m_deserializers[i]->GetStreamDescription();
         description.m_id = i;
         // Check if we should rename this input based on the config
@@ -117,6 +194,14 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
         m_streams[i] = description;
     }
 
+    // Version 2 stores the compression of the chunks after the inputs.
+    if (versionNumber >= 2)
+    {
+        m_file.ReadOrDie(m_chunkCompression);
+        if (m_chunkCompression > ChunkCompressionType::lz)
+            RuntimeError("Unknown chunk compression type %u requested.", (unsigned int)m_chunkCompression);
+    }
+
     // We just finished the header. So we're now at the chunk table.
     m_chunkTableOffset = m_file.TellOrDie();
 
@@ -150,10 +235,13 @@ void BinaryChunkDeserializer::SequenceInfosForChunk(ChunkIdType chunkId, std::ve
     auto numberOfSequences = m_chunkTable->GetNumSequences(chunkId);
     unique_ptr<uint32_t[]> numSamplesPerSequence(new uint32_t[numberOfSequences]);
 
-    // Seek to the start of the chunk
-    m_file.SeekOrDie(offset, SEEK_SET);
-    // read 'numberOfSequences' unsigned ints
-    m_file.ReadOrDie(numSamplesPerSequence.get(), sizeof(uint32_t), numberOfSequences);
+    {
+        std::lock_guard<std::mutex> lock(m_fileLock);
+        // Seek to the start of the chunk
+        m_file.SeekOrDie(offset, SEEK_SET);
+        // read 'numberOfSequences' unsigned ints
+        m_file.ReadOrDie(numSamplesPerSequence.get(), sizeof(uint32_t), numberOfSequences);
+    }
 
     auto startId = m_chunkTable->GetStartIndex(chunkId);
     for (decltype(numberOfSequences) i = 0; i < numberOfSequences; i++)
@@ -169,29 +257,78 @@ void BinaryChunkDeserializer::SequenceInfosForChunk(ChunkIdType chunkId, std::ve
     }
 }
 
-unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
+std::shared_ptr<uint8_t> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 {
-    // Seek to the start of the data portion in the chunk
-    m_file.SeekOrDie(m_chunkTable->GetDataStartOffset(chunkId), SEEK_SET);
+    auto dataStartOffset = m_chunkTable->GetDataStartOffset(chunkId);
 
     // Determine how big the chunk is.
     size_t chunkSize = m_chunkTable->GetChunkSize(chunkId);
-    
+
+    if (m_mappedFile)
+    {
+        if (dataStartOffset + chunkSize > m_mappedFile->Size())
+            RuntimeError("Chunk %u is beyond the end of the input file.", (unsigned int)chunkId);
+
+        // The chunk is requested ahead of its use when the randomizer prefetches it,
+        // so start reading it in background. The sequences are parsed only on first access.
+        m_mappedFile->WillNeed(dataStartOffset, chunkSize);
+
+        // The view shares the ownership of the mapping.
+        return std::shared_ptr<uint8_t>(m_mappedFile, m_mappedFile->Data() + dataStartOffset);
+    }
+
     // Create buffer
     // TODO: use a pool of buffers instead of allocating a new one, each time a chunk is read.
-    unique_ptr<byte[]> buffer(new byte[chunkSize]);
+    std::shared_ptr<uint8_t> buffer(new uint8_t[chunkSize], std::default_delete<uint8_t[]>());
+
+    std::lock_guard<std::mutex> lock(m_fileLock);
+
+    // Seek to the start of the data portion in the chunk
+    m_file.SeekOrDie(dataStartOffset, SEEK_SET);
 
     // Read the chunk from disk
-    m_file.ReadOrDie(buffer.get(), sizeof(byte), chunkSize);
+    m_file.ReadOrDie(buffer.get(), sizeof(uint8_t), chunkSize);
 
     return buffer;
 }
 
 
+std::shared_ptr<uint8_t> BinaryChunkDeserializer::DecodeChunk(ChunkIdType chunkId, std::shared_ptr<uint8_t> data)
+{
+    const char* begin = reinterpret_cast<const char*>(data.get());
+    const char* end = begin + m_chunkTable->GetChunkSize(chunkId);
+
+    std::shared_ptr<std::vector<char>> decoded;
+    if (m_chunkCompression == ChunkCompressionType::lz)
+    {
+        decoded = make_shared<std::vector<char>>();
+        ChunkCompressor::Decompress(begin, end - begin, *decoded);
+        begin = decoded->data();
+        end = begin + decoded->size();
+    }
+
+    if (m_hasCompactStreams)
+    {
+        auto expanded = make_shared<std::vector<char>>();
+        size_t numSequences = m_chunkTable->GetNumSequences(chunkId);
+        for (const auto& deserializer : m_deserializers)
+            begin = deserializer->DecodeChunk(numSequences, begin, end, *expanded);
+        decoded = expanded;
+    }
+
+    // The view shares the ownership of the decoded data.
+    return std::shared_ptr<uint8_t>(decoded, reinterpret_cast<uint8_t*>(decoded->data()));
+}
+
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
-    // Read the chunk into memory
-    unique_ptr<byte[]> buffer = ReadChunk(chunkId);
+    // Read the chunk into memory or map it
+    std::shared_ptr<uint8_t> buffer = ReadChunk(chunkId);
+
+    // Compressed chunks are decoded right away: the randomizer requests the next chunk on its prefetch thread,
+    // so that decompression overlaps with the use of the current chunk.
+    if (m_chunkCompression != ChunkCompressionType::none || m_hasCompactStreams)
+        buffer = DecodeChunk(chunkId, std::move(buffer));
 
     return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), std::move(buffer), m_deserializers);
 }
@@ -5,10 +5,12 @@
 
 #pragma once
 
+#include <mutex>
 #include "DataDeserializerBase.h"
 #include "BinaryConfigHelper.h"
 #include "BinaryDataChunk.h"
 #include "BinaryDataDeserializer.h"
+#include "CBFUtils.h"
 
 namespace CNTK {
 
@@ -101,6 +103,10 @@ public:
     // Get information about particular chunk.
     void SequenceInfosForChunk(ChunkIdType chunkId, std::vector<SequenceInfo>& result) override;
 
+    // Latest version of the CBF files this deserializer reads, all earlier versions are supported as well.
+    // Version 2 adds the chunk compression and the compact stream encodings.
+    static const uint32_t s_currentVersion = 2;
+
 private:
     // Builds an index of the input data.
     void Initialize(const std::map<std::wstring, std::wstring>& rename, DataType precision);
@@ -108,18 +114,36 @@ private:
     // Reads the chunk table from disk into memory
     void ReadChunkTable();
 
-    // Reads a chunk from disk into buffer
-    unique_ptr<byte[]> ReadChunk(ChunkIdType chunkId);
+    // Reads a chunk from disk into buffer, or returns a view of the chunk in the mapped file.
+    std::shared_ptr<uint8_t> ReadChunk(ChunkIdType chunkId);
+
+    // Decompresses a chunk and expands the compact stream encodings into the layout the deserializers parse.
+    std::shared_ptr<uint8_t> DecodeChunk(ChunkIdType chunkId, std::shared_ptr<uint8_t> data);
 
     BinaryChunkDeserializer(const wstring& filename);
 
     void SetTraceLevel(unsigned int traceLevel);
 
 private:
+    class MappedFile;
+
     FileWrapper m_file;
 
+    // Chunks are read by the prefetch threads of the randomizer while the sequence infos are read
+    // by the main thread. Decoding of the chunks is not serialized.
+    std::mutex m_fileLock;
+
+    // Read-only mapping of the input file, null if chunks are read into buffers.
+    // Chunks and sequences keep the mapping alive.
+    std::shared_ptr<MappedFile> m_mappedFile;
+
     int64_t m_headerOffset, m_chunkTableOffset;
 
+    ChunkCompressionType m_chunkCompression;
+
+    // True if some stream has an encoding that has to be expanded before parsing.
+    bool m_hasCompactStreams;
+
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
     ChunkTablePtr m_chunkTable;
     void* m_chunkBuffer;
@@ -130,8 +154,6 @@ private:
     
     unsigned int m_traceLevel;
 
-    static const uint32_t s_currentVersion = 1;
-
     friend class CNTKBinaryReaderTestRunner;
 
 
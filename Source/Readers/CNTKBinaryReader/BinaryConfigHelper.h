@@ -35,6 +35,8 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    bool UseMemoryMapping() const { return m_memoryMapped; }
+
     DataType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(BinaryConfigHelper);
@@ -49,6 +51,7 @@ private:
     bool m_sampleBasedRandomizationWindow;
     unsigned int m_traceLevel;
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    bool m_memoryMapped; // if true chunks are served directly from a memory mapping of the input file
 };
 
 }
@@ -9,6 +9,7 @@
 #include "BinaryConfigHelper.h"
 #include "BinaryDataChunk.h"
 #include "FileWrapper.h"
+#include "CBFUtils.h"
 #include "Reader.h"
 
 namespace CNTK {
@@ -37,6 +38,11 @@ public:
 
     virtual size_t GetSequenceDataForChunk(size_t numSequences, void* data, std::vector<SequenceDataPtr>& result) = 0;
 
+    // Appends the data of all sequences of a chunk to 'output' in the layout expected by GetSequenceDataForChunk,
+    // reading the stream as it is stored in the file from [data, end). Returns the position after the stream.
+    // Only used for chunks that are compressed or contain streams with a compact encoding.
+    virtual const char* DecodeChunk(size_t numSequences, const char* data, const char* end, std::vector<char>& output) = 0;
+
     virtual StorageFormat GetStorageFormat() = 0;
 
     StreamInformation GetStreamDescription() 
@@ -64,8 +70,6 @@ public:
         LogicError("Unsupported input data type %u.", (unsigned int)m_dataType);
     }
 
-protected:
-
     enum class ReaderDataType : unsigned char
     {
         tfloat = 0,
@@ -75,6 +79,7 @@ protected:
         // tbyte = 3, 1 byte per value
     };
 
+protected:
     virtual ~BinaryDataDeserializer() = default;
 
     void ReadName(FileWrapper& file)
@@ -99,6 +104,31 @@ protected:
         file.ReadOrDie(m_sampleDimension);
     }
 
+    template <class T>
+    static T ReadValue(const char*& data, const char* end)
+    {
+        T value;
+        memcpy(&value, Skip(data, end, sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    // Advances the position by 'size' bytes and returns the previous position.
+    static const char* Skip(const char*& data, const char* end, size_t size)
+    {
+        if ((size_t)(end - data) < size)
+            RuntimeError("Unexpected end of chunk data.");
+        const char* result = data;
+        data += size;
+        return result;
+    }
+
+    template <class T>
+    static void Append(std::vector<char>& output, const T& value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        output.insert(output.end(), bytes, bytes + sizeof(T));
+    }
+
     struct DenseInputStreamBuffer : DenseSequenceData
     {
         const void* GetDataBuffer() override
@@ -171,6 +201,19 @@ public:
 
         return offset;
     }
+
+    const char* DecodeChunk(size_t numSequences, const char* data, const char* end, std::vector<char>& output) override
+    {
+        const char* begin = data;
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            uint32_t numSamples = ReadValue<uint32_t>(data, end);
+            Skip(data, end, (size_t)numSamples * m_sampleDimension * SizeOfDataType());
+        }
+
+        output.insert(output.end(), begin, data);
+        return data;
+    }
 };
 
 class SparseBinaryDataDeserializer : public BinaryDataDeserializer
@@ -248,6 +291,127 @@ public:
 
         return offset;
     }
+
+    const char* DecodeChunk(size_t numSequences, const char* data, const char* end, std::vector<char>& output) override
+    {
+        const char* begin = data;
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            uint32_t numSamples = ReadValue<uint32_t>(data, end);
+            uint32_t nnz = ReadValue<uint32_t>(data, end);
+            Skip(data, end, (size_t)nnz * (SizeOfDataType() + sizeof(int32_t)) + (size_t)numSamples * sizeof(int32_t));
+        }
+
+        output.insert(output.end(), begin, data);
+        return data;
+    }
+};
+
+// Sparse stream with compact indices (MatrixEncodingType::compressed_sparse_csc).
+// The format of data is:
+// sequence[numSequences], where each sequence consists of:
+//   uint32_t: numSamples
+//   uint32_t: nnz for the sequence
+//   ElemType[nnz]: the values for the sparse sequences
+//   for each sample: the nnz count as a var-int, followed by the differences of the (increasing) row offsets
+//   of the sample as var-ints, the first one relative to 0.
+// Chunks are decoded into the layout of SparseBinaryDataDeserializer.
+class CompressedSparseBinaryDataDeserializer : public SparseBinaryDataDeserializer
+{
+public:
+    using SparseBinaryDataDeserializer::SparseBinaryDataDeserializer;
+
+    const char* DecodeChunk(size_t numSequences, const char* data, const char* end, std::vector<char>& output) override
+    {
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            uint32_t numSamples = ReadValue<uint32_t>(data, end);
+            uint32_t nnz = ReadValue<uint32_t>(data, end);
+            Append(output, numSamples);
+            Append(output, nnz);
+
+            size_t valuesSize = (size_t)nnz * SizeOfDataType();
+            const char* values = Skip(data, end, valuesSize);
+            output.insert(output.end(), values, values + valuesSize);
+
+            size_t indicesOffset = output.size();
+            size_t countsOffset = indicesOffset + (size_t)nnz * sizeof(int32_t);
+            output.resize(countsOffset + (size_t)numSamples * sizeof(int32_t));
+
+            size_t k = 0;
+            for (size_t j = 0; j < numSamples; j++)
+            {
+                uint32_t count = CBFUtils::ReadVarInt(data, end);
+                if (count > nnz - k)
+                    RuntimeError("The nnz counts of a sequence of stream '%ls' exceed its nnz.", m_name.c_str());
+
+                uint64_t index = 0;
+                for (uint32_t n = 0; n < count; n++, k++)
+                {
+                    index += CBFUtils::ReadVarInt(data, end);
+                    if (index >= m_sampleDimension)
+                        RuntimeError("Index %zu is out of bounds of the dimension %u of stream '%ls'.", (size_t)index, (unsigned int)m_sampleDimension, m_name.c_str());
+                    int32_t value = (int32_t)index;
+                    memcpy(output.data() + indicesOffset + k * sizeof(int32_t), &value, sizeof(int32_t));
+                }
+
+                int32_t value = (int32_t)count;
+                memcpy(output.data() + countsOffset + j * sizeof(int32_t), &value, sizeof(int32_t));
+            }
+
+            if (k != nnz)
+                RuntimeError("The nnz counts of a sequence of stream '%ls' do not add up to its nnz.", m_name.c_str());
+        }
+
+        return data;
+    }
+};
+
+// Dense stream with the values stored in half precision (MatrixEncodingType::dense_fp16).
+// The format of data is:
+// sequence[numSequences], where each sequence consists of:
+//   uint32_t: numSamples
+//   uint16_t[numSamples * sampleDimension]: the values of all samples in IEEE half precision
+// Chunks are decoded into the layout of DenseBinaryDataDeserializer, with values in the element type of the stream.
+class HalfDenseBinaryDataDeserializer : public DenseBinaryDataDeserializer
+{
+public:
+    using DenseBinaryDataDeserializer::DenseBinaryDataDeserializer;
+
+    const char* DecodeChunk(size_t numSequences, const char* data, const char* end, std::vector<char>& output) override
+    {
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            uint32_t numSamples = ReadValue<uint32_t>(data, end);
+            Append(output, numSamples);
+
+            size_t count = (size_t)numSamples * m_sampleDimension;
+            const char* values = Skip(data, end, count * sizeof(uint16_t));
+            size_t offset = output.size();
+            output.resize(offset + count * SizeOfDataType());
+            if (m_dataType == ReaderDataType::tdouble)
+                Convert<double>(values, count, output.data() + offset);
+            else
+                Convert<float>(values, count, output.data() + offset);
+        }
+
+        return data;
+    }
+
+private:
+    template <class ElemType>
+    static void Convert(const char* values, size_t count, char* output)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned short half;
+            float value;
+            memcpy(&half, values + i * sizeof(half), sizeof(half));
+            float16ToFloat(&half, &value);
+            ElemType result = (ElemType)value;
+            memcpy(output + i * sizeof(ElemType), &result, sizeof(ElemType));
+        }
+    }
 };
 
     
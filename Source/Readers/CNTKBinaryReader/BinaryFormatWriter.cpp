@@ -0,0 +1,372 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include "BinaryFormatWriter.h"
+#include "BinaryDataDeserializer.h"
+#include "CBFUtils.h"
+#include "ChunkCompressor.h"
+
+namespace CNTK {
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace {
+
+template <class T>
+void Append(std::vector<char>& buffer, const T& value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <class T>
+void Append(std::vector<char>& buffer, const T* values, size_t count)
+{
+    const char* bytes = reinterpret_cast<const char*>(values);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T) * count);
+}
+
+template <class ElemType>
+void AppendHalf(std::vector<char>& buffer, const ElemType* values, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        float value = (float)values[i];
+        unsigned short half;
+        floatToFloat16(&value, &half);
+        Append(buffer, half);
+    }
+}
+
+}
+
+BinaryFormatWriter::BinaryFormatWriter(DataDeserializerPtr deserializer, const std::map<std::wstring, StorageFormat>& storageFormats, unsigned int traceLevel)
+    : m_deserializer(deserializer), m_compress(false), m_traceLevel(traceLevel)
+{
+    m_streams = m_deserializer->StreamInfos();
+    for (const auto& stream : m_streams)
+    {
+        if (stream.m_elementType != DataType::Float && stream.m_elementType != DataType::Double)
+            RuntimeError("Stream '%ls' has an element type that is not supported by the binary format.", stream.m_name.c_str());
+
+        auto format = storageFormats.find(stream.m_name);
+        m_outputFormats.push_back(format != storageFormats.end() ? format->second : stream.m_storageFormat);
+    }
+
+    for (const auto& format : storageFormats)
+    {
+        if (std::none_of(m_streams.begin(), m_streams.end(), [&](const StreamInformation& s) { return s.m_name == format.first; }))
+            InvalidArgument("Unknown stream '%ls' in the output formats.", format.first.c_str());
+    }
+
+    m_halfPrecision.assign(m_streams.size(), false);
+}
+
+void BinaryFormatWriter::SetHalfPrecision(const std::set<std::wstring>& streams)
+{
+    m_halfPrecision.assign(m_streams.size(), false);
+    for (const auto& name : streams)
+    {
+        auto stream = std::find_if(m_streams.begin(), m_streams.end(), [&](const StreamInformation& s) { return s.m_name == name; });
+        if (stream == m_streams.end())
+            InvalidArgument("Unknown stream '%ls' in the half precision streams.", name.c_str());
+
+        size_t streamId = stream - m_streams.begin();
+        if (m_outputFormats[streamId] != StorageFormat::Dense)
+            InvalidArgument("Stream '%ls' is not dense, only dense streams can be stored in half precision.", name.c_str());
+        m_halfPrecision[streamId] = true;
+    }
+}
+
+MatrixEncodingType BinaryFormatWriter::GetEncoding(size_t streamId) const
+{
+    if (m_outputFormats[streamId] == StorageFormat::Dense)
+        return m_halfPrecision[streamId] ? MatrixEncodingType::dense_fp16 : MatrixEncodingType::dense;
+    return m_compress ? MatrixEncodingType::compressed_sparse_csc : MatrixEncodingType::sparse_csc;
+}
+
+uint32_t BinaryFormatWriter::GetVersion() const
+{
+    uint32_t latestVersion = BinaryChunkDeserializer::s_currentVersion;
+    bool compact = m_compress || std::find(m_halfPrecision.begin(), m_halfPrecision.end(), true) != m_halfPrecision.end();
+    return compact ? latestVersion : 1;
+}
+
+void BinaryFormatWriter::Write(const std::wstring& filename)
+{
+    auto start = std::chrono::system_clock::now();
+
+    auto file = FileWrapper::OpenOrDie(filename, L"wb");
+
+    // The very first 8 bytes of the file is the CBF magic number, then the version.
+    uint64_t magic = CBFUtils::MAGIC_NUMBER;
+    uint32_t version = GetVersion();
+    file.WriteOrDie(magic);
+    file.WriteOrDie(version);
+
+    auto chunkInfos = m_deserializer->ChunkInfos();
+    std::vector<BinaryChunkInfo> chunkTable;
+    chunkTable.reserve(chunkInfos.size());
+
+    std::future<LoadedChunk> next;
+    if (!chunkInfos.empty())
+        next = std::async(std::launch::async, [this, &chunkInfos]() { return LoadChunk(chunkInfos.front().m_id); });
+
+    std::vector<char> buffer;
+    size_t totalSequences = 0, totalSamples = 0;
+    for (size_t i = 0; i < chunkInfos.size(); i++)
+    {
+        LoadedChunk current = next.get();
+        if (i + 1 < chunkInfos.size())
+            next = std::async(std::launch::async, [this, &chunkInfos, i]() { return LoadChunk(chunkInfos[i + 1].m_id); });
+
+        const auto& sequenceInfos = current.sequenceInfos;
+        buffer.clear();
+        EncodeChunk(sequenceInfos, current.sequences, buffer);
+
+        BinaryChunkInfo entry;
+        entry.offset = file.TellOrDie();
+        entry.numSequences = (uint32_t)sequenceInfos.size();
+        entry.numSamples = 0;
+        for (const auto& s : sequenceInfos)
+            entry.numSamples += s.m_numberOfSamples;
+        chunkTable.push_back(entry);
+
+        file.WriteOrDie(buffer.data(), sizeof(char), buffer.size());
+
+        totalSequences += entry.numSequences;
+        totalSamples += entry.numSamples;
+        if (m_traceLevel > 1)
+            fprintf(stderr, "BinaryFormatWriter: chunk %zu of %zu written (%zu bytes).\n", i + 1, chunkInfos.size(), buffer.size());
+    }
+
+    WriteHeader(file, chunkTable);
+    file.FlushOrDie();
+
+    if (m_traceLevel > 0)
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start).count();
+        fprintf(stderr, "BinaryFormatWriter: written %zu chunks, %zu sequences and %zu samples to '%ls' in %.3f seconds.\n",
+                chunkTable.size(), totalSequences, totalSamples, filename.c_str(), elapsed / 1000.0);
+    }
+}
+
+BinaryFormatWriter::LoadedChunk BinaryFormatWriter::LoadChunk(ChunkIdType chunkId)
+{
+    LoadedChunk result;
+    m_deserializer->SequenceInfosForChunk(chunkId, result.sequenceInfos);
+    result.chunk = m_deserializer->GetChunk(chunkId);
+    result.sequences.resize(result.sequenceInfos.size());
+    for (size_t i = 0; i < result.sequenceInfos.size(); i++)
+        result.chunk->GetSequence(result.sequenceInfos[i].m_indexInChunk, result.sequences[i]);
+    return result;
+}
+
+void BinaryFormatWriter::EncodeChunk(const std::vector<SequenceInfo>& sequenceInfos, const std::vector<std::vector<SequenceDataPtr>>& sequences, std::vector<char>& buffer)
+{
+    // The number of samples of each sequence in the chunk.
+    for (const auto& s : sequenceInfos)
+        Append(buffer, (uint32_t)s.m_numberOfSamples);
+
+    size_t dataOffset = buffer.size();
+    for (size_t streamId = 0; streamId < m_streams.size(); streamId++)
+    {
+        bool isDouble = m_streams[streamId].m_elementType == DataType::Double;
+        if (m_outputFormats[streamId] == StorageFormat::Dense)
+        {
+            if (isDouble)
+                EncodeDenseStream<double>(streamId, sequences, buffer);
+            else
+                EncodeDenseStream<float>(streamId, sequences, buffer);
+        }
+        else
+        {
+            if (isDouble)
+                EncodeSparseStream<double>(streamId, sequences, buffer);
+            else
+                EncodeSparseStream<float>(streamId, sequences, buffer);
+        }
+    }
+
+    if (m_compress)
+    {
+        std::vector<char> compressed;
+        ChunkCompressor::Compress(buffer.data() + dataOffset, buffer.size() - dataOffset, compressed);
+        buffer.resize(dataOffset);
+        buffer.insert(buffer.end(), compressed.begin(), compressed.end());
+    }
+}
+
+// The format of a dense stream is (see DenseBinaryDataDeserializer):
+// sequence[numSequences], where each sequence consists of:
+//   uint32_t: numSamples
+//   ElemType[numSamples * sampleDimension]: the values of all samples
+// In half precision the values are stored as uint16_t (see HalfDenseBinaryDataDeserializer).
+template <class ElemType>
+void BinaryFormatWriter::EncodeDenseStream(size_t streamId, const std::vector<std::vector<SequenceDataPtr>>& sequences, std::vector<char>& buffer)
+{
+    size_t dimension = m_streams[streamId].m_sampleLayout.TotalSize();
+    bool isSparseInput = m_streams[streamId].m_storageFormat != StorageFormat::Dense;
+    bool halfPrecision = m_halfPrecision[streamId];
+    std::vector<ElemType> values;
+    for (const auto& sequence : sequences)
+    {
+        const auto& data = sequence[streamId];
+        uint32_t numSamples = data->m_numberOfSamples;
+        Append(buffer, numSamples);
+
+        auto dataBuffer = static_cast<const ElemType*>(data->GetDataBuffer());
+        if (!isSparseInput)
+        {
+            if (halfPrecision)
+                AppendHalf(buffer, dataBuffer, numSamples * dimension);
+            else
+                Append(buffer, dataBuffer, numSamples * dimension);
+            continue;
+        }
+
+        auto sparse = static_cast<SparseSequenceData*>(data.get());
+        values.assign(numSamples * dimension, 0);
+        size_t k = 0;
+        for (size_t j = 0; j < numSamples; j++)
+        {
+            for (SparseIndexType n = 0; n < sparse->m_nnzCounts[j]; n++, k++)
+            {
+                if (sparse->m_indices[k] < 0 || (size_t)sparse->m_indices[k] >= dimension)
+                    RuntimeError("Index %d is out of bounds of the dimension %zu of stream '%ls'.", (int)sparse->m_indices[k], dimension, m_streams[streamId].m_name.c_str());
+                values[j * dimension + sparse->m_indices[k]] = dataBuffer[k];
+            }
+        }
+
+        if (halfPrecision)
+            AppendHalf(buffer, values.data(), values.size());
+        else
+            Append(buffer, values.data(), values.size());
+    }
+}
+
+// The format of a sparse stream is (see SparseBinaryDataDeserializer):
+// sequence[numSequences], where each sequence consists of:
+//   uint32_t: numSamples
+//   uint32_t: nnz for the sequence
+//   ElemType[nnz]: the values for the sparse sequences
+//   int32_t[nnz]: the row offsets for the sparse sequences, increasing within each sample
+//   int32_t[numSamples]: sizes (nnz counts) for each sample in the sequence
+// With compression the indices and the nnz counts are stored as var-ints (see CompressedSparseBinaryDataDeserializer).
+template <class ElemType>
+void BinaryFormatWriter::EncodeSparseStream(size_t streamId, const std::vector<std::vector<SequenceDataPtr>>& sequences, std::vector<char>& buffer)
+{
+    size_t dimension = m_streams[streamId].m_sampleLayout.TotalSize();
+    bool isSparseInput = m_streams[streamId].m_storageFormat != StorageFormat::Dense;
+    std::vector<std::pair<SparseIndexType, ElemType>> entries;
+    std::vector<ElemType> values;
+    std::vector<int32_t> indices;
+    std::vector<int32_t> nnzCounts;
+    for (const auto& sequence : sequences)
+    {
+        const auto& data = sequence[streamId];
+        uint32_t numSamples = data->m_numberOfSamples;
+        auto dataBuffer = static_cast<const ElemType*>(data->GetDataBuffer());
+        auto sparse = isSparseInput ? static_cast<SparseSequenceData*>(data.get()) : nullptr;
+
+        values.clear();
+        indices.clear();
+        nnzCounts.clear();
+        size_t k = 0;
+        for (size_t j = 0; j < numSamples; j++)
+        {
+            entries.clear();
+            if (isSparseInput)
+            {
+                for (SparseIndexType n = 0; n < sparse->m_nnzCounts[j]; n++, k++)
+                    entries.emplace_back(sparse->m_indices[k], dataBuffer[k]);
+            }
+            else
+            {
+                for (size_t r = 0; r < dimension; r++)
+                {
+                    if (dataBuffer[j * dimension + r] != 0)
+                        entries.emplace_back((SparseIndexType)r, dataBuffer[j * dimension + r]);
+                }
+            }
+
+            // The text format does not require the indices of a sample to be ordered.
+            std::stable_sort(entries.begin(), entries.end(), [](const std::pair<SparseIndexType, ElemType>& a, const std::pair<SparseIndexType, ElemType>& b) { return a.first < b.first; });
+            for (const auto& e : entries)
+            {
+                if (e.first < 0 || (size_t)e.first >= dimension)
+                    RuntimeError("Index %d is out of bounds of the dimension %zu of stream '%ls'.", (int)e.first, dimension, m_streams[streamId].m_name.c_str());
+                indices.push_back((int32_t)e.first);
+                values.push_back(e.second);
+            }
+            nnzCounts.push_back((int32_t)entries.size());
+        }
+
+        Append(buffer, numSamples);
+        Append(buffer, (uint32_t)values.size());
+        Append(buffer, values.data(), values.size());
+        if (!m_compress)
+        {
+            Append(buffer, indices.data(), indices.size());
+            Append(buffer, nnzCounts.data(), nnzCounts.size());
+            continue;
+        }
+
+        // Deltas of the increasing indices of each sample are small, typically a single byte.
+        k = 0;
+        for (int32_t count : nnzCounts)
+        {
+            CBFUtils::WriteVarInt(buffer, (uint32_t)count);
+            int32_t previous = 0;
+            for (int32_t n = 0; n < count; n++, k++)
+            {
+                CBFUtils::WriteVarInt(buffer, (uint32_t)(indices[k] - previous));
+                previous = indices[k];
+            }
+        }
+    }
+}
+
+// The header is at the end of the file:
+//   uint64_t: magic number
+//   uint32_t: number of chunks
+//   uint32_t: number of streams
+//   for each stream: encoding (uint8_t), name length (uint32_t), name, element type (uint8_t), sample dimension (uint32_t)
+//   chunk compression (uint8_t), only in version 2
+//   chunk table: offset (int64_t), number of sequences (uint32_t), number of samples (uint32_t) for each chunk
+//   int64_t: offset of the header
+void BinaryFormatWriter::WriteHeader(FileWrapper& file, const std::vector<BinaryChunkInfo>& chunkTable)
+{
+    int64_t headerOffset = file.TellOrDie();
+    uint64_t magic = CBFUtils::MAGIC_NUMBER;
+    file.WriteOrDie(magic);
+    file.WriteOrDie((uint32_t)chunkTable.size());
+    file.WriteOrDie((uint32_t)m_streams.size());
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        const auto& stream = m_streams[i];
+        file.WriteOrDie(GetEncoding(i));
+
+        std::string name = Microsoft::MSR::CNTK::ToLegacyString(Microsoft::MSR::CNTK::ToUTF8(stream.m_name));
+        file.WriteOrDie((uint32_t)name.size());
+        file.WriteOrDie(name.data(), sizeof(char), name.size());
+
+        file.WriteOrDie(stream.m_elementType == DataType::Double ? BinaryDataDeserializer::ReaderDataType::tdouble : BinaryDataDeserializer::ReaderDataType::tfloat);
+        file.WriteOrDie((uint32_t)stream.m_sampleLayout.TotalSize());
+    }
+
+    if (GetVersion() >= 2)
+        file.WriteOrDie(m_compress ? ChunkCompressionType::lz : ChunkCompressionType::none);
+
+    file.WriteOrDie(chunkTable.data(), sizeof(BinaryChunkInfo), chunkTable.size());
+
+    file.WriteOrDie(headerOffset);
+}
+
+}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <map>
+#include <set>
+#include "DataDeserializer.h"
+#include "FileWrapper.h"
+#include "BinaryChunkDeserializer.h"
+#include "CBFUtils.h"
+
+namespace CNTK {
+
+// Writes the data exposed by a deserializer into a CNTK binary format (CBF) file that can be read by the
+// BinaryChunkDeserializer. Every chunk of the deserializer becomes a chunk of the binary file, so the chunk size
+// is controlled by the deserializer (i.e. 'chunkSizeInBytes' of the text format deserializer).
+// The next chunk is loaded on a separate thread while the current one is encoded and written; the text format
+// deserializer in addition parses the sequences of a chunk on several threads (see 'numParsingThreads').
+class BinaryFormatWriter
+{
+public:
+    // 'storageFormats' overrides the encoding of the given streams (by name) in the output,
+    // the other streams keep the storage format they have in the deserializer.
+    BinaryFormatWriter(DataDeserializerPtr deserializer, const std::map<std::wstring, StorageFormat>& storageFormats, unsigned int traceLevel = 0);
+
+    // Compresses the data of each chunk (see ChunkCompressor) and stores the indices of sparse streams as
+    // delta encoded var-ints. The file is written in version 2 of the format.
+    void SetCompression(bool compress) { m_compress = compress; }
+
+    // Stores the values of the given dense streams in half precision, the file is written in version 2 of the format.
+    void SetHalfPrecision(const std::set<std::wstring>& streams);
+
+    // Writes all chunks of the deserializer into the given file.
+    void Write(const std::wstring& filename);
+
+private:
+    // Sequences of a chunk, the chunk is kept alive as its sequences might share its memory.
+    struct LoadedChunk
+    {
+        ChunkPtr chunk;
+        std::vector<SequenceInfo> sequenceInfos;
+        std::vector<std::vector<SequenceDataPtr>> sequences;
+    };
+
+    LoadedChunk LoadChunk(ChunkIdType chunkId);
+
+    // Encodes a chunk: the number of samples of all sequences, followed by the data of all sequences for each stream.
+    // With compression enabled the data of all sequences is compressed, the number of samples stays as is.
+    void EncodeChunk(const std::vector<SequenceInfo>& sequenceInfos, const std::vector<std::vector<SequenceDataPtr>>& sequences, std::vector<char>& buffer);
+
+    template <class ElemType>
+    void EncodeDenseStream(size_t streamId, const std::vector<std::vector<SequenceDataPtr>>& sequences, std::vector<char>& buffer);
+
+    template <class ElemType>
+    void EncodeSparseStream(size_t streamId, const std::vector<std::vector<SequenceDataPtr>>& sequences, std::vector<char>& buffer);
+
+    // Encoding of a stream in the output file.
+    MatrixEncodingType GetEncoding(size_t streamId) const;
+
+    // Version 1 is written whenever possible, so that the file can be read by older readers.
+    uint32_t GetVersion() const;
+
+    void WriteHeader(FileWrapper& file, const std::vector<BinaryChunkInfo>& chunkTable);
+
+    DataDeserializerPtr m_deserializer;
+    std::vector<StreamInformation> m_streams;
+    std::vector<StorageFormat> m_outputFormats;
+    std::vector<bool> m_halfPrecision;
+    bool m_compress;
+    unsigned int m_traceLevel;
+
+    DISABLE_COPY_AND_MOVE(BinaryFormatWriter);
+};
+
+}
@@ -9,10 +9,28 @@
 #define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
 #endif
 
+#include <vector>
+
 class FileWrapper;
 
 namespace CNTK {
 
+// Encoding of an input stream in a CBF file.
+enum class MatrixEncodingType : unsigned char
+{
+    dense = 0,
+    sparse_csc = 1,
+    compressed_sparse_csc = 2, // indices and nnz counts are delta encoded var-ints (version 2)
+    dense_fp16 = 3, // values are stored in half precision (version 2)
+};
+
+// Compression of the stream data of the chunks in a CBF file (version 2), see ChunkCompressor.
+enum class ChunkCompressionType : unsigned char
+{
+    none = 0,
+    lz = 1,
+};
+
 // Implementation of a helper class for reading binary files with FileWrapper class
 class CBFUtils
 {
@@ -46,6 +64,30 @@ public:
         return headerOffset;
     }
 
+    // Unsigned LEB128 encoding of var-ints: 7 bits per byte, the high bit is set on all bytes but the last one.
+    static void WriteVarInt(std::vector<char>& buffer, uint32_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            buffer.push_back((char)(value | 0x80));
+        buffer.push_back((char)value);
+    }
+
+    static uint32_t ReadVarInt(const char*& data, const char* end)
+    {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (data == end)
+                RuntimeError("Unexpected end of chunk data while reading a var-int.");
+            uint8_t byte = (uint8_t)*data++;
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+
+        RuntimeError("Malformed var-int in chunk data.");
+    }
+
 private:
     CBFUtils();
 };
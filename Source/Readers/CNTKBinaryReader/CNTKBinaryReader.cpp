@@ -9,6 +9,7 @@
 #include "BinaryConfigHelper.h"
 #include "BinaryChunkDeserializer.h"
 #include "ChunkCache.h"
+#include "DiskChunkCache.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
 #include "SequencePacker.h"
@@ -30,12 +31,18 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
     try
     {
         m_deserializer = shared_ptr<DataDeserializer>(new BinaryChunkDeserializer(configHelper));
+        if (configHelper.UseMemoryMapping())
+            log << " | memory mapped";
 
         if (configHelper.ShouldKeepDataInMemory())
         {
             m_deserializer = shared_ptr<DataDeserializer>(new ChunkCache(m_deserializer));
             log << " | keeping data in memory";
         }
+        else
+        {
+            m_deserializer = WrapWithDiskChunkCache(m_deserializer, config);
+        }
 
         size_t window = configHelper.GetRandomizationWindow();
         if (window > 0)
@@ -53,7 +60,8 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
                 false, /* multithreadedGetNextSequences */
                  0, /*maxNumberOfInvalidSequences */
                 configHelper.UseSampleBasedRandomizationWindow() /*sampleBasedRandomizationWindow */,
-                GetRandomSeed(config) /*seedOffset*/);
+                GetRandomSeed(config) /*seedOffset*/,
+                GetPrefetchConfiguration(config) /*prefetchConfig*/);
         }
         else
         {
@@ -0,0 +1,246 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <cstring>
+#include <omp.h>
+#include "ChunkCompressor.h"
+#include "ExceptionCapture.h"
+#include "Basics.h"
+
+namespace CNTK {
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace {
+
+// A compressed block is a sequence of commands, each consisting of:
+//   token (uint8_t): number of literals in the high 4 bits, match length - MinMatch in the low 4 bits,
+//                    a value of 15 means that the length continues with bytes of 255 terminated by a byte < 255
+//   the literals
+//   offset of the match (uint16_t, little endian) and the continuation of the match length.
+// The last command of a block has only literals.
+const size_t MinMatch = 4;
+const size_t MaxOffset = 65535;
+const int HashBits = 16;
+
+inline uint32_t Hash(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return (value * 2654435761U) >> (32 - HashBits);
+}
+
+inline void WriteLength(std::vector<char>& output, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        output.push_back((char)255);
+    output.push_back((char)length);
+}
+
+void WriteCommand(std::vector<char>& output, const uint8_t* literals, size_t numLiterals, size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength ? matchLength - MinMatch : 0;
+    output.push_back((char)((std::min<size_t>(numLiterals, 15) << 4) | std::min<size_t>(matchCode, 15)));
+    if (numLiterals >= 15)
+        WriteLength(output, numLiterals - 15);
+    output.insert(output.end(), literals, literals + numLiterals);
+
+    if (!matchLength)
+        return;
+
+    output.push_back((char)(offset & 0xFF));
+    output.push_back((char)(offset >> 8));
+    if (matchCode >= 15)
+        WriteLength(output, matchCode - 15);
+}
+
+// Greedy compression with a single entry hash table of the positions of 4 byte sequences.
+void CompressBlock(const uint8_t* input, size_t size, std::vector<char>& output)
+{
+    std::vector<int32_t> positions((size_t)1 << HashBits, -1);
+    size_t anchor = 0, position = 0;
+    while (position + MinMatch <= size)
+    {
+        uint32_t hash = Hash(input + position);
+        int32_t candidate = positions[hash];
+        positions[hash] = (int32_t)position;
+        if (candidate < 0 || position - candidate > MaxOffset || memcmp(input + candidate, input + position, MinMatch) != 0)
+        {
+            position++;
+            continue;
+        }
+
+        size_t matchLength = MinMatch;
+        while (position + matchLength < size && input[candidate + matchLength] == input[position + matchLength])
+            matchLength++;
+
+        WriteCommand(output, input + anchor, position - anchor, position - candidate, matchLength);
+        position += matchLength;
+        anchor = position;
+    }
+
+    WriteCommand(output, input + anchor, size - anchor, 0, 0);
+}
+
+inline size_t ReadLength(const uint8_t*& input, const uint8_t* end)
+{
+    size_t length = 0;
+    uint8_t value;
+    do
+    {
+        if (input == end)
+            RuntimeError("Compressed chunk data is corrupt: unexpected end of a block.");
+        value = *input++;
+        length += value;
+    } while (value == 255);
+    return length;
+}
+
+void DecompressBlock(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize)
+{
+    const uint8_t* inputEnd = input + inputSize;
+    uint8_t* begin = output;
+    uint8_t* outputEnd = output + outputSize;
+    for (;;)
+    {
+        if (input == inputEnd)
+            RuntimeError("Compressed chunk data is corrupt: unexpected end of a block.");
+
+        uint8_t token = *input++;
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15)
+            numLiterals += ReadLength(input, inputEnd);
+        if (numLiterals > (size_t)(inputEnd - input) || numLiterals > (size_t)(outputEnd - output))
+            RuntimeError("Compressed chunk data is corrupt: literals are out of bounds.");
+
+        memcpy(output, input, numLiterals);
+        input += numLiterals;
+        output += numLiterals;
+        if (input == inputEnd)
+            break;
+
+        if (inputEnd - input < 2)
+            RuntimeError("Compressed chunk data is corrupt: unexpected end of a block.");
+        size_t offset = input[0] | ((size_t)input[1] << 8);
+        input += 2;
+
+        size_t matchLength = (token & 15) + MinMatch;
+        if ((token & 15) == 15)
+            matchLength += ReadLength(input, inputEnd);
+        if (offset == 0 || offset > (size_t)(output - begin) || matchLength > (size_t)(outputEnd - output))
+            RuntimeError("Compressed chunk data is corrupt: match is out of bounds.");
+
+        // The source and the destination of the match overlap when the offset is smaller than the length.
+        const uint8_t* match = output - offset;
+        for (size_t i = 0; i < matchLength; i++)
+            output[i] = match[i];
+        output += matchLength;
+    }
+
+    if (output != outputEnd)
+        RuntimeError("Compressed chunk data is corrupt: the size of a block does not match.");
+}
+
+struct BlockInfo
+{
+    uint32_t uncompressedSize;
+    uint32_t compressedSize;
+};
+
+}
+
+void ChunkCompressor::Compress(const char* data, size_t size, std::vector<char>& output, size_t blockSize)
+{
+    if (blockSize == 0 || blockSize > UINT32_MAX)
+        InvalidArgument("Invalid compression block size %zu.", blockSize);
+
+    size_t numBlocks = (size + blockSize - 1) / blockSize;
+    if (numBlocks > UINT32_MAX)
+        RuntimeError("Chunk of %zu bytes is too large to be compressed.", size);
+
+    std::vector<std::vector<char>> blocks(numBlocks);
+    ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t i = 0; i < (int64_t)numBlocks; i++)
+    {
+        capture.SafeRun([&](int64_t block)
+        {
+            size_t offset = block * blockSize;
+            size_t length = std::min(blockSize, size - offset);
+            auto& compressed = blocks[block];
+            compressed.reserve(length);
+            CompressBlock(reinterpret_cast<const uint8_t*>(data) + offset, length, compressed);
+
+            // Incompressible data is stored as is.
+            if (compressed.size() >= length)
+                compressed.assign(data + offset, data + offset + length);
+        }, i);
+    }
+    capture.RethrowIfHappened();
+
+    uint32_t count = (uint32_t)numBlocks;
+    const char* bytes = reinterpret_cast<const char*>(&count);
+    output.insert(output.end(), bytes, bytes + sizeof(count));
+    for (size_t i = 0; i < numBlocks; i++)
+    {
+        BlockInfo info = { (uint32_t)std::min(blockSize, size - i * blockSize), (uint32_t)blocks[i].size() };
+        bytes = reinterpret_cast<const char*>(&info);
+        output.insert(output.end(), bytes, bytes + sizeof(info));
+    }
+
+    for (const auto& block : blocks)
+        output.insert(output.end(), block.begin(), block.end());
+}
+
+void ChunkCompressor::Decompress(const char* data, size_t size, std::vector<char>& output)
+{
+    uint32_t numBlocks;
+    if (size < sizeof(numBlocks))
+        RuntimeError("Compressed chunk data is corrupt: missing block table.");
+    memcpy(&numBlocks, data, sizeof(numBlocks));
+
+    size_t tableSize = sizeof(numBlocks) + (size_t)numBlocks * sizeof(BlockInfo);
+    if (tableSize > size)
+        RuntimeError("Compressed chunk data is corrupt: block table is out of bounds.");
+
+    std::vector<BlockInfo> blocks(numBlocks);
+    memcpy(blocks.data(), data + sizeof(numBlocks), numBlocks * sizeof(BlockInfo));
+
+    // Offsets of the blocks in the input and the output.
+    std::vector<size_t> inputOffsets(numBlocks), outputOffsets(numBlocks);
+    size_t inputOffset = tableSize, outputOffset = 0;
+    for (size_t i = 0; i < numBlocks; i++)
+    {
+        inputOffsets[i] = inputOffset;
+        outputOffsets[i] = outputOffset;
+        inputOffset += blocks[i].compressedSize;
+        outputOffset += blocks[i].uncompressedSize;
+    }
+
+    if (inputOffset > size)
+        RuntimeError("Compressed chunk data is corrupt: blocks are out of bounds.");
+
+    output.resize(outputOffset);
+    ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t i = 0; i < (int64_t)numBlocks; i++)
+    {
+        capture.SafeRun([&](int64_t block)
+        {
+            const auto& info = blocks[block];
+            const char* input = data + inputOffsets[block];
+            char* destination = output.data() + outputOffsets[block];
+            if (info.compressedSize == info.uncompressedSize)
+                memcpy(destination, input, info.uncompressedSize);
+            else
+                DecompressBlock(reinterpret_cast<const uint8_t*>(input), info.compressedSize,
+                                reinterpret_cast<uint8_t*>(destination), info.uncompressedSize);
+        }, i);
+    }
+    capture.RethrowIfHappened();
+}
+
+}
@@ -0,0 +1,41 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CNTK {
+
+// Compression of the stream data of CBF chunks.
+// The data is split into blocks that are compressed independently with a byte-oriented LZ77 codec
+// (in the spirit of the LZ4 block format), so that a chunk is compressed and decompressed on several threads.
+// Decompression is a plain copy loop and is much cheaper than reading the uncompressed bytes
+// from a network attached storage.
+//
+// The layout of the compressed data is:
+//   uint32_t: number of blocks
+//   for each block: uncompressed size (uint32_t), compressed size (uint32_t)
+//   the compressed blocks; a block whose compressed size equals its uncompressed size is stored as is.
+class ChunkCompressor
+{
+public:
+    // Default size of the uncompressed blocks.
+    static const size_t s_defaultBlockSize = 1024 * 1024;
+
+    // Compresses 'size' bytes and appends the result to 'output'.
+    static void Compress(const char* data, size_t size, std::vector<char>& output, size_t blockSize = s_defaultBlockSize);
+
+    // Decompresses the data produced by Compress into 'output', reading at most 'size' bytes.
+    // Throws if the data is corrupt.
+    static void Decompress(const char* data, size_t size, std::vector<char>& output);
+
+private:
+    ChunkCompressor();
+};
+
+}
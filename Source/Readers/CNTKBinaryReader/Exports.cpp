@@ -13,6 +13,8 @@
 #include "V2Dependencies.h"
 #include "BinaryChunkDeserializer.h"
 #include "CorpusDescriptor.h"
+#include "BinaryFormatWriter.h"
+#include "StringUtil.h"
 
 namespace CNTK {
 
@@ -55,4 +57,50 @@ extern "C" DATAREADER_API bool CreateDeserializer(DataDeserializerPtr& deseriali
     return true;
 }
 
+// Converts the input described by a text format deserializer configuration into a CNTK binary format file.
+// Besides the options of the text format deserializer (i.e. 'chunkSizeInBytes' and 'numParsingThreads'
+// that control the chunking and the parsing), the configuration contains:
+//   outputFile   - the binary file to write
+//   outputFormat - for each stream in the 'input' section, the encoding in the output ('dense' or 'sparse'),
+//                  by default the format of the text input is kept
+extern "C" DATAREADER_API void ConvertToBinaryFormat(const ConfigParameters& config)
+{
+    typedef bool(*CreateDeserializerFactory) (DataDeserializerPtr& d, const std::wstring& type, const ConfigParameters& cfg, CorpusDescriptorPtr corpus, bool primary);
+
+    Plugin plugin;
+    CreateDeserializerFactory f = (CreateDeserializerFactory)plugin.Load(L"CNTKTextFormatReader", "CreateDeserializer");
+
+    DataDeserializerPtr deserializer;
+    if (!f(deserializer, L"CNTKTextFormatDeserializer", config, std::make_shared<CorpusDescriptor>(true), true))
+        RuntimeError("Cannot create the text format deserializer.");
+
+    std::map<std::wstring, StorageFormat> storageFormats;
+    std::set<std::wstring> halfPrecisionStreams;
+    const ConfigParameters& input = config(L"input");
+    for (const pair<string, ConfigParameters>& section : input)
+    {
+        ConfigParameters streamConfig = section.second;
+        wstring name = Microsoft::MSR::CNTK::ToFixedWStringFromMultiByte(section.first);
+        if (streamConfig(L"halfPrecision", false))
+            halfPrecisionStreams.insert(name);
+
+        if (!streamConfig.ExistsCurrent(L"outputFormat"))
+            continue;
+
+        string format = streamConfig(L"outputFormat");
+        if (AreEqualIgnoreCase(format, "dense"))
+            storageFormats[name] = StorageFormat::Dense;
+        else if (AreEqualIgnoreCase(format, "sparse"))
+            storageFormats[name] = StorageFormat::SparseCSC;
+        else
+            InvalidArgument("Unknown output format '%s' of stream '%ls', expected 'dense' or 'sparse'.", format.c_str(), name.c_str());
+    }
+
+    wstring outputFile = config(L"outputFile");
+    BinaryFormatWriter writer(deserializer, storageFormats, config(L"traceLevel", 1));
+    writer.SetCompression(config(L"compressChunks", false));
+    writer.SetHalfPrecision(halfPrecisionStreams);
+    writer.Write(outputFile);
+}
+
 }
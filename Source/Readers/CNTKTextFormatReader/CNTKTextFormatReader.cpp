@@ -8,6 +8,7 @@
 #include "Config.h"
 #include "TextConfigHelper.h"
 #include "ChunkCache.h"
+#include "DiskChunkCache.h"
 #include "BlockRandomizer.h"
 #include "NoRandomizer.h"
 #include "TextParser.h"
@@ -36,6 +37,8 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
 
         if (configHelper.ShouldKeepDataInMemory())
             m_deserializer = make_shared<ChunkCache>(m_deserializer);
+        else
+            m_deserializer = WrapWithDiskChunkCache(m_deserializer, config);
 
         size_t window = configHelper.GetRandomizationWindow();
         if (window > 0)
@@ -47,7 +50,8 @@ CNTKTextFormatReader::CNTKTextFormatReader(const ConfigParameters& config)
                                                                 /*multithreadedGetNextSequences =*/ false,
                                                                 /*maxNumberOfInvalidSequences =*/ 0,
                                                                 /*sampleBasedRandomizationWindow =*/ configHelper.UseSampleBasedRandomizationWindow(),
-                                                                /*seedOffset =*/ GetRandomSeed(config));
+                                                                /*seedOffset =*/ GetRandomSeed(config),
+                                                                /*prefetchConfig =*/ GetPrefetchConfiguration(config));
         }
         else
         {
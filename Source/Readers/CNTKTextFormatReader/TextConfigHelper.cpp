@@ -7,6 +7,8 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <limits>
+#include <algorithm>
+#include <omp.h>
 #include "TextConfigHelper.h"
 #include "DataReader.h"
 #include "StringUtil.h"
@@ -128,6 +130,17 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_keepDataInMemory = config(L"keepDataInMemory", false);
     m_frameMode = config(L"frameMode", false);
     m_cacheIndex = config(L"cacheIndex", false);
+    m_numParsingThreads = config(L"numParsingThreads", (size_t)0);
+
+    // Chunks may be loaded on several threads at the same time (see 'prefetchThreads' of the reader), each of which
+    // parses its chunk on numParsingThreads threads. By default the OpenMP threads are split among the loading threads,
+    // instead of every one of them starting a full OpenMP team.
+    size_t numPrefetchThreads = config(L"prefetchThreads", (size_t)1);
+    if (m_numParsingThreads == 0 && numPrefetchThreads > 1)
+        m_numParsingThreads = std::max<size_t>(1, omp_get_max_threads() / numPrefetchThreads);
+
+    m_numIndexingThreads = config(L"numIndexingThreads", (size_t)0);
+    m_cacheIndexAsync = config(L"cacheIndexAsync", true);
 
     m_randomizationWindow = GetRandomizationWindowFromConfig(config);
     m_sampleBasedRandomizationWindow = config(L"sampleBasedRandomizationWindow", false);
@@ -39,6 +39,12 @@ public:
 
     size_t GetChunkSize() const { return m_chunkSizeBytes; }
 
+    size_t GetNumParsingThreads() const { return m_numParsingThreads; }
+
+    size_t GetNumIndexingThreads() const { return m_numIndexingThreads; }
+
+    bool ShouldCacheIndexAsync() const { return m_cacheIndexAsync; }
+
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
     bool IsInFrameMode() const { return m_frameMode; }
@@ -63,6 +69,11 @@ private:
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
     bool m_cacheIndex; // When true, the index will be loaded from a cache file it if exists.
                        // If cache does not exist, the index, once created, will be written out to a file.
+    size_t m_numParsingThreads; // number of threads used to parse a chunk (0 = number of OpenMP threads,
+                                // divided by 'prefetchThreads' if chunks are loaded concurrently).
+    size_t m_numIndexingThreads; // number of threads used to index the input (0 = number of hardware threads).
+    bool m_cacheIndexAsync; // When false, the index cache is written out before the reader starts (e.g., when
+                            // the cache is built ahead of time by the 'buildIndex' command).
 };
 
 }
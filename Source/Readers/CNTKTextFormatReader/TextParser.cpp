@@ -7,10 +7,12 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
-#include "BufferedFileReader.h"
+#include <cstdarg>
+#include <omp.h>
 #include "IndexBuilder.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
+#include "ExceptionCapture.h"
 #include "File.h"
 
 #define isSign(c) ((c == '-' || c == '+'))
@@ -25,6 +27,81 @@ inline bool IsDigit(char c)
     return '0' <= c && c <= '9';
 }
 
+// Parses a plain decimal number ([+-]digits[.digits][(e|E)[+-]digits]) in the range [position, end).
+// The number must be followed by at least one more character in the range, have at most 19 digits 
+// and a decimal exponent that is small enough for the value to be computed with a single rounding 
+// (mantissa and the power of ten are both exact doubles). Returns the position following the number,
+// or nullptr if the input is not of this form, in which case it should be handled by the general parser.
+static const char* TryParseDecimal(const char* position, const char* end, double& value)
+{
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const int maxExponent = 22;
+    const uint64_t maxExactMantissa = 1ULL << 53;
+
+    const char* p = position;
+    bool negative = false;
+    if (p < end && isSign(*p))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int numDigits = 0, exponent = 0;
+    for (; p < end && IsDigit(*p); ++p, ++numDigits)
+        mantissa = mantissa * 10 + (*p - '0');
+
+    if (numDigits == 0)
+        return nullptr;
+
+    if (p < end && *p == '.')
+    {
+        ++p;
+        // A period that is not followed by a digit is left to the general parser.
+        if (p == end || !IsDigit(*p))
+            return nullptr;
+
+        for (; p < end && IsDigit(*p); ++p, ++numDigits, --exponent)
+            mantissa = mantissa * 10 + (*p - '0');
+    }
+
+    if (numDigits > 19) // the mantissa might have overflown
+        return nullptr;
+
+    if (p < end && isE(*p))
+    {
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && isSign(*p))
+        {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+
+        if (p == end || !IsDigit(*p))
+            return nullptr;
+
+        int explicitExponent = 0;
+        for (; p < end && IsDigit(*p); ++p)
+        {
+            if (explicitExponent <= maxExponent + 19)
+                explicitExponent = explicitExponent * 10 + (*p - '0');
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    if (p == end || mantissa > maxExactMantissa || exponent < -maxExponent || exponent > maxExponent)
+        return nullptr;
+
+    double result = static_cast<double>(mantissa);
+    result = (exponent < 0) ? result / powersOf10[-exponent] : result * powersOf10[exponent];
+    value = negative ? -result : result;
+    return p;
+}
+
 enum State
 {
     Init = 0,
@@ -61,6 +138,104 @@ struct TextParser<ElemType>::StreamInfo
     NDShape m_sampleShape;
 };
 
+// Parsing state of a single thread: the position in the in-memory chunk data and a scratch buffer
+// for input names. When a chunk is parsed by several threads, the messages are collected per sequence
+// and printed in the order of sequences once the whole chunk has been parsed.
+template <class ElemType>
+class TextParser<ElemType>::ParsingContext
+{
+public:
+    explicit ParsingContext(size_t maxAliasLength) :
+        m_scratch(new char[maxAliasLength + 1]),
+        m_begin(nullptr),
+        m_position(nullptr),
+        m_end(nullptr),
+        m_fileOffset(0),
+        m_log(nullptr)
+    {
+    }
+
+    // Positions the context inside the chunk data [begin, end), which starts at fileOffset in the input file.
+    // If log is not null, messages are appended to it instead of being printed.
+    void Reset(const char* begin, const char* end, const char* position, size_t fileOffset, std::string* log)
+    {
+        m_begin = begin;
+        m_end = end;
+        m_position = position;
+        m_fileOffset = fileOffset;
+        m_log = log;
+    }
+
+    // Returns the character at the current position.
+    inline char Peek() const
+    {
+        if (m_position == m_end)
+            RuntimeError("Buffer is empty.");
+
+        return *m_position;
+    }
+
+    // Advances the current position to the next character.
+    inline void Pop()
+    {
+        if (m_position != m_end)
+            ++m_position;
+    }
+
+    // Advances the current position by the given number of characters.
+    inline void Skip(size_t count)
+    {
+        assert(count <= Remaining());
+        m_position += count;
+    }
+
+    inline const char* Position() const { return m_position; }
+
+    inline size_t Remaining() const { return m_end - m_position; }
+
+    // Returns true if the end of the chunk data has been reached.
+    inline bool Empty() const { return m_position == m_end; }
+
+    // File offset that corresponds to the current position.
+    inline size_t GetFileOffset() const { return m_fileOffset + (m_position - m_begin); }
+
+    void Log(const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        if (m_log == nullptr)
+        {
+            vfprintf(stderr, format, args);
+        }
+        else
+        {
+            va_list argsCopy;
+            va_copy(argsCopy, args);
+            int size = vsnprintf(nullptr, 0, format, argsCopy);
+            va_end(argsCopy);
+            if (size > 0)
+            {
+                size_t offset = m_log->size();
+                m_log->resize(offset + size + 1);
+                vsnprintf(&(*m_log)[offset], size + 1, format, args);
+                m_log->resize(offset + size);
+            }
+        }
+        va_end(args);
+    }
+
+    unique_ptr<char[]> m_scratch; // local buffer for string parsing
+
+private:
+    const char* m_begin;
+    const char* m_position;
+    const char* m_end;
+    size_t m_fileOffset;
+    std::string* m_log;
+
+    DISABLE_COPY_AND_MOVE(ParsingContext);
+};
+
 template <class ElemType>
 TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const TextConfigHelper& helper, bool primary) :
 TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), primary)
@@ -72,6 +247,12 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), primary)
 
     SetCacheIndex(helper.ShouldCacheIndex());
 
+    SetNumParsingThreads(helper.GetNumParsingThreads());
+
+    SetNumIndexingThreads(helper.GetNumIndexingThreads());
+
+    SetCacheIndexAsync(helper.ShouldCacheIndexAsync());
+
     Initialize();
 }
 
@@ -82,7 +263,6 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_streamDescriptors(streams),
     m_filename(filename),
     m_file(nullptr),
-    m_fileReader(nullptr),
     m_streamInfos(streams.size()),
     m_index(nullptr),
     m_chunkSizeBytes(0),
@@ -91,6 +271,9 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
     m_numRetries(5),
+    m_numParsingThreads(0),
+    m_numIndexingThreads(0),
+    m_cacheIndexAsync(true),
     m_corpus(corpus),
     m_useMaximumAsSequenceLength(true),
     m_cacheIndex(false)
@@ -140,8 +323,6 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     }
 
     assert(m_maxAliasLength > 0);
-
-    m_scratch = unique_ptr<char[]>(new char[m_maxAliasLength + 1]);
 }
 
 template <class ElemType>
@@ -187,7 +368,9 @@ void TextParser<ElemType>::Initialize()
             .SetCorpus(m_corpus)
             .SetPrimary(m_primary)
             .SetChunkSize(m_chunkSizeBytes)
-            .SetCachingEnabled(m_cacheIndex);
+            .SetCachingEnabled(m_cacheIndex)
+            .SetAsyncCacheWrite(m_cacheIndexAsync)
+            .SetNumThreads(m_numIndexingThreads);
 
         if (!m_useMaximumAsSequenceLength)
         {
@@ -197,8 +380,6 @@ void TextParser<ElemType>::Initialize()
         }
 
         m_index = builder.Build();
-
-        m_fileReader = std::make_shared<BufferedFileReader>(BUFFER_SIZE, *m_file);
     });
 
     assert(m_index != nullptr);
@@ -266,12 +447,6 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 
     attempt(m_numRetries, [this, &textChunk, &chunkDescriptor]()
     {
-        if (m_file->CheckError())
-        {
-            m_file.reset(new FileWrapper(m_filename, L"rbS"));
-            m_file->CheckIsOpenOrDie();
-        }
-
         LoadChunk(textChunk, chunkDescriptor);
     });
 
@@ -281,34 +456,92 @@ ChunkPtr TextParser<ElemType>::GetChunk(ChunkIdType chunkId)
 template <class ElemType>
 void TextParser<ElemType>::LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor)
 {
-    chunk->m_sequenceMap.resize(descriptor.NumberOfSequences());
-    for (size_t sequenceIndex = 0; sequenceIndex < descriptor.NumberOfSequences(); ++sequenceIndex)
+    // Read the whole chunk into memory, the sequence boundaries are known from the index,
+    // so that the sequences can then be parsed independently of each other.
+    size_t sizeInBytes = descriptor.SizeInBytes();
+    std::vector<char> buffer(sizeInBytes);
+    {
+        std::lock_guard<std::mutex> lock(m_fileLock);
+        if (m_file->CheckError())
+        {
+            m_file.reset(new FileWrapper(m_filename, L"rbS"));
+            m_file->CheckIsOpenOrDie();
+        }
+
+        if (sizeInBytes > 0)
+        {
+            m_file->SeekOrDie(descriptor.StartOffset(), SEEK_SET);
+            m_file->ReadOrDie(buffer.data(), sizeInBytes, 1);
+        }
+    }
+
+    const char* begin = buffer.data();
+    const char* end = begin + sizeInBytes;
+    size_t numberOfSequences = descriptor.NumberOfSequences();
+    chunk->m_sequenceMap.resize(numberOfSequences);
+
+    int numThreads = (m_numParsingThreads > 0) ? (int)m_numParsingThreads : omp_get_max_threads();
+    numThreads = (int)std::min<size_t>((size_t)numThreads, numberOfSequences);
+
+    if (numThreads <= 1)
+    {
+        ParsingContext context(m_maxAliasLength);
+        for (size_t sequenceIndex = 0; sequenceIndex < numberOfSequences; ++sequenceIndex)
+        {
+            const auto& sequenceDescriptor = descriptor.Sequences()[sequenceIndex];
+            context.Reset(begin, end, begin + sequenceDescriptor.OffsetInChunk(), descriptor.StartOffset(), nullptr);
+            chunk->m_sequenceMap[sequenceIndex] = LoadSequence(context, sequenceDescriptor);
+        }
+        return;
+    }
+
+    std::vector<std::unique_ptr<ParsingContext>> contexts(numThreads);
+    for (auto& context : contexts)
+        context.reset(new ParsingContext(m_maxAliasLength));
+
+    std::vector<std::string> logs(numberOfSequences);
+    ExceptionCapture exceptionCapture;
+
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    for (int sequenceIndex = 0; sequenceIndex < (int)numberOfSequences; ++sequenceIndex)
     {
-        const auto& sequenceDescriptor = descriptor.Sequences()[sequenceIndex];
-        chunk->m_sequenceMap[sequenceIndex] = LoadSequence(sequenceDescriptor, descriptor.StartOffset());
+        exceptionCapture.SafeRun([&](int i)
+        {
+            const auto& sequenceDescriptor = descriptor.Sequences()[i];
+            auto& context = *contexts[omp_get_thread_num()];
+            context.Reset(begin, end, begin + sequenceDescriptor.OffsetInChunk(), descriptor.StartOffset(), &logs[i]);
+            chunk->m_sequenceMap[i] = LoadSequence(context, sequenceDescriptor);
+        }, sequenceIndex);
     }
+
+    for (const auto& log : logs)
+    {
+        if (!log.empty())
+            fputs(log.c_str(), stderr);
+    }
+
+    exceptionCapture.RethrowIfHappened();
 }
 
 template <class ElemType>
 void TextParser<ElemType>::IncrementNumberOfErrorsOrDie()
 {
-    if (m_numAllowedErrors == 0)
+    unsigned int numAllowedErrors = m_numAllowedErrors;
+    do
     {
-        PrintWarningNotification();
-        RuntimeError("Reached the maximum number of allowed errors"
-            " while reading the input file (%ls).",
-            m_filename.c_str());
-    }
-    --m_numAllowedErrors;
+        if (numAllowedErrors == 0)
+        {
+            PrintWarningNotification();
+            RuntimeError("Reached the maximum number of allowed errors"
+                " while reading the input file (%ls).",
+                m_filename.c_str());
+        }
+    } while (!m_numAllowedErrors.compare_exchange_weak(numAllowedErrors, numAllowedErrors - 1));
 }
 
 template <class ElemType>
-typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(const SequenceDescriptor& sequenceDsc, size_t chunkOffsetInFile)
+typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence(ParsingContext& context, const SequenceDescriptor& sequenceDsc)
 {
-    size_t fileOffset = sequenceDsc.OffsetInChunk() + chunkOffsetInFile;
-
-    m_fileReader->SetFileOffset(fileOffset);
-
     size_t bytesToRead = sequenceDsc.SizeInBytes();
 
     SequenceBuffer sequence;
@@ -331,7 +564,7 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     size_t rowNumber = 1;
     while(bytesToRead)
     {
-        if ((TryReadRow(sequence, bytesToRead)))
+        if ((TryReadRow(context, sequence, bytesToRead)))
         {
             ++numRowsRead;
         }
@@ -339,12 +572,12 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
         {
             if (ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Could not read a row (# %" PRIu64 ")"
                     " while loading sequence (id = %" PRIu64 ") %ls.\n",
                     rowNumber,
                     sequenceDsc.m_key,
-                    GetFileInfo().c_str());
+                    GetFileInfo(context).c_str());
             }
             IncrementNumberOfErrorsOrDie();
         }
@@ -353,12 +586,12 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
 
     if (ShouldWarn() && numRowsRead < expectedRowCount)
     {
-        fprintf(stderr,
+        context.Log(
             "WARNING: Exhausted all input"
             " expected for the current sequence (id = %" PRIu64 ") %ls,"
             " but only read %" PRIu64 " out of %" PRIu64 " expected rows.\n",
             sequenceDsc.m_key,
-            GetFileInfo().c_str(), numRowsRead, expectedRowCount);
+            GetFileInfo(context).c_str(), numRowsRead, expectedRowCount);
 
     }
 
@@ -370,9 +603,9 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     {
         if (sequence[i]->m_numberOfSamples == 0)
         {
-            fprintf(stderr,
+            context.Log(
                 "ERROR: Input ('%ls') is empty in sequence (id = %" PRIu64 ") %ls.\n",
-                m_streams[i].m_name.c_str(), sequenceDsc.m_key, GetFileInfo().c_str());
+                m_streams[i].m_name.c_str(), sequenceDsc.m_key, GetFileInfo(context).c_str());
             hasEmptyInputs = true;
         }
 
@@ -388,11 +621,11 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
             hasDuplicateInputs = true;
             if (ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Input ('%ls') contains more samples than expected"
                     " (%u vs. %" PRIu64 ") for sequence (id = %" PRIu64 ") %ls.\n",
                     m_streams[i].m_name.c_str(), sequence[i]->m_numberOfSamples,
-                    expectedRowCount, sequenceDsc.m_key, GetFileInfo().c_str());
+                    expectedRowCount, sequenceDsc.m_key, GetFileInfo(context).c_str());
             }
         }
         
@@ -412,21 +645,21 @@ typename TextParser<ElemType>::SequenceBuffer TextParser<ElemType>::LoadSequence
     {
         if (ShouldWarn())
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Number of samples for sequence (id = %" PRIu64 ") %ls"
                 " is less than expected (%u vs. %" PRIu64 ").\n",
                 sequenceDsc.m_key,
-                GetFileInfo().c_str(), overallSequenceLength, expectedRowCount);
+                GetFileInfo(context).c_str(), overallSequenceLength, expectedRowCount);
         }
         IncrementNumberOfErrorsOrDie();
     }
 
     if (m_traceLevel >= Info)
     {
-        fprintf(stderr,
+        context.Log(
             "INFO: Finished loading sequence (id = %" PRIu64 ") %ls,"
             " successfully read %" PRIu64 " out of expected %" PRIu64 " rows.\n",
-            sequenceDsc.m_key, GetFileInfo().c_str(), numRowsRead, expectedRowCount);
+            sequenceDsc.m_key, GetFileInfo(context).c_str(), numRowsRead, expectedRowCount);
     }
 
     FillSequenceMetadata(sequence, { sequenceDsc.m_key, 0 });
@@ -452,38 +685,38 @@ void TextParser<ElemType>::FillSequenceMetadata(SequenceBuffer& sequenceData, co
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadRow(ParsingContext& context, SequenceBuffer& sequence, size_t& bytesToRead)
 {
-    while (bytesToRead && CanRead() && IsDigit(m_fileReader->Peek()))
+    while (bytesToRead && !context.Empty() && IsDigit(context.Peek()))
     {
         // skip sequence ids
-        m_fileReader->Pop();
+        context.Pop();
         --bytesToRead;
     }
 
     size_t numSampleRead = 0;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && !context.Empty())
     {
-        char c = m_fileReader->Peek();
+        char c = context.Peek();
 
         if (c == ROW_DELIMITER)
         {
             // found the end of row, skip the delimiter, return.
-            m_fileReader->Pop();
+            context.Pop();
             --bytesToRead;
 
             if (numSampleRead == 0 && ShouldWarn())
             {
-                fprintf(stderr,
-                    "WARNING: Empty input row %ls.\n", GetFileInfo().c_str());
+                context.Log(
+                    "WARNING: Empty input row %ls.\n", GetFileInfo(context).c_str());
             }
             else if (numSampleRead > m_streams.size() && ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Input row %ls contains more"
                     " samples than expected (%" PRIu64 " vs. %" PRIu64 ").\n",
-                    GetFileInfo().c_str(), numSampleRead, m_streams.size());
+                    GetFileInfo(context).c_str(), numSampleRead, m_streams.size());
             }
 
             return numSampleRead > 0;
@@ -492,28 +725,28 @@ bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToR
         if (isColumnDelimiter(c))
         {
             // skip column (input) delimiters.
-            m_fileReader->Pop();
+            context.Pop();
             --bytesToRead;
             continue;
         }
 
-        if (TryReadSample(sequence, bytesToRead))
+        if (TryReadSample(context, sequence, bytesToRead))
         {
             numSampleRead++;
         }
         else
         {
             // skip over until the next sample/end of row
-            SkipToNextInput(bytesToRead);
+            SkipToNextInput(context, bytesToRead);
         }
     }
 
     if (ShouldWarn())
     {
-        fprintf(stderr,
+        context.Log(
             "WARNING: Exhausted all input expected for the current sequence"
             " while reading an input row %ls."
-            " Possibly, a trailing newline is missing.\n", GetFileInfo().c_str());
+            " Possibly, a trailing newline is missing.\n", GetFileInfo(context).c_str());
     }
 
     // Return true when we've consumed all expected input.
@@ -522,38 +755,38 @@ bool TextParser<ElemType>::TryReadRow(SequenceBuffer& sequence, size_t& bytesToR
 
 // Reads one sample (an pipe-prefixed input identifier followed by a list of values)
 template <class ElemType>
-bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadSample(ParsingContext& context, SequenceBuffer& sequence, size_t& bytesToRead)
 {
     // prefix check.
-    if (m_fileReader->Peek() != NAME_PREFIX)
+    if (context.Peek() != NAME_PREFIX)
     {
         if (ShouldWarn())
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Unexpected character('%c') in place of a name prefix ('%c')"
                 " in an input name %ls.\n",
-                m_fileReader->Peek(), NAME_PREFIX, GetFileInfo().c_str());
+                context.Peek(), NAME_PREFIX, GetFileInfo(context).c_str());
         }
         IncrementNumberOfErrorsOrDie();
         return false;
     }
 
     // skip name prefix
-    m_fileReader->Pop();
+    context.Pop();
     --bytesToRead;
 
-    if (bytesToRead && CanRead() && m_fileReader->Peek() == ESCAPE_SYMBOL)
+    if (bytesToRead && !context.Empty() && context.Peek() == ESCAPE_SYMBOL)
     {
         // A vertical bar followed by the number sign (|#) is treated as an escape sequence, 
         // everything that follows is ignored until the next vertical bar or the end of 
         // row, whichever comes first.
-        m_fileReader->Pop();
+        context.Pop();
         --bytesToRead;
         return false;
     }
 
     size_t id;
-    if (!TryGetInputId(id, bytesToRead))
+    if (!TryGetInputId(context, id, bytesToRead))
     {
         return false;
     }
@@ -566,7 +799,7 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
         vector<ElemType>& values = data->m_buffer;
         size_t size = values.size();
         assert(size % stream.m_sampleShape.Dimensions()[0] == 0);
-        if (!TryReadDenseSample(values, stream.m_sampleShape.Dimensions()[0], bytesToRead))
+        if (!TryReadDenseSample(context, values, stream.m_sampleShape.Dimensions()[0], bytesToRead))
         {
             // expected a dense sample, but was not able to fully read it, ignore it.
             if (values.size() != size)
@@ -587,7 +820,7 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
         vector<SparseIndexType>& indices = data->m_indicesBuffer;
         assert(values.size() == indices.size());
         size_t size = values.size();
-        if (!TryReadSparseSample(values, indices, stream.m_sampleShape.Dimensions()[0], bytesToRead))
+        if (!TryReadSparseSample(context, values, indices, stream.m_sampleShape.Dimensions()[0], bytesToRead))
         {
             // expected a sparse sample, but something went south, ignore it.
             if (values.size() != size)
@@ -615,22 +848,22 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
+bool TextParser<ElemType>::TryGetInputId(ParsingContext& context, size_t& id, size_t& bytesToRead)
 {
-    char* scratchIndex = m_scratch.get();
+    char* scratchIndex = context.m_scratch.get();
 
-    for (; bytesToRead && CanRead(); m_fileReader->Pop(), --bytesToRead)
+    for (; bytesToRead && !context.Empty(); context.Pop(), --bytesToRead)
     {
-        unsigned char c = m_fileReader->Peek();
+        unsigned char c = context.Peek();
 
         // stop as soon as there's a value delimiter, an input prefix
         // or a non-printable character (e.g., newline, carriage return).
         if (isValueDelimiter(c) || c == NAME_PREFIX || isNonPrintable(c))
         {
-            size_t size = scratchIndex - m_scratch.get();
+            size_t size = scratchIndex - context.m_scratch.get();
             if (size)
             {
-                string name(m_scratch.get(), size);
+                string name(context.m_scratch.get(), size);
                 auto it = m_aliasToIdMap.find(name);
                 if (it != m_aliasToIdMap.end())
                 {
@@ -640,10 +873,10 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
 
                 if (m_traceLevel >= Info)
                 {
-                    fprintf(stderr,
+                    context.Log(
                         "INFO: Skipping unknown input ('%s') %ls. "
                         "Input name '%s' was not specified in the reader config section.\n",
-                        name.c_str(), GetFileInfo().c_str(), name.c_str());
+                        name.c_str(), GetFileInfo(context).c_str(), name.c_str());
                 }
 
                 // return false here to skip this input, but do not call IncrementNumberOfErrorsOrDie()
@@ -652,15 +885,15 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
 
             if (ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Input name prefix ('%c') is followed by"
                     " an invalid character ('%c') %ls.\n",
-                    NAME_PREFIX, c, GetFileInfo().c_str());
+                    NAME_PREFIX, c, GetFileInfo(context).c_str());
             }
 
             break;
         }
-        else if (scratchIndex < (m_scratch.get() + m_maxAliasLength))
+        else if (scratchIndex < (context.m_scratch.get() + m_maxAliasLength))
         {
             *scratchIndex = c;
             ++scratchIndex;
@@ -671,12 +904,12 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
             // yet it's not followed by a delimiter.
             if (m_traceLevel >= Info)
             {
-                string namePrefix(m_scratch.get(), m_maxAliasLength);
-                fprintf(stderr,
+                string namePrefix(context.m_scratch.get(), m_maxAliasLength);
+                context.Log(
                     "INFO: Skipping unknown input %ls. "
                     "Input name (with the %" PRIu64 "-character prefix '%s') "
                     "exceeds the maximum expected length (%" PRIu64 ").\n",
-                    GetFileInfo().c_str(), m_maxAliasLength, namePrefix.c_str(), m_maxAliasLength);
+                    GetFileInfo(context).c_str(), m_maxAliasLength, namePrefix.c_str(), m_maxAliasLength);
             }
             return false;
         }
@@ -685,15 +918,15 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
     if (ShouldWarn()) {
         if (bytesToRead == 0)
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading an input name %ls.\n", GetFileInfo().c_str());
+                " while reading an input name %ls.\n", GetFileInfo(context).c_str());
         }
-        else if (!CanRead()) 
+        else if (context.Empty()) 
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading an input name %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading an input name %ls.\n", bytesToRead, GetFileInfo(context).c_str());
         }
     }
     
@@ -703,19 +936,19 @@ bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadDenseSample(ParsingContext& context, vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead)
 {
     size_t counter = 0;
     ElemType value;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && !context.Empty())
     {
-        char c = m_fileReader->Peek();
+        char c = context.Peek();
 
         if (isValueDelimiter(c))
         {
             // skip value delimiters
-            m_fileReader->Pop();
+            context.Pop();
             --bytesToRead;
             continue;
         }
@@ -727,10 +960,10 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
             {
                 if (ShouldWarn())
                 {
-                    fprintf(stderr,
+                    context.Log(
                         "WARNING: Dense sample (size = %" PRIu64 ") %ls"
                         " exceeds the expected size (%" PRIu64 ").\n",
-                        counter, GetFileInfo().c_str(), sampleSize);
+                        counter, GetFileInfo(context).c_str(), sampleSize);
                 }
                 return false;
             }
@@ -741,10 +974,10 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
             {
                 if (ShouldWarn())
                 {
-                    fprintf(stderr,
+                    context.Log(
                         "WARNING: A dense sample %ls has a sparse suffix "
                         "(expected size = %" PRIu64 ", actual size = %" PRIu64 ").\n",
-                        GetFileInfo().c_str(), sampleSize, counter);
+                        GetFileInfo(context).c_str(), sampleSize, counter);
                 }
                 for (; counter < sampleSize; ++counter)
                 {
@@ -755,7 +988,7 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
             return true;
         }
 
-        if (!TryReadRealNumber(value, bytesToRead))
+        if (!TryReadRealNumber(context, value, bytesToRead))
         {
             // bail out.
             return false;
@@ -769,15 +1002,15 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
     {
         if (bytesToRead == 0)
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading a dense sample %ls.\n", GetFileInfo().c_str());
+                " while reading a dense sample %ls.\n", GetFileInfo(context).c_str());
         }
-        else if (!CanRead())
+        else if (context.Empty())
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading a dense sample %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading a dense sample %ls.\n", bytesToRead, GetFileInfo(context).c_str());
         }
     }
 
@@ -787,20 +1020,20 @@ bool TextParser<ElemType>::TryReadDenseSample(vector<ElemType>& values, size_t s
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, std::vector<SparseIndexType>& indices,
+bool TextParser<ElemType>::TryReadSparseSample(ParsingContext& context, std::vector<ElemType>& values, std::vector<SparseIndexType>& indices,
     size_t sampleSize, size_t& bytesToRead)
 {
     size_t index = 0;
     ElemType value;
 
-    while (bytesToRead && CanRead())
+    while (bytesToRead && !context.Empty())
     {
-        char c = m_fileReader->Peek();
+        char c = context.Peek();
 
         if (isValueDelimiter(c))
         {
             // skip value delimiters
-            m_fileReader->Pop();
+            context.Pop();
             --bytesToRead;
             continue;
         }
@@ -813,7 +1046,7 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
         }
 
         // read next sparse index
-        if (!TryReadUint64(index, bytesToRead))
+        if (!TryReadUint64(context, index, bytesToRead))
         {
             // bail out.
             return false;
@@ -823,36 +1056,36 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
         {
             if (ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Sparse index value (%" PRIu64 ") %ls"
                     " exceeds the maximum expected value (%" PRIu64 ").\n",
-                    index, GetFileInfo().c_str(), sampleSize - 1);
+                    index, GetFileInfo(context).c_str(), sampleSize - 1);
             }
             // bail out.
             return false;
         }
 
         // an index must be followed by a delimiter
-        c = m_fileReader->Peek();
+        c = context.Peek();
         if (c != INDEX_DELIMITER)
         {
             if (ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Unexpected character('%c')"
                     " in place of the index delimiter ('%c')"
                     " after a sparse value index (%" PRIu64 ") %ls.\n",
-                    c, INDEX_DELIMITER, index, GetFileInfo().c_str());
+                    c, INDEX_DELIMITER, index, GetFileInfo(context).c_str());
             }
             return false;
         }
 
         // skip index delimiter
-        m_fileReader->Pop();
+        context.Pop();
         --bytesToRead;
 
         // read the corresponding value
-        if (!TryReadRealNumber(value, bytesToRead))
+        if (!TryReadRealNumber(context, value, bytesToRead))
         {
             // bail out.
             return false;
@@ -866,15 +1099,15 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
     { 
         if (bytesToRead == 0)
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading a sparse sample %ls.\n", GetFileInfo().c_str());
+                " while reading a sparse sample %ls.\n", GetFileInfo(context).c_str());
         }
-        else if (!CanRead())
+        else if (context.Empty())
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading a sparse sample %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading a sparse sample %ls.\n", bytesToRead, GetFileInfo(context).c_str());
         }
     }
 
@@ -884,11 +1117,11 @@ bool TextParser<ElemType>::TryReadSparseSample(std::vector<ElemType>& values, st
 }
 
 template <class ElemType>
-void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
+void TextParser<ElemType>::SkipToNextInput(ParsingContext& context, size_t& bytesToRead)
 {
-    for (; bytesToRead && CanRead(); m_fileReader->Pop(), --bytesToRead)
+    for (; bytesToRead && !context.Empty(); context.Pop(), --bytesToRead)
     {
-        char c = m_fileReader->Peek();
+        char c = context.Peek();
         // skip everything until we hit either an input marker or the end of row.
         if (c == NAME_PREFIX || c == ROW_DELIMITER)
         {
@@ -898,21 +1131,21 @@ void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
 }
 
 template <class ElemType>
-bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadUint64(ParsingContext& context, size_t& value, size_t& bytesToRead)
 {
     value = 0;
     bool found = false;
-    for (; bytesToRead && CanRead(); m_fileReader->Pop(), --bytesToRead)
+    for (; bytesToRead && !context.Empty(); context.Pop(), --bytesToRead)
     {
-        char c = m_fileReader->Peek();
+        char c = context.Peek();
 
         if (!IsDigit(c))
         {
             if (!found && ShouldWarn()) 
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Expected a uint64 value, but none found %ls.\n", 
-                    GetFileInfo().c_str());
+                    GetFileInfo(context).c_str());
             }
 
             return found;
@@ -926,9 +1159,9 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
         {
             if (ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Overflow while reading a uint64 value %ls.\n",
-                    GetFileInfo().c_str());
+                    GetFileInfo(context).c_str());
             }
 
             return false;
@@ -939,15 +1172,15 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
     if (ShouldWarn())
     {
         if (bytesToRead == 0) {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Exhausted all input expected for the current sequence"
-                " while reading a uint64 value %ls.\n", GetFileInfo().c_str());
+                " while reading a uint64 value %ls.\n", GetFileInfo(context).c_str());
         }
-        else if (!CanRead())
+        else if (context.Empty())
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-                " while reading a uint64 value %ls.\n", bytesToRead, GetFileInfo().c_str());
+                " while reading a uint64 value %ls.\n", bytesToRead, GetFileInfo(context).c_str());
         }
         
     }
@@ -966,15 +1199,28 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 // cannot be parsed as part of a floating point number.
 // Returns true if parsing was successful.
 template <class ElemType>
-bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
+bool TextParser<ElemType>::TryReadRealNumber(ParsingContext& context, ElemType& value, size_t& bytesToRead)
 {
+    // Most values are plain decimal numbers, try the fast path first.
+    double fastValue;
+    const char* position = context.Position();
+    const char* next = TryParseDecimal(position, position + std::min(bytesToRead, context.Remaining()), fastValue);
+    if (next != nullptr)
+    {
+        size_t length = next - position;
+        context.Skip(length);
+        bytesToRead -= length;
+        value = static_cast<ElemType>(fastValue);
+        return true;
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
 
-    for (; bytesToRead && CanRead(); m_fileReader->Pop(), --bytesToRead)
+    for (; bytesToRead && !context.Empty(); context.Pop(), --bytesToRead)
     {
-        char c = m_fileReader->Peek();
+        char c = context.Peek();
 
         switch (state)
         {
@@ -994,10 +1240,10 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             {
                 if (ShouldWarn())
                 {
-                    fprintf(stderr,
+                    context.Log(
                         "WARNING: Unexpected character ('%c')"
                         " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                        c, GetFileInfo(context).c_str());
                 }
                 return false;
             }
@@ -1013,10 +1259,10 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             {
                 if (ShouldWarn())
                 {
-                    fprintf(stderr,
+                    context.Log(
                         "WARNING: A sign symbol is followed by an invalid character('%c')"
                         " in a floating point value %ls.\n",
-                        c, GetFileInfo().c_str());
+                        c, GetFileInfo(context).c_str());
                 }
                 return false;
             }
@@ -1097,10 +1343,10 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             {
                 if (ShouldWarn())
                 {
-                    fprintf(stderr,
+                    context.Log(
                         "WARNING: An exponent symbol is followed by"
                         " an invalid character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                        " in a floating point value %ls.\n", c, GetFileInfo(context).c_str());
                 }
                 return false;
             }
@@ -1116,10 +1362,10 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
             {
                 if (ShouldWarn())
                 {
-                    fprintf(stderr,
+                    context.Log(
                         "WARNING: An exponent sign symbol followed by"
                         " an unexpected character('%c')"
-                        " in a floating point value %ls.\n", c, GetFileInfo().c_str());
+                        " in a floating point value %ls.\n", c, GetFileInfo(context).c_str());
                 }
                 return false;
             }
@@ -1141,9 +1387,9 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
         default:
             if (ShouldWarn())
             {
-                fprintf(stderr,
+                context.Log(
                     "WARNING: Reached an invalid state while reading a floating point value %ls.\n",
-                    GetFileInfo().c_str());
+                    GetFileInfo(context).c_str());
             }
             return false;
         }
@@ -1154,10 +1400,10 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
     {
         if (ShouldWarn())
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Exhausted all input expected for the current sequence"
                 " while reading an input row %ls."
-                " Possibly, a trailing newline is missing.\n", GetFileInfo().c_str());
+                " Possibly, a trailing newline is missing.\n", GetFileInfo(context).c_str());
         }
 
         switch (state)
@@ -1179,18 +1425,18 @@ bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRea
         // The floating point number we're reading is malformed.
         if (ShouldWarn())
         {
-            fprintf(stderr,
+            context.Log(
                 "WARNING: Reached an invalid state while reading a floating point value %ls.\n",
-                GetFileInfo().c_str());
+                GetFileInfo(context).c_str());
         }
         return false;
     }
 
     if (ShouldWarn())
     {
-        fprintf(stderr,
+        context.Log(
             "WARNING: Expected %" PRIu64 " more bytes, but no more input is available for the current sequence"
-            " while reading an input row %ls.\n", bytesToRead, GetFileInfo().c_str());
+            " while reading an input row %ls.\n", bytesToRead, GetFileInfo(context).c_str());
     }
 
     return false;
@@ -1232,23 +1478,29 @@ void TextParser<ElemType>::SetCacheIndex(bool value)
     m_cacheIndex = value;
 }
 
-template<class ElemType>
-inline bool TextParser<ElemType>::CanRead()
+template <class ElemType>
+void TextParser<ElemType>::SetNumParsingThreads(size_t numThreads)
+{
+    m_numParsingThreads = numThreads;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetNumIndexingThreads(size_t numThreads)
 {
-    return !m_fileReader->Empty();
+    m_numIndexingThreads = numThreads;
 }
 
 template <class ElemType>
-int64_t TextParser<ElemType>::GetFileOffset() const
+void TextParser<ElemType>::SetCacheIndexAsync(bool value)
 {
-    return m_fileReader->GetFileOffset();
+    m_cacheIndexAsync = value;
 }
 
 template <class ElemType>
-std::wstring TextParser<ElemType>::GetFileInfo()
+std::wstring TextParser<ElemType>::GetFileInfo(const ParsingContext& context)
 {
     std::wstringstream info;
-    info << L"at offset " << GetFileOffset() << L" in the input file (" << m_filename << L")";
+    info << L"at offset " << context.GetFileOffset() << L" in the input file (" << m_filename << L")";
     return info.str();
 }
 
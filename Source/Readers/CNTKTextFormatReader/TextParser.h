@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include "DataDeserializerBase.h"
 #include "Descriptors.h"
 #include "TextConfigHelper.h"
@@ -17,7 +19,6 @@ template <class ElemType>
 class CNTKTextFormatReaderTestRunner;
 
 class FileWrapper;
-class BufferedFileReader;
 
 // TODO: more details when tracing warnings
 // (e.g., buffer content around the char that triggered the warning)
@@ -97,6 +98,9 @@ private:
     // A chunk of input data in the text format.
     class TextDataChunk;
 
+    // Per-thread parsing state (position in the chunk data, scratch buffer and log).
+    class ParsingContext;
+
     typedef std::shared_ptr<TextDataChunk> TextChunkPtr;
 
     enum TraceLevel
@@ -108,7 +112,9 @@ private:
 
     const std::wstring m_filename;
     std::shared_ptr<FileWrapper> m_file;
-    std::shared_ptr<BufferedFileReader> m_fileReader;
+
+    // Chunks can be loaded concurrently (see PrefetchConfiguration), each reads from the shared file under this lock.
+    std::mutex m_fileLock;
 
     // An internal structure to assist with copying from input stream buffers into
     // into sequence data in a proper format.
@@ -121,20 +127,22 @@ private:
 
     std::shared_ptr<Index> m_index;
 
-    unique_ptr<char[]> m_scratch; // local buffer for string parsing
-
     // Indicates if the sequence length is computed as the maximum 
     // of number of samples across all streams (inputs).
     bool m_useMaximumAsSequenceLength;
 
     size_t m_chunkSizeBytes;
     unsigned int m_traceLevel;
-    bool m_hadWarnings;
-    unsigned int m_numAllowedErrors;
+    std::atomic<bool> m_hadWarnings;
+    std::atomic<unsigned int> m_numAllowedErrors;
     bool m_skipSequenceIds;
     bool m_cacheIndex;
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
                                // file operation should be repeated (default value is 5).
+    size_t m_numParsingThreads; // number of threads used to parse the sequences of a chunk
+                                // (default value is 0, which stands for the number of OpenMP threads).
+    size_t m_numIndexingThreads; // number of threads used to build the index (0 = number of hardware threads).
+    bool m_cacheIndexAsync; // if false, the index cache is written out before the parser is initialized.
 
     // Corpus descriptor.
     CorpusDescriptorPtr m_corpus;
@@ -147,45 +155,41 @@ private:
     // have been swallowed.
     void PrintWarningNotification();
 
-    int64_t GetFileOffset() const;
-
-    void SkipToNextInput(size_t& bytesToRead);
+    void SkipToNextInput(ParsingContext& context, size_t& bytesToRead);
 
     // Returns a string containing input file information (current offset, file name, etc.),
     // which can be included as a part of the trace/log message.
-    std::wstring GetFileInfo();
+    std::wstring GetFileInfo(const ParsingContext& context);
 
     // Reads an alias/name and converts it to an internal stream id (= stream index).
-    bool TryGetInputId(size_t& id, size_t& bytesToRead);
+    bool TryGetInputId(ParsingContext& context, size_t& id, size_t& bytesToRead);
 
-    bool TryReadRealNumber(ElemType& value, size_t& bytesToRead);
+    bool TryReadRealNumber(ParsingContext& context, ElemType& value, size_t& bytesToRead);
 
-    bool TryReadUint64(size_t& value, size_t& bytesToRead);
+    bool TryReadUint64(ParsingContext& context, size_t& value, size_t& bytesToRead);
 
     // Reads dense sample values into the provided vector.
-    bool TryReadDenseSample(std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
+    bool TryReadDenseSample(ParsingContext& context, std::vector<ElemType>& values, size_t sampleSize, size_t& bytesToRead);
 
     // Reads sparse sample values and corresponding indices into the provided vectors.
-    bool TryReadSparseSample(std::vector<ElemType>& values, std::vector<SparseIndexType>& indices,
+    bool TryReadSparseSample(ParsingContext& context, std::vector<ElemType>& values, std::vector<SparseIndexType>& indices,
         size_t sampleSize, size_t& bytesToRead);
 
     // Reads one sample (an input identifier followed by a list of values)
-    bool TryReadSample(SequenceBuffer& sequence, size_t& bytesToRead);
+    bool TryReadSample(ParsingContext& context, SequenceBuffer& sequence, size_t& bytesToRead);
 
     // Reads one whole row (terminated by a row delimiter) of samples
-    bool TryReadRow(SequenceBuffer& sequence, size_t& bytesToRead);
-
-    // Returns true if there's still data available.
-    bool inline CanRead();
+    bool TryReadRow(ParsingContext& context, SequenceBuffer& sequence, size_t& bytesToRead);
 
     // Returns true if the trace level is greater or equal to 'Warning'
     bool inline ShouldWarn() { m_hadWarnings = true; return m_traceLevel >= Warning; }
 
-    // Given a descriptor and the file offset of the containing chunk,
-    // retrieves the data for the corresponding sequence from the file.
-    SequenceBuffer LoadSequence(const SequenceDescriptor& descriptor, size_t chunkOffset);
+    // Given a descriptor, parses the data for the corresponding sequence,
+    // the context must be positioned at the beginning of the sequence.
+    SequenceBuffer LoadSequence(ParsingContext& context, const SequenceDescriptor& descriptor);
 
     // Given a descriptor, retrieves the data for the corresponding chunk from the file.
+    // Sequences of the chunk are parsed in parallel (see SetNumParsingThreads).
     void LoadChunk(TextChunkPtr& chunk, const ChunkDescriptor& descriptor);
 
     // Fills some metadata members to be conformant to the exposed SequenceData interface.
@@ -203,6 +207,12 @@ private:
 
     void SetCacheIndex(bool value);
 
+    void SetNumParsingThreads(size_t numThreads);
+
+    void SetNumIndexingThreads(size_t numThreads);
+
+    void SetCacheIndexAsync(bool value);
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     DISABLE_COPY_AND_MOVE(TextParser);
@@ -25,6 +25,7 @@
 #include "V2Dependencies.h"
 #include "LTNoRandomizer.h"
 #include "LTTumblingWindowRandomizer.h"
+#include "DiskChunkCache.h"
 
 namespace CNTK {
 
@@ -167,9 +168,17 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
                 }
             }
 
+            // Only the text and binary deserializers can load chunks concurrently.
+            auto prefetchConfig = GetPrefetchConfiguration(config);
+            if (prefetchConfig.m_numberOfThreads > 1 && !OnlyContainsDeserializers(config, { L"CNTKTextFormatDeserializer", L"CNTKBinaryFormatDeserializer" }))
+            {
+                fprintf(stderr, "WARNING: 'prefetchThreads' is ignored, the deserializers do not support loading chunks concurrently.\n");
+                prefetchConfig.m_numberOfThreads = 1;
+            }
+
             bool shouldPrefetch = true;
             m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, shouldPrefetch,
-                multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow, GetRandomSeed(config));
+                multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow, GetRandomSeed(config), prefetchConfig);
         }
         else
             m_sequenceEnumerator = std::make_shared<NoRandomizer>(deserializer, multiThreadedDeserialization, maxErrors);
@@ -282,6 +291,9 @@ DataDeserializerPtr CompositeDataReader::CreateDeserializer(const ConfigParamete
         RuntimeError("Cannot create deserializer. Please check module and type in the configuration.");
     }
 
+    // Decoded chunks can be persisted on disk, independent of the deserializer type.
+    d = WrapWithDiskChunkCache(d, deserializerConfig);
+
     // Create transformers if necessary.
     CreateTransforms(deserializerConfig);
 
@@ -381,4 +393,19 @@ bool CompositeDataReader::ContainsDeserializer(const ConfigParameters& readerCon
     return false;
 }
 
+bool CompositeDataReader::OnlyContainsDeserializers(const ConfigParameters& readerConfig, const vector<wstring>& types)
+{
+    argvector<ConfigValue> deserializerConfigs =
+        readerConfig(L"deserializers", ConfigParameters::Array(argvector<ConfigValue>(vector<ConfigValue> {})));
+
+    for (size_t i = 0; i < deserializerConfigs.size(); ++i)
+    {
+        ConfigParameters p = deserializerConfigs[i];
+        std::wstring deserializerType = p("type");
+        if (std::find(types.begin(), types.end(), deserializerType) == types.end())
+            return false;
+    }
+    return true;
+}
+
 }
@@ -69,6 +69,9 @@ private:
 
     bool ContainsDeserializer(const Microsoft::MSR::CNTK::ConfigParameters& readerConfig, const wstring& type);
 
+    // Checks that all deserializers are of the given types.
+    bool OnlyContainsDeserializers(const Microsoft::MSR::CNTK::ConfigParameters& readerConfig, const std::vector<wstring>& types);
+
     enum class PackingMode
     {
         sample,
@@ -9,6 +9,7 @@
 #include <inttypes.h>
 #include "BlockRandomizer.h"
 #include <algorithm>
+#include <chrono>
 #include <utility>
 
 #include "DataReader.h"
@@ -24,7 +25,8 @@ BlockRandomizer::BlockRandomizer(
     bool multithreadedGetNextSequence,
     size_t maxNumberOfInvalidSequences,
     bool sampleBasedRandomizationWindow,
-    size_t seedOffset)
+    size_t seedOffset,
+    const PrefetchConfiguration& prefetchConfig)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_sweep(SIZE_MAX),
@@ -34,12 +36,16 @@ BlockRandomizer::BlockRandomizer(
       m_sweepSizeInSamples(0),
       m_chunkRandomizer(std::make_shared<ChunkRandomizer>(deserializer, randomizationRange, sampleBasedRandomizationWindow)),
       m_multithreadedGetNextSequences(multithreadedGetNextSequence),
-      m_prefetchedChunk(ChunkIdMax),
+      m_prefetchConfig(prefetchConfig),
+      m_prefetchStatisticsReported(false),
       m_cleaner(maxNumberOfInvalidSequences),
       m_seedOffset(seedOffset)
 {
     assert(deserializer != nullptr);
 
+    if (m_prefetchConfig.m_depth == 0 || m_prefetchConfig.m_numberOfThreads == 0)
+        InvalidArgument("BlockRandomizer: the prefetch depth and the number of prefetch threads must be greater than zero.");
+
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
 
     m_streams = m_deserializer->StreamInfos();
@@ -64,6 +70,8 @@ void BlockRandomizer::StartEpoch(const EpochConfiguration& config)
     m_currentWindowRange = ClosedOpenChunkInterval{};
 
     m_config = config;
+    m_prefetchStatistics = PrefetchStatistics();
+    m_prefetchStatisticsReported = false;
     
     if (config.m_totalEpochSizeInSweeps != g_infinity)
     {
@@ -155,6 +163,19 @@ Sequences BlockRandomizer::GetNextSequences(size_t globalSampleCount, size_t loc
 
     m_cleaner.Clean(result);
 
+    if (result.m_endOfEpoch && !m_prefetchStatisticsReported)
+    {
+        m_prefetchStatisticsReported = true;
+        if (m_verbosity >= Notification)
+            fprintf(stderr, "BlockRandomizer: epoch %" PRIu64 ": %" PRIu64 " chunks paged in, %" PRIu64 " of them prefetched, "
+                    "waited %" PRIu64 " times for %.3f seconds for chunks\n",
+                    m_config.m_epochIndex + 1,
+                    m_prefetchStatistics.m_chunksLoaded,
+                    m_prefetchStatistics.m_chunksPrefetched,
+                    m_prefetchStatistics.m_stalls,
+                    m_prefetchStatistics.m_stallSeconds);
+    }
+
     return result;
 }
 
@@ -233,9 +254,8 @@ std::pair<size_t, size_t> BlockRandomizer::LoadSequenceData(size_t globalSampleC
             process(i);
     }
 
-    // Now it is safe to start the new chunk prefetch.
-    ChunkIdType chunkToPrefetchNext = GetChunkToPrefetch(windowRange);
-    Prefetch(chunkToPrefetchNext);
+    // Now it is safe to start the new chunk prefetches.
+    Prefetch(windowRange);
 
     return { numGlobalSamples, numLocalSamples };
 }
@@ -395,10 +415,17 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         }
 
         auto const& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
-        if (chunk.m_original->m_id == m_prefetchedChunk && m_prefetch.valid())
+        auto prefetched = std::find_if(m_prefetched.begin(), m_prefetched.end(),
+                                       [&chunk](const PrefetchedChunk& p) { return p.m_id == chunk.m_original->m_id; });
+        auto start = std::chrono::steady_clock::now();
+        bool stalled = true;
+        if (prefetched != m_prefetched.end())
         {
             // Taking prefetched chunk.
-            m_chunks[chunk.m_original->m_id] = m_prefetch.get();
+            stalled = prefetched->m_chunk.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+            m_chunks[chunk.m_original->m_id] = prefetched->m_chunk.get();
+            m_prefetched.erase(prefetched);
+            m_prefetchStatistics.m_chunksPrefetched++;
             if (m_verbosity >= Information)
                 fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in prefetched chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
                 chunk.m_chunkId,
@@ -407,11 +434,10 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
         }
         else
         {
-            // Make sure we have no outstanding prefetches.
-            if (m_prefetch.valid())
-            {
-                m_prefetch.wait();
-            }
+            // With a single prefetch thread the deserializer is not required to load chunks concurrently,
+            // so make sure we have no outstanding prefetches.
+            if (m_prefetchConfig.m_numberOfThreads == 1)
+                WaitForPrefetches();
 
             m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
             if (m_verbosity >= Information)
@@ -420,6 +446,13 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 chunk.m_original->m_id,
                 ++numLoadedChunks);
         }
+
+        m_prefetchStatistics.m_chunksLoaded++;
+        if (stalled)
+        {
+            m_prefetchStatistics.m_stalls++;
+            m_prefetchStatistics.m_stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
     }
 
     if (m_verbosity >= Notification)
@@ -429,43 +462,95 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_end - 1].m_chunkId);
 }
 
-// Identifies chunk id that should be prefetched.
-ChunkIdType BlockRandomizer::GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange)
+// Identifies chunk ids that should be prefetched: the next local chunks after the window that are not loaded,
+// limited by the prefetch depth and the maximum number of prefetched samples.
+std::vector<const ChunkInfo*> BlockRandomizer::GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    ChunkIdType toBePrefetched = ChunkIdMax;
-    auto current = windowRange.m_end;
-    while (current < m_chunkRandomizer->GetRandomizedChunks().size())
+    std::vector<const ChunkInfo*> toBePrefetched;
+    size_t numberOfSamples = 0;
+    const auto& randomizedChunks = m_chunkRandomizer->GetRandomizedChunks();
+    for (auto current = windowRange.m_end; current < randomizedChunks.size() && toBePrefetched.size() < m_prefetchConfig.m_depth; ++current)
     {
-        const auto& chunk = m_chunkRandomizer->GetRandomizedChunks()[current];
-        if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank &&
-            m_chunks.find(chunk.m_original->m_id) == m_chunks.end())
+        const auto& chunk = randomizedChunks[current];
+        if (chunk.m_chunkId % m_config.m_numberOfWorkers != m_config.m_workerRank ||
+            m_chunks.find(chunk.m_original->m_id) != m_chunks.end())
         {
-            toBePrefetched = chunk.m_original->m_id;
-            break;
+            continue;
         }
-        ++current;
+
+        numberOfSamples += chunk.m_original->m_numberOfSamples;
+        if (!toBePrefetched.empty() && numberOfSamples > m_prefetchConfig.m_maxSamples)
+            break;
+
+        toBePrefetched.push_back(chunk.m_original);
     }
     return toBePrefetched;
 }
 
-// Performs io prefetch of the specified chunk if needed.
-void BlockRandomizer::Prefetch(ChunkIdType chunkId)
+// Performs io prefetch of the chunks following the window if needed.
+void BlockRandomizer::Prefetch(const ClosedOpenChunkInterval& windowRange)
 {
-    // Start new prefetch if necessary.
-    if (m_prefetchedChunk != chunkId && chunkId != ChunkIdMax)
+    std::vector<const ChunkInfo*> toBePrefetched = GetChunksToPrefetch(windowRange);
+
+    // Drop the prefetches that are not needed anymore (i.e. after a reset of the randomization).
+    auto stale = std::remove_if(m_prefetched.begin(), m_prefetched.end(), [&toBePrefetched](PrefetchedChunk& p)
     {
-        // Wait to make sure there is no outstanding prefetches.
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
+        if (std::any_of(toBePrefetched.begin(), toBePrefetched.end(), [&p](const ChunkInfo* c) { return c->m_id == p.m_id; }))
+            return false;
 
-        m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+        if (p.m_chunk.valid())
+            p.m_chunk.wait();
+        return true;
+    });
+    m_prefetched.erase(stale, m_prefetched.end());
+
+    // Start new prefetches in order, keeping at most the configured number of loads running.
+    size_t numberOfRunning = std::count_if(m_prefetched.begin(), m_prefetched.end(), [](const PrefetchedChunk& p)
+    {
+        return p.m_chunk.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    });
+
+    for (auto chunk : toBePrefetched)
+    {
+        if (numberOfRunning >= m_prefetchConfig.m_numberOfThreads)
+            break;
+
+        auto chunkId = chunk->m_id;
+        if (std::any_of(m_prefetched.begin(), m_prefetched.end(), [chunkId](const PrefetchedChunk& p) { return p.m_id == chunkId; }))
+            continue;
+
+        m_prefetched.push_back(PrefetchedChunk{ chunkId, chunk->m_numberOfSamples, std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); }) });
+        numberOfRunning++;
 
         if (m_verbosity >= Debug)
             fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
     }
+
+    size_t prefetchedSamples = 0;
+    for (const auto& p : m_prefetched)
+        prefetchedSamples += p.m_numberOfSamples;
+    m_prefetchStatistics.m_maxPrefetchedSamples = std::max(m_prefetchStatistics.m_maxPrefetchedSamples, prefetchedSamples);
+}
+
+void BlockRandomizer::WaitForPrefetches()
+{
+    for (auto& p : m_prefetched)
+    {
+        if (p.m_chunk.valid())
+            p.m_chunk.wait();
+    }
+}
+
+std::map<std::wstring, double> BlockRandomizer::GetStatistics()
+{
+    return std::map<std::wstring, double>
+    {
+        { L"chunksLoaded", (double)m_prefetchStatistics.m_chunksLoaded },
+        { L"chunksPrefetched", (double)m_prefetchStatistics.m_chunksPrefetched },
+        { L"chunkStalls", (double)m_prefetchStatistics.m_stalls },
+        { L"chunkStallSeconds", m_prefetchStatistics.m_stallSeconds },
+        { L"maxPrefetchedSamples", (double)m_prefetchStatistics.m_maxPrefetchedSamples },
+    };
 }
 
 void BlockRandomizer::SetState(const std::map<std::wstring, size_t>& state)
@@ -16,6 +16,45 @@
 
 namespace CNTK {
 
+// Configuration of the chunk prefetching of the BlockRandomizer.
+struct PrefetchConfiguration
+{
+    // Number of chunks that are loaded ahead of the randomization window.
+    size_t m_depth{ 1 };
+
+    // Maximum number of chunks loaded at the same time. Values greater than one require
+    // a deserializer that can load chunks concurrently. The text format deserializer parses each
+    // chunk on several threads as well; unless 'numParsingThreads' is set, it then parses a chunk
+    // on the number of OpenMP threads divided by the number of loading threads.
+    size_t m_numberOfThreads{ 1 };
+
+    // Maximum number of samples in prefetched chunks that are not used yet, bounds the memory
+    // taken by the prefetched chunks. At least one chunk is always prefetched.
+    size_t m_maxSamples{ SIZE_MAX };
+};
+
+// Reads the prefetch configuration of a reader: 'prefetchDepth', 'prefetchThreads' and 'prefetchMaxSamples'.
+inline PrefetchConfiguration GetPrefetchConfiguration(const Microsoft::MSR::CNTK::ConfigParameters& config)
+{
+    PrefetchConfiguration result;
+    result.m_depth = config(L"prefetchDepth", result.m_depth);
+    result.m_numberOfThreads = config(L"prefetchThreads", result.m_numberOfThreads);
+    result.m_maxSamples = config(L"prefetchMaxSamples", result.m_maxSamples);
+    if (result.m_depth == 0 || result.m_numberOfThreads == 0)
+        InvalidArgument("'prefetchDepth' and 'prefetchThreads' must be greater than zero.");
+    return result;
+}
+
+// Counters of the chunk loading of the BlockRandomizer for the current epoch.
+struct PrefetchStatistics
+{
+    size_t m_chunksLoaded{ 0 };      // Number of chunks paged in.
+    size_t m_chunksPrefetched{ 0 };  // Number of chunks paged in from the prefetch queue.
+    size_t m_stalls{ 0 };            // Number of times the reader waited for a chunk that was not prefetched or not loaded yet.
+    double m_stallSeconds{ 0 };      // Total time of the waits.
+    size_t m_maxPrefetchedSamples{ 0 }; // Peak number of samples in the prefetch queue.
+};
+
 // A randomizer that firstly randomizes chunks and then sequences inside a rolling window of chunks.
 // Uses ChunkRandomizer to randomize chunk descriptions and SequenceRandomizer to randomize sequence descriptions inside a window of chunks.
 // It requires only a window of sequence descriptions and corresponding chunk data.
@@ -29,6 +68,7 @@ namespace CNTK {
 //         4) return sequence descriptions not exceeding sampleCount/minibatch limit
 //         5) decimate sequence descriptions based on the worker rank
 //         6) request chunks of data based on decimated sequences and return sequence data
+//         7) prefetch the next chunks after the window (see PrefetchConfiguration)
 //
 // This class is responsible for decimation and loading the data chunks in to memory.
 // Actual randomization happens in ChunkRandomizer and SequenceRandomizer.
@@ -44,7 +84,8 @@ public:
         bool multithreadedGetNextSequences = false,
         size_t maxNumberOfInvalidSequences = 0, // per worker
         bool sampleBasedRandomizationWindow = true,
-        size_t seedOffset = 0);
+        size_t seedOffset = 0,
+        const PrefetchConfiguration& prefetchConfig = PrefetchConfiguration());
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -65,16 +106,22 @@ public:
 
     ~BlockRandomizer()
     {
-        if (m_prefetch.valid())
-        {
-            m_prefetch.wait();
-        }
+        WaitForPrefetches();
     }
 
     void SetState(const std::map<std::wstring, size_t>& state) override;
 
     void SetConfiguration(const ReaderConfiguration& config) override;
 
+    // Returns the chunk loading counters of the current epoch.
+    const PrefetchStatistics& GetPrefetchStatistics() const
+    {
+        return m_prefetchStatistics;
+    }
+
+    // Returns the chunk loading counters of the current epoch by name.
+    std::map<std::wstring, double> GetStatistics() override;
+
 private:
     // Load data for chunks if needed.
     void LoadDataChunks(const ClosedOpenChunkInterval& windowRange);
@@ -97,11 +144,14 @@ private:
     // Prepares a new sweep if needed.
     void PrepareNewSweepIfNeeded(size_t samplePosition);
 
-    // Performs io prefetch of the specified chunk if needed.
-    void Prefetch(ChunkIdType chunkId);
+    // Starts io prefetch of the chunks following the given window if needed.
+    void Prefetch(const ClosedOpenChunkInterval& windowRange);
 
-    // Returns next candidate for the prefetch in the given range.
-    ChunkIdType GetChunkToPrefetch(const ClosedOpenChunkInterval& windowRange);
+    // Returns the next candidates for the prefetch after the given window, in the order they are needed.
+    std::vector<const ChunkInfo*> GetChunksToPrefetch(const ClosedOpenChunkInterval& windowRange);
+
+    // Waits for all outstanding prefetches.
+    void WaitForPrefetches();
 
     // Global sample position on the timeline.
     size_t m_globalSamplePosition;
@@ -153,12 +203,23 @@ private:
 
     int m_verbosity;
 
-    // Prefetch future.
-    std::future<ChunkPtr> m_prefetch;
+    // A chunk that is prefetched or being prefetched.
+    struct PrefetchedChunk
+    {
+        // Original chunk id.
+        ChunkIdType m_id;
+        size_t m_numberOfSamples;
+        std::future<ChunkPtr> m_chunk;
+    };
+
+    // Prefetch queue, in the order the chunks are requested.
+    std::vector<PrefetchedChunk> m_prefetched;
     // Whether to have async or deferred prefetch.
     launch m_launchType;
-    // Prefetched original chunk id.
-    ChunkIdType m_prefetchedChunk;
+    PrefetchConfiguration m_prefetchConfig;
+    PrefetchStatistics m_prefetchStatistics;
+    // Whether the statistics have been reported for the current epoch.
+    bool m_prefetchStatisticsReported;
 
     // Current loaded chunks.
     ClosedOpenChunkInterval m_currentWindowRange;
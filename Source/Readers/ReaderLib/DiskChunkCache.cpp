@@ -0,0 +1,778 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define __STDC_FORMAT_MACROS
+#define _CRT_SECURE_NO_WARNINGS
+#include <inttypes.h>
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include "DiskChunkCache.h"
+#include "SequenceData.h"
+#include "ReaderConstants.h"
+#include "EnvironmentUtil.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace CNTK {
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+namespace {
+
+// Layout of the cache file (all blocks are padded to s_alignment bytes):
+//   CacheHeader
+//   for every cached chunk:
+//     ChunkRecordHeader
+//     for every sequence in the chunk and every stream: CachedSequenceHeader, shape dimensions,
+//         nnz counts and indices (sparse only), data
+//     ChunkRecordTrailer
+const uint64_t s_cacheMagic = 0x636e746b5f636368;   // 'cntk_cch'
+const uint64_t s_recordMagic = 0x636e746b5f636b72;  // 'cntk_ckr'
+const uint64_t s_trailerMagic = 0x636e746b5f656e64; // 'cntk_end'
+const size_t s_alignment = 16;
+
+struct CacheHeader
+{
+    uint64_t magic;
+    uint64_t version;
+    uint64_t key;
+    uint64_t reserved;
+};
+
+struct ChunkRecordHeader
+{
+    uint64_t magic;
+    uint32_t chunkId;
+    uint32_t numberOfSequences;
+    uint64_t numberOfStreams;
+    uint64_t payloadSize;
+};
+
+struct ChunkRecordTrailer
+{
+    uint64_t magic;
+    uint64_t payloadSize;
+};
+
+struct CachedSequenceHeader
+{
+    uint64_t indexInChunk;
+    uint64_t key;
+    uint32_t keySample;
+    uint32_t numberOfSamples;
+    uint32_t isValid;
+    uint32_t elementType;
+    uint32_t storageFormat;
+    uint32_t rank;
+    uint64_t numberOfNnzCounts;
+    uint64_t totalNnzCount;
+    uint64_t dataSize; // in bytes
+};
+
+static_assert(sizeof(CacheHeader) % s_alignment == 0, "Cache header must be aligned");
+static_assert(sizeof(ChunkRecordHeader) % s_alignment == 0, "Chunk record header must be aligned");
+static_assert(sizeof(ChunkRecordTrailer) % s_alignment == 0, "Chunk record trailer must be aligned");
+static_assert(sizeof(CachedSequenceHeader) % s_alignment == 0, "Sequence header must be aligned");
+
+inline size_t AlignUp(size_t size)
+{
+    return (size + s_alignment - 1) & ~(s_alignment - 1);
+}
+
+// Appends a block of data to the buffer, padding it to the alignment.
+void AppendBlock(vector<char>& buffer, const void* data, size_t size)
+{
+    size_t offset = buffer.size();
+    buffer.resize(offset + AlignUp(size), 0);
+    if (size != 0)
+        memcpy(&buffer[offset], data, size);
+}
+
+// FNV-1a hash.
+const uint64_t s_hashOffsetBasis = 14695981039346656037ULL;
+
+uint64_t Hash(uint64_t hash, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t Hash(uint64_t hash, const string& value)
+{
+    return Hash(Hash(hash, value.data(), value.size()), "\0", 1);
+}
+
+uint64_t Hash(uint64_t hash, uint64_t value)
+{
+    return Hash(hash, &value, sizeof(value));
+}
+
+// Sequences that point into a memory mapped chunk record. The mapping is kept alive
+// through the holding buffer for as long as the sequence is used.
+struct MappedDenseSequenceData : DenseSequenceData
+{
+    MappedDenseSequenceData(const NDShape& sampleShape, const void* data)
+        : m_sampleShape(sampleShape), m_data(data)
+    {}
+
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+    const NDShape& GetSampleShape() override
+    {
+        return m_sampleShape;
+    }
+
+    NDShape m_sampleShape;
+    const void* m_data;
+};
+
+struct MappedSparseSequenceData : SparseSequenceData
+{
+    MappedSparseSequenceData(const NDShape& sampleShape, const void* data)
+        : m_sampleShape(sampleShape), m_data(data)
+    {}
+
+    const void* GetDataBuffer() override
+    {
+        return m_data;
+    }
+
+    const NDShape& GetSampleShape() override
+    {
+        return m_sampleShape;
+    }
+
+    NDShape m_sampleShape;
+    const void* m_data;
+};
+
+}
+
+// A read-only memory mapping of a range of the cache file.
+class DiskChunkCache::MappedRegion
+{
+public:
+    MappedRegion(FILE* file, uint64_t offset, size_t size)
+        : m_base(nullptr), m_mappedSize(0), m_data(nullptr)
+    {
+#ifdef _WIN32
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        uint64_t alignedOffset = offset - offset % systemInfo.dwAllocationGranularity;
+        m_mappedSize = size + (offset - alignedOffset);
+
+        uint64_t end = offset + size;
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+        HANDLE mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, (DWORD)(end >> 32), (DWORD)end, NULL);
+        if (mapping == NULL)
+            RuntimeError("Cannot create a mapping of the chunk cache file, error code %d.", (int)GetLastError());
+
+        m_base = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(alignedOffset >> 32), (DWORD)alignedOffset, m_mappedSize);
+        // The view keeps a reference to the mapping object.
+        CloseHandle(mapping);
+        if (m_base == NULL)
+            RuntimeError("Cannot map a view of the chunk cache file, error code %d.", (int)GetLastError());
+#else
+        uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+        uint64_t alignedOffset = offset - offset % pageSize;
+        m_mappedSize = size + (offset - alignedOffset);
+
+        void* base = mmap(nullptr, m_mappedSize, PROT_READ, MAP_SHARED, fileno(file), (off_t)alignedOffset);
+        if (base == MAP_FAILED)
+            RuntimeError("Cannot map the chunk cache file: %s.", strerror(errno));
+        m_base = base;
+#endif
+        m_data = static_cast<const char*>(m_base) + (offset - alignedOffset);
+    }
+
+    ~MappedRegion()
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_base);
+#else
+        munmap(m_base, m_mappedSize);
+#endif
+    }
+
+    const char* Data() const { return m_data; }
+
+private:
+    void* m_base;
+    size_t m_mappedSize;
+    const char* m_data;
+
+    DISABLE_COPY_AND_MOVE(MappedRegion);
+};
+
+// A chunk served from a mapped chunk record. The record is validated and indexed
+// when the chunk is created, GetSequence only creates views on the mapped data.
+class DiskChunkCache::MappedChunk : public Chunk
+{
+public:
+    MappedChunk(const shared_ptr<MappedRegion>& region, size_t size, size_t numberOfStreams)
+        : m_region(region), m_size(size), m_numberOfStreams(numberOfStreams), m_firstIndex(0), m_isContiguous(true)
+    {
+        const char* record = m_region->Data();
+        auto header = reinterpret_cast<const ChunkRecordHeader*>(record);
+        if (size < sizeof(ChunkRecordHeader) + sizeof(ChunkRecordTrailer) ||
+            header->magic != s_recordMagic ||
+            header->numberOfStreams != numberOfStreams ||
+            header->payloadSize != size - sizeof(ChunkRecordHeader) - sizeof(ChunkRecordTrailer))
+            RuntimeError("Invalid chunk record in the chunk cache file.");
+
+        const char* current = record + sizeof(ChunkRecordHeader);
+        const char* end = current + header->payloadSize;
+        auto take = [&](uint64_t count, size_t elementSize) -> const char*
+        {
+            size_t available = end - current;
+            if (count > available / elementSize || AlignUp(count * elementSize) > available)
+                RuntimeError("Truncated chunk record in the chunk cache file.");
+            const char* result = current;
+            current += AlignUp(count * elementSize);
+            return result;
+        };
+
+        m_sequences.reserve(header->numberOfSequences * numberOfStreams);
+        for (size_t i = 0; i < header->numberOfSequences; ++i)
+        {
+            for (size_t j = 0; j < numberOfStreams; ++j)
+            {
+                SequenceLocation location;
+                location.header = reinterpret_cast<const CachedSequenceHeader*>(take(1, sizeof(CachedSequenceHeader)));
+                location.dimensions = reinterpret_cast<const uint64_t*>(take(location.header->rank, sizeof(uint64_t)));
+                location.nnzCounts = reinterpret_cast<const SparseIndexType*>(take(location.header->numberOfNnzCounts, sizeof(SparseIndexType)));
+                location.indices = reinterpret_cast<const SparseIndexType*>(take(location.header->totalNnzCount, sizeof(SparseIndexType)));
+                location.data = take(location.header->dataSize, 1);
+                m_sequences.push_back(location);
+            }
+
+            size_t index = m_sequences[i * numberOfStreams].header->indexInChunk;
+            if (i == 0)
+                m_firstIndex = index;
+            m_isContiguous = m_isContiguous && index == m_firstIndex + i;
+            m_indexToPosition[index] = i;
+        }
+
+        // Most deserializers number the sequences of a chunk consecutively, in that case the map is not needed.
+        if (m_isContiguous)
+            m_indexToPosition.clear();
+    }
+
+    void GetSequence(size_t sequenceIndex, vector<SequenceDataPtr>& result) override
+    {
+        size_t position;
+        if (m_isContiguous)
+        {
+            position = sequenceIndex - m_firstIndex;
+            if (sequenceIndex < m_firstIndex || position * m_numberOfStreams >= m_sequences.size())
+                LogicError("Sequence %" PRIu64 " does not belong to the cached chunk.", sequenceIndex);
+        }
+        else
+        {
+            auto it = m_indexToPosition.find(sequenceIndex);
+            if (it == m_indexToPosition.end())
+                LogicError("Sequence %" PRIu64 " does not belong to the cached chunk.", sequenceIndex);
+            position = it->second;
+        }
+
+        for (size_t j = 0; j < m_numberOfStreams; ++j)
+            result.push_back(CreateSequence(m_sequences[position * m_numberOfStreams + j]));
+    }
+
+    size_t SizeInBytes() const { return m_size; }
+
+private:
+    struct SequenceLocation
+    {
+        const CachedSequenceHeader* header;
+        const uint64_t* dimensions;
+        const SparseIndexType* nnzCounts;
+        const SparseIndexType* indices;
+        const char* data;
+    };
+
+    SequenceDataPtr CreateSequence(const SequenceLocation& location)
+    {
+        const CachedSequenceHeader& header = *location.header;
+        SequenceDataPtr result;
+        if (!header.isValid)
+        {
+            result = make_shared<InvalidSequenceData>();
+        }
+        else
+        {
+            NDShape sampleShape(vector<size_t>(location.dimensions, location.dimensions + header.rank));
+            if (header.storageFormat == (uint32_t)StorageFormat::Dense)
+            {
+                result = make_shared<MappedDenseSequenceData>(sampleShape, location.data);
+            }
+            else
+            {
+                auto sparse = make_shared<MappedSparseSequenceData>(sampleShape, location.data);
+                // The mapping is read-only, the indices are never written to by the packers.
+                sparse->m_indices = const_cast<SparseIndexType*>(location.indices);
+                sparse->m_nnzCounts.assign(location.nnzCounts, location.nnzCounts + header.numberOfNnzCounts);
+                sparse->m_totalNnzCount = (SparseIndexType)header.totalNnzCount;
+                result = sparse;
+            }
+
+            result->m_numberOfSamples = header.numberOfSamples;
+            result->m_elementType = (DataType)header.elementType;
+            result->m_holdingBuffer = shared_ptr<uint8_t>(m_region, (uint8_t*)location.data);
+        }
+
+        result->m_key = SequenceKey(header.key, header.keySample);
+        return result;
+    }
+
+    shared_ptr<MappedRegion> m_region;
+    size_t m_size;
+    size_t m_numberOfStreams;
+    vector<SequenceLocation> m_sequences; // for every sequence, one location per stream
+    size_t m_firstIndex;
+    bool m_isContiguous;
+    map<size_t, size_t> m_indexToPosition;
+};
+
+DiskChunkCache::DiskChunkCache(DataDeserializerPtr deserializer, const wstring& cacheFilename, uint64_t key, size_t maxResidentBytes, int traceLevel,
+                               bool writable, const vector<wstring>& inputs)
+    : m_deserializer(deserializer),
+    m_streams(deserializer->StreamInfos()),
+    m_cacheFilename(cacheFilename),
+    m_key(key),
+    m_maxResidentBytes(maxResidentBytes),
+    m_traceLevel(traceLevel),
+    m_enabled(false),
+    m_writable(false),
+    m_waitingForWriter(false),
+    m_inputs(inputs),
+    m_scannedBytes(0),
+    m_residentBytes(0)
+{
+    for (const auto& stream : m_streams)
+    {
+        if (stream.m_isBinary)
+        {
+            // Opaque binary streams (i.e. lattices) do not expose their layout and cannot be cached.
+            if (m_traceLevel > 0)
+                fprintf(stderr, "DiskChunkCache: stream '%ls' is binary, caching is disabled.\n", stream.m_name.c_str());
+            return;
+        }
+
+        m_key = Hash(m_key, Microsoft::MSR::CNTK::ToLegacyString(Microsoft::MSR::CNTK::ToUTF8(stream.m_name)));
+        m_key = Hash(m_key, (uint64_t)stream.m_storageFormat);
+        m_key = Hash(m_key, (uint64_t)stream.m_elementType);
+        for (auto dimension : stream.m_sampleLayout.Dimensions())
+            m_key = Hash(m_key, (uint64_t)dimension);
+    }
+
+    m_enabled = writable ? OpenOrCreate(true) : TryOpenReadOnly();
+    m_waitingForWriter = !writable && !m_enabled;
+
+    if (m_traceLevel > 0)
+    {
+        if (m_enabled)
+            fprintf(stderr, "DiskChunkCache: using cache file '%ls' with %" PRIu64 " cached chunks%s.\n",
+                m_cacheFilename.c_str(), m_locations.size(), m_writable ? "" : " (read-only)");
+        else if (m_waitingForWriter)
+            fprintf(stderr, "DiskChunkCache: cache file '%ls' is not available yet, reading from the deserializer until the main node has created it.\n", m_cacheFilename.c_str());
+        else
+            fprintf(stderr, "DiskChunkCache: cache file '%ls' is not available, caching is disabled.\n", m_cacheFilename.c_str());
+    }
+}
+
+// Opens the cache file written by the main node, unless it does not exist yet or is older than one of the inputs
+// (i.e. the main node is about to rebuild it).
+bool DiskChunkCache::TryOpenReadOnly()
+{
+    for (const auto& input : m_inputs)
+    {
+        if (!msra::files::fuptodate(m_cacheFilename, input, true))
+            return false;
+    }
+
+    if (!OpenOrCreate(false))
+    {
+        m_file.reset();
+        m_locations.clear();
+        return false;
+    }
+    return true;
+}
+
+// Returns true if the cache file is in use. A read-only cache retries to open the cache file until the main node has created it.
+bool DiskChunkCache::IsEnabled()
+{
+    lock_guard<mutex> lock(m_lock);
+    if (m_waitingForWriter && TryOpenReadOnly())
+    {
+        m_enabled = true;
+        m_waitingForWriter = false;
+        if (m_traceLevel > 0)
+            fprintf(stderr, "DiskChunkCache: using cache file '%ls' with %" PRIu64 " cached chunks (read-only).\n", m_cacheFilename.c_str(), m_locations.size());
+    }
+    return m_enabled;
+}
+
+bool DiskChunkCache::OpenOrCreate(bool writable)
+{
+    m_file.reset(new FileWrapper(m_cacheFilename, writable ? L"r+b" : L"rb"));
+
+    CacheHeader header;
+    bool isValid = m_file->IsOpen() &&
+        m_file->TryRead(header) &&
+        header.magic == s_cacheMagic &&
+        header.version == s_version &&
+        header.key == m_key;
+
+    if (!isValid)
+    {
+        if (!writable)
+            return false;
+
+        // The cache does not exist or was created for a different configuration, start from scratch.
+        m_file.reset();
+        _wunlink(m_cacheFilename.c_str());
+        m_file.reset(new FileWrapper(m_cacheFilename, L"w+b"));
+
+        header = CacheHeader{ s_cacheMagic, s_version, m_key, 0 };
+        if (!m_file->IsOpen() || !m_file->TryWrite(header) || !m_file->TryFlush())
+            return false;
+    }
+
+    m_writable = writable;
+    m_scannedBytes = sizeof(CacheHeader);
+    ScanRecords();
+
+    if (m_writable && m_scannedBytes < m_file->Filesize())
+    {
+        // Drop the incomplete record left by a job that was interrupted while writing.
+        int rc;
+#ifdef _WIN32
+        rc = _chsize_s(_fileno(m_file->File()), (int64_t)m_scannedBytes);
+#else
+        rc = ftruncate(fileno(m_file->File()), (off_t)m_scannedBytes);
+#endif
+        if (rc != 0)
+            m_writable = false;
+    }
+
+    return true;
+}
+
+// Picks up the chunk records that were appended to the cache file after the last scan.
+void DiskChunkCache::ScanRecords()
+{
+    uint64_t fileSize = m_file->Filesize();
+    while (m_scannedBytes + sizeof(ChunkRecordHeader) + sizeof(ChunkRecordTrailer) <= fileSize)
+    {
+        ChunkRecordHeader header;
+        if (!m_file->TrySeek(m_scannedBytes, SEEK_SET) ||
+            !m_file->TryRead(header) ||
+            header.magic != s_recordMagic ||
+            header.numberOfStreams != m_streams.size() ||
+            header.payloadSize % s_alignment != 0)
+            break;
+
+        uint64_t size = sizeof(ChunkRecordHeader) + header.payloadSize + sizeof(ChunkRecordTrailer);
+        if (header.payloadSize > fileSize || m_scannedBytes + size > fileSize)
+            break; // the record is still being written
+
+        ChunkRecordTrailer trailer;
+        if (!m_file->TrySeek(m_scannedBytes + sizeof(ChunkRecordHeader) + header.payloadSize, SEEK_SET) ||
+            !m_file->TryRead(trailer) ||
+            trailer.magic != s_trailerMagic ||
+            trailer.payloadSize != header.payloadSize)
+            break;
+
+        m_locations[header.chunkId] = CachedChunkLocation{ m_scannedBytes, size, header.numberOfSequences };
+        m_scannedBytes += size;
+    }
+}
+
+bool DiskChunkCache::TryAppend(ChunkIdType chunkId, const ChunkPtr& chunk)
+{
+    vector<SequenceInfo> sequenceInfos;
+    m_deserializer->SequenceInfosForChunk(chunkId, sequenceInfos);
+
+    vector<char> payload;
+    vector<SequenceDataPtr> sequences;
+    for (const auto& sequenceInfo : sequenceInfos)
+    {
+        sequences.clear();
+        chunk->GetSequence(sequenceInfo.m_indexInChunk, sequences);
+        if (sequences.size() != m_streams.size())
+            LogicError("Chunk %u returned %" PRIu64 " streams for a sequence, expected %" PRIu64 ".",
+                chunkId, sequences.size(), m_streams.size());
+
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            const auto& sequence = sequences[i];
+            const auto& stream = m_streams[i];
+
+            CachedSequenceHeader header = {};
+            header.indexInChunk = sequenceInfo.m_indexInChunk;
+            header.key = sequence->m_key.m_sequence;
+            header.keySample = sequence->m_key.m_sample;
+            header.isValid = sequence->m_isValid ? 1 : 0;
+            if (!sequence->m_isValid)
+            {
+                AppendBlock(payload, &header, sizeof(header));
+                continue;
+            }
+
+            DataType elementType = sequence->m_elementType != DataType::Unknown ? sequence->m_elementType : stream.m_elementType;
+            if (elementType == DataType::Unknown)
+                return false;
+
+            const auto& dimensions = sequence->GetSampleShape().Dimensions();
+            vector<uint64_t> shape(dimensions.begin(), dimensions.end());
+
+            header.numberOfSamples = sequence->m_numberOfSamples;
+            header.elementType = (uint32_t)elementType;
+            header.storageFormat = (uint32_t)stream.m_storageFormat;
+            header.rank = (uint32_t)shape.size();
+
+            if (stream.m_storageFormat == StorageFormat::Dense)
+            {
+                header.dataSize = sequence->GetSampleShape().TotalSize() * sequence->m_numberOfSamples * DataTypeSize(elementType);
+                AppendBlock(payload, &header, sizeof(header));
+                AppendBlock(payload, shape.data(), shape.size() * sizeof(uint64_t));
+                AppendBlock(payload, sequence->GetDataBuffer(), header.dataSize);
+            }
+            else
+            {
+                auto sparse = static_cast<SparseSequenceData*>(sequence.get());
+                header.numberOfNnzCounts = sparse->m_nnzCounts.size();
+                header.totalNnzCount = sparse->m_totalNnzCount;
+                header.dataSize = sparse->m_totalNnzCount * DataTypeSize(elementType);
+                AppendBlock(payload, &header, sizeof(header));
+                AppendBlock(payload, shape.data(), shape.size() * sizeof(uint64_t));
+                AppendBlock(payload, sparse->m_nnzCounts.data(), sparse->m_nnzCounts.size() * sizeof(SparseIndexType));
+                AppendBlock(payload, sparse->m_indices, sparse->m_totalNnzCount * sizeof(SparseIndexType));
+                AppendBlock(payload, sequence->GetDataBuffer(), header.dataSize);
+            }
+        }
+    }
+
+    ChunkRecordHeader header{ s_recordMagic, chunkId, (uint32_t)sequenceInfos.size(), m_streams.size(), payload.size() };
+    ChunkRecordTrailer trailer{ s_trailerMagic, payload.size() };
+
+    bool success = m_file->TrySeek(m_scannedBytes, SEEK_SET) &&
+        m_file->TryWrite(header) &&
+        m_file->TryWrite(payload.data(), 1, payload.size()) &&
+        m_file->TryWrite(trailer) &&
+        m_file->TryFlush();
+
+    if (!success)
+    {
+        // Most likely out of disk space, keep the records written so far and stop appending.
+        fprintf(stderr, "WARNING: DiskChunkCache: cannot append chunk %u to '%ls': %s.\n",
+            chunkId, m_cacheFilename.c_str(), strerror(errno));
+        m_writable = false;
+        return false;
+    }
+
+    uint64_t size = sizeof(ChunkRecordHeader) + payload.size() + sizeof(ChunkRecordTrailer);
+    m_locations[chunkId] = CachedChunkLocation{ m_scannedBytes, size, header.numberOfSequences };
+    m_scannedBytes += size;
+    return true;
+}
+
+DiskChunkCache::MappedChunkPtr DiskChunkCache::TryMap(ChunkIdType chunkId, const CachedChunkLocation& location)
+{
+    try
+    {
+        auto region = make_shared<MappedRegion>(m_file->File(), location.offset, location.size);
+        return make_shared<MappedChunk>(region, location.size, m_streams.size());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: DiskChunkCache: cannot load chunk %u from '%ls': %s\n", chunkId, m_cacheFilename.c_str(), e.what());
+        return nullptr;
+    }
+}
+
+void DiskChunkCache::Touch(ChunkIdType chunkId, const MappedChunkPtr& chunk)
+{
+    m_lru.emplace_front(chunkId, chunk);
+    m_lruPositions[chunkId] = m_lru.begin();
+    m_residentBytes += chunk->SizeInBytes();
+
+    // Always keep the chunk that was just requested.
+    while (m_residentBytes > m_maxResidentBytes && m_lru.size() > 1)
+    {
+        auto& last = m_lru.back();
+        m_residentBytes -= last.second->SizeInBytes();
+        m_lruPositions.erase(last.first);
+        m_lru.pop_back();
+    }
+}
+
+DiskChunkCache::MappedChunkPtr DiskChunkCache::FindCachedChunk(ChunkIdType chunkId)
+{
+    auto mapped = m_lruPositions.find(chunkId);
+    if (mapped != m_lruPositions.end())
+    {
+        m_lru.splice(m_lru.begin(), m_lru, mapped->second);
+        return mapped->second->second;
+    }
+
+    auto location = m_locations.find(chunkId);
+    if (location == m_locations.end() && !m_writable)
+    {
+        // The main node may have stored the chunk in the meantime.
+        ScanRecords();
+        location = m_locations.find(chunkId);
+    }
+
+    if (location == m_locations.end())
+        return nullptr;
+
+    auto chunk = TryMap(chunkId, location->second);
+    if (chunk)
+        Touch(chunkId, chunk);
+    return chunk;
+}
+
+ChunkPtr DiskChunkCache::GetChunk(ChunkIdType chunkId)
+{
+    if (!IsEnabled())
+        return m_deserializer->GetChunk(chunkId);
+
+    {
+        lock_guard<mutex> lock(m_lock);
+        auto cached = FindCachedChunk(chunkId);
+        if (cached)
+            return cached;
+    }
+
+    // The lock is not held while deserializing, so that chunks requested by several
+    // prefetch threads are still parsed concurrently on a cold cache.
+    auto chunk = m_deserializer->GetChunk(chunkId);
+
+    lock_guard<mutex> lock(m_lock);
+    if (!m_writable)
+        return chunk;
+
+    // Another thread may have stored the same chunk while this one was deserializing it.
+    bool isStored = m_locations.find(chunkId) != m_locations.end();
+    if (!isStored && !TryAppend(chunkId, chunk))
+        return chunk;
+
+    // Serve the chunk from the cache right away, so that the deserialized data
+    // does not have to be kept in memory twice.
+    auto cached = FindCachedChunk(chunkId);
+    return cached ? cached : chunk;
+}
+
+size_t DiskChunkCache::NumberOfCachedChunks()
+{
+    if (!IsEnabled())
+        return 0;
+
+    lock_guard<mutex> lock(m_lock);
+    if (!m_writable)
+        ScanRecords();
+    return m_locations.size();
+}
+
+size_t DiskChunkCache::ResidentBytes()
+{
+    lock_guard<mutex> lock(m_lock);
+    return m_residentBytes;
+}
+
+/*static*/ uint64_t DiskChunkCache::ComputeKey(const ConfigParameters& config)
+{
+    // Options that only affect how the data is randomized, traced or cached do not change the deserialized chunks.
+    static const vector<string> ignoredPrefixes = {
+        "persistentchunkcache", "keepdatainmemory", "cacheindex", "tracelevel", "verbosity", "randomize", "randomizationwindow", "samplebasedrandomizationwindow"
+    };
+
+    uint64_t key = Hash(s_hashOffsetBasis, s_version);
+    for (const auto& entry : config)
+    {
+        string name = entry.first;
+        transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower(c); });
+        if (any_of(ignoredPrefixes.begin(), ignoredPrefixes.end(), [&name](const string& prefix) { return name.compare(0, prefix.size(), prefix) == 0; }))
+            continue;
+
+        key = Hash(key, name);
+        key = Hash(key, (const string&)entry.second);
+    }
+    return key;
+}
+
+DataDeserializerPtr WrapWithDiskChunkCache(DataDeserializerPtr deserializer, const ConfigParameters& config)
+{
+    if (!config(L"persistentChunkCache", false))
+        return deserializer;
+
+    vector<wstring> inputs;
+    if (config.Exists(L"file"))
+        inputs.push_back(ToFixedWStringFromMultiByte(config(L"file")));
+    if (config.Exists(L"persistentChunkCacheInputs"))
+    {
+        ConfigArray additionalInputs = config(L"persistentChunkCacheInputs");
+        for (const auto& input : additionalInputs)
+            inputs.push_back(ToFixedWStringFromMultiByte(input));
+    }
+
+    uint64_t key = DiskChunkCache::ComputeKey(config);
+
+    wstring cacheFilename;
+    if (config.Exists(L"persistentChunkCacheFile"))
+    {
+        cacheFilename = ToFixedWStringFromMultiByte(config(L"persistentChunkCacheFile"));
+    }
+    else
+    {
+        if (inputs.empty())
+            InvalidArgument("persistentChunkCache requires either 'file' or 'persistentChunkCacheFile' to be specified.");
+
+        // Different configurations of the same input get different cache files.
+        wstringstream wss;
+        wss << inputs.front() << L"." << hex << key << L".v" << dec << DiskChunkCache::s_version << L".chunkcache";
+        cacheFilename = wss.str();
+    }
+
+    // A single writer in the whole job, the cache file may be on a file system shared by several hosts.
+    // The other workers do not open a stale cache, they wait for the main node to rebuild it (see TryOpenReadOnly()).
+    bool isMainNode = EnvironmentUtil::GetMPIWorldRank() == 0;
+    if (isMainNode)
+    {
+        for (const auto& input : inputs)
+        {
+            if (!msra::files::fuptodate(cacheFilename, input, true))
+            {
+                _wunlink(cacheFilename.c_str());
+                break;
+            }
+        }
+    }
+
+    size_t maxResidentBytes = config(L"persistentChunkCacheMaxResidentBytes", g_4GB);
+    int traceLevel = config(L"traceLevel", 1);
+    return make_shared<DiskChunkCache>(deserializer, cacheFilename, key, maxResidentBytes, traceLevel, isMainNode, inputs);
+}
+
+}
@@ -0,0 +1,135 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "DataDeserializer.h"
+#include "FileWrapper.h"
+#include "Config.h"
+
+namespace CNTK {
+
+// A persistent counterpart of the ChunkCache. Decoded chunks (the dense and sparse sequence data
+// produced by the wrapped deserializer) are appended to a cache file the first time they are requested,
+// and are served from a read-only memory mapping of that file afterwards, in this and in later runs.
+// This way only the first pass over the data pays for parsing text, labels or images.
+//
+// The cache file starts with a header that contains a key identifying the deserializer configuration
+// and the stream layout; a cache with a different key is discarded. Chunks are stored as self-contained
+// records, so that a cache that was only partially written (i.e. a job that did not finish a sweep
+// or a worker that only saw its own chunks) can still be used and is completed on demand.
+// Only the main node (rank 0 of the whole MPI job, across hosts) writes. Other workers open the cache read-only
+// once the main node has created it (and it is newer than all inputs), and pick up the chunks written so far;
+// until then they retry on every chunk request and read from the deserializer.
+//
+// At most maxResidentBytes of chunk records are kept mapped by the cache itself (least recently used
+// chunks are unmapped first); chunks that are still referenced by the randomizer stay mapped until released.
+class DiskChunkCache : public DataDeserializer
+{
+public:
+    // 'writable' is true for the single writer of the cache. A read-only cache is only used while it is newer than all 'inputs'.
+    DiskChunkCache(DataDeserializerPtr deserializer, const std::wstring& cacheFilename, uint64_t key, size_t maxResidentBytes, int traceLevel = 0,
+                   bool writable = true, const std::vector<std::wstring>& inputs = std::vector<std::wstring>());
+
+    virtual std::vector<StreamInformation> StreamInfos() override
+    {
+        return m_streams;
+    }
+
+    virtual std::vector<ChunkInfo> ChunkInfos() override
+    {
+        return m_deserializer->ChunkInfos();
+    }
+
+    virtual void SequenceInfosForChunk(ChunkIdType chunkId, std::vector<SequenceInfo>& descriptions) override
+    {
+        return m_deserializer->SequenceInfosForChunk(chunkId, descriptions);
+    }
+
+    virtual bool GetSequenceInfo(const SequenceInfo& primary, SequenceInfo& description) override
+    {
+        return m_deserializer->GetSequenceInfo(primary, description);
+    }
+
+    // Gets chunk data given its id, from the cache file if the chunk has been stored already.
+    virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
+
+    // Returns the number of chunks that are currently available in the cache file.
+    size_t NumberOfCachedChunks();
+
+    // Returns the number of bytes of chunk records currently mapped by the cache.
+    size_t ResidentBytes();
+
+    // Computes the cache key for the given deserializer configuration. The stream layout of the
+    // wrapped deserializer is added to the key by the cache itself.
+    static uint64_t ComputeKey(const Microsoft::MSR::CNTK::ConfigParameters& config);
+
+    // Current version of the cache file format.
+    static const uint64_t s_version = 1;
+
+private:
+    class MappedRegion;
+    class MappedChunk;
+    typedef std::shared_ptr<MappedChunk> MappedChunkPtr;
+
+    struct CachedChunkLocation
+    {
+        uint64_t offset; // offset of the record in the cache file
+        uint64_t size;   // size of the record including its header and trailer
+        uint32_t numberOfSequences;
+    };
+
+    bool OpenOrCreate(bool writable);
+    bool IsEnabled();
+    bool TryOpenReadOnly();
+    void ScanRecords();
+    bool TryAppend(ChunkIdType chunkId, const ChunkPtr& chunk);
+    MappedChunkPtr TryMap(ChunkIdType chunkId, const CachedChunkLocation& location);
+    void Touch(ChunkIdType chunkId, const MappedChunkPtr& chunk);
+
+    // Returns the chunk from the cache file, or nullptr if it is not stored (yet). Expects m_lock to be held.
+    MappedChunkPtr FindCachedChunk(ChunkIdType chunkId);
+
+    DataDeserializerPtr m_deserializer;
+    std::vector<StreamInformation> m_streams;
+    std::wstring m_cacheFilename;
+    uint64_t m_key;
+    size_t m_maxResidentBytes;
+    int m_traceLevel;
+
+    bool m_enabled;  // false if the cache could not be opened, all requests are then passed through
+    bool m_writable; // true if this worker appends missing chunks to the cache file
+    bool m_waitingForWriter;           // true while a read-only cache waits for the main node to (re)create the cache file
+    std::vector<std::wstring> m_inputs; // files the cache must be newer than to be opened read-only
+
+    std::unique_ptr<FileWrapper> m_file; // opened for reading (and for appending on the main node)
+    uint64_t m_scannedBytes;             // size of the valid prefix of the cache file
+    std::map<ChunkIdType, CachedChunkLocation> m_locations;
+
+    // Mapped chunks in the order of use, the most recently used first.
+    std::list<std::pair<ChunkIdType, MappedChunkPtr>> m_lru;
+    std::unordered_map<ChunkIdType, std::list<std::pair<ChunkIdType, MappedChunkPtr>>::iterator> m_lruPositions;
+    size_t m_residentBytes;
+
+    std::mutex m_lock;
+
+    DISABLE_COPY_AND_MOVE(DiskChunkCache);
+};
+
+// Wraps the deserializer into a DiskChunkCache if 'persistentChunkCache' is set in its configuration,
+// otherwise returns the deserializer as is. Recognized options:
+//   persistentChunkCache                 - true to enable the cache (default: false)
+//   persistentChunkCacheFile             - path to the cache file (default: derived from 'file' and the cache key)
+//   persistentChunkCacheInputs           - additional input files the cache depends on (colon separated)
+//   persistentChunkCacheMaxResidentBytes - bound on the chunk records kept mapped by the cache (default: 4 GB)
+// The cache is discarded if it is older than 'file' or any of the additional inputs.
+DataDeserializerPtr WrapWithDiskChunkCache(DataDeserializerPtr deserializer, const Microsoft::MSR::CNTK::ConfigParameters& config);
+
+}
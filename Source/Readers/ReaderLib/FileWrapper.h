@@ -166,7 +166,7 @@ public:
 
     // This method should not be used if T has bare pointers as its members.
     template <typename T, typename std::enable_if<std::is_pod<T>::value>::type* = nullptr>
-    inline bool WriteOrDie(const T& value)
+    inline void WriteOrDie(const T& value)
     {
         WriteOrDie(&value, sizeof(value), 1);
     }
@@ -21,11 +21,21 @@ IndexBuilder::IndexBuilder(const FileWrapper& input)
     : m_input(input),
     m_corpus(nullptr),
     m_isCacheEnabled(false),
+    m_isCacheWriteAsync(true),
+    m_numThreads(0),
+    m_minBytesPerThread(g_64MB),
     m_chunkSize(g_32MB),
     m_bufferSize(g_2MB),
     m_primary(true)
 {}
 
+size_t IndexBuilder::GetNumberOfRanges(size_t inputSize) const
+{
+    size_t numThreads = (m_numThreads > 0) ? m_numThreads : thread::hardware_concurrency();
+    size_t minBytesPerThread = max<size_t>(m_minBytesPerThread, 1);
+    return max<size_t>(1, min(numThreads, inputSize / minBytesPerThread));
+}
+
 shared_ptr<Index> IndexBuilder::Build()
 {
     if (m_isCacheEnabled) 
@@ -54,7 +64,7 @@ shared_ptr<Index> IndexBuilder::Build()
         // For now, we do not cache index if input contains non-numeric sequence ids 
         // and the corpus does not use a (deterministic and stateless) hashing procedure
         // to transform sequence ids into numeric keys.
-        WriteIndexCacheAsync(index);
+        WriteIndexCache(index);
     }
 
     if (!m_primary)
@@ -63,7 +73,7 @@ shared_ptr<Index> IndexBuilder::Build()
 }
 
 
-void IndexBuilder::WriteIndexCacheAsync(shared_ptr<Index>& index) 
+void IndexBuilder::WriteIndexCache(shared_ptr<Index>& index) 
 {
     if (!m_isCacheEnabled)
         return;
@@ -73,52 +83,68 @@ void IndexBuilder::WriteIndexCacheAsync(shared_ptr<Index>& index)
     
     auto cacheFilename = GetCacheFilename();
 
+    if (!m_isCacheWriteAsync)
+    {
+        if (!TryWriteIndexCache(cacheFilename, index))
+            RuntimeError("Failed to write the index cache file '%ls'.", cacheFilename.c_str());
+        return;
+    }
+
     // using thread(lambda).detach() as a workaround the blocking
     // async destructor.
     thread([cacheFilename, index]()
     {
-        // At this point, it's safe to assume that the previous cache is stale,
-        // remove the cache file if it exists (return value is ignored).
-        _wunlink(cacheFilename.c_str());
+        TryWriteIndexCache(cacheFilename, index);
+    }).detach();
+}
 
-        bool isCacheEnabled = true;
-        auto temp = cacheFilename + L".tmp";
-        {
-            FileWrapper cache(temp, L"wb");
-            isCacheEnabled = cache.IsOpen();
+/*static*/ bool IndexBuilder::TryWriteIndexCache(const wstring& cacheFilename, const shared_ptr<Index>& index)
+{
+    // At this point, it's safe to assume that the previous cache is stale,
+    // remove the cache file if it exists (return value is ignored).
+    _wunlink(cacheFilename.c_str());
+
+    bool isCacheEnabled = true;
+    auto temp = cacheFilename + L".tmp";
+    {
+        FileWrapper cache(temp, L"wb");
+        isCacheEnabled = cache.IsOpen();
 
-            Prefix prefix(s_magic, s_version, index->NumberOfSequences(), uint64_t(sizeof(Prefix)));
+        Prefix prefix(s_magic, s_version, index->NumberOfSequences(), uint64_t(sizeof(Prefix)));
 
-            isCacheEnabled = isCacheEnabled && cache.TryWrite(prefix);
+        isCacheEnabled = isCacheEnabled && cache.TryWrite(prefix);
 
-            IndexedSequence cachedSequence;
-            for (auto& chunk : index->Chunks())
+        IndexedSequence cachedSequence;
+        for (auto& chunk : index->Chunks())
+        {
+            for (auto& sequence : chunk.Sequences())
             {
-                for (auto& sequence : chunk.Sequences())
-                {
-                    cachedSequence.SetKey(sequence.m_key)
-                        .SetNumberOfSamples(sequence.NumberOfSamples())
-                        .SetSize(sequence.SizeInBytes())
-                        .SetOffset(chunk.StartOffset() + sequence.OffsetInChunk());
-
-                    isCacheEnabled = isCacheEnabled && cache.TryWrite(cachedSequence);
-                }
-            }
+                cachedSequence.SetKey(sequence.m_key)
+                    .SetNumberOfSamples(sequence.NumberOfSamples())
+                    .SetSize(sequence.SizeInBytes())
+                    .SetOffset(chunk.StartOffset() + sequence.OffsetInChunk());
 
-            isCacheEnabled = isCacheEnabled && cache.TryFlush();
+                isCacheEnabled = isCacheEnabled && cache.TryWrite(cachedSequence);
+            }
         }
-        
 
-        if (isCacheEnabled) 
+        isCacheEnabled = isCacheEnabled && cache.TryFlush();
+    }
+
+    if (isCacheEnabled) 
+    {
+        try 
         {
-            try 
-            {
-                // TODO: add TryRename that does not throw.
-                renameOrDie(temp, cacheFilename);
-            }
-            catch (...) {}
+            // TODO: add TryRename that does not throw.
+            renameOrDie(temp, cacheFilename);
         }
-    }).detach();
+        catch (...) 
+        {
+            isCacheEnabled = false;
+        }
+    }
+
+    return isCacheEnabled;
 }
 
 const static size_t s_sequenceSize = sizeof(IndexedSequence);
@@ -218,28 +244,30 @@ static const char s_BOM[3] = { '\xEF', '\xBB', '\xBF' };
     if (m_fileSize == 0)
         RuntimeError("Input file is empty");
 
-    m_reader.reset(new BufferedFileReader(m_bufferSize, m_input));
+    BufferedFileReader reader(m_bufferSize, m_input);
 
     index->Reserve(m_fileSize);
 
     // skip BOM prefix at the very beginning of the input file if it's there.
     for (char ch : s_BOM) 
     {
-        if (!m_reader->Empty() && m_reader->Peek() == ch)
-            m_reader->Pop();
+        if (!reader.Empty() && reader.Peek() == ch)
+            reader.Pop();
         else break;
     }
 
     if (!isspace(m_streamPrefix))
     {
         // as long as the stream prefix is not a white space, it's safe to skip all leading spaces.
-        while (isspace(m_reader->Peek()) && m_reader->Pop()); 
+        while (isspace(reader.Peek()) && reader.Pop()); 
     }
 
-    if (m_reader->Empty())
+    if (reader.Empty())
         RuntimeError("Input file is empty");
 
-    if (m_skipSequenceIds || (!m_reader->Empty() && m_reader->Peek() == m_streamPrefix))
+    bool fromLines = m_skipSequenceIds || (!reader.Empty() && reader.Peek() == m_streamPrefix);
+
+    if (fromLines)
     {
         // Skip sequence id parsing, treat lines as individual sequences
         // In this case the sequences do not have ids, they are assigned corresponding line numbers
@@ -247,73 +275,205 @@ static const char s_BOM[3] = { '\xEF', '\xBB', '\xBF' };
         if (m_corpus && !m_corpus->IsNumericSequenceKeys())
             RuntimeError("Corpus expects non-numeric sequence keys present but the input file does not have them."
                 "Please use the configuration to enable numeric keys instead.");
+    }
+
+    // Symbolic ids are mapped to keys by the corpus, which is only thread-safe when hashing is used.
+    bool canSplit = !m_corpus || m_corpus->IsNumericSequenceKeys() || m_corpus->IsHashingEnabled();
+    size_t numberOfRanges = canSplit ? GetNumberOfRanges(m_fileSize - reader.GetFileOffset()) : 1;
 
-        PopulateFromLines(index);
+    if (numberOfRanges > 1)
+    {
+        PopulateInParallel(index, reader, numberOfRanges, fromLines);
+        return;
     }
+
+    auto addSequence = [&index](const IndexedSequence& sequence) { index->AddSequence(sequence); };
+    if (fromLines)
+        PopulateFromLines(reader, m_fileSize, addSequence);
     else 
+        PopulateImpl(reader, m_fileSize, addSequence);
+}
+
+void TextInputIndexBuilder::PopulateInParallel(shared_ptr<Index>& index, BufferedFileReader& reader, size_t numberOfRanges, bool fromLines)
+{
+    // Ranges are resynchronized to start at the first sequence (or line) boundary
+    // following an even split of the input.
+    size_t firstOffset = reader.GetFileOffset();
+    size_t rangeSize = (m_fileSize - firstOffset) / numberOfRanges;
+
+    vector<future<size_t>> rangeStarts;
+    for (size_t i = 1; i < numberOfRanges; ++i)
+    {
+        size_t offset = firstOffset + i * rangeSize;
+        rangeStarts.push_back(async(launch::async, [this, offset, fromLines]() { return FindRangeStart(offset, fromLines); }));
+    }
+
+    vector<size_t> offsets(1, firstOffset);
+    for (auto& start : rangeStarts)
+        offsets.push_back(max(start.get(), offsets.back()));
+    offsets.push_back(m_fileSize);
+
+    struct RangeIndex
+    {
+        vector<IndexedSequence> sequences;
+        size_t numberOfLines; // number of lines in the range (used to compute line-based keys)
+    };
+
+    auto indexRange = [this, fromLines](BufferedFileReader& rangeReader, size_t endOffset, RangeIndex& result)
+    {
+        auto addSequence = [&result](const IndexedSequence& sequence) { result.sequences.push_back(sequence); };
+        if (fromLines)
+            PopulateFromLines(rangeReader, endOffset, addSequence);
+        else
+            PopulateImpl(rangeReader, endOffset, addSequence);
+        result.numberOfLines = rangeReader.CurrentLineNumber();
+    };
+
+    vector<RangeIndex> ranges(numberOfRanges);
+    vector<future<void>> workers;
+    for (size_t i = 1; i < numberOfRanges; ++i)
+    {
+        if (offsets[i] >= offsets[i + 1])
+        {
+            ranges[i].numberOfLines = 0;
+            continue;
+        }
+
+        workers.push_back(async(launch::async, [this, i, &offsets, &ranges, &indexRange]()
+        {
+            FileWrapper file(m_input.Filename(), L"rbS");
+            file.CheckIsOpenOrDie();
+            file.SeekOrDie(offsets[i], SEEK_SET);
+            BufferedFileReader rangeReader(m_bufferSize, file);
+            indexRange(rangeReader, offsets[i + 1], ranges[i]);
+        }));
+    }
+
+    // The first range is indexed on this thread, using the reader that has already skipped the preamble.
+    indexRange(reader, offsets[1], ranges[0]);
+
+    for (auto& worker : workers)
+        worker.get(); // rethrows exceptions, if any
+
+    size_t lineOffset = 0;
+    for (auto& range : ranges)
     {
-        PopulateImpl(index);
+        for (auto& sequence : range.sequences)
+        {
+            if (fromLines)
+                sequence.SetKey(sequence.key + lineOffset);
+            index->AddSequence(sequence);
+        }
+
+        lineOffset += range.numberOfLines;
+        vector<IndexedSequence>().swap(range.sequences);
     }
 }
 
-void TextInputIndexBuilder::PopulateFromLines(shared_ptr<Index>& index)
+size_t TextInputIndexBuilder::FindRangeStart(size_t offset, bool fromLines)
+{
+    FileWrapper file(m_input.Filename(), L"rbS");
+    file.CheckIsOpenOrDie();
+    file.SeekOrDie(offset - 1, SEEK_SET);
+    BufferedFileReader reader(m_bufferSize, file);
+
+    // Move to the beginning of the first line that starts at or after the offset.
+    if (reader.Empty())
+        return m_fileSize;
+
+    bool atEndOfLine = (reader.Peek() == g_eol);
+    if (!(atEndOfLine ? reader.Pop() : reader.TryMoveToNextLine()))
+        return m_fileSize;
+
+    if (fromLines)
+        return reader.GetFileOffset();
+
+    // A sequence might have started before the offset, skip all the lines that have the same id 
+    // as the first line with an id (lines without an id belong to the current sequence).
+    bool found = false;
+    size_t firstId = 0, id = 0;
+    do 
+    {
+        size_t lineOffset = reader.GetFileOffset();
+        if (TryGetSequenceId(reader, id))
+        {
+            if (!found)
+            {
+                found = true;
+                firstId = id;
+            }
+            else if (id != firstId)
+                return lineOffset;
+        }
+    } while (reader.TryMoveToNextLine());
+
+    return m_fileSize;
+}
+
+void TextInputIndexBuilder::PopulateFromLines(BufferedFileReader& reader, size_t endOffset, const SequenceSink& addSequence)
 {
     IndexedSequence sequence;
-    while (!m_reader->Empty())
+    while (!reader.Empty())
     {
-        size_t offset = m_reader->GetFileOffset();
+        size_t offset = reader.GetFileOffset();
+
+        if (offset >= endOffset)
+            break;
 
-        if (!FindMainStream())
+        if (!FindMainStream(reader))
         { 
             // skip lines that do not contain main stream name.
-            m_reader->TryMoveToNextLine();
+            reader.TryMoveToNextLine();
             continue;
         }
 
-        sequence.SetNumberOfSamples(1).SetOffset(offset).SetKey(m_reader->CurrentLineNumber());
+        sequence.SetNumberOfSamples(1).SetOffset(offset).SetKey(reader.CurrentLineNumber());
 
-        if (m_reader->TryMoveToNextLine())
+        if (reader.TryMoveToNextLine())
         {
-            sequence.SetSize(m_reader->GetFileOffset() - offset);
-            index->AddSequence(sequence);
+            sequence.SetSize(reader.GetFileOffset() - offset);
+            addSequence(sequence);
         } 
         else  if (offset < m_fileSize)
         {
             // There's a number of characters, not terminated by a newline,
             // add a sequence to the index, parser will have to deal with it.
             sequence.SetSize(m_fileSize - offset);
-            index->AddSequence(sequence);
+            addSequence(sequence);
             break;
         }
     }
 }
 
-void TextInputIndexBuilder::PopulateImpl(shared_ptr<Index>& index)
+void TextInputIndexBuilder::PopulateImpl(BufferedFileReader& reader, size_t endOffset, const SequenceSink& addSequence)
 {
     IndexedSequence sequence;
     uint32_t numberOfSamples = 0;
     bool foundMainStream = false;
-    size_t prevId = 0, nextId = 0, prevOffset = m_reader->GetFileOffset();
+    size_t prevId = 0, nextId = 0, prevOffset = reader.GetFileOffset();
 
     // Go ahead and read the id of the very first sequence.
-    if (!TryGetSequenceId(prevId))
+    if (!TryGetSequenceId(reader, prevId))
     {
         RuntimeError("Expected a sequence id at the offset %zu, none was found.", prevOffset);
     }
 
-    while (!m_reader->Empty())
+    while (!reader.Empty())
     {
-        if (FindMainStream())
+        if (FindMainStream(reader))
         {
             numberOfSamples++;
             foundMainStream = true;
         }
 
-        m_reader->TryMoveToNextLine(); // ignore whatever is left on this line.
+        reader.TryMoveToNextLine(); // ignore whatever is left on this line.
 
-        auto offset = m_reader->GetFileOffset(); // a new line starts at this offset;
+        auto offset = reader.GetFileOffset(); // a new line starts at this offset;
+
+        if (offset >= endOffset)
+            break; // the rest of the input is indexed separately, the next sequence starts at endOffset.
         
-        if (TryGetSequenceId(nextId) && nextId != prevId)
+        if (TryGetSequenceId(reader, nextId) && nextId != prevId)
         {
             // found a new sequence, which starts at the [offset] bytes into the file
             // adding the previous one to the index.
@@ -327,26 +487,27 @@ void TextInputIndexBuilder::PopulateImpl(shared_ptr<Index>& index)
             numberOfSamples = 0;
             
             if (foundMainStream)
-                index->AddSequence(sequence);
+                addSequence(sequence);
             foundMainStream = false;
         }
     }
 
-    if (prevOffset < m_fileSize)
+    endOffset = min(endOffset, m_fileSize);
+    if (prevOffset < endOffset)
     {
         sequence.SetKey(prevId)
             .SetNumberOfSamples(numberOfSamples)
             .SetOffset(prevOffset)
-            .SetSize(m_fileSize - prevOffset);
+            .SetSize(endOffset - prevOffset);
         
         if (foundMainStream)
-            index->AddSequence(sequence);
+            addSequence(sequence);
     }
 }
 
-inline bool TextInputIndexBuilder::FindMainStream()
+inline bool TextInputIndexBuilder::FindMainStream(BufferedFileReader& reader)
 {
-    if (m_reader->Empty())
+    if (reader.Empty())
         return false;
     
     if (m_mainStream.empty())
@@ -357,7 +518,7 @@ inline bool TextInputIndexBuilder::FindMainStream()
     int i = 0;
     do  
     {
-        char c = m_reader->Peek();
+        char c = reader.Peek();
         if (i == length)
         {
             // we found a match, check to see if it's followed by either a space, 
@@ -375,30 +536,30 @@ inline bool TextInputIndexBuilder::FindMainStream()
 
         if (c == g_eol)
             break;
-    } while (m_reader->Pop());
+    } while (reader.Pop());
 
     // we hit either the EOL or the EOF, see if we have a match
     return (i == length);
 }
 
-inline bool TextInputIndexBuilder::TryGetSequenceId(size_t& id)
+inline bool TextInputIndexBuilder::TryGetSequenceId(BufferedFileReader& reader, size_t& id)
 {
     if (m_corpus && !m_corpus->IsNumericSequenceKeys())
-        return TryGetSymbolicSequenceId(id, m_corpus->KeyToId);
+        return TryGetSymbolicSequenceId(reader, id, m_corpus->KeyToId);
 
-    return TryGetNumericSequenceId(id);
+    return TryGetNumericSequenceId(reader, id);
 }
 
-inline bool TextInputIndexBuilder::TryGetNumericSequenceId(size_t& id)
+inline bool TextInputIndexBuilder::TryGetNumericSequenceId(BufferedFileReader& reader, size_t& id)
 {
-    if (m_reader->Empty())
+    if (reader.Empty())
         return false;
 
     bool found = false;
     id = 0;
     do
     {
-        char c = m_reader->Peek();
+        char c = reader.Peek();
         if (!isdigit(c))
             // Stop as soon as there's a non-digit character
             return found;
@@ -409,16 +570,16 @@ inline bool TextInputIndexBuilder::TryGetNumericSequenceId(size_t& id)
             RuntimeError("Overflow while reading a numeric sequence id (%zu-bit value).", sizeof(id));
         
         found = true;
-    } while (m_reader->Pop());
+    } while (reader.Pop());
 
     // reached EOF without hitting the pipe character,
     // ignore it for now, parser will have to deal with it.
     return false;
 }
 
-inline bool TextInputIndexBuilder::TryGetSymbolicSequenceId(size_t& id, function<size_t(const string&)> keyToId)
+inline bool TextInputIndexBuilder::TryGetSymbolicSequenceId(BufferedFileReader& reader, size_t& id, function<size_t(const string&)> keyToId)
 {
-    if (m_reader->Empty())
+    if (reader.Empty())
         return false;
 
     bool found = false;
@@ -427,7 +588,7 @@ inline bool TextInputIndexBuilder::TryGetSymbolicSequenceId(size_t& id, function
     key.reserve(256);
     do
     {
-        char c = m_reader->Peek();
+        char c = reader.Peek();
         if (isspace(c))
         {
             if (found)
@@ -437,7 +598,7 @@ inline bool TextInputIndexBuilder::TryGetSymbolicSequenceId(size_t& id, function
 
         key += c;
         found = true;
-    } while (m_reader->Pop());
+    } while (reader.Pop());
 
     // reached EOF without hitting the pipe character,
     // ignore it for now, parser will have to deal with it.
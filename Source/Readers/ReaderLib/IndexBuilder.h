@@ -25,6 +25,7 @@ class IndexedSequence
 
     friend class Index;
     friend class ChunkDescriptor;
+    friend class TextInputIndexBuilder;
     
 public:
     IndexedSequence& SetKey(size_t value) { key = value; return *this;  }
@@ -76,6 +77,16 @@ public:
 
     IndexBuilder& SetCachingEnabled(bool value) { m_isCacheEnabled = value; return *this; }
 
+    // When false, the index cache is written out before Build() returns (by default, it's written
+    // in the background, so that the training can start right away).
+    IndexBuilder& SetAsyncCacheWrite(bool value) { m_isCacheWriteAsync = value; return *this; }
+
+    // Number of threads used to index the input (0 = number of hardware threads).
+    // The input is only split if every thread gets at least minBytesPerThread bytes.
+    IndexBuilder& SetNumThreads(size_t numThreads) { m_numThreads = numThreads; return *this; }
+
+    IndexBuilder& SetMinBytesPerThread(size_t size) { m_minBytesPerThread = size; return *this; }
+
     virtual std::wstring GetCacheFilename() = 0;
 
 protected:
@@ -92,12 +103,21 @@ protected:
     size_t m_chunkSize;
 
     bool m_isCacheEnabled;
+    bool m_isCacheWriteAsync;
+
+    size_t m_numThreads;
+    size_t m_minBytesPerThread;
+
+    // Returns the number of byte ranges the input of the given size should be split into
+    // to be indexed in parallel.
+    size_t GetNumberOfRanges(size_t inputSize) const;
 
     static const uint64_t s_version = 1;
 
 private:
     static std::shared_ptr<Index> TryLoadFromCache(const std::wstring& cacheFilename, size_t chunkSize);
-    void WriteIndexCacheAsync(std::shared_ptr<Index>& index);
+    static bool TryWriteIndexCache(const std::wstring& cacheFilename, const std::shared_ptr<Index>& index);
+    void WriteIndexCache(std::shared_ptr<Index>& index);
     std::shared_ptr<Index> m_index;
 
     static const uint64_t s_magic = 0x636e746b5f696478; // 'cntk_idx'
@@ -142,31 +162,42 @@ private:
     std::string m_mainStream;
     std::unique_ptr<KMP> m_nfa; 
 
-    std::unique_ptr<BufferedFileReader> m_reader;
+    typedef std::function<void(const IndexedSequence&)> SequenceSink;
 
     // Returns true if main stream name if found on the current line.
-    bool FindMainStream();
+    bool FindMainStream(BufferedFileReader& reader);
 
     // Invokes either TryGetNumericSequenceId or TryGetSymbolicSequenceId depending
     // on the specified corpus settings.
-    bool TryGetSequenceId(size_t& id);
+    bool TryGetSequenceId(BufferedFileReader& reader, size_t& id);
 
     // Tries to get numeric sequence id.
     // Throws an exception if a non-numerical is read until the pipe character or 
     // EOF is reached without hitting the pipe character.
     // Returns false if no numerical characters are found preceding the pipe.
     // Otherwise, writes sequence id value to the provided reference, returns true.
-    bool TryGetNumericSequenceId(size_t& id);
+    bool TryGetNumericSequenceId(BufferedFileReader& reader, size_t& id);
 
     // Same as above but for symbolic ids.
     // It reads a symbolic key and converts it to numeric id using provided keyToId function.
-    bool TryGetSymbolicSequenceId(size_t& id, std::function<size_t(const std::string&)> keyToId);
+    bool TryGetSymbolicSequenceId(BufferedFileReader& reader, size_t& id, std::function<size_t(const std::string&)> keyToId);
 
-    void PopulateImpl(std::shared_ptr<Index>& index);
+    // Indexes sequences (with explicit sequence ids) that start in the range 
+    // [current reader position, endOffset).
+    void PopulateImpl(BufferedFileReader& reader, size_t endOffset, const SequenceSink& addSequence);
 
     // Parses input line by line, treating each line as an individual sequence.
-    // Ignores sequence id information, using the line number instead as the id.
-    void PopulateFromLines(std::shared_ptr<Index>& index);
+    // Ignores sequence id information, using the line number (relative to the 
+    // start of the reader) instead as the id. Stops at the first line starting at or after endOffset.
+    void PopulateFromLines(BufferedFileReader& reader, size_t endOffset, const SequenceSink& addSequence);
+
+    // Splits the input into byte ranges starting at sequence boundaries (or at line boundaries, if 
+    // the input has no sequence ids) and indexes the ranges in parallel. The reader is positioned
+    // at the beginning of the first sequence.
+    void PopulateInParallel(std::shared_ptr<Index>& index, BufferedFileReader& reader, size_t numberOfRanges, bool fromLines);
+
+    // Returns the offset of the first sequence (or line) that starts at or after the given offset.
+    size_t FindRangeStart(size_t offset, bool fromLines);
 };
 
 }
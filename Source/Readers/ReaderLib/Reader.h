@@ -120,6 +120,12 @@ public:
     // Set current global position
     virtual void SetState(const std::map<std::wstring, size_t>& state) = 0;
 
+    // Returns named statistics of the current epoch (e.g. of the chunk prefetching), empty if the reader has none.
+    virtual std::map<std::wstring, double> GetStatistics()
+    {
+        return std::map<std::wstring, double>();
+    }
+
     virtual ~Reader() {};
 };
 
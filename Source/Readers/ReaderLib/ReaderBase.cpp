@@ -74,6 +74,11 @@ void ReaderBase::SetState(const std::map<std::wstring, size_t>& state)
     m_packer->Reset();
 }
 
+std::map<std::wstring, double> ReaderBase::GetStatistics()
+{
+    return m_sequenceEnumerator->GetStatistics();
+}
+
 void ReaderBase::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>&)
 {
     m_sequenceEnumerator->SetConfiguration(config);
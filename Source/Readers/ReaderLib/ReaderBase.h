@@ -32,6 +32,8 @@ namespace CNTK {
 
         void SetState(const std::map<std::wstring, size_t>& state) override;
 
+        std::map<std::wstring, double> GetStatistics() override;
+
         void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions) override;
 
         virtual ~ReaderBase() = 0;
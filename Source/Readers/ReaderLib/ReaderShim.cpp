@@ -88,6 +88,7 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     }
 
     m_currentState = m_reader->GetState();
+    m_currentStatistics = m_reader->GetStatistics();
 }
 
 template <class ElemType>
@@ -138,6 +139,7 @@ void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition
     m_endOfEpoch = false;
 
     m_currentState = m_reader->GetState();
+    m_currentStatistics = m_reader->GetStatistics();
 }
 
 template <class ElemType>
@@ -210,6 +212,7 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
     m_reader->StartEpoch(config, inputDescriptions);
 
     m_currentState = m_reader->GetState();
+    m_currentStatistics = m_reader->GetStatistics();
 }
 
 template <class ElemType>
@@ -275,6 +278,7 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 
     // Let's update our sample position.
     m_currentState = m_reader->GetState();
+    m_currentStatistics = m_reader->GetStatistics();
 
     m_endOfEpoch = result.m_isEndOfEpoch;
     m_endOfSweep = result.m_isEndOfSweep;
@@ -468,6 +472,13 @@ const std::map<std::wstring, size_t>& ReaderShim<ElemType>::GetState()
     return m_currentState;
 }
 
+template <class ElemType>
+std::map<std::wstring, double> ReaderShim<ElemType>::GetStatistics()
+{
+    // The reader may be prefetching the next minibatch, so the statistics are taken whenever a prefetch is done.
+    return m_currentStatistics;
+}
+
 template <class ElemType>
 void ReaderShim<ElemType>::SetState(const std::map<std::wstring, size_t>& state)
 {
@@ -486,6 +497,7 @@ void ReaderShim<ElemType>::SetState(const std::map<std::wstring, size_t>& state)
     // Set current position.
     m_reader->SetState(state);
     m_currentState = m_reader->GetState();
+    m_currentStatistics = m_reader->GetStatistics();
     m_endOfEpoch = false;
 }
 
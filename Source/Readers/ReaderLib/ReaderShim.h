@@ -102,6 +102,9 @@ public:
 
     const std::map<std::wstring, size_t>& GetState();
     void SetState(const std::map<std::wstring, size_t>& state);
+
+    // Statistics of the reader, as of the last minibatch that was returned.
+    virtual std::map<std::wstring, double> GetStatistics() override;
     void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions);
 
     bool IsEndOfEpoch() const
@@ -169,6 +172,7 @@ private:
     int m_deviceId;
 
     std::map<std::wstring, size_t> m_currentState;
+    std::map<std::wstring, double> m_currentStatistics;
 };
 
 }
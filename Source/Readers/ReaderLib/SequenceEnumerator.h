@@ -55,6 +55,12 @@ public:
     // Returns the current state of the enumerator.
     virtual std::map<std::wstring, size_t> GetState() = 0;
 
+    // Returns named statistics of the current epoch, e.g. the chunk prefetch counters of the BlockRandomizer.
+    virtual std::map<std::wstring, double> GetStatistics()
+    {
+        return std::map<std::wstring, double>();
+    }
+
     // Gets next sequences up to a maximum count of local and global samples.
     virtual Sequences GetNextSequences(size_t globalSampleCount, size_t localSampleCount) = 0;
 
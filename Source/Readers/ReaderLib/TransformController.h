@@ -65,6 +65,11 @@ public:
         m_sequenceProvider->SetState(state);
     }
 
+    std::map<std::wstring, double> GetStatistics() override
+    {
+        return m_sequenceProvider->GetStatistics();
+    }
+
     // Description of streams that the transformer provides.
     virtual std::vector<StreamInformation> GetStreamDescriptions() const override
     {
@@ -120,6 +120,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // BUGBUG: We should discount gaps.
         actualMBSize = net->DetermineActualMBSizeFromFeatures();
 
+        // now that the minibatch size is known, refine the memory sharing plan if needed
+        net->OptimizeMemorySharingForMinibatch();
+
         return true;
     }
 
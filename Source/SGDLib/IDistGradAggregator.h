@@ -19,6 +19,17 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) = 0;
 
+    // Returns true if the aggregator starts aggregating gradients during the backward pass, see OnGradientReady().
+    virtual bool OverlapsAggregation() const
+    {
+        return false;
+    }
+
+    // Called during the backward pass as soon as gradients[index] is complete, before AggregateGradients() is called
+    // with the same gradients. Aggregation overlaps best when the gradients are ordered as they get ready.
+    virtual void OnGradientReady(const std::vector<Matrix<ElemType>*>& /*gradients*/, size_t /*index*/)
+    {}
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -32,12 +32,14 @@
 
 #include "CNTKLibraryInternals.h"
 #include "SimpleDistGradAggregator.h"
+#include "SparseDistGradAggregator.h"
 #include "V2SimpleDistGradAggregator.h"
 #include "ProgressTracing.h"
 #include "PerformanceProfiler.h"
 
 #include <map>
 #include <set>
+#include <unordered_map>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -677,6 +679,16 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         for (size_t j = 0; j < epochEvalErrors.size(); j++)
             epochEvalErrors[j].LogCriterion(evaluationNodes[j]->NodeName());
         fprintf(stderr, "totalSamplesSeen = %zu; learningRatePerSample = %.8g; epochTime=%.6gs\n", totalTrainingSamplesSeen, learnRatePerSample, epochTime);
+
+        // e.g. the chunk prefetching of the reader in this epoch
+        auto readerStatistics = trainSetDataReader->GetStatistics();
+        if (m_traceLevel > 0 && !readerStatistics.empty())
+        {
+            LOGPRINTF(stderr, "Finished Epoch[%2d of %d]: [Reader] ", i + 1, (int)m_maxEpochs);
+            for (const auto& statistic : readerStatistics)
+                fprintf(stderr, "%ls = %.6g; ", statistic.first.c_str(), statistic.second);
+            fprintf(stderr, "\n");
+        }
 #if 0
         // TODO: This was only printed if >1 eval criterion. Why? Needed?
         LOGPRINTF(stderr, "Finished Epoch[%2d of %d]:     Criterion Node [%ls] Per Sample = %.8g\n",
@@ -696,6 +708,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             {
                 tensorBoardWriter->WriteValue(L"summary/" + evaluationNodes[0]->NodeName(), (float)epochEvalErrors[j].Average(), i + 1);
             }
+            for (const auto& statistic : readerStatistics)
+                tensorBoardWriter->WriteValue(L"reader/" + statistic.first, (float)statistic.second, i + 1);
 
             tensorBoardWriter->Flush();
         }
@@ -1034,6 +1048,11 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     }
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
+    std::unordered_map<ComputationNodeBasePtr, size_t> learnParamsGradientIndices; // position of the gradient of a node in learnParamsGradients
+
+    // The aggregation of the gradients may start during the backward pass.
+    bool overlapGradientAggregation = useGradientAggregation && m_distGradAgg->OverlapsAggregation();
+
     Profiler profiler(m_numMBsToCUDAProfile);
 
     // resetting this, so profiling is performed for one epoch only
@@ -1255,7 +1274,20 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // ===========================================================
 
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                {
+                    // With sub-minibatches the gradients are only complete after the last one.
+                    if (overlapGradientAggregation && !learnParamsGradients.empty() && actualNumSubminibatches == 1)
+                    {
+                        net->Backprop(criterionNodes[0], [&](const ComputationNodeBasePtr& node)
+                        {
+                            auto iter = learnParamsGradientIndices.find(node);
+                            if (iter != learnParamsGradientIndices.end())
+                                m_distGradAgg->OnGradientReady(learnParamsGradients, iter->second);
+                        });
+                    }
+                    else
+                        net->Backprop(criterionNodes[0]);
+                }
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -1304,8 +1336,21 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             if (learnParamsGradients.size() == 0)
             {
                 // lazily form the list of smoothedGradients to exchange
+                // With overlapped aggregation the gradients are ordered as they get ready, i.e. in reverse evaluation order.
+                std::vector<ComputationNodeBasePtr> gradientNodes(learnableNodes.begin(), learnableNodes.end());
+                if (overlapGradientAggregation)
+                {
+                    std::unordered_map<ComputationNodeBasePtr, size_t> evalOrderIndices;
+                    for (const auto& node : net->GetEvalOrder(criterionNodes[0]))
+                        evalOrderIndices.emplace(node, evalOrderIndices.size());
+                    std::stable_sort(gradientNodes.begin(), gradientNodes.end(), [&](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b)
+                    {
+                        return evalOrderIndices[a] > evalOrderIndices[b];
+                    });
+                }
+
                 learnParamsGradients.reserve(learnableNodes.size());
-                for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++)
+                for (auto nodeIter = gradientNodes.begin(); nodeIter != gradientNodes.end(); nodeIter++)
                 {
                     ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
                     if (node->IsParameterUpdateRequired())
@@ -1320,6 +1365,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                             currParamsGradient->Resize(currParamsValues->GetNumRows(), currParamsValues->GetNumCols());
                         }
 
+                        learnParamsGradientIndices[node] = learnParamsGradients.size();
                         learnParamsGradients.push_back(currParamsGradient);
                     }
                 }
@@ -2285,6 +2331,17 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
     }
+    else if (m_sparseGradientTopKRatio > 0 || m_sparseGradientThreshold > 0)
+    {
+        if (traceLevel > 0)
+        {
+            if (m_sparseGradientTopKRatio > 0)
+                fprintf(stderr, "Initializing dataParallelSGD with sparse aggregation of the top %g of each gradient.\n", m_sparseGradientTopKRatio);
+            else
+                fprintf(stderr, "Initializing dataParallelSGD with sparse aggregation of gradient values above %g.\n", m_sparseGradientThreshold);
+        }
+        m_distGradAgg = std::make_shared<SparseDistGradAggregator<ElemType>>(m_mpi, m_sparseGradientTopKRatio, m_sparseGradientThreshold, m_syncStatsTrace);
+    }
     else
     {
         if (traceLevel > 0)
@@ -2292,7 +2349,7 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
             m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, ::CNTK::MPICommunicator(m_packThresholdSizeInBytes));
         else
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes);
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes, m_gradientBucketSizeInBytes);
     }
 
     m_gradHeader.reset(DistGradHeader::Create(numEvalNodes), [](DistGradHeader* ptr) { DistGradHeader::Destroy(ptr); });
@@ -3129,6 +3186,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = vector<int>{8 * (int)sizeofElemType}; // means no quantization
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInBytes = 0;
+    m_sparseGradientTopKRatio = 0;
+    m_sparseGradientThreshold = 0;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
@@ -3162,11 +3222,27 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", ConfigRecordType::Array(intargvector(vector<int>{defaultGradientBits})));
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            m_gradientBucketSizeInBytes = configDataParallelSGD(L"gradientBucketSizeInKB", (size_t)0) * 1024;
+            m_sparseGradientTopKRatio = configDataParallelSGD(L"sparseGradientTopKRatio", 0.0);
+            m_sparseGradientThreshold = configDataParallelSGD(L"sparseGradientThreshold", 0.0);
             for (size_t i = 0; i < m_numGradientBits.size(); i++)
             {
                 if (m_numGradientBits[i] < 1 || m_numGradientBits[i] > defaultGradientBits)
                     InvalidArgument("gradientBits values must be in the range [1, 32] when using precision=float and in range [1, 64] when using precision=double.");
             }
+
+            if (m_sparseGradientTopKRatio > 0 || m_sparseGradientThreshold > 0)
+            {
+                if (m_sparseGradientTopKRatio < 0 || m_sparseGradientTopKRatio > 1)
+                    InvalidArgument("sparseGradientTopKRatio must be in the range [0, 1].");
+                if (m_bufferedAsyncGradientAggregation)
+                    InvalidArgument("Sparse gradient aggregation (sparseGradientTopKRatio, sparseGradientThreshold) cannot be combined with useBufferedAsyncGradientAggregation.");
+                for (size_t i = 0; i < m_numGradientBits.size(); i++)
+                {
+                    if (m_numGradientBits[i] != defaultGradientBits)
+                        InvalidArgument("Sparse gradient aggregation (sparseGradientTopKRatio, sparseGradientThreshold) cannot be combined with gradient quantization (gradientBits).");
+                }
+            }
         }
         if (configParallelTrain.Exists(L"ModelAveragingSGD"))
         {
@@ -292,6 +292,13 @@ protected:
     // Data parallel SGD training parameters
     intargvector m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
+    // Size of the buckets of gradients whose aggregation starts during the backward pass, 0 to aggregate after it
+    size_t m_gradientBucketSizeInBytes;
+
+    // Sparse gradient aggregation with residuals: fraction of the largest values of each gradient that are
+    // exchanged (top-k), or the magnitude above which values are exchanged if no ratio is given; 0 to disable
+    double m_sparseGradientTopKRatio;
+    double m_sparseGradientThreshold;
     bool m_zeroThresholdFor1Bit;
 
     // Parallel training related with MA / BM
@@ -25,9 +25,14 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES)
+    // 'bucketSizeInBytes' > 0 groups the gradients into buckets of about that size that are aggregated as soon as
+    // all their gradients are ready during the backward pass (see OnGradientReady()), overlapping the communication
+    // with the rest of the backward pass. This is only supported for gradients on the CPU (MPI_Iallreduce) and not
+    // combined with async aggregation. On the GPU, NCCL reduces on a stream that synchronizes with the compute stream,
+    // so its all-reduce would not overlap with the backward pass, and the other paths aggregate from CPU copies.
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, size_t bucketSizeInBytes = 0)
         : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace),
-        m_iterationCount(0), m_packThresholdSizeInBytes(packThresholdSizeInBytes)
+        m_iterationCount(0), m_packThresholdSizeInBytes(packThresholdSizeInBytes), m_deviceId(deviceId), m_bucketSizeInBytes(bucketSizeInBytes), m_numLaunchedBuckets(0)
     {}
 
     ~SimpleDistGradAggregator()
@@ -39,6 +44,51 @@ public:
             DistGradHeader::Destroy(m_bufferedGradHeader);
     }
 
+    bool OverlapsAggregation() const override
+    {
+        return (m_bucketSizeInBytes > 0) && !m_useAsyncAggregation && (m_mpi->NumNodesInUse() > 1) &&
+               (m_deviceId == CPUDEVICE) && (m_mpi->UseGpuGdr() == 0);
+    }
+
+    // Groups consecutive gradients into buckets of at least 'bucketSizeInBytes' (except for the last one),
+    // returns the indices of the gradients of each bucket.
+    static std::vector<std::vector<size_t>> GroupIntoBuckets(const std::vector<size_t>& gradientSizesInBytes, size_t bucketSizeInBytes)
+    {
+        std::vector<std::vector<size_t>> buckets;
+        size_t currentSizeInBytes = 0;
+        for (size_t i = 0; i < gradientSizesInBytes.size(); i++)
+        {
+            if (buckets.empty() || currentSizeInBytes >= bucketSizeInBytes)
+            {
+                buckets.push_back(std::vector<size_t>());
+                currentSizeInBytes = 0;
+            }
+
+            buckets.back().push_back(i);
+            currentSizeInBytes += gradientSizesInBytes[i];
+        }
+        return buckets;
+    }
+
+    // Starts the aggregation of the bucket of the gradient if all its gradients are ready. The buckets are launched
+    // in order, so that all nodes issue the same sequence of collective operations. The buckets in flight are tested
+    // on every call, see TestLaunchedBuckets().
+    void OnGradientReady(const std::vector<Matrix<ElemType>*>& gradients, size_t index) override
+    {
+        // The buckets are formed when the gradients are aggregated for the first time.
+        if (!m_initialized || m_buckets.empty())
+            return;
+
+        auto& bucket = m_buckets[m_gradientBuckets[index]];
+        assert(bucket.m_numReady < bucket.m_gradientIndices.size());
+        bucket.m_numReady++;
+
+        while (m_numLaunchedBuckets < m_buckets.size() && m_buckets[m_numLaunchedBuckets].IsReady())
+            LaunchBucket(gradients, m_numLaunchedBuckets++);
+
+        TestLaunchedBuckets();
+    }
+
     // Aggregate the gradient matrices across all nodes
     bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) override
     {
@@ -128,6 +178,11 @@ public:
 
             return false;
         }
+        else if (!m_buckets.empty())
+        {
+            AggregateBucketsImpl(gradients, headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
         else
         {
             AggregateGradientsImpl(gradients, headerCPU, showSyncPerfStats);
@@ -161,6 +216,30 @@ private:
         return true;
     }
 
+    // Creates the buckets (see GroupIntoBuckets()). Buckets of more than one gradient are packed into a continuous buffer.
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients, int deviceId)
+    {
+        std::vector<size_t> gradientSizesInBytes;
+        for (const auto& gradient : gradients)
+            gradientSizesInBytes.push_back(sizeof(ElemType) * gradient->GetNumElements());
+
+        m_gradientBuckets.resize(gradients.size());
+        for (auto& gradientIndices : GroupIntoBuckets(gradientSizesInBytes, m_bucketSizeInBytes))
+        {
+            m_buckets.push_back(GradientBucket());
+            auto& bucket = m_buckets.back();
+            bucket.m_gradientIndices = std::move(gradientIndices);
+            for (size_t i : bucket.m_gradientIndices)
+            {
+                bucket.m_numElements += gradients[i]->GetNumElements();
+                m_gradientBuckets[i] = m_buckets.size() - 1;
+            }
+
+            if (bucket.m_gradientIndices.size() > 1)
+                bucket.m_buffer.reset(new Matrix<ElemType>(1, bucket.m_numElements, deviceId));
+        }
+    }
+
     void ResetState(const std::vector<Matrix<ElemType>*>& gradients, int numEvalNodes, bool resetState)
     {
         // When called the first time let's setup the intermediateCPU buffers for gradient aggregation if needed
@@ -175,10 +254,14 @@ private:
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
             }
 
+            // Buckets replace the packing of small gradients.
+            if (OverlapsAggregation())
+                CreateBuckets(gradients, deviceId);
+
             size_t packedGradientsSizeInElements = 0;
             for (size_t i = 0; i < gradients.size(); i++)
             {
-                if (!m_useAsyncAggregation && sizeof(ElemType) * gradients[i]->GetNumElements() <= m_packThresholdSizeInBytes)
+                if (!m_useAsyncAggregation && m_buckets.empty() && sizeof(ElemType) * gradients[i]->GetNumElements() <= m_packThresholdSizeInBytes)
                 {
                     packedGradientsSizeInElements += gradients[i]->GetNumElements();
                     m_packedGradientsIndex.push_back(i);
@@ -298,22 +381,9 @@ private:
             offset += gradients[i]->GetNumElements();
         }
 
-        // Initiate receive of the header on the main node
         std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
-        if (m_mpi->IsMainNode())
-        {
-            for (size_t j = 0; j < NumProc() - 1; ++j)
-            {
-                int source = (j >= MyRank()) ? (j + 1) : j;
-                // We use a tag of 'numGradMatrices' for the pre-aggregation header
-                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
-            }
-        }
-
-        // Send the headers from all nodes but the main node
         MPI_Request sendHeaderRequest;
-        if (!m_mpi->IsMainNode())
-            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+        StartHeaderAggregation(headerCPU, numGradMatrices, recvHeaderRequests, sendHeaderRequest);
 
 
         // New aggregation pipeline for non-GDR, perform sync allreduce on the gradient data
@@ -419,6 +489,64 @@ private:
             }
         }
 
+        FinishHeaderAggregation(headerCPU, recvHeaderRequests, sendHeaderRequest);
+
+        if (m_nccl->IsSupported())
+        {
+            m_nccl->Sync();
+        }
+        // Non-GDR && GPU
+        else if ((m_mpi->UseGpuGdr() == 0) && (deviceId != CPUDEVICE))
+        {
+            // Wait for async CPU-to-GPU copy (non-GDR)
+            for (size_t i = 0; i < allReduceIndex; i++)
+                m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+        }
+        // CPU
+        else if (m_mpi->UseGpuGdr() == 0)
+        {
+            // Wait for the Iallreduce operations to finish
+            for (size_t i = 0; i < allReduceIndex; i++)
+            {
+                m_mpi->Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            }
+        }
+
+        // Copy data back to the packed gradients from the continous buffer
+        offset = 0;
+        for (size_t i : m_packedGradientsIndex)
+        {
+            gradients[i]->AssignValuesOf(m_aggregationBuffer->ColumnSlice(offset, gradients[i]->GetNumElements()).Reshaped(gradients[i]->GetNumRows(), gradients[i]->GetNumCols()));
+            offset += gradients[i]->GetNumElements();
+        }
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", gradientAggregationTime);
+        }
+    }
+
+    // Initiates the receive of the headers on the main node and the send of the header from all other nodes.
+    void StartHeaderAggregation(DistGradHeader* headerCPU, size_t numGradMatrices, std::vector<MPI_Request>& recvHeaderRequests, MPI_Request& sendHeaderRequest)
+    {
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                // We use a tag of 'numGradMatrices' for the pre-aggregation header
+                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+        }
+        else
+            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+    }
+
+    // Aggregates the headers on the main node and broadcasts the result to all nodes.
+    void FinishHeaderAggregation(DistGradHeader* headerCPU, std::vector<MPI_Request>& recvHeaderRequests, MPI_Request& sendHeaderRequest)
+    {
         // On the main node wait for the headers to arrive and aggregate
         if (m_mpi->IsMainNode())
         {
@@ -443,44 +571,131 @@ private:
         // Broadcast the aggregated header to all nodes
         m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
 
-        if (m_nccl->IsSupported())
-        {
-            m_nccl->Sync();
-        }
-        // Non-GDR && GPU
-        else if ((m_mpi->UseGpuGdr() == 0) && (deviceId != CPUDEVICE))
+        // Wait for completion of the async send requests
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+    }
+
+    // Starts the non-blocking all-reduce of a bucket, packing its gradients into the bucket buffer first.
+    void LaunchBucket(const std::vector<Matrix<ElemType>*>& gradients, size_t bucketIndex)
+    {
+        auto& bucket = m_buckets[bucketIndex];
+        bucket.m_timer.Start();
+
+        Matrix<ElemType>* reductionBuffer = gradients[bucket.m_gradientIndices[0]];
+        if (bucket.m_buffer)
         {
-            // Wait for async CPU-to-GPU copy (non-GDR)
-            for (size_t i = 0; i < allReduceIndex; i++)
-                m_gpuDataTransferers[i]->WaitForCopyCPUToGPUAsync();
+            reductionBuffer = bucket.m_buffer.get();
+            size_t offset = 0;
+            for (size_t i : bucket.m_gradientIndices)
+            {
+                reductionBuffer->ColumnSlice(offset, gradients[i]->GetNumElements()).AssignValuesOf(gradients[i]->Reshaped(1, gradients[i]->GetNumElements()));
+                offset += gradients[i]->GetNumElements();
+            }
         }
-        // CPU
-        else if (m_mpi->UseGpuGdr() == 0)
+
+        m_mpi->Iallreduce(MPI_IN_PLACE, reductionBuffer->Data(), reductionBuffer->GetNumElements(),
+                          MPIWrapper::GetDataType(reductionBuffer->Data()), MPI_SUM, &bucket.m_request) || MpiFail("MPI_Iallreduce");
+    }
+
+    // Tests the buckets in flight for completion. MPI implementations typically progress non-blocking collectives
+    // only inside MPI calls, so without these calls the all-reduces launched during the backward pass would mostly
+    // run in the final MPI_Wait().
+    void TestLaunchedBuckets()
+    {
+        for (size_t b = 0; b < m_numLaunchedBuckets; b++)
         {
-            // Wait for the Iallreduce operations to finish
-            for (size_t i = 0; i < allReduceIndex; i++)
+            auto& bucket = m_buckets[b];
+            if (bucket.m_completed)
+                continue;
+
+            int completed = 0;
+            m_mpi->Test(&bucket.m_request, &completed, MPI_STATUS_IGNORE) || MpiFail("MPI_Test");
+            if (completed)
             {
-                m_mpi->Wait(&allReduceRequests[i], MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+                bucket.m_timer.Stop();
+                bucket.m_completed = true;
             }
         }
+    }
 
-        // Copy data back to the packed gradients from the continous buffer
-        offset = 0;
-        for (size_t i : m_packedGradientsIndex)
+    // Aggregation with buckets: the buckets that were not launched during the backward pass are launched now,
+    // then the header is aggregated and the buckets that did not complete yet are waited for.
+    void AggregateBucketsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        size_t numGradMatrices = gradients.size();
+        size_t numBucketsLaunchedInBackprop = m_numLaunchedBuckets;
+
+        // If the current node did not process any samples, the gradients should be zero'd
+        if (headerCPU->numSamples == 0)
         {
-            gradients[i]->AssignValuesOf(m_aggregationBuffer->ColumnSlice(offset, gradients[i]->GetNumElements()).Reshaped(gradients[i]->GetNumRows(), gradients[i]->GetNumCols()));
-            offset += gradients[i]->GetNumElements();
+            for (size_t b = m_numLaunchedBuckets; b < m_buckets.size(); b++)
+                for (size_t i : m_buckets[b].m_gradientIndices)
+                    gradients[i]->SetValue(0);
         }
 
-        // Wait for completion of the async send requests
-        if (!m_mpi->IsMainNode())
-            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+        for (; m_numLaunchedBuckets < m_buckets.size(); m_numLaunchedBuckets++)
+            LaunchBucket(gradients, m_numLaunchedBuckets);
+
+        std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
+        MPI_Request sendHeaderRequest;
+        StartHeaderAggregation(headerCPU, numGradMatrices, recvHeaderRequests, sendHeaderRequest);
+        FinishHeaderAggregation(headerCPU, recvHeaderRequests, sendHeaderRequest);
+
+        size_t numBucketsCompletedInBackprop = 0;
+        for (auto& bucket : m_buckets)
+        {
+            if (bucket.m_completed)
+                numBucketsCompletedInBackprop++;
+            else
+            {
+                Timer waitTimer;
+                waitTimer.Start();
+                m_mpi->Wait(&bucket.m_request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+                waitTimer.Stop();
+                bucket.m_timer.Stop();
+                bucket.m_waitSeconds += waitTimer.ElapsedSeconds();
+            }
+
+            bucket.m_inFlightSeconds += bucket.m_timer.ElapsedSeconds();
+            bucket.m_numAggregations++;
+
+            // Copy data back to the gradients from the bucket buffer
+            if (bucket.m_buffer)
+            {
+                size_t offset = 0;
+                for (size_t i : bucket.m_gradientIndices)
+                {
+                    gradients[i]->AssignValuesOf(bucket.m_buffer->ColumnSlice(offset, gradients[i]->GetNumElements()).Reshaped(gradients[i]->GetNumRows(), gradients[i]->GetNumCols()));
+                    offset += gradients[i]->GetNumElements();
+                }
+            }
+
+            bucket.m_numReady = 0;
+            bucket.m_completed = false;
+        }
+        m_numLaunchedBuckets = 0;
 
         if (showSyncPerfStats)
         {
             aggregationTimer.Stop();
-            double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
-            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", gradientAggregationTime);
+            fprintf(stderr, "Actual gradient aggregation time: %.6g, %d of %d buckets launched and %d completed during the backward pass\n",
+                    aggregationTimer.ElapsedSeconds(), (int)numBucketsLaunchedInBackprop, (int)m_buckets.size(), (int)numBucketsCompletedInBackprop);
+
+            // Average over the aggregations since the stats were last shown.
+            for (size_t b = 0; b < m_buckets.size(); b++)
+            {
+                auto& bucket = m_buckets[b];
+                fprintf(stderr, "Gradient bucket %d (%d gradients, %.1f KB): time in flight %.6g, wait time %.6g\n",
+                        (int)b, (int)bucket.m_gradientIndices.size(), sizeof(ElemType) * bucket.m_numElements / 1024.0,
+                        bucket.m_inFlightSeconds / bucket.m_numAggregations, bucket.m_waitSeconds / bucket.m_numAggregations);
+                bucket.m_inFlightSeconds = bucket.m_waitSeconds = 0;
+                bucket.m_numAggregations = 0;
+            }
         }
     }
 
@@ -509,6 +724,39 @@ private:
     std::vector<size_t> m_packedGradientsIndex;
     std::vector<size_t> m_gradientIndexToAggregate;
 
+    // Group of gradients that is aggregated by a single all-reduce, started as soon as all its gradients are ready
+    struct GradientBucket
+    {
+        std::vector<size_t> m_gradientIndices;
+        size_t m_numElements = 0;
+        std::unique_ptr<Matrix<ElemType>> m_buffer; // continuous buffer of buckets with more than one gradient
+        size_t m_numReady = 0;                      // number of gradients that are ready in the current iteration
+        MPI_Request m_request = MPI_Request();      // pending all-reduce on the CPU
+        bool m_completed = false;                   // all-reduce completed during the backward pass
+
+        // Stats since they were last shown: time from the launch of the all-reduce to its completion and
+        // time spent waiting for it after the backward pass.
+        Timer m_timer;
+        double m_inFlightSeconds = 0;
+        double m_waitSeconds = 0;
+        size_t m_numAggregations = 0;
+
+        bool IsReady() const
+        {
+            return m_numReady == m_gradientIndices.size();
+        }
+    };
+
+    // Device of the gradients, buckets are only used on the CPU
+    const int m_deviceId;
+
+    // Size of the buckets of gradients that are aggregated during the backward pass, 0 if disabled
+    // (tunable by "gradientBucketSizeInKB=[value]" in the DataParallelSGD section)
+    const size_t m_bucketSizeInBytes;
+    std::vector<GradientBucket> m_buckets;
+    std::vector<size_t> m_gradientBuckets; // index of the bucket of each gradient
+    size_t m_numLaunchedBuckets;
+
     int m_syncStatsTrace;
 
     // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
@@ -0,0 +1,178 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "GradientSparsifier.h"
+#include "TimerUtility.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Aggregates the gradients by exchanging only their largest values and keeping the rest as residuals that are
+// added to the gradients of the next minibatch (see GradientSparsifier). Meant for bandwidth limited clusters:
+// the values are exchanged from CPU memory, gradients on a GPU are copied to the CPU and back.
+template <class ElemType>
+class SparseDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    SparseDistGradAggregator(const MPIWrapperPtr& mpi, double topKRatio, double threshold, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_sparsifier(mpi->NumNodesInUse(), MPISparseMessageExchange(mpi), topKRatio, threshold), m_syncStatsTrace(syncStatsTrace),
+        m_iterationCount(0), m_bytesSent(0), m_bytesReceived(0), m_denseBytes(0)
+    {}
+
+    ~SparseDistGradAggregator()
+    {
+        for (size_t i = 0; i < m_recvHeaders.size(); ++i)
+            DistGradHeader::Destroy(m_recvHeaders[i]);
+    }
+
+    // resetState is set on the first minibatch of every epoch, the residuals are kept across epochs.
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool /*resetState*/) override
+    {
+        if (m_mpi->NumNodesInUse() == 1) // No need to aggregate anything.
+            return (headerCPU->numSamples != 0);
+
+        if (m_recvHeaders.empty() && m_mpi->IsMainNode())
+        {
+            for (size_t i = 0; i < NumProc() - 1; ++i)
+                m_recvHeaders.push_back(DistGradHeader::Create(headerCPU->numEvalNode));
+        }
+
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        size_t numGradMatrices = gradients.size();
+
+        // If the current node did not process any samples, the gradients should be zero'd
+        if (headerCPU->numSamples == 0)
+        {
+            for (size_t i = 0; i < numGradMatrices; ++i)
+                gradients[i]->SetValue(0);
+        }
+
+        // Initiate receive of the header on the main node
+        std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                // We use a tag of 'numGradMatrices' for the pre-aggregation header
+                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+        }
+
+        // Send the headers from all nodes but the main node
+        MPI_Request sendHeaderRequest;
+        if (!m_mpi->IsMainNode())
+            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+
+        // Gradients on the CPU are aggregated in place, the others through a copy in CPU memory.
+        m_cpuBuffers.resize(numGradMatrices);
+        std::vector<typename GradientSparsifier<ElemType>::Gradient> cpuGradients(numGradMatrices);
+        size_t denseBytes = 0;
+        for (size_t i = 0; i < numGradMatrices; i++)
+        {
+            Matrix<ElemType>* gradient = gradients[i];
+            if (gradient->GetMatrixType() != DENSE)
+                RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+
+            cpuGradients[i].numElements = gradient->GetNumElements();
+            if (gradient->GetDeviceId() == CPUDEVICE)
+                cpuGradients[i].data = gradient->Data();
+            else
+            {
+                m_cpuBuffers[i].resize(gradient->GetNumElements());
+                gradient->CopySection(gradient->GetNumRows(), gradient->GetNumCols(), m_cpuBuffers[i].data(), gradient->GetNumRows());
+                cpuGradients[i].data = m_cpuBuffers[i].data();
+            }
+            denseBytes += gradient->GetNumElements() * sizeof(ElemType);
+        }
+
+        m_sparsifier.AggregateInPlace(cpuGradients);
+
+        for (size_t i = 0; i < numGradMatrices; i++)
+        {
+            Matrix<ElemType>* gradient = gradients[i];
+            if (gradient->GetDeviceId() != CPUDEVICE)
+                gradient->SetValue(gradient->GetNumRows(), gradient->GetNumCols(), gradient->GetDeviceId(), m_cpuBuffers[i].data());
+        }
+
+        // On the main node wait for the headers to arrive and aggregate
+        if (m_mpi->IsMainNode())
+        {
+            size_t numNodesHeadersReceivedFrom = 0;
+            while (numNodesHeadersReceivedFrom < (NumProc() - 1))
+            {
+                int idx = MPI_UNDEFINED;
+                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (idx == MPI_UNDEFINED)
+                {
+                    break;
+                }
+
+                numNodesHeadersReceivedFrom++;
+
+                headerCPU->Aggregate(m_recvHeaders[idx], true);
+            }
+
+            assert(numNodesHeadersReceivedFrom == (NumProc() - 1));
+        }
+
+        // Broadcast the aggregated header to all nodes
+        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+
+        // Wait for completion of the async send requests
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+
+        m_bytesSent += m_sparsifier.BytesSent();
+        m_bytesReceived += m_sparsifier.BytesReceived();
+        m_denseBytes += denseBytes;
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", gradientAggregationTime);
+
+            // Average bytes on the wire per minibatch since the stats were last shown.
+            size_t numMinibatches = (m_iterationCount == 1) ? 1 : m_syncStatsTrace;
+            fprintf(stderr, "Sparse gradient aggregation: %.1f KB sent, %.1f KB received per minibatch (%.2f%% of the %.1f KB of the dense gradients)\n",
+                    m_bytesSent / 1024.0 / numMinibatches, m_bytesReceived / 1024.0 / numMinibatches,
+                    m_denseBytes > 0 ? 100.0 * m_bytesSent / m_denseBytes : 0.0, m_denseBytes / 1024.0 / numMinibatches);
+            m_bytesSent = m_bytesReceived = m_denseBytes = 0;
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    GradientSparsifier<ElemType> m_sparsifier;
+
+    // CPU copies of the gradients that are not on the CPU
+    std::vector<std::vector<ElemType>> m_cpuBuffers;
+
+    std::vector<DistGradHeader*> m_recvHeaders;
+
+    int m_syncStatsTrace;
+
+    // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
+    size_t m_iterationCount;
+
+    // Bytes exchanged since the stats were last shown
+    size_t m_bytesSent;
+    size_t m_bytesReceived;
+    size_t m_denseBytes;
+};
+
+} } }
@@ -8,6 +8,7 @@
 #include "Matrix.h"
 #include "CUDAPageLockedMemAllocator.h"
 
+#include <exception>
 #include <memory>
 #include <vector>
 
@@ -99,7 +100,6 @@ public:
     {
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
-        size_t boundaryframenum;
         std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
         validframes.assign(samplesInRecurrentStep, 0);
         ElemType objectValue = 0.0;
@@ -125,15 +125,27 @@ public:
             assert(T == pMBLayout->GetNumTimeSteps());
         }
 
-        size_t mapi = 0; // parallel-sequence index for utterance [i]
-        // cal gamma for each utterance
-        size_t ts = 0;
-        for (size_t i = 0; i < lattices.size(); i++)
+        // per-utterance state carried from the preparation of an utterance to the use of its gammas
+        struct utterancestate
+        {
+            size_t ts;        // first column of the utterance in pred/dengammas
+            size_t mapi;      // parallel-sequence index of the utterance
+            size_t tbegin;    // first time step of the utterance within its parallel sequence
+            double numavlogp; // average numerator log LL
+            double denavlogp; // return value of lattice::forwardbackward()
+        };
+        std::vector<utterancestate> utts(lattices.size());
+
+        // copies the log LLs of utterance [i] into pred and scores its reference
+        auto prepareutterance = [&](size_t i, size_t ts)
         {
+            auto& utt = utts[i];
             const size_t numframes = lattices[i]->getnumframes();
+            utt.ts = ts;
+            utt.mapi = 0;
+            utt.tbegin = 0;
 
-            msra::dbn::matrixstripe predstripe(pred, ts, numframes);           // logLLs for this utterance
-            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes); // denominator gammas
+            msra::dbn::matrixstripe predstripe(pred, ts, numframes); // logLLs for this utterance
 
             if (samplesInRecurrentStep == 1) // no sequence parallelism
             {
@@ -149,7 +161,7 @@ public:
             else // multiple parallel sequences
             {
                 // get number of frames for the utterance
-                mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                const size_t mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
 
                 // scan MBLayout for end of utterance
                 size_t mapframenum = SIZE_MAX; // duration of utterance [i] as determined from MBLayout
@@ -183,42 +195,59 @@ public:
                 {
                     parallellattice.setloglls(tempmatrix);
                 }
+
+                utt.mapi = mapi;
+                utt.tbegin = validframes[mapi];
+                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
             }
 
             array_ref<size_t> uidsstripe(&uids[ts], numframes);
 
-            if (doreferencealign)
-            {
-                boundaryframenum = numframes;
-            }
-            else
-                boundaryframenum = 0;
-            array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
-
             double numavlogp = 0;
-            foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
+            for (size_t t = 0; t < numframes; t++) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
             {
                 const size_t s = uidsstripe[t];
                 numavlogp += predstripe(s, t) / amf;
             }
-            numavlogp /= numframes;
+            utt.numavlogp = numavlogp / numframes;
+        };
+
+        // runs the lattice forward-backward of utterance [i], writing its denominator gammas into its stripe of dengammas
+        auto forwardbackwardutterance = [&](size_t i)
+        {
+            auto& utt = utts[i];
+            const size_t numframes = lattices[i]->getnumframes();
+
+            msra::dbn::matrixstripe predstripe(pred, utt.ts, numframes);           // logLLs for this utterance
+            msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, numframes); // denominator gammas
+
+            array_ref<size_t> uidsstripe(&uids[utt.ts], numframes);
+            array_ref<size_t> boundariesstripe(&boundaries[utt.ts], doreferencealign ? numframes : 0);
 
             // auto_timer dengammatimer;
-            double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
-                                                                   (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
-                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
-                                                                   lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
-            objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
+            utt.denavlogp = lattices[i]->second.forwardbackward(parallellattice,
+                                                                (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
+                                                                (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
+                                                                lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
+        };
+
+        // copies the gammas of utterance [i] into gammafromlattice and accumulates the objective
+        auto finishutterance = [&](size_t i)
+        {
+            const auto& utt = utts[i];
+            const size_t numframes = lattices[i]->getnumframes();
+            objectValue += (ElemType)((utt.numavlogp - utt.denavlogp) * numframes);
 
             if (samplesInRecurrentStep == 1)
             {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
+                tempmatrix = gammafromlattice.ColumnSlice(utt.ts, numframes);
             }
 
             // copy gamma to tempmatrix
             if (m_deviceid == CPUDEVICE)
             {
-                CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
+                msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, numframes);
+                CopyFromSSEMatrixToCNTKMatrix(dengammasstripe, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
             }
             else
                 parallellattice.getgamma(tempmatrix);
@@ -226,7 +255,7 @@ public:
             // set gamma for multi channel
             if (samplesInRecurrentStep > 1)
             {
-                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(utt.mapi + (utt.tbegin * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
                 gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
             }
 
@@ -234,17 +263,54 @@ public:
             {
                 for (size_t nframe = 0; nframe < numframes; nframe++)
                 {
-                    size_t uid = uidsstripe[nframe];
+                    size_t uid = uids[utt.ts + nframe];
                     if (samplesInRecurrentStep > 1)
-                        labels(uid, (nframe + validframes[mapi]) * samplesInRecurrentStep + mapi) = 1.0;
+                        labels(uid, (nframe + utt.tbegin) * samplesInRecurrentStep + utt.mapi) = 1.0;
                     else
-                        labels(uid, ts + nframe) = 1.0;
+                        labels(uid, utt.ts + nframe) = 1.0;
                 }
             }
-            if (samplesInRecurrentStep > 1)
-                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
-            fprintf(stderr, "dengamma value %f\n", denavlogp);
-            ts += numframes;
+            fprintf(stderr, "dengamma value %f\n", utt.denavlogp);
+        };
+
+        // The GPU implementation holds the state of one utterance at a time, so utterances are processed one by one.
+        // On the CPU the lattices of the minibatch are independent: their forward-backward runs concurrently, each
+        // writing its own stripe of dengammas, while the objective is accumulated in utterance order as before.
+        const bool parallelutterances = !parallellattice.enabled() && lattices.size() > 1;
+        size_t ts = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            prepareutterance(i, ts);
+            if (!parallelutterances)
+            {
+                forwardbackwardutterance(i);
+                finishutterance(i);
+            }
+            ts += lattices[i]->getnumframes();
+        }
+
+        if (parallelutterances)
+        {
+            std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < (int) lattices.size(); i++)
+            {
+                try
+                {
+                    forwardbackwardutterance(i);
+                }
+                catch (...)
+                {
+#pragma omp critical
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+            if (error)
+                std::rethrow_exception(error);
+
+            for (size_t i = 0; i < lattices.size(); i++)
+                finishutterance(i);
         }
         functionValues.SetValue(objectValue);
     }
@@ -14,6 +14,7 @@
 #include "latticestorage.h"
 #include <unordered_map>
 #include <list>
+#include <exception>
 #include <stdexcept>
 
 using namespace std;
@@ -952,50 +953,67 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
             parallelstate.getedgeacscores(edgeacscoresgpu);
             parallelstate.copyalignments(thisedgealignmentsgpu);
         }
-        foreach_index (j, edges)
+        // The edges are independent, so they are aligned concurrently. When several lattices are processed in parallel
+        // (see GammaCalculation::calgammaformb()) this nested region runs on the calling thread only.
+        std::exception_ptr error;
+        // edgealignments::operator[] allocates the alignments on first use, which must not happen on several threads at once.
+        thisedgealignments.getalignmentsbuffer();
+#pragma omp parallel for schedule(dynamic) if (!cpuverification)
+        for (int j = 0; j < (int) edges.size(); j++)
         {
-            const edgeinfowithscores &e = edges[j];
-            const size_t ts = nodes[e.S].t;
-            const size_t te = nodes[e.E].t;
-            if (ts == te) // dummy !NULL edge at end
-                edgeacscores[j] = 0.0f;
-            else
+            try
             {
-                const auto &aligntokens = getaligninfo(j); // get alignment tokens
-                const auto edgeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase &>(logLLs), ts, te - ts);
-                if (minlogpp > LOGZERO && origlogpps[j] < minlogpp)
-                    edgeacscores[j] = LOGZERO; // will kill word level forwardbackward hypothesis
-                else if (softalignstates)
-                    edgeacscores[j] = forwardbackwardedge(aligntokens, hset, edgeLLs, *abcs[j], j);
+                const edgeinfowithscores &e = edges[j];
+                const size_t ts = nodes[e.S].t;
+                const size_t te = nodes[e.E].t;
+                if (ts == te) // dummy !NULL edge at end
+                    edgeacscores[j] = 0.0f;
                 else
-                    edgeacscores[j] = alignedge(aligntokens, hset, edgeLLs, *abcs[j], j, returnsenoneids, thisedgealignments[j]);
-            }
-            if (cpuverification)
-            {
-                const auto &aligntokens = getaligninfo(j); // get alignment tokens
-                bool edgehassil = false;
-                foreach_index (i, aligntokens)
                 {
-                    if (aligntokens[i].unit == silunitid)
-                        edgehassil = true;
+                    const auto &aligntokens = getaligninfo(j); // get alignment tokens
+                    const auto edgeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase &>(logLLs), ts, te - ts);
+                    if (minlogpp > LOGZERO && origlogpps[j] < minlogpp)
+                        edgeacscores[j] = LOGZERO; // will kill word level forwardbackward hypothesis
+                    else if (softalignstates)
+                        edgeacscores[j] = forwardbackwardedge(aligntokens, hset, edgeLLs, *abcs[j], j);
+                    else
+                        edgeacscores[j] = alignedge(aligntokens, hset, edgeLLs, *abcs[j], j, returnsenoneids, thisedgealignments[j]);
                 }
-                if (fabs(edgeacscores[j] - edgeacscoresgpu[j]) > 1e-3)
+                if (cpuverification)
                 {
-                    fprintf(stderr, "edge %d, sil ? %d, edgeacscores / edgeacscoresgpu MISMATCH %f v.s. %f, diff %e\n",
-                            j, edgehassil ? 1 : 0, (float) edgeacscores[j], (float) edgeacscoresgpu[j],
-                            (float) (edgeacscores[j] - edgeacscoresgpu[j]));
-                    fprintf(stderr, "aligntokens: ");
+                    const auto &aligntokens = getaligninfo(j); // get alignment tokens
+                    bool edgehassil = false;
                     foreach_index (i, aligntokens)
-                        fprintf(stderr, "%d %d; ", i, aligntokens[i].unit);
-                    fprintf(stderr, "\n");
-                }
-                for (size_t t = ts; t < te; t++)
-                {
-                    if (thisedgealignments[j][t - ts] != thisedgealignmentsgpu[j][t - ts])
-                        fprintf(stderr, "edge %d, sil ? %d, time %d, alignment / alignmentgpu MISMATCH %d v.s. %d\n", j, edgehassil ? 1 : 0, (int) (t - ts), thisedgealignments[j][t - ts], thisedgealignmentsgpu[j][t - ts]);
+                    {
+                        if (aligntokens[i].unit == silunitid)
+                            edgehassil = true;
+                    }
+                    if (fabs(edgeacscores[j] - edgeacscoresgpu[j]) > 1e-3)
+                    {
+                        fprintf(stderr, "edge %d, sil ? %d, edgeacscores / edgeacscoresgpu MISMATCH %f v.s. %f, diff %e\n",
+                                j, edgehassil ? 1 : 0, (float) edgeacscores[j], (float) edgeacscoresgpu[j],
+                                (float) (edgeacscores[j] - edgeacscoresgpu[j]));
+                        fprintf(stderr, "aligntokens: ");
+                        foreach_index (i, aligntokens)
+                            fprintf(stderr, "%d %d; ", i, aligntokens[i].unit);
+                        fprintf(stderr, "\n");
+                    }
+                    for (size_t t = ts; t < te; t++)
+                    {
+                        if (thisedgealignments[j][t - ts] != thisedgealignmentsgpu[j][t - ts])
+                            fprintf(stderr, "edge %d, sil ? %d, time %d, alignment / alignmentgpu MISMATCH %d v.s. %d\n", j, edgehassil ? 1 : 0, (int) (t - ts), thisedgealignments[j][t - ts], thisedgealignmentsgpu[j][t - ts]);
+                    }
                 }
             }
+            catch (...)
+            {
+#pragma omp critical
+                if (!error)
+                    error = std::current_exception();
+            }
         }
+        if (error)
+            std::rethrow_exception(error);
     }
 }
 
@@ -7,6 +7,8 @@
 #include "ComputationNode.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <atomic>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -137,6 +139,134 @@ BOOST_AUTO_TEST_CASE(EvalScalarTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalSessionSharesParametersTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "o1 = Times(Constant(3), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    // Sessions evaluate the same model on their own inputs, concurrently
+    const size_t numSessions = 4, numIterations = 50;
+    std::vector<IEvaluateModelExtended<float>*> sessions;
+    for (size_t i = 0; i < numSessions; i++)
+        sessions.push_back(eval->CreateSession());
+    BOOST_REQUIRE(sessions[0]->GetOutputSchema()[0].m_name == outputLayouts[0].m_name);
+
+    // The master can be destroyed before its sessions
+    eval->Destroy();
+
+    std::vector<std::vector<float>> results(numSessions);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < numSessions; i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            Values<float> inputBuffer(1);
+            Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+            for (size_t iteration = 0; iteration < numIterations; iteration++)
+            {
+                inputBuffer[0].m_buffer = { (float)(i + iteration) };
+                sessions[i]->ForwardPass(inputBuffer, outputBuffer);
+                results[i].push_back(outputBuffer[0].m_buffer[0]);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    for (size_t i = 0; i < numSessions; i++)
+    {
+        std::vector<float> expected;
+        for (size_t iteration = 0; iteration < numIterations; iteration++)
+            expected.push_back(3.0f * (i + iteration));
+        BOOST_CHECK_EQUAL_COLLECTIONS(results[i].begin(), results[i].end(), expected.begin(), expected.end());
+        sessions[i]->Destroy();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatcherTest)
+{
+    // The recurrence makes the output depend on the sequence boundaries in the packed minibatch
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(1) \n"
+        "o1 = Plus(i1, PastValue(1, i1, timeStep=1, defaultHiddenActivation=0), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    BatchingOptions options;
+    options.m_maxBatchRequests = 4;
+    options.m_maxLatencyMicroseconds = 10000;
+    IEvaluateModelBatcher<float> *batcher = eval->CreateBatcher(options);
+
+    // Requests of different lengths from several threads
+    const size_t numThreads = 8, numRequestsPerThread = 10;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> numMismatches(0);
+    for (size_t thread = 0; thread < numThreads; thread++)
+    {
+        threads.emplace_back([&, thread]()
+        {
+            for (size_t request = 0; request < numRequestsPerThread; request++)
+            {
+                size_t length = 1 + (thread + request) % 5;
+                Values<float> inputBuffer(1);
+                for (size_t t = 0; t < length; t++)
+                    inputBuffer[0].m_buffer.push_back((float)(100 * thread + t + 1));
+                Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ length });
+
+                batcher->ForwardPass(inputBuffer, outputBuffer);
+
+                const auto& input = inputBuffer[0].m_buffer;
+                const auto& output = outputBuffer[0].m_buffer;
+                if (output.size() != length)
+                    numMismatches++;
+                for (size_t t = 0; t < length && t < output.size(); t++)
+                    if (output[t] != input[t] + (t > 0 ? input[t - 1] : 0))
+                        numMismatches++;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    BOOST_CHECK_EQUAL(numMismatches, 0);
+
+    // A malformed request fails on its own
+    Values<float> inputBuffer(1);
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    BOOST_REQUIRE_THROW(batcher->ForwardPass(inputBuffer, outputBuffer), std::exception); // Empty input
+
+    BatchingStatistics statistics = batcher->GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_numRequests, numThreads * numRequestsPerThread + 1);
+    BOOST_CHECK_EQUAL(statistics.m_numFailedRequests, 1);
+    BOOST_CHECK_GE(statistics.m_numBatches, (numThreads * numRequestsPerThread) / options.m_maxBatchRequests);
+    BOOST_CHECK_LE(statistics.m_maxLatencySeconds, statistics.m_elapsedSeconds);
+
+    batcher->Destroy();
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_CASE(EvalScalarTimesDualOutputTest)
 {
     std::string modelDefinition =
@@ -11,6 +11,7 @@
 #include "CPUMatrix.h"
 #include "TensorView.h"
 #include "Sequences.h"
+#include "TensorOps.h"
 #include <chrono>
 #include <iostream>
 #include <vector>
@@ -336,6 +337,162 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
+// CTC forward-backward as it was computed before AssignCTCScore processed each utterance as a whole: for each frame
+// and utterance the label positions are processed by an OMP loop with a scalar LogAdd(). Used as the baseline of
+// CTCScoreTest. Utterance 'utt' is in channel 'utt', without a delay constraint. Returns the total score, the
+// posteriors are written into 'posterior' (in the layout of 'prob').
+template <class ElemType>
+ElemType ReferenceCTCScore(const Matrix<ElemType>& prob, const Matrix<ElemType>& phoneSeq, size_t numUtterances, size_t numFrames, size_t blankTokenId,
+                           vector<ElemType>& posterior)
+{
+    const size_t numClasses = prob.GetNumRows(), phoneNum = phoneSeq.GetNumRows(), numCols = numFrames * numUtterances;
+    const ElemType* p = prob.Data();
+
+    // the first and last positions are not labels
+    vector<size_t> labels(phoneNum * numUtterances, SIZE_MAX);
+    for (size_t utt = 0; utt < numUtterances; utt++)
+        for (size_t s = 1; s + 1 < phoneNum; s++)
+            labels[utt * phoneNum + s] = (size_t) phoneSeq(s, utt);
+    // the blank between the labels at s and 'other' may be skipped
+    auto canSkip = [&](size_t utt, size_t s, size_t other)
+    {
+        size_t label = labels[utt * phoneNum + s];
+        return label != blankTokenId && label != labels[utt * phoneNum + other];
+    };
+
+    vector<ElemType> alpha(phoneNum * numCols, (ElemType) LZERO), beta(phoneNum * numCols, (ElemType) LZERO);
+    for (size_t t = 0; t < numFrames; t++)
+    {
+        for (size_t utt = 0; utt < numUtterances; utt++)
+        {
+            size_t col = t * numUtterances + utt;
+#pragma omp parallel for
+            for (int s = 1; s < (int) phoneNum - 1; s++)
+            {
+                ElemType ascore = p[col * numClasses + labels[utt * phoneNum + s]];
+                if (t == 0)
+                {
+                    if (s <= 2)
+                        alpha[col * phoneNum + s] = ascore;
+                    continue;
+                }
+                const ElemType* prev = &alpha[(col - numUtterances) * phoneNum];
+                ElemType x = LZERO;
+                if (s > 2 && canSkip(utt, s, s - 2))
+                    x = LogAdd(x, prev[s - 2]);
+                if (s > 1)
+                    x = LogAdd(x, prev[s - 1]);
+                alpha[col * phoneNum + s] = LogAdd(x, prev[s]) + ascore;
+            }
+        }
+    }
+
+    for (size_t t = numFrames; t-- > 0;)
+    {
+        for (size_t utt = 0; utt < numUtterances; utt++)
+        {
+            size_t col = t * numUtterances + utt;
+#pragma omp parallel for
+            for (int s = 1; s < (int) phoneNum - 1; s++)
+            {
+                ElemType ascore = p[col * numClasses + labels[utt * phoneNum + s]];
+                if (t == numFrames - 1)
+                {
+                    if (s >= (int) phoneNum - 3)
+                        beta[col * phoneNum + s] = ascore;
+                    continue;
+                }
+                const ElemType* next = &beta[(col + numUtterances) * phoneNum];
+                ElemType x = LZERO;
+                if (s < (int) phoneNum - 3 && canSkip(utt, s, s + 2))
+                    x = LogAdd(x, next[s + 2]);
+                if (s < (int) phoneNum - 2)
+                    x = LogAdd(x, next[s + 1]);
+                beta[col * phoneNum + s] = LogAdd(x, next[s]) + ascore;
+            }
+        }
+    }
+
+    ElemType totalScore = 0;
+    posterior.assign(numClasses * numCols, (ElemType) LZERO);
+    for (size_t utt = 0; utt < numUtterances; utt++)
+    {
+        ElemType logP = LogAdd(beta[utt * phoneNum + 1], beta[utt * phoneNum + 2]);
+        totalScore -= logP;
+        for (size_t t = 0; t < numFrames; t++)
+        {
+            size_t col = t * numUtterances + utt;
+            for (size_t s = 1; s + 1 < phoneNum; s++)
+            {
+                size_t label = labels[utt * phoneNum + s];
+                ElemType logoccu = alpha[col * phoneNum + s] + beta[col * phoneNum + s] - p[col * numClasses + label] - logP;
+                posterior[col * numClasses + label] = LogAdd(posterior[col * numClasses + label], logoccu);
+            }
+            for (size_t k = 0; k < numClasses; k++)
+            {
+                ElemType& value = posterior[col * numClasses + k];
+                value = value < LZERO ? 0 : exp(value);
+            }
+        }
+    }
+    return totalScore;
+}
+
+// CTC forward-backward of 'numUtterances' utterances of 'numFrames' frames, one per minibatch channel,
+// each with a random sequence of 'numLabels' labels out of 'numClasses'. AssignCTCScore is compared against
+// ReferenceCTCScore, both in time and in the results.
+template <class ElemType>
+void CTCScoreTest(size_t numLabels, size_t numFrames, size_t numUtterances, size_t numClasses = 100, int count = 10)
+{
+    cout << numUtterances << " utterances of " << numFrames << " frames and " << numLabels << " labels" << endl;
+    const size_t blankTokenId = numClasses - 1;
+    Matrix<ElemType> prob(numClasses, numFrames * numUtterances, CPUDEVICE);
+    randomInitializeMatrix<ElemType>(prob, -5, 5);
+    prob.InplaceLogSoftmax(true);
+
+    // blanks around and between the labels, and a non-label position at each end
+    const size_t phoneNum = 2 * numLabels + 3;
+    Matrix<ElemType> phoneSeq(phoneNum, numUtterances, CPUDEVICE), phoneBound(phoneNum, numUtterances, CPUDEVICE);
+    vector<size_t> uttToChanInd(numUtterances), uttBeginFrame(numUtterances, 0), uttFrameNum(numUtterances, numFrames), uttPhoneNum(numUtterances, phoneNum);
+    for (size_t utt = 0; utt < numUtterances; utt++)
+    {
+        uttToChanInd[utt] = utt;
+        phoneSeq(0, utt) = phoneSeq(phoneNum - 1, utt) = (ElemType) SIZE_MAX;
+        phoneBound(0, utt) = 0;
+        phoneBound(phoneNum - 1, utt) = (ElemType) numFrames;
+        for (size_t s = 1; s < phoneNum - 1; s++)
+        {
+            phoneSeq(s, utt) = (ElemType) ((s % 2) ? blankTokenId : rand() % blankTokenId);
+            phoneBound(s, utt) = (ElemType) ((s - 1) / 2 * numFrames / (numLabels + 1));
+        }
+    }
+
+    Matrix<ElemType> posterior(CPUDEVICE), alpha(CPUDEVICE), beta(CPUDEVICE), totalScore(1, 1, CPUDEVICE);
+    auto t_start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i)
+        posterior.AssignCTCScore(prob, alpha, beta, phoneSeq, phoneBound, totalScore, uttToChanInd, uttBeginFrame, uttFrameNum, uttPhoneNum,
+                                 numUtterances, numFrames, blankTokenId, -1, true);
+    auto t_end = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(t_end - t_start).count() / count;
+    cout << "AssignCTCScore in: " << seconds << " seconds, " << numFrames * numUtterances / seconds << " frames per second" << endl;
+
+    vector<ElemType> referencePosterior;
+    ElemType referenceScore = 0;
+    t_start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i)
+        referenceScore = ReferenceCTCScore(prob, phoneSeq, numUtterances, numFrames, blankTokenId, referencePosterior);
+    t_end = chrono::steady_clock::now();
+    double referenceSeconds = chrono::duration<double>(t_end - t_start).count() / count;
+    cout << "Reference in: " << referenceSeconds << " seconds, " << numFrames * numUtterances / referenceSeconds << " frames per second, "
+         << "speedup " << referenceSeconds / seconds << endl;
+
+    double maxDifference = 0;
+    const ElemType* result = posterior.Data();
+    for (size_t i = 0; i < referencePosterior.size(); i++)
+        maxDifference = max(maxDifference, (double) fabs(result[i] - referencePosterior[i]));
+    cout << "Max difference of the posteriors: " << maxDifference << ", of the total score: " << fabs((double) totalScore(0, 0) - referenceScore) << endl;
+}
+
 int wmain()
 {
     // MandSTest<float>(100, 2);
@@ -355,5 +512,9 @@ int wmain()
     MultiplyAndWeightedAddTest<float>(1100,1000,1200);    
     MultiplyAndWeightedAddTest<float>(11000,10000,12000);*/
 
+    cout << endl << "********************CPUMatrix AssignCTCScore TEST********************" << endl;
+    for (size_t numLabels : { 5, 20, 50, 100, 200 })
+        CTCScoreTest<float>(numLabels, max<size_t>(3 * numLabels, 200), 8);
+
     return 0;
 }
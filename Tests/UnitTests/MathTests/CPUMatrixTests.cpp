@@ -4,6 +4,8 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include <omp.h>
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -15,6 +17,75 @@ typedef CPUSingleMatrix SMatrix;
 // TODO: consider using PI from some library, e.g. boost
 const double pi = 3.14159265358979323846264338327950288419716939937510;
 
+// TensorOp reduction of a [rows x cols] matrix along its columns (giving a row vector), its rows (giving a column vector), or both
+static DMatrix TensorReduce(const DMatrix& a, ElementWiseOperator reductionOp, bool reduceRows, bool reduceCols)
+{
+    const ptrdiff_t rows = a.GetNumRows(), cols = a.GetNumCols();
+    SmallVector<size_t> regularOpDims, reducingOpDims;
+    array<SmallVector<ptrdiff_t>, 2> regularStrides, reducingStrides;
+    auto addDim = [](SmallVector<size_t>& dims, array<SmallVector<ptrdiff_t>, 2>& strides, size_t dim, ptrdiff_t inputStride, ptrdiff_t outputStride)
+    {
+        dims.push_back(dim);
+        strides[0].push_back(inputStride);
+        strides[1].push_back(outputStride);
+    };
+    if (reduceRows)
+        addDim(reducingOpDims, reducingStrides, rows, 1, 0);
+    else
+        addDim(regularOpDims, regularStrides, rows, 1, 1);
+    if (reduceCols)
+        addDim(reducingOpDims, reducingStrides, cols, rows, 0);
+    else
+        addDim(regularOpDims, regularStrides, cols, rows, reduceRows ? 1 : rows);
+
+    DMatrix o(reduceRows ? 1 : rows, reduceCols ? 1 : cols);
+    if (reductionOp == ElementWiseOperator::opArgmax || reductionOp == ElementWiseOperator::opArgmin)
+        o.TensorArgOp(a, reductionOp, array<size_t, 2>{0, 0}, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    else
+        o.TensorOp(0, a, 1, ElementWiseOperator::opCopy, reductionOp, array<size_t, 2>{0, 0}, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+    return o;
+}
+
+// the same reduction computed with plain loops
+static DMatrix ReferenceReduce(const DMatrix& a, ElementWiseOperator reductionOp, bool reduceRows, bool reduceCols)
+{
+    DMatrix o(reduceRows ? 1 : a.GetNumRows(), reduceCols ? 1 : a.GetNumCols());
+    DMatrix count = DMatrix::Zeros(o.GetNumRows(), o.GetNumCols());
+    DMatrix best(o.GetNumRows(), o.GetNumCols());
+    for (size_t j = 0; j < a.GetNumCols(); j++)
+    {
+        for (size_t i = 0; i < a.GetNumRows(); i++)
+        {
+            size_t oi = reduceRows ? 0 : i, oj = reduceCols ? 0 : j;
+            double index = reduceRows ? (reduceCols ? j * a.GetNumRows() + i : i) : j;
+            double val = a(i, j);
+            bool first = count(oi, oj)++ == 0;
+            switch (reductionOp)
+            {
+            case ElementWiseOperator::opSum:
+                o(oi, oj) = first ? val : o(oi, oj) + val;
+                break;
+            case ElementWiseOperator::opMax:
+                o(oi, oj) = first ? val : max(o(oi, oj), val);
+                break;
+            case ElementWiseOperator::opLogSum:
+                o(oi, oj) = first ? val : max(o(oi, oj), val) + log1p(exp(-fabs(o(oi, oj) - val)));
+                break;
+            case ElementWiseOperator::opArgmax:
+                if (first || val > best(oi, oj))
+                {
+                    best(oi, oj) = val;
+                    o(oi, oj) = index;
+                }
+                break;
+            default:
+                LogicError("ReferenceReduce: unsupported reduction.");
+            }
+        }
+    }
+    return o;
+}
+
 BOOST_AUTO_TEST_SUITE(CPUMatrixSuite)
 
 BOOST_FIXTURE_TEST_CASE(CPUMatrixConstructorNoFlags, RandomSeedFixture)
@@ -295,6 +366,96 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixMultiplyAndDiv, RandomSeedFixture)
     BOOST_CHECK(m3.IsEqualTo(m2));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixHalfMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    // Sizes that span several blocks of the blocked half product, with partial blocks at the edges
+    const size_t m = 300, n = 270, k = 520;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    auto randomHalf = [&](size_t rows, size_t cols)
+    {
+        CPUMatrix<half> result(rows, cols);
+        for (size_t j = 0; j < cols; j++)
+            for (size_t i = 0; i < rows; i++)
+                result(i, j) = dist(rng);
+        return result;
+    };
+
+    for (bool transposeA : { false, true })
+        for (bool transposeB : { false, true })
+        {
+            CPUMatrix<half> a = transposeA ? randomHalf(k, m) : randomHalf(m, k);
+            CPUMatrix<half> b = transposeB ? randomHalf(n, k) : randomHalf(k, n);
+            CPUMatrix<half> c = randomHalf(m, n);
+            CPUMatrix<half> c0 = c.DeepClone();
+
+            const float alpha = 0.5f, beta = 2.0f;
+            CPUMatrix<half>::MultiplyAndWeightedAdd(alpha, a, transposeA, b, transposeB, beta, c);
+
+            for (size_t i = 0; i < m; i++)
+                for (size_t j = 0; j < n; j++)
+                {
+                    double expected = beta * (float)c0(i, j), magnitude = 0;
+                    for (size_t l = 0; l < k; l++)
+                    {
+                        double product = (double)(float)(transposeA ? a(l, i) : a(i, l)) * (float)(transposeB ? b(j, l) : b(l, j));
+                        expected += alpha * product;
+                        magnitude += fabs(alpha * product);
+                    }
+                    BOOST_REQUIRE_SMALL((float)c(i, j) - expected, 2e-3 * (magnitude + fabs(expected)) + 1e-3);
+                }
+        }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixHalfSoftmaxSum, RandomSeedFixture)
+{
+    // labels (row vector of class indices) and log softmax [numSamples x numClasses]
+    const size_t numSamples = 100, numClasses = 7;
+    CPUMatrix<half> labels(1, numSamples), softmax(numSamples, numClasses), c(1, 1);
+    float expected = 0;
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        labels(0, i) = (float)(i % numClasses);
+        for (size_t j = 0; j < numClasses; j++)
+            softmax(i, j) = -0.25f * (float)(j + 1);
+        expected -= (float)softmax(i, i % numClasses);
+    }
+    labels.AssignSoftmaxSum(softmax, c);
+    BOOST_CHECK_CLOSE((float)c(0, 0), expected, 0.1);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixHalfNCEUnnormalizedEval, RandomSeedFixture)
+{
+    // samples (row vector of negated class indices), hidden [dim x numSamples], embedding [dim x numClasses], bias [numClasses x 1]
+    const size_t numSamples = 100, numClasses = 11, dim = 16;
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> dist(0, 1);
+    CPUMatrix<half> samples(1, numSamples), hidden(dim, numSamples), embedding(dim, numClasses), bias(numClasses, 1), c(1, 1);
+    CPUMatrix<float> samplesFloat(1, numSamples), hiddenFloat(dim, numSamples), embeddingFloat(dim, numClasses), biasFloat(numClasses, 1), cFloat(1, 1);
+    // the float inputs hold the same (half) values, so the results only differ by the precision of the computation
+    auto fill = [&](CPUMatrix<half>& m, CPUMatrix<float>& mFloat)
+    {
+        for (size_t j = 0; j < m.GetNumCols(); j++)
+            for (size_t i = 0; i < m.GetNumRows(); i++)
+            {
+                m(i, j) = dist(rng);
+                mFloat(i, j) = (float)m(i, j);
+            }
+    };
+    fill(hidden, hiddenFloat);
+    fill(embedding, embeddingFloat);
+    fill(bias, biasFloat);
+    for (size_t i = 0; i < numSamples; i++)
+    {
+        samples(0, i) = -(float)(i % numClasses);
+        samplesFloat(0, i) = -(float)(i % numClasses);
+    }
+
+    samples.AssignNCEUnnormalizedEval(hidden, embedding, bias, c);
+    samplesFloat.AssignNCEUnnormalizedEval(hiddenFloat, embeddingFloat, biasFloat, cFloat);
+    BOOST_CHECK_CLOSE((float)c(0, 0), cFloat(0, 0), 0.1);
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixElementOperations, RandomSeedFixture)
 {
     // TODO: consider splitting this large test
@@ -1215,6 +1376,180 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherFromTarget, RandomSeedFixture)
     BOOST_CHECK(m2.IsEqualTo(expect, 1e-6));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpReduction, RandomSeedFixture)
+{
+    // use several threads even on small machines, so that both parallel reduction strategies are exercised
+    int numThreads = omp_get_max_threads();
+    omp_set_num_threads(4);
+
+    DMatrix a = DMatrix::RandomUniform(300, 200, -1, 1, IncrementCounter());
+    DMatrix wide = DMatrix::RandomUniform(2, 30000, -1, 1, IncrementCounter());
+    for (auto reductionOp : { ElementWiseOperator::opSum, ElementWiseOperator::opMax, ElementWiseOperator::opLogSum })
+    {
+        BOOST_CHECK(TensorReduce(a, reductionOp, true, false).IsEqualTo(ReferenceReduce(a, reductionOp, true, false), 1e-10));  // many outputs, contiguous
+        BOOST_CHECK(TensorReduce(a, reductionOp, false, true).IsEqualTo(ReferenceReduce(a, reductionOp, false, true), 1e-10));  // many outputs, strided
+        BOOST_CHECK(TensorReduce(a, reductionOp, true, true).IsEqualTo(ReferenceReduce(a, reductionOp, true, true), 1e-10));    // scalar
+        BOOST_CHECK(TensorReduce(wide, reductionOp, false, true).IsEqualTo(ReferenceReduce(wide, reductionOp, false, true), 1e-10)); // two outputs
+    }
+
+    // the result must not depend on the number of threads
+    DMatrix large = DMatrix::RandomUniform(1, 100000, -1, 1, IncrementCounter());
+    DMatrix parallelSum = TensorReduce(large, ElementWiseOperator::opSum, true, true);
+    omp_set_num_threads(1);
+    DMatrix serialSum = TensorReduce(large, ElementWiseOperator::opSum, true, true);
+    BOOST_CHECK_EQUAL(parallelSum(0, 0), serialSum(0, 0));
+
+    // small reductions are run serially and sum the elements in order, even if they are contiguous
+    DMatrix small = DMatrix::RandomUniform(1000, 2, -1, 1, IncrementCounter());
+    BOOST_CHECK(TensorReduce(small, ElementWiseOperator::opSum, true, false).IsEqualTo(ReferenceReduce(small, ElementWiseOperator::opSum, true, false), 0));
+
+    omp_set_num_threads(numThreads);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorArgOpReduction, RandomSeedFixture)
+{
+    int numThreads = omp_get_max_threads();
+    omp_set_num_threads(4);
+
+    DMatrix a = DMatrix::RandomUniform(300, 200, -1, 1, IncrementCounter());
+    DMatrix wide = DMatrix::RandomUniform(2, 30000, -1, 1, IncrementCounter());
+    BOOST_CHECK(TensorReduce(a, ElementWiseOperator::opArgmax, true, false).IsEqualTo(ReferenceReduce(a, ElementWiseOperator::opArgmax, true, false), 0));
+    BOOST_CHECK(TensorReduce(a, ElementWiseOperator::opArgmax, false, true).IsEqualTo(ReferenceReduce(a, ElementWiseOperator::opArgmax, false, true), 0));
+    BOOST_CHECK(TensorReduce(wide, ElementWiseOperator::opArgmax, false, true).IsEqualTo(ReferenceReduce(wide, ElementWiseOperator::opArgmax, false, true), 0));
+
+    // ties are resolved towards the lowest index, also across threads
+    DMatrix ones(2, 30000);
+    ones.SetValue(1);
+    DMatrix index = TensorReduce(ones, ElementWiseOperator::opArgmax, false, true);
+    BOOST_CHECK_EQUAL(index(0, 0), 0);
+    BOOST_CHECK_EQUAL(index(1, 0), 0);
+
+    omp_set_num_threads(numThreads);
+}
+
+// Label sequence of an utterance in the layout of AssignCTCScore: blanks around and between the labels, with a
+// non-label position at each end
+static void AppendCTCLabels(const vector<size_t>& labels, size_t blankTokenId, size_t numFrames, vector<vector<size_t>>& phoneSeqs, vector<vector<size_t>>& phoneBounds)
+{
+    vector<size_t> phoneSeq{ SIZE_MAX, blankTokenId }, phoneBound{ 0, 0 };
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        size_t boundary = i * numFrames / labels.size();
+        phoneSeq.insert(phoneSeq.end(), { labels[i], blankTokenId });
+        phoneBound.insert(phoneBound.end(), { boundary, boundary });
+    }
+    phoneSeq.push_back(SIZE_MAX);
+    phoneBound.push_back(numFrames);
+    phoneSeqs.push_back(phoneSeq);
+    phoneBounds.push_back(phoneBound);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixCTCScore, RandomSeedFixture)
+{
+    int numThreads = omp_get_max_threads();
+    const size_t numLabels = 4, blankTokenId = numLabels - 1;
+
+    // Two channels with three utterances of random lengths and labels.
+    const size_t numChannels = 2, numFrames = 60;
+    vector<vector<size_t>> phoneSeqs, phoneBounds;
+    vector<size_t> uttToChanInd{ 0, 0, 1 }, uttBeginFrame{ 0, 25, 0 }, uttFrameNum{ 25, 35, 60 }, uttPhoneNum;
+    std::mt19937 rng(IncrementCounter());
+    for (size_t utt = 0; utt < uttFrameNum.size(); utt++)
+    {
+        vector<size_t> labels(1 + rng() % (uttFrameNum[utt] / 3));
+        for (auto& label : labels)
+            label = rng() % blankTokenId;
+        AppendCTCLabels(labels, blankTokenId, uttFrameNum[utt], phoneSeqs, phoneBounds);
+        uttPhoneNum.push_back(phoneSeqs.back().size());
+    }
+    size_t maxPhoneNum = 0;
+    for (const auto& phoneSeq : phoneSeqs)
+        maxPhoneNum = std::max(maxPhoneNum, phoneSeq.size());
+    SMatrix phoneSeq(maxPhoneNum, phoneSeqs.size()), phoneBound(maxPhoneNum, phoneSeqs.size());
+    for (size_t utt = 0; utt < phoneSeqs.size(); utt++)
+    {
+        for (size_t s = 0; s < phoneSeqs[utt].size(); s++)
+        {
+            phoneSeq(s, utt) = (float)phoneSeqs[utt][s];
+            phoneBound(s, utt) = (float)phoneBounds[utt][s];
+        }
+    }
+
+    // log-softmax of random activations
+    SMatrix prob = SMatrix::RandomUniform(numLabels, numFrames * numChannels, -3, 3, IncrementCounter());
+    for (size_t j = 0; j < prob.GetNumCols(); j++)
+    {
+        float sum = 0;
+        for (size_t i = 0; i < numLabels; i++)
+            sum += exp(prob(i, j));
+        for (size_t i = 0; i < numLabels; i++)
+            prob(i, j) -= log(sum);
+    }
+
+    for (int delayConstraint : { -1, 3 })
+    {
+        SMatrix posterior[2], alpha[2], beta[2], totalScore[2];
+        for (int i = 0; i < 2; i++)
+        {
+            omp_set_num_threads(i == 0 ? 1 : 4);
+            // the scores are accumulated in the log domain, as Matrix::AssignCTCScore does they start at LZERO
+            posterior[i].Resize(numLabels, prob.GetNumCols());
+            posterior[i].SetValue(LZERO);
+            alpha[i].Resize(maxPhoneNum, prob.GetNumCols());
+            alpha[i].SetValue(LZERO);
+            beta[i].Resize(maxPhoneNum, prob.GetNumCols());
+            beta[i].SetValue(LZERO);
+            totalScore[i].Resize(1, 1);
+            posterior[i].AssignCTCScore(prob, alpha[i], beta[i], phoneSeq, phoneBound, totalScore[i], uttToChanInd, uttBeginFrame,
+                                        uttFrameNum, uttPhoneNum, numChannels, numFrames, blankTokenId, delayConstraint, true);
+        }
+
+        // the utterances are processed independently, the result must not depend on the number of threads
+        BOOST_CHECK(posterior[0].IsEqualTo(posterior[1], 0));
+        BOOST_CHECK_EQUAL(totalScore[0](0, 0), totalScore[1](0, 0));
+        BOOST_CHECK(totalScore[0](0, 0) > 0);
+
+        // without a delay constraint all paths are allowed, the posteriors of each frame sum to 1
+        if (delayConstraint == -1)
+        {
+            for (size_t j = 0; j < posterior[0].GetNumCols(); j++)
+            {
+                float sum = 0;
+                for (size_t i = 0; i < numLabels; i++)
+                    sum += posterior[0](i, j);
+                BOOST_CHECK_CLOSE(sum, 1.0f, 1e-2);
+            }
+        }
+    }
+
+    // A single label 'a' in two frames is emitted by the paths "aa", "-a" and "a-".
+    {
+        vector<vector<size_t>> seqs, bounds;
+        AppendCTCLabels({ 0 }, blankTokenId, 2, seqs, bounds);
+        SMatrix seq(seqs[0].size(), 1), bound(seqs[0].size(), 1);
+        for (size_t s = 0; s < seqs[0].size(); s++)
+        {
+            seq(s, 0) = (float)seqs[0][s];
+            bound(s, 0) = (float)bounds[0][s];
+        }
+        SMatrix frames = prob.ColumnSlice(0, 2);
+        double pa0 = exp(frames(0, 0)), pa1 = exp(frames(0, 1));
+        double pb0 = exp(frames(blankTokenId, 0)), pb1 = exp(frames(blankTokenId, 1));
+        double expected = -log(pa0 * pa1 + pb0 * pa1 + pa0 * pb1);
+
+        SMatrix posterior(numLabels, 2), alpha(seq.GetNumRows(), 2), beta(seq.GetNumRows(), 2), totalScore(1, 1);
+        posterior.SetValue(LZERO);
+        alpha.SetValue(LZERO);
+        beta.SetValue(LZERO);
+        posterior.AssignCTCScore(frames, alpha, beta, seq, bound, totalScore, { 0 }, { 0 }, { 2 }, { seqs[0].size() }, 1, 2, blankTokenId, -1, true);
+        BOOST_CHECK_CLOSE(totalScore(0, 0), expected, 1e-3);
+        // 'a' is emitted in the first frame by "aa" and "a-"
+        BOOST_CHECK_CLOSE(posterior(0, 0), (pa0 * pa1 + pa0 * pb1) / (pa0 * pa1 + pb0 * pa1 + pa0 * pb1), 1e-2);
+    }
+
+    omp_set_num_threads(numThreads);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -0,0 +1,128 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Tests for the CPU implementation of OptimizedRNNStack (CPURNNExecutor)
+//
+#include "stdafx.h"
+#include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/RNNCommon.h"
+#include <math.h>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+typedef CPUDoubleMatrix DMatrix;
+
+static double Sigmoid(double x)
+{
+    return 1 / (1 + exp(-x));
+}
+
+// sum(Y .* V) after a forward pass, used as the objective for the gradient checks
+static double RNNObjective(const RnnAttributes& attributes, const DMatrix& x, const DMatrix& w, const DMatrix& v, const vector<size_t>& numSequencesForFrame, size_t xDim)
+{
+    DMatrix y, reserve, workspace;
+    y.RNNForward(x, w, xDim, v.GetNumRows(), numSequencesForFrame, attributes, reserve, workspace);
+    double sum = 0;
+    for (size_t j = 0; j < y.GetNumCols(); j++)
+        for (size_t i = 0; i < y.GetNumRows(); i++)
+            sum += y(i, j) * v(i, j);
+    return sum;
+}
+
+static void CheckRNNGradients(const wstring& recurrentOp, bool bidirectional, size_t numLayers, unsigned long seed)
+{
+    const size_t xDim = 3;
+    const size_t hiddenSize = 2;
+    const vector<size_t> numSequencesForFrame = { 3, 2, 2, 1 }; // three sequences of length 4, 3 and 1
+    const size_t numSamples = 8;
+    const double epsilon = 1e-6;
+    const double tolerance = 1e-5;
+
+    RnnAttributes attributes(bidirectional, numLayers, hiddenSize, recurrentOp, -1);
+    const size_t yDim = (bidirectional ? 2 : 1) * hiddenSize;
+    auto numParameters = attributes.GetNumParameters(xDim);
+
+    DMatrix x = DMatrix::RandomUniform(xDim, numSamples, -1, 1, seed);
+    DMatrix w = DMatrix::RandomUniform(numParameters.first, numParameters.second, -0.5, 0.5, seed + 1);
+    DMatrix v = DMatrix::RandomUniform(yDim, numSamples, -1, 1, seed + 2);
+
+    DMatrix y, reserve, workspace;
+    y.RNNForward(x, w, xDim, yDim, numSequencesForFrame, attributes, reserve, workspace);
+    BOOST_REQUIRE_EQUAL(y.GetNumRows(), yDim);
+    BOOST_REQUIRE_EQUAL(y.GetNumCols(), numSamples);
+
+    DMatrix dx(xDim, numSamples);
+    DMatrix dw = DMatrix::Zeros(w.GetNumRows(), w.GetNumCols());
+    y.RNNBackwardData(v, w, dx, attributes, reserve, workspace);
+    y.RNNBackwardWeights(x, y, dw, attributes, reserve, workspace);
+
+    for (size_t i = 0; i < w.GetNumElements(); i++)
+    {
+        double original = w.Data()[i];
+        w.Data()[i] = original + epsilon;
+        double plus = RNNObjective(attributes, x, w, v, numSequencesForFrame, xDim);
+        w.Data()[i] = original - epsilon;
+        double minus = RNNObjective(attributes, x, w, v, numSequencesForFrame, xDim);
+        w.Data()[i] = original;
+        BOOST_CHECK_SMALL((plus - minus) / (2 * epsilon) - dw.Data()[i], tolerance);
+    }
+
+    for (size_t i = 0; i < x.GetNumElements(); i++)
+    {
+        double original = x.Data()[i];
+        x.Data()[i] = original + epsilon;
+        double plus = RNNObjective(attributes, x, w, v, numSequencesForFrame, xDim);
+        x.Data()[i] = original - epsilon;
+        double minus = RNNObjective(attributes, x, w, v, numSequencesForFrame, xDim);
+        x.Data()[i] = original;
+        BOOST_CHECK_SMALL((plus - minus) / (2 * epsilon) - dx.Data()[i], tolerance);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(CPURNNSuite)
+
+BOOST_FIXTURE_TEST_CASE(CPURNNLSTMForwardSingleStep, RandomSeedFixture)
+{
+    // one sequence of one frame, xDim = hiddenSize = 1: the result can be computed by hand
+    RnnAttributes attributes(false, 1, 1, L"lstm", -1);
+    DMatrix x(1, 1);
+    x(0, 0) = 0.5;
+
+    // layout: W (i, f, c, o), R (i, f, c, o), bW (i, f, c, o), bR (i, f, c, o)
+    double values[16] = { 0.1, 0.2, 0.3, 0.4,  0.5, 0.6, 0.7, 0.8,  0.01, 0.02, 0.03, 0.04,  0.05, 0.06, 0.07, 0.08 };
+    DMatrix w(16, 1, values, matrixFlagNormal);
+
+    DMatrix y, reserve, workspace;
+    y.RNNForward(x, w, 1, 1, vector<size_t>{ 1 }, attributes, reserve, workspace);
+
+    double i = Sigmoid(0.1 * 0.5 + 0.01 + 0.05);
+    double g = tanh(0.3 * 0.5 + 0.03 + 0.07);
+    double o = Sigmoid(0.4 * 0.5 + 0.04 + 0.08);
+    double expected = o * tanh(i * g); // the forget gate only acts on the (zero) initial cell state
+    BOOST_CHECK_CLOSE(y(0, 0), expected, 1e-10);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPURNNLSTMGradients, RandomSeedFixture)
+{
+    CheckRNNGradients(L"lstm", false, 1, IncrementCounter());
+    CheckRNNGradients(L"lstm", true, 2, IncrementCounter());
+}
+
+BOOST_FIXTURE_TEST_CASE(CPURNNGRUGradients, RandomSeedFixture)
+{
+    CheckRNNGradients(L"gru", false, 1, IncrementCounter());
+    CheckRNNGradients(L"gru", true, 2, IncrementCounter());
+}
+
+BOOST_FIXTURE_TEST_CASE(CPURNNTanhGradients, RandomSeedFixture)
+{
+    CheckRNNGradients(L"rnnTanh", false, 2, IncrementCounter());
+    CheckRNNGradients(L"rnnTanh", true, 1, IncrementCounter());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include <algorithm>
 #include <array>
+#include <cstdio>
+#include <fstream>
 #include <random>
 #include <numeric>
 #include <boost/random/normal_distribution.hpp>
@@ -99,6 +101,12 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Winograd and direct engines. Implemented only for CPU, Gemm engine is used for configurations they do not support.
+    auto withGemm = [](ConvolutionEngineKind kind) { return (ConvolutionEngineKind)((int)kind | (int)ConvolutionEngineKind::Gemm); };
+    res.push_back(std::make_tuple(withGemm(ConvolutionEngineKind::Winograd), -1, 0));
+    res.push_back(std::make_tuple(withGemm(ConvolutionEngineKind::Winograd), -1, 3));
+    res.push_back(std::make_tuple(withGemm(ConvolutionEngineKind::Direct), -1, 0));
     return res;
 }
 
@@ -166,6 +174,12 @@ std::vector<ConvolveGeometryPtr> GenerateConvTestConfigs()
         ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
         TensorShape(0), TensorShape(0)));
 
+    // 3x3 convolution without padding, output is not a multiple of Winograd tiles.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(11, 10, 4),
+        TensorShape(3, 3, 4), TensorShape(6), TensorShape(1),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+
     // 1x1 convolution (shortcuts in ResNet).
     res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(16, 16, 2),
         TensorShape(1, 1, 2), TensorShape(1), TensorShape(2, 2, 1),
@@ -421,6 +435,170 @@ BOOST_AUTO_TEST_CASE(ConvolutionBackwardKernel)
     }
 }
 
+BOOST_AUTO_TEST_CASE(DepthwiseConvolutionDirect)
+{
+    // Depthwise convolution is compared to the same convolution without groups computed by reference engine,
+    // whose kernels are zero everywhere except for the input map of their group.
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    size_t mapInCount = 3;
+    size_t n = 4;
+    for (size_t stride : {1, 2})
+    {
+        for (size_t multiplier : {1, 2})
+        {
+            size_t mapCount = mapInCount * multiplier;
+            auto g = std::make_shared<ConvolveGeometry>(TensorShape(9, 8, mapInCount),
+                TensorShape(3, 3, 1), TensorShape(mapCount), TensorShape(stride, stride, 1),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+                TensorShape(0), TensorShape(0), TensorShape(1), false, mapInCount);
+            auto gRef = std::make_shared<ConvolveGeometry>(TensorShape(9, 8, mapInCount),
+                TensorShape(3, 3, mapInCount), TensorShape(mapCount), TensorShape(stride, stride, mapInCount),
+                ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+                TensorShape(0), TensorShape(0));
+            BOOST_REQUIRE(g->OutputShape() == gRef->OutputShape());
+
+            auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Direct);
+            auto refEng = ConvEng::Create(gRef, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+
+            size_t kernelSize = g->KernelShape().GetNumElements();
+            auto expandKernel = [&](const vec& kern)
+            {
+                vec res(kernelSize * mapInCount * mapCount, 0);
+                for (size_t k = 0; k < mapCount; k++)
+                    std::copy(begin(kern) + k * kernelSize, begin(kern) + (k + 1) * kernelSize, begin(res) + (k * mapInCount + k / multiplier) * kernelSize);
+                return res;
+            };
+
+            vec buf(g->InputShape().GetNumElements() * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+            buf.resize(g->OutputShape().GetNumElements() * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix srcGrad(g->OutputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+            vec kernBuf(kernelSize * mapCount);
+            std::generate(begin(kernBuf), end(kernBuf), [&] { return nd(rng); });
+            vec kernBufRef = expandKernel(kernBuf);
+            SingleMatrix kernel(mapCount, kernelSize, kernBuf.data(), deviceId, matrixFlagNormal);
+            SingleMatrix kernelRef(mapCount, kernelSize * mapInCount, kernBufRef.data(), deviceId, matrixFlagNormal);
+
+            SingleMatrix workspace(deviceId);
+            std::string emsg;
+            std::stringstream tmsg;
+            tmsg << "Geometry: " << (std::string)(*g) << ", Batch: " << n;
+            std::string msg = " are not equal, " + tmsg.str();
+
+            SingleMatrix out(g->OutputShape().GetNumElements(), n, deviceId);
+            SingleMatrix outRef(g->OutputShape().GetNumElements(), n, deviceId);
+            testEng->Forward(in, kernel, out, workspace);
+            refEng->Forward(in, kernelRef, outRef, workspace);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outRef, emsg, Err<float>::Rel * 4, Err<float>::Abs * 4), "out" << msg << ". " << emsg);
+
+            SingleMatrix grad(in.DeepClone(), deviceId);
+            SingleMatrix gradRef(in.DeepClone(), deviceId);
+            testEng->BackwardData(srcGrad, kernel, grad, true, workspace);
+            refEng->BackwardData(srcGrad, kernelRef, gradRef, true, workspace);
+            BOOST_REQUIRE_MESSAGE(CheckEqual(grad, gradRef, emsg, Err<float>::Rel * 16, Err<float>::Abs * 16), "grad" << msg << ". " << emsg);
+
+            SingleMatrix kernelGrad(kernel.DeepClone(), deviceId);
+            SingleMatrix kernelGradRef(kernelRef.DeepClone(), deviceId);
+            testEng->BackwardKernel(srcGrad, in, kernelGrad, true, false, workspace);
+            refEng->BackwardKernel(srcGrad, in, kernelGradRef, true, false, workspace);
+            // Kernels of the reference engine also get gradients outside of their group, only the ones inside are compared.
+            std::unique_ptr<float[]> kernelGradRefData(kernelGradRef.CopyToArray());
+            vec kernelGradGroups(kernelSize * mapCount);
+            for (size_t k = 0; k < mapCount; k++)
+                std::copy(kernelGradRefData.get() + (k * mapInCount + k / multiplier) * kernelSize,
+                          kernelGradRefData.get() + (k * mapInCount + k / multiplier + 1) * kernelSize, begin(kernelGradGroups) + k * kernelSize);
+            kernelGradRef.SetValue(mapCount, kernelSize, deviceId, kernelGradGroups.data());
+            BOOST_REQUIRE_MESSAGE(CheckEqual(kernelGrad, kernelGradRef, emsg, Err<float>::Rel * 192, Err<float>::Abs * 32), "kernel" << msg << ". " << emsg);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConvolutionTuningCacheReuse)
+{
+    // The first engine tunes and persists its decision, the second one with the same geometry must reuse it.
+    // Every tuning appends a line to the cache file, so the number of lines counts the tunings.
+    const char* cacheFile = "ConvolutionTuningCache.txt";
+    std::remove(cacheFile);
+    SetConvolutionTuningCachePath(L"ConvolutionTuningCache.txt");
+    auto readLines = [&]
+    {
+        std::ifstream file(cacheFile);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(file, line);)
+            lines.push_back(line);
+        return lines;
+    };
+
+    std::mt19937 rng(0);
+    boost::random::normal_distribution<float> nd;
+
+    int deviceId = -1;
+    size_t n = 4;
+    auto g = std::make_shared<ConvolveGeometry>(TensorShape(10, 9, 4), TensorShape(3, 3, 4), TensorShape(5), TensorShape(1, 1, 4),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false}, TensorShape(0), TensorShape(0));
+    auto refEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+
+    vec buf(g->InputShape().GetNumElements() * n);
+    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+    SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+    buf.resize(g->KernelShape().GetNumElements() * g->KernelCount());
+    std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+    SingleMatrix kernel(g->KernelCount(), g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+    SingleMatrix workspace(deviceId);
+    SingleMatrix outRef(g->OutputShape().GetNumElements(), n, deviceId);
+    refEng->Forward(in, kernel, outRef, workspace);
+
+    std::string emsg;
+    auto forward = [&](const std::string& run)
+    {
+        auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None,
+                                       (ConvolutionEngineKind)((int)ConvolutionEngineKind::Winograd | (int)ConvolutionEngineKind::Gemm));
+        SingleMatrix out(g->OutputShape().GetNumElements(), n, deviceId);
+        testEng->Forward(in, kernel, out, workspace);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outRef, emsg, Err<float>::Rel * 4, Err<float>::Abs * 4), "out are not equal, " << run << ". " << emsg);
+    };
+    for (int run = 0; run < 2; run++)
+    {
+        forward("run " + std::to_string(run));
+        BOOST_REQUIRE_EQUAL(readLines().size(), 1);
+    }
+
+    // A new run loads the file. Replace the decision with another engine: it must be used as is, without tuning.
+    auto lines = readLines();
+    auto key = lines[0].substr(0, lines[0].find(' '));
+    auto tunedEngine = lines[0].substr(key.size() + 1, lines[0].find(' ', key.size() + 1) - key.size() - 1);
+    auto cachedDecision = key + (tunedEngine == "Gemm" ? " WinogradF2 0" : " Gemm 1");
+    {
+        std::ofstream file(cacheFile, std::ios::trunc);
+        file << cachedDecision << "\n";
+    }
+    SetConvolutionTuningCachePath(L"ConvolutionTuningCache.txt");
+    forward("cached decision");
+    lines = readLines();
+    BOOST_REQUIRE_EQUAL(lines.size(), 1);
+    BOOST_REQUIRE_EQUAL(lines[0], cachedDecision);
+
+    // A decision for an engine that is not available is tuned again.
+    {
+        std::ofstream file(cacheFile, std::ios::trunc);
+        file << key << " Unavailable 0\n";
+    }
+    SetConvolutionTuningCachePath(L"ConvolutionTuningCache.txt");
+    forward("unavailable engine");
+    BOOST_REQUIRE_EQUAL(readLines().size(), 2);
+
+    SetConvolutionTuningCachePath(L"");
+    std::remove(cacheFile);
+}
+
 BOOST_AUTO_TEST_CASE(PoolingForward)
 {
     std::mt19937 rng(0);
@@ -5,6 +5,8 @@
 #include "stdafx.h"
 #include "../../../Source/Math/QuantizedOperations.h"
 #include "../../../Source/Math/Helpers.h"
+#include <array>
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -51,6 +53,69 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
 }
 
 
+BOOST_FIXTURE_TEST_CASE(QuantizedGemmMatchesReference, RandomSeedFixture)
+{
+    // Shapes that are not multiples of the panel sizes, with odd and even k
+    std::vector<std::array<size_t, 3>> shapes = { { 1, 1, 1 }, { 17, 5, 3 }, { 16, 4, 2 }, { 33, 9, 64 }, { 100, 37, 129 }, { 300, 260, 50 } };
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> dist(-3000, 3000);
+    for (const auto& shape : shapes)
+    {
+        size_t m = shape[0], n = shape[1], k = shape[2];
+        std::vector<short> A(m*k), B(k*n);
+        for (auto& a : A)
+            a = (short)dist(rng);
+        for (auto& b : B)
+            b = (short)dist(rng);
+
+        std::vector<short> packedA, packedB;
+        QuantizedGemm::PackA(A.data(), m, k, packedA);
+        QuantizedGemm::PackB(B.data(), k, n, packedB);
+        std::vector<double> C(m*n);
+        QuantizedGemm::Multiply(packedA, packedB, m, n, k, C.data());
+
+        for (size_t i = 0; i < m; i++)
+            for (size_t j = 0; j < n; j++)
+            {
+                int64_t dotProduct = 0;
+                for (size_t l = 0; l < k; l++)
+                    dotProduct += (int64_t)A[i + l*m] * B[l + k*j];
+                BOOST_REQUIRE_EQUAL(C[i + j*m], (double)dotProduct);
+            }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(MultiplyIntToSignedChar, RandomSeedFixture)
+{
+    // Values in [-127, 127] with an absolute maximum of 127 are quantized exactly to 8 bits
+    int m = 19, n = 6, k = 7;
+    std::vector<float> A(m*k), B(k*n);
+    for (size_t i = 0; i < A.size(); i++)
+        A[i] = (float)((int)(i * 37 % 255) - 127);
+    for (size_t i = 0; i < B.size(); i++)
+        B[i] = (float)((int)(i * 53 % 255) - 127);
+    A[0] = 127;
+    B[0] = -127;
+
+    shared_ptr<QuantizerBase<float, signed char>> quantA(new SymmetricQuantizer<float, signed char>(0));
+    shared_ptr<QuantizerBase<float, signed char>> quantB(new SymmetricQuantizer<float, signed char>(0));
+    QuantizedMultiplier<float, signed char> mult(quantA, false, quantB, true);
+
+    std::vector<float> C(m*n);
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        mult.Multiply(m, n, k, A.data(), B.data(), C.data());
+        for (size_t i = 0; i < m; i++)
+            for (size_t j = 0; j < n; j++)
+            {
+                float dotProduct = 0;
+                for (size_t l = 0; l < k; l++)
+                    dotProduct += A[i + l*m] * B[l + k*j];
+                BOOST_CHECK_EQUAL(round(C[i + j*m]), dotProduct);
+            }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
\ No newline at end of file
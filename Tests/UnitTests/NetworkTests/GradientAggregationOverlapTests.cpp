@@ -0,0 +1,346 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/SGDLib/SimpleDistGradAggregator.h"
+#include "Globals.h"
+#include <map>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// criterion = SquareError(labels, W3 * ((W1 * features + b1) + (W2 * features + b2))), the two branches can
+// be back-propagated concurrently.
+struct TwoBranchNetwork
+{
+    TwoBranchNetwork()
+    {
+        const size_t numSamples = 5;
+        net = make_shared<ComputationNetwork>(CPUDEVICE);
+        ComputationNetworkBuilder<float> builder(*net);
+        auto features = builder.CreateInputNode(L"features", 3);
+        auto labels = builder.CreateInputNode(L"labels", 2);
+        auto W1 = builder.CreateLearnableParameter(L"W1", 4, 3);
+        auto b1 = builder.CreateLearnableParameter(L"b1", 4, 1);
+        auto W2 = builder.CreateLearnableParameter(L"W2", 4, 3);
+        auto b2 = builder.CreateLearnableParameter(L"b2", 4, 1);
+        auto W3 = builder.CreateLearnableParameter(L"W3", 2, 4);
+        auto z = builder.Plus(builder.Plus(builder.Times(W1, features), b1), builder.Plus(builder.Times(W2, features), b2));
+        criterion = builder.SquareError(labels, builder.Times(W3, z), L"criterion");
+        net->AddToNodeGroup(L"criterion", criterion);
+        net->CompileNetwork();
+
+        unsigned long seed = 1;
+        for (const auto& parameter : net->LearnableParameterNodes(criterion))
+            net->InitLearnableParameters(parameter, L"uniform", 1.0, seed++);
+        net->AllocateAllMatrices({}, {}, criterion);
+
+        net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+        features->Value().Resize(3, numSamples);
+        features->Value().SetUniformRandomValue(-1, 1, seed++);
+        labels->Value().Resize(2, numSamples);
+        labels->Value().SetUniformRandomValue(-1, 1, seed++);
+        net->StartEvaluateMinibatchLoop(criterion);
+    }
+
+    // Runs a forward and a backward pass, returns the names of the notified parameters in notification order
+    // and their gradients at the time of the notification.
+    vector<wstring> Backprop(map<wstring, vector<float>>& gradientsWhenNotified)
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        const auto& inputs = net->InputNodes(criterion);
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>(inputs.begin(), inputs.end()));
+        net->ForwardProp(criterion);
+
+        vector<wstring> notified;
+        net->Backprop(criterion, [&](const ComputationNodeBasePtr& node)
+        {
+            notified.push_back(node->NodeName());
+            const auto& gradient = node->As<ComputationNode<float>>()->Gradient();
+            gradientsWhenNotified[node->NodeName()] = vector<float>(gradient.Data(), gradient.Data() + gradient.GetNumElements());
+        });
+        return notified;
+    }
+
+    ComputationNetworkPtr net;
+    ComputationNodeBasePtr criterion;
+};
+
+// MPI stand-in for the second of two ranks. The other rank is assumed to contribute the same values, so an all-reduce
+// doubles its buffer. Like an MPI implementation without a progress thread, an all-reduce only progresses inside
+// MPI calls on it: it completes when it is tested for the second time, or when it is waited for.
+class TwoRankMPIWrapper : public MPIWrapper
+{
+public:
+    size_t m_numCompletedByTest = 0;
+    size_t m_numCompletedByWait = 0;
+
+    size_t NumNodesInUse() const override { return 2; }
+    size_t CurrentNodeRank() const override { return 1; }
+    bool IsMainNode() const override { return false; }
+    std::wstring CurrentNodeName() const override { return L"rank1"; }
+    bool IsIdle() const override { return false; }
+    bool UsingAllNodes() const override { return true; }
+    size_t MainNodeRank() const override { return 0; }
+    bool IsMultiHost() const override { return false; }
+    bool UseGpuGdr() override { return false; }
+
+    int Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype, MPI_Op, MPI_Request* request) override
+    {
+        BOOST_REQUIRE(sendbuf == MPI_IN_PLACE);
+        BOOST_REQUIRE(m_pending.find(request) == m_pending.end());
+        m_pending[request] = { (float*)recvbuf, count, 0 };
+        return 0;
+    }
+
+    int Test(MPI_Request* request, int* flag, MPI_Status*) override
+    {
+        auto pending = m_pending.find(request);
+        BOOST_REQUIRE(pending != m_pending.end());
+        *flag = (++pending->second.numTests == 2);
+        if (*flag)
+        {
+            Complete(pending);
+            m_numCompletedByTest++;
+        }
+        return 0;
+    }
+
+    int Wait(MPI_Request* request, MPI_Status*) override
+    {
+        // the header send request is not pending here
+        auto pending = m_pending.find(request);
+        if (pending != m_pending.end())
+        {
+            Complete(pending);
+            m_numCompletedByWait++;
+        }
+        return 0;
+    }
+
+    // the header exchange is a no-op
+    int Isend(const void*, int, MPI_Datatype, int, int, MPI_Request*) override { return 0; }
+    void Bcast(void*, int, MPI_Datatype, int) override {}
+
+    // not used by the gradient aggregation with buckets
+    int Finalize(void) override { return 0; }
+    int Waitany(int, MPI_Request[], int*, MPI_Status*) override { return Unexpected(); }
+    int Waitall(int, MPI_Request[], MPI_Status[]) override { return Unexpected(); }
+    int Testall(int, MPI_Request[], int*, MPI_Status[]) override { return Unexpected(); }
+    int Recv(void*, int, MPI_Datatype, int, int, MPI_Status*) override { return Unexpected(); }
+    int Irecv(void*, int, MPI_Datatype, int, int, MPI_Request*) override { return Unexpected(); }
+    int Abort(int) override { return Unexpected(); }
+    int Error_string(int, char*, int*) override { return Unexpected(); }
+    void AllReduce(std::vector<size_t>&) const override { Unexpected(); }
+    void AllReduce(std::vector<int>&) const override { Unexpected(); }
+    void AllReduce(std::vector<double>&) const override { Unexpected(); }
+    void AllReduce(std::vector<float>&) const override { Unexpected(); }
+    void AllReduce(size_t*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduce(int*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduce(double*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduce(float*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduce(size_t*, size_t*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduce(int*, int*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduce(double*, double*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduce(float*, float*, size_t, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(size_t*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(int*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(double*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(float*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(size_t*, size_t*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(int*, int*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(double*, double*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void AllReduceAsync(float*, float*, size_t, MPI_Request*, MPI_Op) const override { Unexpected(); }
+    void Bcast(size_t*, size_t, size_t) override { Unexpected(); }
+    void Bcast(double*, size_t, size_t) override { Unexpected(); }
+    void Bcast(float*, size_t, size_t) override { Unexpected(); }
+    void AllGatherAsync(const size_t*, size_t, size_t*, size_t, MPI_Request*) const override { Unexpected(); }
+    void AllGatherAsync(const int*, size_t, int*, size_t, MPI_Request*) const override { Unexpected(); }
+    void AllGatherAsync(const float*, size_t, float*, size_t, MPI_Request*) const override { Unexpected(); }
+    void AllGatherAsync(const double*, size_t, double*, size_t, MPI_Request*) const override { Unexpected(); }
+    void AllGather(const size_t*, size_t, size_t*, size_t) const override { Unexpected(); }
+    void AllGather(const int*, size_t, int*, size_t) const override { Unexpected(); }
+    void AllGather(const float*, size_t, float*, size_t) const override { Unexpected(); }
+    void AllGather(const double*, size_t, double*, size_t) const override { Unexpected(); }
+    void Allgather(const void*, int, MPI_Datatype, void*, int, MPI_Datatype) const override { Unexpected(); }
+    void Gather(const size_t*, size_t, size_t*, size_t, size_t) const override { Unexpected(); }
+    void Gather(const int*, size_t, int*, size_t, size_t) const override { Unexpected(); }
+    void Gather(const float*, size_t, float*, size_t, size_t) const override { Unexpected(); }
+    void Gather(const double*, size_t, double*, size_t, size_t) const override { Unexpected(); }
+    void Gatherv(const size_t*, size_t, size_t*, int[], int[], size_t) const override { Unexpected(); }
+    void Gatherv(const char*, size_t, char*, int[], int[], size_t) const override { Unexpected(); }
+    void Gatherv(const int*, size_t, int*, int[], int[], size_t) const override { Unexpected(); }
+    void Gatherv(const float*, size_t, float*, int[], int[], size_t) const override { Unexpected(); }
+    void Gatherv(const double*, size_t, double*, int[], int[], size_t) const override { Unexpected(); }
+    void Allgatherv(const char*, size_t, char*, int[], int[]) const override { Unexpected(); }
+    int WaitAll() override { return Unexpected(); }
+    void WaitAny(MPI_Request*, int, int*) override { Unexpected(); }
+    void Wait(MPI_Request*) override { Unexpected(); }
+    int WaitAll(std::vector<MPI_Request>&) override { return Unexpected(); }
+
+private:
+    struct PendingAllReduce
+    {
+        float* buffer;
+        int count;
+        size_t numTests;
+    };
+
+    // by the address of their request, which stays the same while they are in flight
+    map<MPI_Request*, PendingAllReduce> m_pending;
+
+    void Complete(map<MPI_Request*, PendingAllReduce>::iterator pending)
+    {
+        for (int i = 0; i < pending->second.count; i++)
+            pending->second.buffer[i] *= 2;
+        m_pending.erase(pending);
+    }
+
+    static int Unexpected()
+    {
+        LogicError("TwoRankMPIWrapper: unexpected MPI call");
+    }
+};
+
+static void CheckGradientReadyNotifications(size_t numThreads)
+{
+    auto previousNumThreads = Globals::GetNodeExecutionThreads();
+    Globals::SetNodeExecutionThreads(numThreads);
+
+    TwoBranchNetwork network;
+    vector<wstring> expected;
+    const auto& evalOrder = network.net->GetEvalOrder(network.criterion);
+    for (auto node = evalOrder.rbegin(); node != evalOrder.rend(); node++)
+    {
+        if ((*node)->IsLeaf() && (*node)->NeedsGradient())
+            expected.push_back((*node)->NodeName());
+    }
+    BOOST_REQUIRE_EQUAL(expected.size(), 5u);
+
+    map<wstring, vector<float>> gradientsWhenNotified;
+    auto notified = network.Backprop(gradientsWhenNotified);
+    Globals::SetNodeExecutionThreads(previousNumThreads);
+
+    // Every parameter is notified once, in reverse evaluation order, and its gradient does not change afterwards.
+    BOOST_CHECK(notified == expected);
+    for (const auto& parameter : network.net->LearnableParameterNodes(network.criterion))
+    {
+        const auto& gradient = parameter->As<ComputationNode<float>>()->Gradient();
+        const auto& whenNotified = gradientsWhenNotified[parameter->NodeName()];
+        BOOST_CHECK_EQUAL_COLLECTIONS(whenNotified.begin(), whenNotified.end(), gradient.Data(), gradient.Data() + gradient.GetNumElements());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(GradientAggregationOverlapTests)
+
+BOOST_AUTO_TEST_CASE(BackpropNotifiesGradientsInReverseEvalOrder)
+{
+    CheckGradientReadyNotifications(0);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelBackpropNotifiesGradientsInReverseEvalOrder)
+{
+    CheckGradientReadyNotifications(4);
+}
+
+BOOST_AUTO_TEST_CASE(GradientBucketsGroupConsecutiveGradients)
+{
+    typedef SimpleDistGradAggregator<float> Aggregator;
+    typedef vector<vector<size_t>> Buckets;
+
+    // A bucket is closed once it reaches the bucket size, the last one may be smaller.
+    Buckets expected = { { 0, 1, 2 }, { 3 }, { 4, 5 } };
+    BOOST_CHECK(Aggregator::GroupIntoBuckets({ 100, 100, 200, 500, 10, 20 }, 400) == expected);
+
+    // Gradients larger than the bucket size get a bucket of their own.
+    expected = { { 0 }, { 1 }, { 2 } };
+    BOOST_CHECK(Aggregator::GroupIntoBuckets({ 1000, 1000, 1000 }, 400) == expected);
+
+    // A bucket size of one byte aggregates each gradient separately, a huge one all gradients at once.
+    expected = { { 0 }, { 1 }, { 2 }, { 3 } };
+    BOOST_CHECK(Aggregator::GroupIntoBuckets({ 4, 8, 4, 8 }, 1) == expected);
+    expected = { { 0, 1, 2, 3 } };
+    BOOST_CHECK(Aggregator::GroupIntoBuckets({ 4, 8, 4, 8 }, SIZE_MAX) == expected);
+
+    BOOST_CHECK(Aggregator::GroupIntoBuckets({}, 400).empty());
+}
+
+BOOST_AUTO_TEST_CASE(GradientBucketsCompleteDuringBackprop)
+{
+    // The NCCL communicator of the aggregator is created for the default device.
+    ::CNTK::DeviceDescriptor::TrySetDefaultDevice(::CNTK::DeviceDescriptor::CPUDevice());
+
+    TwoBranchNetwork network;
+    vector<Matrix<float>*> gradients;
+    map<wstring, size_t> gradientIndices;
+    const auto& evalOrder = network.net->GetEvalOrder(network.criterion);
+    for (auto node = evalOrder.rbegin(); node != evalOrder.rend(); node++)
+    {
+        if ((*node)->IsLeaf() && (*node)->NeedsGradient())
+        {
+            gradientIndices[(*node)->NodeName()] = gradients.size();
+            gradients.push_back(&(*node)->As<ComputationNode<float>>()->Gradient());
+        }
+    }
+
+    // one gradient per bucket
+    auto mpi = make_shared<TwoRankMPIWrapper>();
+    SimpleDistGradAggregator<float> aggregator(mpi, false /*useAsyncAggregation*/, CPUDEVICE, 0 /*syncStatsTrace*/, DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, 1 /*bucketSizeInBytes*/);
+    BOOST_REQUIRE(aggregator.OverlapsAggregation());
+
+    shared_ptr<DistGradHeader> header(DistGradHeader::Create(0), [](DistGradHeader* p) { DistGradHeader::Destroy(p); });
+    auto aggregate = [&]
+    {
+        header->Clear();
+        header->numSamples = 5;
+        BOOST_CHECK(aggregator.AggregateGradients(gradients, header.get(), false /*resetState*/));
+    };
+
+    // The buckets are formed by the first aggregation, all its all-reduces run in the final wait.
+    map<wstring, vector<float>> gradientsWhenNotified;
+    network.Backprop(gradientsWhenNotified);
+    aggregate();
+    BOOST_CHECK_EQUAL(mpi->m_numCompletedByTest, 0u);
+    BOOST_CHECK_EQUAL(mpi->m_numCompletedByWait, gradients.size());
+
+    // From now on a bucket is launched as soon as its gradient is ready and completes when it is tested by the
+    // notification of the next gradient; only the last bucket is left for the final wait.
+    mpi->m_numCompletedByWait = 0;
+    ScopedNetworkOperationMode modeGuard(network.net, NetworkOperationMode::training);
+    const auto& inputs = network.net->InputNodes(network.criterion);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>(inputs.begin(), inputs.end()));
+    network.net->ForwardProp(network.criterion);
+    network.net->Backprop(network.criterion, [&](const ComputationNodeBasePtr& node)
+    {
+        const auto& gradient = node->As<ComputationNode<float>>()->Gradient();
+        gradientsWhenNotified[node->NodeName()] = vector<float>(gradient.Data(), gradient.Data() + gradient.GetNumElements());
+        aggregator.OnGradientReady(gradients, gradientIndices[node->NodeName()]);
+    });
+    BOOST_CHECK_EQUAL(mpi->m_numCompletedByTest, gradients.size() - 1);
+    BOOST_CHECK_EQUAL(mpi->m_numCompletedByWait, 0u);
+
+    aggregate();
+    BOOST_CHECK_EQUAL(mpi->m_numCompletedByTest, gradients.size() - 1);
+    BOOST_CHECK_EQUAL(mpi->m_numCompletedByWait, 1u);
+
+    // Each gradient is the sum over both ranks.
+    for (const auto& entry : gradientIndices)
+    {
+        const auto& gradient = *gradients[entry.second];
+        vector<float> expected;
+        for (float value : gradientsWhenNotified[entry.first])
+            expected.push_back(2 * value);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), gradient.Data(), gradient.Data() + gradient.GetNumElements());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,239 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "GradientSparsifier.h"
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Exchanges the messages of workers that run on threads of this process, in place of MPI.
+class LocalMessageExchange
+{
+public:
+    explicit LocalMessageExchange(size_t numWorkers)
+        : m_messages(numWorkers), m_numArrived(0), m_generation(0)
+    {}
+
+    SparseMessageExchange ForWorker(size_t rank)
+    {
+        return [this, rank](const vector<char>& message, vector<char>& messages, vector<size_t>& messageSizes)
+        {
+            unique_lock<mutex> lock(m_mutex);
+            size_t generation = m_generation;
+            m_messages[rank] = message;
+            if (++m_numArrived == m_messages.size())
+            {
+                m_gathered.clear();
+                m_sizes.clear();
+                for (const auto& m : m_messages)
+                {
+                    m_gathered.insert(m_gathered.end(), m.begin(), m.end());
+                    m_sizes.push_back(m.size());
+                }
+                m_numArrived = 0;
+                m_generation++;
+                m_condition.notify_all();
+            }
+            else
+                m_condition.wait(lock, [&] { return m_generation != generation; });
+
+            messages = m_gathered;
+            messageSizes = m_sizes;
+        };
+    }
+
+private:
+    mutex m_mutex;
+    condition_variable m_condition;
+    vector<vector<char>> m_messages;
+    vector<char> m_gathered;
+    vector<size_t> m_sizes;
+    size_t m_numArrived;
+    size_t m_generation;
+};
+
+// Sparsifiers of several workers, each aggregates its gradients on its own thread.
+template <class ElemType>
+class SparsifiedWorkers
+{
+public:
+    SparsifiedWorkers(size_t numWorkers, double topKRatio, double threshold)
+        : m_exchange(numWorkers)
+    {
+        for (size_t rank = 0; rank < numWorkers; rank++)
+            m_sparsifiers.push_back(make_unique<GradientSparsifier<ElemType>>(numWorkers, m_exchange.ForWorker(rank), topKRatio, threshold));
+    }
+
+    // gradients[rank] are the gradients of a worker, they are replaced by the aggregated ones.
+    void Aggregate(vector<vector<vector<ElemType>>>& gradients)
+    {
+        vector<exception_ptr> errors(m_sparsifiers.size());
+        vector<thread> threads;
+        for (size_t rank = 0; rank < m_sparsifiers.size(); rank++)
+        {
+            threads.emplace_back([&, rank]()
+            {
+                try
+                {
+                    vector<typename GradientSparsifier<ElemType>::Gradient> views;
+                    for (auto& gradient : gradients[rank])
+                        views.push_back({ gradient.data(), gradient.size() });
+                    m_sparsifiers[rank]->AggregateInPlace(views);
+                }
+                catch (...)
+                {
+                    errors[rank] = current_exception();
+                }
+            });
+        }
+
+        for (auto& t : threads)
+            t.join();
+        for (auto& error : errors)
+        {
+            if (error)
+                rethrow_exception(error);
+        }
+    }
+
+    const GradientSparsifier<ElemType>& Sparsifier(size_t rank) const { return *m_sparsifiers[rank]; }
+
+private:
+    LocalMessageExchange m_exchange;
+    vector<unique_ptr<GradientSparsifier<ElemType>>> m_sparsifiers;
+};
+
+template <class ElemType>
+void CheckAllWorkers(const vector<vector<vector<ElemType>>>& gradients, const vector<vector<ElemType>>& expected)
+{
+    for (const auto& workerGradients : gradients)
+    {
+        BOOST_REQUIRE_EQUAL(workerGradients.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++)
+            BOOST_CHECK_EQUAL_COLLECTIONS(workerGradients[i].begin(), workerGradients[i].end(), expected[i].begin(), expected[i].end());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(GradientSparsifierTests)
+
+BOOST_AUTO_TEST_CASE(GradientSparsifierTopKSendsLargestValuesAndResiduals)
+{
+    // 2 of the 8 values of each gradient are sent.
+    SparsifiedWorkers<float> workers(2, 0.25, 0);
+    vector<vector<vector<float>>> gradients = {
+        { { 1, -6, 2, 0, 5, 0.5f, 0, 0 } },
+        { { 0, 1, 0, 3, 0, 0, -4, 0.5f } }
+    };
+    workers.Aggregate(gradients);
+    CheckAllWorkers<float>(gradients, { { 0, -6, 0, 3, 5, 0, -4, 0 } });
+
+    // The values not sent are the residuals, they are sent by the next aggregations, largest first.
+    vector<vector<float>> expected[] = {
+        { { 1, 1, 2, 0, 0, 0, 0, 0.5f } },
+        { { 0, 0, 0, 0, 0, 0.5f, 0, 0 } },
+        { { 0, 0, 0, 0, 0, 0, 0, 0 } }
+    };
+    for (const auto& e : expected)
+    {
+        for (auto& workerGradients : gradients)
+            workerGradients[0].assign(8, 0);
+        workers.Aggregate(gradients);
+        CheckAllWorkers(gradients, e);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GradientSparsifierThresholdSendsValuesAboveThreshold)
+{
+    SparsifiedWorkers<float> workers(2, 0, 2);
+    const vector<vector<vector<float>>> minibatchGradients = {
+        { { 2.5f, 1, -3, 0.5f } },
+        { { 0, -2, 1.5f, 1 } }
+    };
+
+    auto gradients = minibatchGradients;
+    workers.Aggregate(gradients);
+    CheckAllWorkers<float>(gradients, { { 2.5f, -2, -3, 0 } });
+
+    // With the residuals, worker 0 sends 2.5, 2, -3 and worker 1 sends -2, 3, 2.
+    gradients = minibatchGradients;
+    workers.Aggregate(gradients);
+    CheckAllWorkers<float>(gradients, { { 2.5f, 0, 0, 2 } });
+}
+
+BOOST_AUTO_TEST_CASE(GradientSparsifierAccumulatesResidualsAcrossSteps)
+{
+    // Worker 0 adds 0.25 per step, it is sent once the residual reaches the threshold.
+    SparsifiedWorkers<float> workers(2, 0, 1);
+    for (size_t step = 1; step <= 8; step++)
+    {
+        vector<vector<vector<float>>> gradients = { { { 0.25f } }, { { 0 } } };
+        workers.Aggregate(gradients);
+        CheckAllWorkers<float>(gradients, { { step % 4 == 0 ? 1.0f : 0.0f } });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GradientSparsifierEncodesSeveralGradients)
+{
+    // With a ratio of 1 all non zero values are sent, so the result is the dense sum.
+    const size_t numWorkers = 3;
+    SparsifiedWorkers<double> workers(numWorkers, 1, 0);
+    vector<vector<vector<double>>> gradients = {
+        { { 1, 0, 2, 0, 3 }, { 0, -1, 0 } },
+        { { 0, 0, 0, 0, 0 }, { 4, 0, 0 } },
+        { { -1, 5, 0, 0, 0.5 }, { 0, 0, 7 } }
+    };
+
+    vector<size_t> numNonZeros;
+    for (const auto& workerGradients : gradients)
+    {
+        size_t count = 0;
+        for (const auto& gradient : workerGradients)
+            count += count_if(gradient.begin(), gradient.end(), [](double v) { return v != 0; });
+        numNonZeros.push_back(count);
+    }
+
+    workers.Aggregate(gradients);
+    CheckAllWorkers<double>(gradients, { { 0, 5, 2, 0, 3.5 }, { 4, -1, 7 } });
+
+    // A message has a count per gradient and an (index, value) pair per value sent.
+    size_t totalBytes = 0;
+    vector<size_t> messageBytes;
+    for (size_t count : numNonZeros)
+    {
+        messageBytes.push_back(2 * sizeof(uint32_t) + count * (sizeof(uint32_t) + sizeof(double)));
+        totalBytes += messageBytes.back();
+    }
+    for (size_t rank = 0; rank < numWorkers; rank++)
+    {
+        BOOST_CHECK_EQUAL(workers.Sparsifier(rank).BytesSent(), messageBytes[rank]);
+        BOOST_CHECK_EQUAL(workers.Sparsifier(rank).BytesReceived(), totalBytes - messageBytes[rank]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GradientSparsifierSingleWorkerKeepsGradients)
+{
+    SparsifiedWorkers<float> workers(1, 0.1, 0);
+    vector<vector<vector<float>>> gradients = { { { 1, 2, 3 } } };
+    workers.Aggregate(gradients);
+    CheckAllWorkers<float>(gradients, { { 1, 2, 3 } });
+}
+
+BOOST_AUTO_TEST_CASE(GradientSparsifierRejectsInvalidConfiguration)
+{
+    BOOST_CHECK_THROW(SparsifiedWorkers<float>(2, 1.5, 0), std::invalid_argument);
+    BOOST_CHECK_THROW(SparsifiedWorkers<float>(2, 0, 0), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,241 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "Sequences.h"
+#include "gammacalculation.h"
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// An HMM set with /sil/, /sp/ (tied to the /sil/ center state) and two 3-state units A and B, 9 senones in total.
+// It is loaded from files, the same way the HTK reader loads the model.
+struct TestHMMSet
+{
+    TestHMMSet()
+    {
+        auto dir = boost::filesystem::unique_path(boost::filesystem::temp_directory_path() / "latticeGammaTests-%%%%-%%%%");
+        boost::filesystem::create_directories(dir);
+
+        ofstream((dir / "statelist").string()) << "sil_s2\nsil_s3\nsil_s4\nA_s2\nA_s3\nA_s4\nB_s2\nB_s3\nB_s4\n";
+        // TRANSPNAME NUMSTATES (ROW_from[to])+, rows from the entry state -1 to the last state, columns up to the exit state
+        ofstream((dir / "transp").string()) << "T3 3 1 0 0 0 0.6 0.4 0 0 0 0.6 0.4 0 0 0 0.6 0.4\n"
+                                            << "T1 1 0.5 0.5 0.6 0.4\n";
+        // HMMNAME TRANSPNAME SENONENAME+
+        ofstream((dir / "cdphonetying").string()) << "sil T3 sil_s2 sil_s3 sil_s4\n"
+                                                  << "sp T1 sil_s3\n"
+                                                  << "A T3 A_s2 A_s3 A_s4\n"
+                                                  << "B T3 B_s2 B_s3 B_s4\n";
+        hset.loadfromfile((dir / "cdphonetying").wstring(), (dir / "statelist").wstring(), (dir / "transp").wstring());
+        boost::filesystem::remove_all(dir);
+    }
+
+    msra::asr::simplesenonehmm hset;
+};
+
+template <class T>
+static void AppendToBuffer(vector<char>& buffer, const T& value)
+{
+    const char* p = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), p, p + sizeof(value));
+}
+
+static void AppendTagToBuffer(vector<char>& buffer, const char* tag, size_t n)
+{
+    buffer.insert(buffer.end(), tag, tag + 4);
+    AppendToBuffer(buffer, (int) n);
+}
+
+// Builds a denominator lattice of numSilFrames1 + numWordFrames + numSilFrames2 frames:
+//   sil, then A B or B A, then sil; or sil, then B A across the word and the final silence.
+// numExtraWordEdges more A B alternatives with different boundaries are added for the word.
+// It is serialized in the V2 format and read back through lattice::ReadFromBuffer(), like the lattices in a chunk.
+static shared_ptr<const msra::dbn::latticepair> MakeLattice(const msra::asr::simplesenonehmm& hset, size_t numSilFrames1, size_t numWordFrames, size_t numSilFrames2,
+                                                            size_t numExtraWordEdges = 0)
+{
+    using msra::lattices::aligninfo;
+    using msra::lattices::edgeinfo;
+    using msra::lattices::nodeinfo;
+
+    const size_t sil = hset.gethmmid("sil"), sp = hset.gethmmid("sp"), A = hset.gethmmid("A"), B = hset.gethmmid("B");
+    const size_t numFrames = numSilFrames1 + numWordFrames + numSilFrames2;
+    const vector<size_t> times = { 0, numSilFrames1, numSilFrames1 + numWordFrames, numFrames };
+
+    struct Edge
+    {
+        size_t S, E;
+        float lmScore;
+        vector<aligninfo> units;
+    };
+    // sorted by (end node, start node), as lattice::forwardbackward() expects
+    vector<Edge> edges = {
+        { 0, 1, -0.5f, { aligninfo(sil, numSilFrames1) } },
+        { 1, 2, -1.0f, { aligninfo(A, numWordFrames / 2), aligninfo(B, numWordFrames - numWordFrames / 2) } },
+        { 1, 2, -1.5f, { aligninfo(B, numWordFrames / 3), aligninfo(A, numWordFrames - numWordFrames / 3) } },
+    };
+    // each unit of the 3-state HMMs takes at least 3 frames
+    for (size_t k = 0; k < numExtraWordEdges; k++)
+    {
+        size_t numAFrames = 3 + k % (numWordFrames - 5);
+        edges.push_back({ 1, 2, -2.0f - 0.1f * k, { aligninfo(A, numAFrames), aligninfo(B, numWordFrames - numAFrames) } });
+    }
+    edges.push_back({ 1, 3, -2.0f, { aligninfo(B, numWordFrames), aligninfo(A, numSilFrames2) } });
+    edges.push_back({ 2, 3, -0.5f, { aligninfo(sil, numSilFrames2) } });
+
+    // each unique alignment is preceded by its LM score (there are no AC scores) and terminated by the 'last' flag
+    vector<edgeinfo> edges2;
+    vector<aligninfo> tokens;
+    for (const auto& edge : edges)
+    {
+        aligninfo lmScore;
+        static_assert(sizeof(lmScore) == sizeof(edge.lmScore), "unexpected size of aligninfo");
+        memcpy(&lmScore, &edge.lmScore, sizeof(lmScore));
+        tokens.push_back(lmScore);
+        edges2.push_back(edgeinfo(edge.S, edge.E, tokens.size()));
+        tokens.insert(tokens.end(), edge.units.begin(), edge.units.end());
+        tokens.back().last = 1;
+    }
+
+    msra::lattices::lattice::header_v1_v2 info;
+    info.numnodes = times.size();
+    info.numedges = edges2.size();
+    info.numframes = numFrames;
+    info.impliedspunitid = sp;
+    info.hasacscores = 0;
+
+    vector<char> buffer;
+    AppendTagToBuffer(buffer, "LAT ", 2);
+    AppendToBuffer(buffer, info);
+    AppendTagToBuffer(buffer, "NODS", times.size());
+    for (auto t : times)
+        AppendToBuffer(buffer, nodeinfo(t));
+    AppendTagToBuffer(buffer, "EDGS", edges2.size());
+    for (const auto& e : edges2)
+        AppendToBuffer(buffer, e);
+    AppendTagToBuffer(buffer, "ALNS", tokens.size());
+    for (const auto& a : tokens)
+        AppendToBuffer(buffer, a);
+    buffer.insert(buffer.end(), { 'E', 'N', 'D', ' ' });
+
+    vector<unsigned int> idmap; // the lattice uses the unit ids of the HMM set
+    for (size_t i = 0; i < hset.hmms.size(); i++)
+        idmap.push_back((unsigned int) i);
+
+    auto pair = make_shared<msra::dbn::latticepair>();
+    pair->second.ReadFromBuffer(buffer.data(), idmap, sp);
+    return pair;
+}
+
+struct GammaResult
+{
+    vector<float> gammas; // column-major, one column of senone posteriors per frame
+    size_t numSenones;
+    float objective;
+};
+
+// Runs GammaCalculation::calgammaformb() on the CPU on the given lattices with the given number of OpenMP threads.
+static GammaResult ComputeGammas(const msra::asr::simplesenonehmm& hset, vector<shared_ptr<const msra::dbn::latticepair>> lattices, int numThreads)
+{
+    size_t numFrames = 0;
+    for (const auto& lattice : lattices)
+        numFrames += lattice->getnumframes();
+    const size_t numSenones = hset.getnumsenone();
+
+    Matrix<float> logLikelihoods(CPUDEVICE);
+    logLikelihoods.Resize(numSenones, numFrames);
+    logLikelihoods.SetUniformRandomValue(-8, 0, 17);
+    vector<size_t> uids(numFrames);
+    for (size_t t = 0; t < numFrames; t++)
+        uids[t] = t % numSenones;
+    vector<size_t> boundaries(numFrames, 0);
+    vector<size_t> extrauttmap;
+
+    Matrix<float> objective(1, 1, CPUDEVICE);
+    Matrix<float> labels(numSenones, numFrames, CPUDEVICE);
+    Matrix<float> gammas(numSenones, numFrames, CPUDEVICE);
+
+    msra::lattices::GammaCalculation<float> gammaCalculation;
+    gammaCalculation.init(hset, CPUDEVICE);
+
+    int maxThreads = omp_get_max_threads();
+    omp_set_num_threads(numThreads);
+    gammaCalculation.calgammaformb(objective, lattices, logLikelihoods, labels, gammas, uids, boundaries, 1, MBLayoutPtr(), extrauttmap, false);
+    omp_set_num_threads(maxThreads);
+
+    GammaResult result;
+    result.gammas.assign(gammas.Data(), gammas.Data() + gammas.GetNumElements());
+    result.numSenones = numSenones;
+    result.objective = objective.Get00Element();
+    return result;
+}
+
+static void CheckBitIdentical(const GammaResult& serial, const GammaResult& parallel)
+{
+    BOOST_REQUIRE_EQUAL(serial.gammas.size(), parallel.gammas.size());
+    BOOST_CHECK(memcmp(serial.gammas.data(), parallel.gammas.data(), serial.gammas.size() * sizeof(float)) == 0);
+    BOOST_CHECK(memcmp(&serial.objective, &parallel.objective, sizeof(float)) == 0);
+
+    // the gammas are state posteriors, so they sum up to 1 in every frame
+    for (size_t i = 0; i < serial.gammas.size(); i += serial.numSenones)
+    {
+        float sum = 0;
+        for (size_t s = 0; s < serial.numSenones; s++)
+            sum += serial.gammas[i + s];
+        BOOST_CHECK_CLOSE(sum, 1.0f, 0.01f);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(LatticeGammaTests)
+
+BOOST_AUTO_TEST_CASE(ParallelUtterancesGiveBitIdenticalGammas)
+{
+    TestHMMSet model;
+    vector<shared_ptr<const msra::dbn::latticepair>> lattices;
+    for (size_t i = 0; i < 5; i++)
+        lattices.push_back(MakeLattice(model.hset, 4 + i, 10 + 2 * i, 5));
+
+    auto serial = ComputeGammas(model.hset, lattices, 1);
+    auto parallel = ComputeGammas(model.hset, lattices, 4);
+    CheckBitIdentical(serial, parallel);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelEdgesGiveBitIdenticalGammas)
+{
+    // with a single lattice the utterance loop is serial and the edges of the lattice are processed concurrently
+    TestHMMSet model;
+    vector<shared_ptr<const msra::dbn::latticepair>> lattices = { MakeLattice(model.hset, 6, 18, 7) };
+
+    auto serial = ComputeGammas(model.hset, lattices, 1);
+    auto parallel = ComputeGammas(model.hset, lattices, 4);
+    CheckBitIdentical(serial, parallel);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelEdgesAlignIntoFreshAlignments)
+{
+    // Every lattice is aligned into a fresh edgealignments object, whose buffer is only allocated on the CPU path
+    // right before the edges are aligned. With many edges, many threads align their first edge at the same time.
+    TestHMMSet model;
+    vector<shared_ptr<const msra::dbn::latticepair>> lattices = { MakeLattice(model.hset, 6, 40, 7, 60) };
+
+    auto serial = ComputeGammas(model.hset, lattices, 1);
+    for (size_t run = 0; run < 20; run++)
+    {
+        auto parallel = ComputeGammas(model.hset, lattices, 8);
+        CheckBitIdentical(serial, parallel);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,180 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNode.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+typedef shared_ptr<Matrix<float>> MatrixPtr;
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolTests)
+
+BOOST_AUTO_TEST_CASE(MatrixPoolReplanForMinibatchSize)
+{
+    MatrixPool pool;
+    pool.Reset();
+
+    // a, c and e are per-sample buffers that scale with the minibatch size, b and d are fixed-size;
+    // p is never released, like the gradient of a parameter
+    MatrixPtr a, b, c, d, e, p;
+    pool.RequestAllocate<float>(c_deviceId, &a, 10, /*mbScale*/ true, false); // step 0
+    pool.RequestAllocate<float>(c_deviceId, &b, 600, false, false);           // step 1
+    pool.RequestRelease<float>(&a);                                           // step 2
+    pool.RequestAllocate<float>(c_deviceId, &c, 10, true, false);             // step 3
+    pool.RequestAllocate<float>(c_deviceId, &p, 5, false, false);             // step 4
+    pool.RequestRelease<float>(&b);                                           // step 5
+    pool.RequestAllocate<float>(c_deviceId, &d, 4, false, false);             // step 6
+    pool.RequestRelease<float>(&d);                                           // step 7
+    pool.RequestRelease<float>(&c);                                           // step 8
+    pool.RequestAllocate<float>(c_deviceId, &e, 2, true, false);              // step 9
+    pool.RequestRelease<float>(&e);                                           // step 10
+    pool.OptimizedMemoryAllocation();
+
+    auto pinned = p;
+
+    MemoryPlanStatistics stats;
+    BOOST_REQUIRE(pool.OptimizedMemoryAllocationForMinibatchSize(100, stats));
+    BOOST_CHECK_EQUAL(stats.numColumns, 100);
+
+    // matrices that are alive at the same time must not share memory, the others are shared as much as possible
+    BOOST_CHECK(a == c);
+    BOOST_CHECK(a != b && b != c && c != p && b != p && d != p && e != p && c != d);
+    BOOST_CHECK(p == pinned);
+
+    // a and c need 1000 elements, b 600, p 5, and d and e fit into b's buffer
+    BOOST_CHECK_EQUAL(stats.plannedBytes, (1000 + 600 + 5) * sizeof(float));
+    BOOST_CHECK_LE(stats.arenaBytes, stats.plannedBytes + 3 * 256);
+
+    // in the arena, requests that are alive at the same time must not overlap
+    vector<MatrixPtr*> all = { &a, &b, &c, &d, &e, &p };
+    vector<MatrixPool::ArenaRequest> requests;
+    for (auto x : all)
+    {
+        auto info = pool.GetMemInfo<float>(x);
+        requests.push_back(MatrixPool::ArenaRequest{ (info->GetSize(100) * sizeof(float) + 255) / 256 * 256, info->allocStep, info->releaseStep, 0 });
+    }
+    BOOST_CHECK_EQUAL(MatrixPool::PlanArenaOffsets(requests), stats.arenaBytes);
+    for (const auto& x : requests)
+    {
+        for (const auto& y : requests)
+        {
+            if (&x == &y || x.allocStep > y.releaseStep || y.allocStep > x.releaseStep)
+                continue;
+            BOOST_CHECK(x.offset + x.bytes <= y.offset || y.offset + y.bytes <= x.offset);
+        }
+    }
+
+    // no re-planning unless the minibatch grows
+    BOOST_CHECK(!pool.OptimizedMemoryAllocationForMinibatchSize(100, stats));
+    BOOST_CHECK(!pool.OptimizedMemoryAllocationForMinibatchSize(50, stats));
+    BOOST_CHECK(pool.OptimizedMemoryAllocationForMinibatchSize(200, stats));
+    BOOST_CHECK_EQUAL(stats.previousBytes, stats.plannedBytes);
+    BOOST_CHECK(p == pinned);
+}
+
+// criterion = SquareError(labels, W2 * Sigmoid(W1 * features + b1) + b2)
+// The gradients of W1x and W2h are aliased with the gradients of the Plus nodes above them.
+struct TwoLayerNetwork
+{
+    TwoLayerNetwork()
+    {
+        const size_t numSamples = 8;
+        net = make_shared<ComputationNetwork>(c_deviceId);
+        ComputationNetworkBuilder<float> builder(*net);
+        features = builder.CreateInputNode(L"features", 4);
+        labels = builder.CreateInputNode(L"labels", 3);
+        W1 = builder.CreateLearnableParameter(L"W1", 5, 4);
+        b1 = builder.CreateLearnableParameter(L"b1", 5, 1);
+        W2 = builder.CreateLearnableParameter(L"W2", 3, 5);
+        b2 = builder.CreateLearnableParameter(L"b2", 3, 1);
+        W1x = builder.Times(W1, features, 1, L"W1x");
+        z1 = builder.Plus(W1x, b1, L"z1");
+        h = builder.Sigmoid(z1, L"h");
+        W2h = builder.Times(W2, h, 1, L"W2h");
+        z = builder.Plus(W2h, b2, L"z");
+        criterion = builder.SquareError(labels, z, L"criterion");
+        net->AddToNodeGroup(L"feature", features);
+        net->AddToNodeGroup(L"label", labels);
+        net->AddToNodeGroup(L"criterion", criterion);
+        net->CompileNetwork();
+        net->InitLearnableParameters(W1, L"uniform", 1.0, 1);
+        net->InitLearnableParameters(b1, L"uniform", 1.0, 2);
+        net->InitLearnableParameters(W2, L"uniform", 1.0, 3);
+        net->InitLearnableParameters(b2, L"uniform", 1.0, 4);
+        net->AllocateAllMatrices({}, {}, criterion);
+
+        net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+        features->Value().Resize(4, numSamples);
+        labels->Value().Resize(3, numSamples);
+        features->Value().SetUniformRandomValue(-1, 1, 5);
+        labels->Value().SetUniformRandomValue(-1, 1, 6);
+        net->StartEvaluateMinibatchLoop(criterion);
+    }
+
+    // Runs forward and backward propagation and returns the criterion followed by the parameter gradients.
+    vector<Matrix<float>> Train()
+    {
+        // the content of the pooled matrices does not survive re-planning, so everything is computed anew
+        ComputationNetwork::BumpEvalTimeStamp({ features, labels });
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+
+        vector<Matrix<float>> results;
+        results.push_back(criterion->As<ComputationNode<float>>()->Value().DeepClone());
+        for (const auto& parameter : { W1, b1, W2, b2 })
+            results.push_back(parameter->Gradient().DeepClone());
+        return results;
+    }
+
+    ComputationNetworkPtr net;
+    shared_ptr<ComputationNode<float>> features, labels, W1, b1, W2, b2, W1x, z1, h, W2h, z;
+    ComputationNodeBasePtr criterion;
+};
+
+BOOST_AUTO_TEST_CASE(MatrixPoolReplanKeepsNetworkResults)
+{
+    TwoLayerNetwork network;
+    BOOST_REQUIRE(network.W1x->GradientPtr() == network.z1->GradientPtr());
+    BOOST_REQUIRE(network.W2h->GradientPtr() == network.z->GradientPtr());
+
+    // first pass with the plan made from the per-sample estimates
+    auto before = network.Train();
+    auto hiddenValue = network.h->ValuePtr();
+    auto parameterGradient = network.W1->GradientPtr();
+
+    // re-plan with the actual minibatch size, which assigns new matrices to the pooled members of the nodes
+    network.net->OptimizeMemorySharingForMinibatch();
+    BOOST_CHECK(network.h->ValuePtr() != hiddenValue);
+    BOOST_CHECK(network.W1->GradientPtr() == parameterGradient);
+
+    // every node still has its buffers, and the aliased gradients still share theirs
+    for (const auto& node : network.net->GetEvalOrder(network.criterion))
+    {
+        BOOST_CHECK(node->ValuePtr() != nullptr);
+        BOOST_CHECK(!node->NeedsGradient() || node->GradientPtr() != nullptr);
+    }
+    BOOST_CHECK(network.W1x->GradientPtr() == network.z1->GradientPtr());
+    BOOST_CHECK(network.W2h->GradientPtr() == network.z->GradientPtr());
+
+    // the second pass gives the same results
+    auto after = network.Train();
+    BOOST_REQUIRE_EQUAL(before.size(), after.size());
+    for (size_t i = 0; i < before.size(); i++)
+        BOOST_CHECK(after[i].IsEqualTo(before[i], 0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
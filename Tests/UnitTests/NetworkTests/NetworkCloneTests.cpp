@@ -0,0 +1,128 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include <exception>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// z = W * features + b
+static ComputationNetworkPtr CreateAffineNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", 3);
+    auto W = builder.CreateLearnableParameter(L"W", 2, 3);
+    auto b = builder.CreateLearnableParameter(L"b", 2, 1);
+    auto z = builder.Plus(builder.Times(W, features), b, L"z");
+    net->AddToNodeGroup(L"output", z);
+    net->CompileNetwork();
+    net->InitLearnableParameters(W, L"uniform", 1.0, 1);
+    net->InitLearnableParameters(b, L"uniform", 1.0, 2);
+    return net;
+}
+
+static void StartEvaluation(const ComputationNetworkPtr& net)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    auto z = net->GetNodeFromName(L"z");
+    net->AllocateAllMatrices({}, { z }, nullptr);
+    net->StartEvaluateMinibatchLoop(z);
+}
+
+// Evaluates z for samples of 3 values each.
+static vector<float> Evaluate(const ComputationNetworkPtr& net, vector<float> samples)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    auto features = net->GetNodeFromName(L"features");
+    auto z = net->GetNodeFromName(L"z");
+    size_t numSamples = samples.size() / 3;
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->As<ComputationNode<float>>()->Value().SetValue(3, numSamples, CPUDEVICE, samples.data());
+    ComputationNetwork::BumpEvalTimeStamp({ features });
+    net->ForwardProp(z);
+
+    const auto& value = z->As<ComputationNode<float>>()->Value();
+    return vector<float>(value.Data(), value.Data() + value.GetNumElements());
+}
+
+BOOST_AUTO_TEST_SUITE(NetworkCloneTests)
+
+BOOST_AUTO_TEST_CASE(CloneSharingModelStateSharesParameterValues)
+{
+    auto net = CreateAffineNetwork();
+    StartEvaluation(net);
+    vector<ComputationNetworkPtr> clones = { net->CloneSharingModelState(), net->CloneSharingModelState() };
+
+    for (const auto& clone : clones)
+    {
+        for (const auto& name : { L"W", L"b" })
+            BOOST_CHECK(clone->GetNodeFromName(name)->ValuePtr() == net->GetNodeFromName(name)->ValuePtr());
+        BOOST_CHECK(clone->GetNodeFromName(L"features") != net->GetNodeFromName(L"features"));
+        BOOST_REQUIRE_EQUAL(clone->OutputNodes().size(), 1u);
+        BOOST_CHECK(clone->OutputNodes()[0] == clone->GetNodeFromName(L"z"));
+        StartEvaluation(clone);
+    }
+    BOOST_CHECK(clones[0]->GetNodeFromName(L"z")->ValuePtr() != clones[1]->GetNodeFromName(L"z")->ValuePtr());
+    BOOST_CHECK(clones[0]->GetNodeFromName(L"z")->ValuePtr() != net->GetNodeFromName(L"z")->ValuePtr());
+
+    // The clones evaluate their own inputs concurrently with the parameters of the network.
+    const size_t numIterations = 20;
+    vector<vector<float>> inputs, expected;
+    for (size_t i = 0; i < clones.size(); i++)
+    {
+        inputs.push_back({ 1.0f + i, -2, 0.5f, 0, 3, -1.0f * i });
+        expected.push_back(Evaluate(net, inputs.back()));
+    }
+
+    vector<exception_ptr> errors(clones.size());
+    vector<vector<float>> outputs(clones.size());
+    vector<thread> threads;
+    for (size_t i = 0; i < clones.size(); i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            try
+            {
+                for (size_t iteration = 0; iteration < numIterations; iteration++)
+                {
+                    outputs[i] = Evaluate(clones[i], inputs[i]);
+                    if (outputs[i] != expected[i])
+                        break;
+                }
+            }
+            catch (...)
+            {
+                errors[i] = current_exception();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    for (size_t i = 0; i < clones.size(); i++)
+    {
+        if (errors[i])
+            rethrow_exception(errors[i]);
+        BOOST_CHECK_EQUAL_COLLECTIONS(outputs[i].begin(), outputs[i].end(), expected[i].begin(), expected[i].end());
+    }
+
+    // The clones keep the parameters alive.
+    auto W = net->GetNodeFromName(L"W")->ValuePtr();
+    net = nullptr;
+    BOOST_CHECK(clones[0]->GetNodeFromName(L"W")->ValuePtr() == W);
+    auto output = Evaluate(clones[1], inputs[1]);
+    BOOST_CHECK_EQUAL_COLLECTIONS(output.begin(), output.end(), expected[1].begin(), expected[1].end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,183 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/NodeProfiler.h"
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <map>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// criterion = SquareError(labels, W * features + b)
+struct ProfiledNetwork
+{
+    ProfiledNetwork()
+    {
+        const size_t numSamples = 4;
+        net = make_shared<ComputationNetwork>(CPUDEVICE);
+        ComputationNetworkBuilder<float> builder(*net);
+        features = builder.CreateInputNode(L"features", 3);
+        labels = builder.CreateInputNode(L"labels", 2);
+        auto W = builder.CreateLearnableParameter(L"W", 2, 3);
+        auto b = builder.CreateLearnableParameter(L"b", 2, 1);
+        auto z = builder.Plus(builder.Times(W, features, 1, L"Wx"), b, L"z");
+        criterion = builder.SquareError(labels, z, L"criterion");
+        net->AddToNodeGroup(L"criterion", criterion);
+        net->CompileNetwork();
+        net->InitLearnableParameters(W, L"uniform", 1.0, 1);
+        net->InitLearnableParameters(b, L"uniform", 1.0, 2);
+        net->AllocateAllMatrices({}, {}, criterion);
+
+        net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+        features->Value().Resize(3, numSamples);
+        labels->Value().Resize(2, numSamples);
+        net->StartEvaluateMinibatchLoop(criterion);
+    }
+
+    // Sets new input data, which starts a new minibatch for the profiler.
+    void SetInputs(unsigned long seed)
+    {
+        features->Value().SetUniformRandomValue(-1, 1, seed);
+        labels->Value().SetUniformRandomValue(-1, 1, seed + 1);
+        ComputationNetwork::BumpEvalTimeStamp({ features, labels });
+    }
+
+    void Train()
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+    }
+
+    ComputationNetworkPtr net;
+    shared_ptr<ComputationNode<float>> features, labels;
+    ComputationNodeBasePtr criterion;
+};
+
+// Profiles the given number of minibatches and returns the profile of each node by name.
+static map<wstring, NodeProfiler::NodeStats> Profile(ProfiledNetwork& network, size_t numMinibatches)
+{
+    NodeProfiler::Reset();
+    Globals::SetNodeProfiling(true);
+    for (size_t i = 0; i < numMinibatches; i++)
+    {
+        network.SetInputs((unsigned long)(2 * i + 1));
+        network.Train();
+    }
+    Globals::SetNodeProfiling(false);
+
+    map<wstring, NodeProfiler::NodeStats> profile;
+    for (const auto& stats : NodeProfiler::GetNodeStats())
+        profile[stats.name] = stats;
+    return profile;
+}
+
+// Reads a Chrome trace written by the profiler; fails if it is not valid JSON.
+static boost::property_tree::ptree ReadTrace(const wstring& path)
+{
+    boost::property_tree::ptree trace;
+    boost::property_tree::read_json(boost::filesystem::path(path).string(), trace);
+    return trace;
+}
+
+BOOST_AUTO_TEST_SUITE(NodeProfilerTests)
+
+BOOST_AUTO_TEST_CASE(NodeProfilerCountsExecutionsPerMinibatch)
+{
+    ProfiledNetwork network;
+    const size_t numMinibatches = 3;
+    auto profile = Profile(network, numMinibatches);
+
+    // Every computed node runs forward and backward once per minibatch. The inputs and parameters are not computed.
+    for (const auto& name : { L"Wx", L"z", L"criterion" })
+    {
+        BOOST_REQUIRE(profile.find(name) != profile.end());
+        const auto& stats = profile[name];
+        BOOST_CHECK_EQUAL(stats.numMinibatches, numMinibatches);
+        BOOST_CHECK_EQUAL(stats.phase[0].count, numMinibatches);
+        BOOST_CHECK_EQUAL(stats.phase[1].count, numMinibatches);
+        BOOST_CHECK(stats.phase[0].flops > 0);
+        BOOST_CHECK(stats.maxPooledBytes > 0 || name == wstring(L"criterion"));
+    }
+    BOOST_CHECK(profile[L"Wx"].operation == L"Times");
+    BOOST_CHECK_EQUAL(profile[L"features"].phase[0].count, 0u);
+
+    // The nodes are sorted by their total time.
+    auto nodes = NodeProfiler::GetNodeStats();
+    for (size_t i = 1; i < nodes.size(); i++)
+        BOOST_CHECK(nodes[i - 1].phase[0].seconds + nodes[i - 1].phase[1].seconds >= nodes[i].phase[0].seconds + nodes[i].phase[1].seconds);
+}
+
+BOOST_AUTO_TEST_CASE(NodeProfilerWritesChromeTrace)
+{
+    ProfiledNetwork network;
+    auto profile = Profile(network, 2);
+
+    auto path = boost::filesystem::unique_path(boost::filesystem::temp_directory_path() / "nodeProfile-%%%%-%%%%.json");
+    NodeProfiler::WriteChromeTrace(path.wstring());
+    auto trace = ReadTrace(path.wstring());
+    boost::filesystem::remove(path);
+
+    // one complete event per recorded execution
+    size_t expectedEvents = 0;
+    for (const auto& entry : profile)
+        expectedEvents += entry.second.phase[0].count + entry.second.phase[1].count;
+    const auto& events = trace.get_child("traceEvents");
+    BOOST_CHECK_EQUAL(events.size(), expectedEvents);
+
+    map<string, size_t> numEvents;
+    for (const auto& entry : events)
+    {
+        const auto& event = entry.second;
+        BOOST_CHECK_EQUAL(event.get<string>("ph"), "X");
+        BOOST_CHECK(event.get<double>("dur") >= 0);
+        BOOST_CHECK(event.get<double>("ts") >= 0);
+        auto category = event.get<string>("cat");
+        BOOST_CHECK(category == "forward" || category == "backward");
+        size_t minibatch = event.get<size_t>("args.minibatch");
+        BOOST_CHECK(minibatch == 1 || minibatch == 2);
+        numEvents[event.get<string>("name")]++;
+    }
+    BOOST_CHECK_EQUAL(numEvents["Wx"], 4u);
+    BOOST_CHECK_EQUAL(numEvents["criterion"], 4u);
+}
+
+BOOST_AUTO_TEST_CASE(NodeProfilerResetStartsCountingMinibatchesAgain)
+{
+    // The inputs of 'second' get older time stamps than the ones 'first' is evaluated with.
+    ProfiledNetwork first, second;
+    second.SetInputs(1);
+    Profile(first, 1);
+
+    NodeProfiler::Reset();
+    Globals::SetNodeProfiling(true);
+    second.Train();
+    Globals::SetNodeProfiling(false);
+
+    auto nodes = NodeProfiler::GetNodeStats();
+    BOOST_REQUIRE(!nodes.empty());
+
+    auto path = boost::filesystem::unique_path(boost::filesystem::temp_directory_path() / "nodeProfile-%%%%-%%%%.json");
+    NodeProfiler::WriteChromeTrace(path.wstring());
+    auto trace = ReadTrace(path.wstring());
+    boost::filesystem::remove(path);
+
+    // After the reset the evaluation of 'second' is the first minibatch, although its inputs are older.
+    const auto& events = trace.get_child("traceEvents");
+    BOOST_REQUIRE(!events.empty());
+    for (const auto& entry : events)
+        BOOST_CHECK_EQUAL(entry.second.get<size_t>("args.minibatch"), 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
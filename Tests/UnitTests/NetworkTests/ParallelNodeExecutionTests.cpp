@@ -0,0 +1,123 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "Globals.h"
+#include <map>
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Criterion value and parameter gradients of a forward and backward pass.
+struct PassResult
+{
+    float criterion;
+    map<wstring, vector<float>> gradients;
+};
+
+// h = Sigmoid(W0 * features + b0) feeds numBranches branches Tanh(Wi * h + bi), which are summed up:
+// criterion = SquareError(labels, Wout * (branch1 + ... + branchN)). The branches are independent of each other,
+// and the gradients from all of them are accumulated into the gradient of h.
+static PassResult RunMultiBranchNetwork(size_t numThreads, bool nodeTiming)
+{
+    const size_t numSamples = 7, numBranches = 4, inputDim = 6, hiddenDim = 8, outputDim = 3;
+
+    auto previousNumThreads = Globals::GetNodeExecutionThreads();
+    auto previousNodeTiming = Globals::ShouldEnableNodeTiming();
+    Globals::SetNodeExecutionThreads(numThreads);
+    Globals::SetNodeTiming(nodeTiming);
+
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto labels = builder.CreateInputNode(L"labels", outputDim);
+    auto W0 = builder.CreateLearnableParameter(L"W0", hiddenDim, inputDim);
+    auto b0 = builder.CreateLearnableParameter(L"b0", hiddenDim, 1);
+    auto h = builder.Sigmoid(builder.Plus(builder.Times(W0, features), b0), L"h");
+
+    shared_ptr<ComputationNode<float>> sum;
+    for (size_t i = 1; i <= numBranches; i++)
+    {
+        auto W = builder.CreateLearnableParameter(L"W" + to_wstring(i), hiddenDim, hiddenDim);
+        auto b = builder.CreateLearnableParameter(L"b" + to_wstring(i), hiddenDim, 1);
+        auto branch = builder.Tanh(builder.Plus(builder.Times(W, h), b));
+        sum = sum ? builder.Plus(sum, branch) : branch;
+    }
+
+    auto Wout = builder.CreateLearnableParameter(L"Wout", outputDim, hiddenDim);
+    ComputationNodeBasePtr criterion = builder.SquareError(labels, builder.Times(Wout, sum), L"criterion");
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+
+    unsigned long seed = 1;
+    for (const auto& parameter : net->LearnableParameterNodes(criterion))
+        net->InitLearnableParameters(parameter, L"uniform", 1.0, seed++);
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+    features->Value().Resize(inputDim, numSamples);
+    features->Value().SetUniformRandomValue(-1, 1, seed++);
+    labels->Value().Resize(outputDim, numSamples);
+    labels->Value().SetUniformRandomValue(-1, 1, seed++);
+    net->StartEvaluateMinibatchLoop(criterion);
+
+    PassResult result;
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        const auto& inputs = net->InputNodes(criterion);
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>(inputs.begin(), inputs.end()));
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+    }
+
+    result.criterion = criterion->As<ComputationNode<float>>()->Value().Get00Element();
+    for (const auto& parameter : net->LearnableParameterNodes(criterion))
+    {
+        const auto& gradient = parameter->As<ComputationNode<float>>()->Gradient();
+        result.gradients[parameter->NodeName()] = vector<float>(gradient.Data(), gradient.Data() + gradient.GetNumElements());
+    }
+
+    Globals::SetNodeExecutionThreads(previousNumThreads);
+    Globals::SetNodeTiming(previousNodeTiming);
+    return result;
+}
+
+BOOST_AUTO_TEST_SUITE(ParallelNodeExecutionTests)
+
+BOOST_AUTO_TEST_CASE(ParallelExecutionMatchesSerialExecution)
+{
+    // Gradients that are accumulated from several branches may be summed up in a different order.
+    const float tolerance = 1e-5f;
+
+    auto serial = RunMultiBranchNetwork(0, false /*nodeTiming*/);
+    BOOST_REQUIRE_EQUAL(serial.gradients.size(), 11u);
+
+    // Node timing is enabled as well, so that the nodes also finish their timing concurrently.
+    for (bool nodeTiming : { false, true })
+    {
+        for (size_t run = 0; run < 5; run++)
+        {
+            auto parallel = RunMultiBranchNetwork(4, nodeTiming);
+            BOOST_CHECK_SMALL(parallel.criterion - serial.criterion, tolerance);
+            BOOST_REQUIRE_EQUAL(parallel.gradients.size(), serial.gradients.size());
+            for (const auto& expected : serial.gradients)
+            {
+                const auto& actual = parallel.gradients[expected.first];
+                BOOST_REQUIRE_EQUAL(actual.size(), expected.second.size());
+                for (size_t i = 0; i < actual.size(); i++)
+                    BOOST_CHECK_SMALL(actual[i] - expected.second[i], tolerance);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,91 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/WorkStealingThreadPool.h"
+#include <atomic>
+#include <stdexcept>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+BOOST_AUTO_TEST_SUITE(WorkStealingThreadPoolTests)
+
+BOOST_AUTO_TEST_CASE(WorkStealingThreadPoolRespectsDependencies)
+{
+    // a layered graph: each task of a layer depends on two tasks of the previous layer
+    const size_t numLayers = 20, width = 16, numTasks = numLayers * width;
+    vector<vector<size_t>> successors(numTasks);
+    vector<size_t> numPredecessors(numTasks, 0);
+    for (size_t layer = 1; layer < numLayers; layer++)
+    {
+        for (size_t j = 0; j < width; j++)
+        {
+            size_t task = layer * width + j;
+            for (size_t predecessor : { (layer - 1) * width + j, (layer - 1) * width + (j + 1) % width })
+            {
+                successors[predecessor].push_back(task);
+                numPredecessors[task]++;
+            }
+        }
+    }
+
+    WorkStealingThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.NumThreads(), 4);
+
+    for (size_t run = 0; run < 10; run++)
+    {
+        vector<atomic<size_t>> finishedAt(numTasks);
+        vector<atomic<size_t>> startedAt(numTasks);
+        atomic<size_t> clock(1);
+        pool.Execute(successors, numPredecessors, [&](size_t task)
+        {
+            startedAt[task] = clock++;
+            finishedAt[task] = clock++;
+        });
+
+        for (size_t task = 0; task < numTasks; task++)
+        {
+            BOOST_REQUIRE(finishedAt[task] != 0);
+            for (size_t successor : successors[task])
+                BOOST_CHECK_LT(finishedAt[task], startedAt[successor]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(WorkStealingThreadPoolPropagatesExceptions)
+{
+    // a chain 0 -> 1 -> 2 -> 3 plus an independent task 4
+    vector<vector<size_t>> successors = { { 1 }, { 2 }, { 3 }, {}, {} };
+    vector<size_t> numPredecessors = { 0, 1, 1, 1, 0 };
+
+    WorkStealingThreadPool pool(3);
+    atomic<size_t> numExecuted(0);
+    auto task = [&](size_t i)
+    {
+        if (i == 1)
+            throw runtime_error("task 1 failed");
+        numExecuted++;
+    };
+    BOOST_CHECK_THROW(pool.Execute(successors, numPredecessors, task), runtime_error);
+    BOOST_CHECK_LE(numExecuted, 2); // tasks 2 and 3 are skipped
+
+    // the pool is usable after a failure
+    numExecuted = 0;
+    pool.Execute(successors, numPredecessors, [&](size_t) { numExecuted++; });
+    BOOST_CHECK_EQUAL(numExecuted, 5);
+
+    // a single thread executes everything on the calling thread
+    WorkStealingThreadPool serial(1);
+    numExecuted = 0;
+    serial.Execute(successors, numPredecessors, [&](size_t) { numExecuted++; });
+    BOOST_CHECK_EQUAL(numExecuted, 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
+#include "FileWrapper.h"
+#include "CBFUtils.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -17,6 +19,40 @@ struct CNTKBinaryReaderFixture : ReaderFixture
         : ReaderFixture("/Data/CNTKBinaryReader/")
     {
     }
+
+    // Converts the text format input of the given config section into the binary format.
+    void ConvertToBinaryFormat(const string& configFileName, const string& sectionName)
+    {
+        std::wstring configFileCommand(L"configFile=" + Microsoft::MSR::CNTK::ToFixedWStringFromMultiByte(configFileName));
+        std::wstring cntk(L"CNTK");
+        std::vector<wchar_t*> arg{ &cntk[0], &configFileCommand[0] };
+
+        ConfigParameters config;
+        const std::string rawConfigString = ConfigParameters::ParseCommandLine((int)arg.size(), &arg[0], config);
+        config.ResolveVariables(rawConfigString);
+        const ConfigParameters sectionConfig = config(sectionName);
+        const ConfigParameters readerConfig = sectionConfig("reader");
+
+        typedef void (*ConvertToBinaryFormatProc)(const ConfigParameters& config);
+        Plugin plugin;
+        ConvertToBinaryFormatProc convert = (ConvertToBinaryFormatProc)plugin.Load(L"CNTKBinaryReader", "ConvertToBinaryFormat");
+        convert(readerConfig);
+    }
+
+    // Checks the magic numbers at the start of a converted file and at its header, returns the number of chunks.
+    uint32_t CheckBinaryFormatHeader(const wstring& filename, uint32_t expectedVersion)
+    {
+        auto file = ::CNTK::FileWrapper::OpenOrDie(filename, L"rb");
+        ::CNTK::CBFUtils::FindMagicOrDie(file);
+        BOOST_CHECK_EQUAL(::CNTK::CBFUtils::GetVersionNumber(file), expectedVersion);
+
+        int64_t headerOffset = ::CNTK::CBFUtils::GetHeaderOffset(file);
+        file.SeekOrDie(headerOffset, SEEK_SET);
+        ::CNTK::CBFUtils::FindMagicOrDie(file);
+        uint32_t numChunks;
+        file.ReadOrDie(numChunks);
+        return numChunks;
+    }
 };
 
 BOOST_FIXTURE_TEST_SUITE(ReaderTestSuite, CNTKBinaryReaderFixture)
@@ -131,6 +167,125 @@ BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse)
         true);
 };
 
+// Chunks are served from a memory mapping of the input file
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense_memory_mapped)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_memory_mapped_Output.txt",
+        "Simple_memoryMapped",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs 
+        1,
+        1,
+        0,
+        1);
+};
+
+// 50 sequences with up to 20 samples each, sparse values and indices are served from the mapped file
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse_memory_mapped)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_sparse_memory_mapped_Output.txt",
+        "50x20_jagged_sequences_sparse_memoryMapped",
+        "reader",
+        564,  // epoch size
+        564,  // mb size 
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true);
+};
+
+// The text format input is converted into the binary format and read back
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense_converted)
+{
+    ConvertToBinaryFormat(testDataPath() + "/Config/CNTKBinaryReader/test.cntk", "Simple_convert");
+    BOOST_CHECK_GT(CheckBinaryFormatHeader(L"Simple_dense_converted.bin", 1), 1u);
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_converted_Output.txt",
+        "Simple_converted",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs 
+        1,
+        1,
+        0,
+        1);
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse_converted)
+{
+    ConvertToBinaryFormat(testDataPath() + "/Config/CNTKBinaryReader/test.cntk", "50x20_jagged_sequences_sparse_convert");
+    BOOST_CHECK_GT(CheckBinaryFormatHeader(L"50x20_jagged_sequences_sparse_converted.bin", 1), 1u);
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_sparse_converted_Output.txt",
+        "50x20_jagged_sequences_sparse_converted",
+        "reader",
+        564,  // epoch size
+        564,  // mb size 
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true);
+};
+
+// The chunks are compressed, the labels are stored in half precision
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_Simple_dense_compressed)
+{
+    ConvertToBinaryFormat(testDataPath() + "/Config/CNTKBinaryReader/test.cntk", "Simple_compressed_convert");
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/Simple_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/Simple_dense_compressed_Output.txt",
+        "Simple_compressed",
+        "reader",
+        1000, // epoch size
+        250,  // mb size
+        10,   // num epochs 
+        1,
+        1,
+        0,
+        1);
+};
+
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse_compressed)
+{
+    ConvertToBinaryFormat(testDataPath() + "/Config/CNTKBinaryReader/test.cntk", "50x20_jagged_sequences_sparse_compressed_convert");
+
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_sparse_compressed_Output.txt",
+        "50x20_jagged_sequences_sparse_compressed",
+        "reader",
+        564,  // epoch size
+        564,  // mb size 
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true);
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
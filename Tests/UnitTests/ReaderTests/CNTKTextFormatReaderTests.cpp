@@ -42,6 +42,12 @@ namespace CNTK {
             m_parser.SetNumRetries(0);
             m_parser.Initialize();
         }
+
+        void SetNumParsingThreads(size_t numThreads)
+        {
+            m_parser.SetNumParsingThreads(numThreads);
+        }
+
         // Retrieves a chunk of data.
         void LoadChunk()
         {
@@ -903,6 +909,73 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_extra_input_should_be_ignored)
     }
 };
 
+// the sequences of a chunk are parsed in parallel, the result must not depend on the number of threads
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_parallel_parsing)
+{
+    vector<StreamDescriptor> streams(2);
+    streams[0].m_alias = "A";
+    streams[0].m_name = L"A";
+    streams[0].m_storageFormat = StorageFormat::Dense;
+    streams[0].m_sampleDimension = 2;
+
+    streams[1].m_alias = "B";
+    streams[1].m_name = L"B";
+    streams[1].m_storageFormat = StorageFormat::SparseCSC;
+    streams[1].m_sampleDimension = 100;
+
+    string filename = "parallel_parsing.txt";
+    const size_t numSequences = 500;
+    {
+        // values in different notations, some of which are parsed by the general (slow) parser
+        vector<string> values{ "1", "-0.25", "3.", "+1e-3", "12345678901234567890123", "6.02E23", "-7.5e+2", "0.1" };
+        std::ofstream file;
+        file.open(filename, std::ofstream::out);
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            for (size_t j = 0; j <= i % 4; ++j)
+            {
+                file << i << " |A " << values[(i + j) % values.size()] << " " << values[(i * 3 + j) % values.size()]
+                     << " |B " << (i + j) % 100 << ":" << values[(i + 2 * j) % values.size()] << "\n";
+            }
+        }
+    }
+
+    auto loadAll = [&](size_t numThreads)
+    {
+        CNTKTextFormatReaderTestRunner<double> testRunner(filename, streams, 0);
+        testRunner.SetNumParsingThreads(numThreads);
+        testRunner.LoadChunk();
+
+        vector<double> result;
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            vector<SequenceDataPtr> data;
+            testRunner.m_chunk->GetSequence(i, data);
+            BOOST_REQUIRE_EQUAL(data.size(), 2);
+            BOOST_REQUIRE_EQUAL(data[0]->m_numberOfSamples, i % 4 + 1);
+            auto dense = reinterpret_cast<const double*>(data[0]->GetDataBuffer());
+            result.insert(result.end(), dense, dense + 2 * data[0]->m_numberOfSamples);
+
+            auto sparse = static_pointer_cast<SparseSequenceData>(data[1]);
+            auto values = reinterpret_cast<const double*>(sparse->GetDataBuffer());
+            result.insert(result.end(), values, values + sparse->m_totalNnzCount);
+            result.insert(result.end(), sparse->m_indices, sparse->m_indices + sparse->m_totalNnzCount);
+        }
+        return result;
+    };
+
+    auto expected = loadAll(1);
+    BOOST_REQUIRE_CLOSE(expected[0], 1, 0.00001);
+    BOOST_REQUIRE_CLOSE(expected[1], 1, 0.00001);
+    for (size_t numThreads : { 2, 4, 7 })
+    {
+        auto actual = loadAll(numThreads);
+        BOOST_REQUIRE(expected == actual);
+    }
+
+    boost::filesystem::remove(filename);
+};
+
 // 100 sequences with N samples for each of 3 inputs, where N is chosen at random
 // from [1, 100] for each sequence
 BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_100x100x3)
@@ -7,6 +7,9 @@
 #include <numeric>
 #include <random>
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "NoRandomizer.h"
 #include "LTNoRandomizer.h"
 #include "DataDeserializer.h"
@@ -14,16 +17,20 @@
 #include "CorpusDescriptor.h"
 #include "FramePacker.h"
 #include "SequencePacker.h"
+#include "TransformController.h"
 #include "TruncatedBpttPacker.h"
 #include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
 #include "BufferedFileReader.h"
+#include "DiskChunkCache.h"
+#include "IndexBuilder.h"
 
 #pragma warning(push)
 // disable warning about possible mod 0 operation in uniform_int_distribution
 #pragma warning(disable:4724)
 #include <boost/random/uniform_int_distribution.hpp>
 #pragma warning(pop)
+#include <boost/filesystem.hpp>
 
 #include "SequentialDeserializer.h"
 
@@ -747,14 +754,14 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithChunks1)
     BlockRandomizerOneEpochWithChunks1Test(true);
 }
 
-void BlockRandomizerOneEpochWithChunks2Test(bool prefetch)
+void BlockRandomizerOneEpochWithChunks2Test(bool prefetch, const PrefetchConfiguration& prefetchConfig = PrefetchConfiguration())
 {
     vector<float> data(20);
     iota(data.begin(), data.end(), 0.0f);
 
     auto mockDeserializer = make_shared<MockDeserializer>(10, 2, data);
 
-    auto randomizer = make_shared<BlockRandomizer>(0, 18, mockDeserializer, prefetch, false);
+    auto randomizer = make_shared<BlockRandomizer>(0, 18, mockDeserializer, prefetch, false, 0, true, 0, prefetchConfig);
 
     EpochConfiguration epochConfiguration;
     epochConfiguration.m_numberOfWorkers = 1;
@@ -784,6 +791,25 @@ void BlockRandomizerOneEpochWithChunks2Test(bool prefetch)
     }
     BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(),
         actual.begin(), actual.end());
+
+    const auto& statistics = randomizer->GetPrefetchStatistics();
+    BOOST_CHECK_GE(statistics.m_chunksLoaded, 10u);
+    BOOST_CHECK_LE(statistics.m_chunksPrefetched, statistics.m_chunksLoaded);
+    BOOST_CHECK_LE(statistics.m_stalls, statistics.m_chunksLoaded);
+
+    // Chunks have two samples, at least one chunk is prefetched regardless of the bound.
+    BOOST_CHECK_LE(statistics.m_maxPrefetchedSamples, 2 * min(prefetchConfig.m_depth, max<size_t>(prefetchConfig.m_maxSamples / 2, 1)));
+    BOOST_CHECK_GE(statistics.m_maxPrefetchedSamples, 2u);
+
+    // The counters are passed up to the reader by name.
+    TransformController controller({}, randomizer);
+    auto namedStatistics = controller.GetStatistics();
+    BOOST_CHECK_EQUAL(namedStatistics.size(), 5u);
+    BOOST_CHECK_EQUAL(namedStatistics[L"chunksLoaded"], (double)statistics.m_chunksLoaded);
+    BOOST_CHECK_EQUAL(namedStatistics[L"chunksPrefetched"], (double)statistics.m_chunksPrefetched);
+    BOOST_CHECK_EQUAL(namedStatistics[L"chunkStalls"], (double)statistics.m_stalls);
+    BOOST_CHECK_EQUAL(namedStatistics[L"chunkStallSeconds"], statistics.m_stallSeconds);
+    BOOST_CHECK_EQUAL(namedStatistics[L"maxPrefetchedSamples"], (double)statistics.m_maxPrefetchedSamples);
 }
 
 BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithChunks2)
@@ -792,6 +818,79 @@ BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithChunks2)
     BlockRandomizerOneEpochWithChunks2Test(true);
 }
 
+BOOST_AUTO_TEST_CASE(BlockRandomizerOneEpochWithChunks2DeepPrefetch)
+{
+    PrefetchConfiguration prefetchConfig;
+    prefetchConfig.m_depth = 4;
+    prefetchConfig.m_numberOfThreads = 2;
+    BlockRandomizerOneEpochWithChunks2Test(false, prefetchConfig);
+    BlockRandomizerOneEpochWithChunks2Test(true, prefetchConfig);
+
+    // Only one chunk of two samples fits into the bound.
+    prefetchConfig.m_maxSamples = 3;
+    BlockRandomizerOneEpochWithChunks2Test(true, prefetchConfig);
+}
+
+// Reads a few epochs of variable sized minibatches and returns the first sample of each sequence.
+vector<float> ReadEpochs(BlockRandomizer& randomizer, size_t epochSize)
+{
+    vector<float> result;
+    for (size_t epoch = 0; epoch < 3; epoch++)
+    {
+        EpochConfiguration epochConfiguration;
+        epochConfiguration.m_numberOfWorkers = 1;
+        epochConfiguration.m_workerRank = 0;
+        epochConfiguration.m_minibatchSizeInSamples = 0;
+        epochConfiguration.m_totalEpochSizeInSamples = epochSize;
+        epochConfiguration.m_epochIndex = epoch;
+        randomizer.StartEpoch(epochConfiguration);
+
+        for (size_t i = 1;; i++)
+        {
+            size_t samplesToGet = 3 * (i % 7 + 1);
+            Sequences sequences = randomizer.GetNextSequences(samplesToGet, samplesToGet);
+            if (!sequences.m_data.empty())
+            {
+                for (const auto& sequence : sequences.m_data.front())
+                    result.push_back(*((float*)sequence->GetDataBuffer()));
+            }
+
+            if (sequences.m_endOfEpoch)
+                break;
+        }
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(BlockRandomizerConcurrentPrefetchMatchesSingleThread)
+{
+    const int sequenceLength = 3;
+    const int numChunks = 50;
+    const int numSequencesPerChunk = 10;
+    const int windowSize = 18;
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 0.0f);
+    size_t epochSize = data.size() * sequenceLength * 2 / 3;
+
+    auto singleThreadDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength);
+    BlockRandomizer singleThread(0, windowSize, singleThreadDeserializer, true, false);
+    auto expected = ReadEpochs(singleThread, epochSize);
+
+    PrefetchConfiguration prefetchConfig;
+    prefetchConfig.m_depth = 4;
+    prefetchConfig.m_numberOfThreads = 3;
+    auto concurrentDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength);
+    BlockRandomizer concurrent(0, windowSize, concurrentDeserializer, true, false, 0, true, 0, prefetchConfig);
+    auto actual = ReadEpochs(concurrent, epochSize);
+
+    BOOST_CHECK_EQUAL(expected.size(), 3 * epochSize / sequenceLength);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+
+    const auto& statistics = concurrent.GetPrefetchStatistics();
+    BOOST_CHECK_GT(statistics.m_chunksPrefetched, 0u);
+    BOOST_CHECK_LE(statistics.m_maxPrefetchedSamples, prefetchConfig.m_depth * numSequencesPerChunk * sequenceLength);
+}
+
 void RandomizerChaosMonkeyTest(SequenceEnumerator& randomizer, size_t sweepSize, int seed)
 {
     std::mt19937 rng(seed);
@@ -854,12 +953,17 @@ BOOST_AUTO_TEST_CASE(RandomizerChaosMonkey)
     auto mockDeserializer = make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength);
     BlockRandomizer blockRandomizerNoPrefetch(0, windowSize, mockDeserializer, false, false);
     BlockRandomizer blockRandomizerWithPrefetch(0, windowSize, mockDeserializer, true, false);
+    PrefetchConfiguration deepPrefetch;
+    deepPrefetch.m_depth = 5;
+    deepPrefetch.m_numberOfThreads = 3;
+    BlockRandomizer blockRandomizerWithDeepPrefetch(0, windowSize, mockDeserializer, true, false, 0, true, 0, deepPrefetch);
     NoRandomizer norandomizer(mockDeserializer);
 
     auto sweepSize = data.size() * sequenceLength;
 
     RandomizerChaosMonkeyTest(blockRandomizerNoPrefetch, sweepSize, 42);
     RandomizerChaosMonkeyTest(blockRandomizerWithPrefetch, sweepSize, 43);
+    RandomizerChaosMonkeyTest(blockRandomizerWithDeepPrefetch, sweepSize, 45);
     RandomizerChaosMonkeyTest(norandomizer, sweepSize, 44);
 }
 
@@ -1305,6 +1409,313 @@ BOOST_AUTO_TEST_CASE(CheckNoDegenerateMinibatches)
     }
 }
 
+// Reads all chunks through the deserializer and checks that sequence i consists of sequenceLength copies of expected[i].
+void CheckChunks(DataDeserializer& deserializer, size_t numSequencesPerChunk, const vector<float>& expected, uint32_t sequenceLength)
+{
+    auto chunkInfos = deserializer.ChunkInfos();
+    for (const auto& chunkInfo : chunkInfos)
+    {
+        auto chunk = deserializer.GetChunk(chunkInfo.m_id);
+        for (size_t i = chunkInfo.m_id * numSequencesPerChunk; i < (chunkInfo.m_id + 1) * numSequencesPerChunk; i++)
+        {
+            vector<SequenceDataPtr> sequences;
+            chunk->GetSequence(i, sequences);
+            BOOST_REQUIRE_EQUAL(sequences.size(), 1);
+            BOOST_REQUIRE_EQUAL(sequences[0]->m_numberOfSamples, sequenceLength);
+            BOOST_CHECK(sequences[0]->GetSampleShape() == NDShape({ 1 }));
+
+            auto data = static_cast<const float*>(sequences[0]->GetDataBuffer());
+            for (size_t j = 0; j < sequenceLength; j++)
+                BOOST_CHECK_EQUAL(data[j], expected[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DiskChunkCacheRoundTrip)
+{
+    const size_t numChunks = 4;
+    const size_t numSequencesPerChunk = 5;
+    const uint32_t sequenceLength = 3;
+    const wstring cacheFilename = L"DiskChunkCacheRoundTrip.chunkcache";
+    _wunlink(cacheFilename.c_str());
+
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 1.0f);
+    vector<float> otherData(data.size(), -1.0f);
+
+    {
+        auto cache = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength), cacheFilename, 42, SIZE_MAX);
+        BOOST_CHECK_EQUAL(cache->NumberOfCachedChunks(), 0);
+        CheckChunks(*cache, numSequencesPerChunk, data, sequenceLength);
+        BOOST_CHECK_EQUAL(cache->NumberOfCachedChunks(), numChunks);
+    }
+
+    {
+        // The chunks are now served from the cache file, not from the (different) underlying data.
+        auto cache = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, otherData, sequenceLength), cacheFilename, 42, SIZE_MAX);
+        BOOST_CHECK_EQUAL(cache->NumberOfCachedChunks(), numChunks);
+        CheckChunks(*cache, numSequencesPerChunk, data, sequenceLength);
+        auto allChunksResident = cache->ResidentBytes();
+
+        // Only the most recently used chunk is kept mapped if the bound is smaller than a chunk.
+        auto boundedCache = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, otherData, sequenceLength), cacheFilename, 42, 1);
+        CheckChunks(*boundedCache, numSequencesPerChunk, data, sequenceLength);
+        BOOST_CHECK_EQUAL(boundedCache->ResidentBytes() * numChunks, allChunksResident);
+    }
+
+    {
+        // A cache with a different key is discarded and rebuilt.
+        auto cache = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, otherData, sequenceLength), cacheFilename, 43, SIZE_MAX);
+        BOOST_CHECK_EQUAL(cache->NumberOfCachedChunks(), 0);
+        CheckChunks(*cache, numSequencesPerChunk, otherData, sequenceLength);
+    }
+
+    _wunlink(cacheFilename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(DiskChunkCacheReadOnlyWaitsForWriter)
+{
+    const size_t numChunks = 4;
+    const size_t numSequencesPerChunk = 5;
+    const uint32_t sequenceLength = 3;
+    const wstring cacheFilename = L"DiskChunkCacheReadOnlyWaitsForWriter.chunkcache";
+    _wunlink(cacheFilename.c_str());
+
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 1.0f);
+    vector<float> otherData(data.size(), -1.0f);
+
+    // A worker other than the main node starts before the cache file exists and reads from its deserializer.
+    auto reader = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, otherData, sequenceLength), cacheFilename, 42, SIZE_MAX, 0, false /*writable*/);
+    BOOST_CHECK_EQUAL(reader->NumberOfCachedChunks(), 0);
+    CheckChunks(*reader, numSequencesPerChunk, otherData, sequenceLength);
+
+    // Once the main node has created the cache, the worker picks up the chunks written so far.
+    auto writer = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength), cacheFilename, 42, SIZE_MAX);
+    CheckChunks(*writer, numSequencesPerChunk, data, sequenceLength);
+    BOOST_CHECK_EQUAL(reader->NumberOfCachedChunks(), numChunks);
+    CheckChunks(*reader, numSequencesPerChunk, data, sequenceLength);
+    writer.reset();
+    reader.reset();
+
+    // A read-only cache that is older than its inputs is not opened.
+    const wstring inputFilename = L"DiskChunkCacheReadOnlyWaitsForWriter.input";
+    {
+        FILE* f = _wfopen(inputFilename.c_str(), L"wb");
+        BOOST_REQUIRE(f != nullptr);
+        fclose(f);
+    }
+    boost::filesystem::last_write_time(inputFilename, boost::filesystem::last_write_time(cacheFilename) + 10);
+    reader = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, otherData, sequenceLength), cacheFilename, 42, SIZE_MAX, 0, false /*writable*/, vector<wstring>{ inputFilename });
+    BOOST_CHECK_EQUAL(reader->NumberOfCachedChunks(), 0);
+    CheckChunks(*reader, numSequencesPerChunk, otherData, sequenceLength);
+    reader.reset();
+
+    _wunlink(inputFilename.c_str());
+    _wunlink(cacheFilename.c_str());
+}
+
+// Passes chunk requests to a deserializer and records how many of them were in flight at the same time.
+// Each request waits (for a bounded time) for another one to overlap with it.
+class ConcurrencyRecordingDeserializer : public DataDeserializer
+{
+public:
+    ConcurrencyRecordingDeserializer(DataDeserializerPtr deserializer)
+        : m_deserializer(deserializer), m_inFlight(0), m_maxInFlight(0)
+    {}
+
+    vector<StreamInformation> StreamInfos() override { return m_deserializer->StreamInfos(); }
+    vector<ChunkInfo> ChunkInfos() override { return m_deserializer->ChunkInfos(); }
+    bool GetSequenceInfo(const SequenceInfo& primary, SequenceInfo& description) override { return m_deserializer->GetSequenceInfo(primary, description); }
+
+    void SequenceInfosForChunk(ChunkIdType chunkId, vector<SequenceInfo>& descriptions) override
+    {
+        m_deserializer->SequenceInfosForChunk(chunkId, descriptions);
+    }
+
+    ChunkPtr GetChunk(ChunkIdType chunkId) override
+    {
+        int inFlight = ++m_inFlight;
+        int max = m_maxInFlight;
+        while (inFlight > max && !m_maxInFlight.compare_exchange_weak(max, inFlight))
+            ;
+
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(2);
+        while (m_maxInFlight < 2 && chrono::steady_clock::now() < deadline)
+            this_thread::yield();
+
+        auto chunk = m_deserializer->GetChunk(chunkId);
+        --m_inFlight;
+        return chunk;
+    }
+
+    int MaxInFlight() const { return m_maxInFlight; }
+
+private:
+    DataDeserializerPtr m_deserializer;
+    atomic<int> m_inFlight;
+    atomic<int> m_maxInFlight;
+};
+
+BOOST_AUTO_TEST_CASE(DiskChunkCacheConcurrentGetChunk)
+{
+    const size_t numChunks = 8;
+    const size_t numSequencesPerChunk = 5;
+    const uint32_t sequenceLength = 3;
+    const size_t numThreads = 4;
+    const wstring cacheFilename = L"DiskChunkCacheConcurrentGetChunk.chunkcache";
+    const wstring serialCacheFilename = L"DiskChunkCacheConcurrentGetChunk.serial.chunkcache";
+    _wunlink(cacheFilename.c_str());
+    _wunlink(serialCacheFilename.c_str());
+
+    vector<float> data(numChunks * numSequencesPerChunk);
+    iota(data.begin(), data.end(), 1.0f);
+    vector<float> otherData(data.size(), -1.0f);
+
+    {
+        auto serialCache = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength), serialCacheFilename, 42, SIZE_MAX);
+        CheckChunks(*serialCache, numSequencesPerChunk, data, sequenceLength);
+    }
+
+    {
+        // All threads request all chunks of a cold, writable cache, each starting at a different chunk.
+        auto deserializer = make_shared<ConcurrencyRecordingDeserializer>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, data, sequenceLength));
+        auto cache = make_shared<DiskChunkCache>(deserializer, cacheFilename, 42, SIZE_MAX);
+
+        vector<vector<ChunkPtr>> chunks(numThreads, vector<ChunkPtr>(numChunks));
+        vector<thread> threads;
+        for (size_t t = 0; t < numThreads; t++)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (size_t i = 0; i < numChunks; i++)
+                {
+                    auto chunkId = (ChunkIdType)((i + 2 * t) % numChunks);
+                    chunks[t][chunkId] = cache->GetChunk(chunkId);
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+
+        // Chunks missing from the cache are deserialized concurrently.
+        BOOST_CHECK_GE(deserializer->MaxInFlight(), 2);
+        BOOST_CHECK_EQUAL(cache->NumberOfCachedChunks(), numChunks);
+
+        for (size_t t = 0; t < numThreads; t++)
+        {
+            for (ChunkIdType chunkId = 0; chunkId < numChunks; chunkId++)
+            {
+                for (size_t i = chunkId * numSequencesPerChunk; i < (chunkId + 1) * numSequencesPerChunk; i++)
+                {
+                    vector<SequenceDataPtr> sequences;
+                    chunks[t][chunkId]->GetSequence(i, sequences);
+                    BOOST_REQUIRE_EQUAL(sequences.size(), 1);
+                    BOOST_REQUIRE_EQUAL(sequences[0]->m_numberOfSamples, sequenceLength);
+                    auto values = static_cast<const float*>(sequences[0]->GetDataBuffer());
+                    for (size_t j = 0; j < sequenceLength; j++)
+                        BOOST_CHECK_EQUAL(values[j], data[i]);
+                }
+            }
+        }
+    }
+
+    // Every chunk is stored exactly once, even if several threads deserialized it.
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(cacheFilename), boost::filesystem::file_size(serialCacheFilename));
+    {
+        auto cache = make_shared<DiskChunkCache>(make_shared<MockDeserializer>(numChunks, numSequencesPerChunk, otherData, sequenceLength), cacheFilename, 42, SIZE_MAX);
+        BOOST_CHECK_EQUAL(cache->NumberOfCachedChunks(), numChunks);
+        CheckChunks(*cache, numSequencesPerChunk, data, sequenceLength);
+    }
+
+    _wunlink(cacheFilename.c_str());
+    _wunlink(serialCacheFilename.c_str());
+}
+
+// Returns (key, number of samples, file offset, size) for all sequences in the index.
+static vector<tuple<size_t, uint32_t, size_t, uint32_t>> GetIndexedSequences(const Index& index)
+{
+    vector<tuple<size_t, uint32_t, size_t, uint32_t>> result;
+    for (const auto& chunk : index.Chunks())
+        for (const auto& sequence : chunk.Sequences())
+            result.push_back(make_tuple(sequence.m_key, sequence.NumberOfSamples(), chunk.StartOffset() + sequence.OffsetInChunk(), sequence.SizeInBytes()));
+    return result;
+}
+
+static void CheckParallelTextIndex(const wstring& filename, bool skipSequenceIds, const string& mainStream)
+{
+    auto buildIndex = [&](size_t numThreads)
+    {
+        TextInputIndexBuilder builder(FileWrapper(filename, L"rbS"));
+        builder.SetSkipSequenceIds(skipSequenceIds).SetMainStream(mainStream);
+        builder.SetChunkSize(256).SetBufferSize(64).SetNumThreads(numThreads).SetMinBytesPerThread(1);
+        return builder.Build();
+    };
+
+    auto expected = buildIndex(1);
+    auto expectedSequences = GetIndexedSequences(*expected);
+    BOOST_REQUIRE(!expectedSequences.empty());
+
+    for (size_t numThreads : { 2, 3, 8, 64 })
+    {
+        auto actual = buildIndex(numThreads);
+        BOOST_CHECK_EQUAL(actual->NumberOfChunks(), expected->NumberOfChunks());
+        BOOST_CHECK_EQUAL(actual->NumberOfSamples(), expected->NumberOfSamples());
+        BOOST_CHECK(GetIndexedSequences(*actual) == expectedSequences);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TextInputIndexBuilderParallel)
+{
+    std::mt19937 rng(7);
+    const string filename = "TextInputIndexBuilderParallel.txt";
+    const wstring wfilename(filename.begin(), filename.end());
+
+    {
+        // Sequences with ids, spanning a random number of lines, some of which do not have
+        // an id or do not contain the main stream. The last line is not terminated.
+        ofstream file(filename, ios::binary);
+        for (size_t i = 0; i < 300; ++i)
+        {
+            size_t id = (i * 7) % 1000;
+            for (size_t j = 0; j <= rng() % 5; ++j)
+            {
+                if (j > 0 && rng() % 4 == 0)
+                    file << "\t|a 1 2";
+                else if (rng() % 5 == 0)
+                    file << id << " |b 3";
+                else
+                    file << id << " |a " << rng() % 100 << " |b 4";
+                file << "\n";
+            }
+        }
+        file << "1000 |a 5";
+    }
+
+    CheckParallelTextIndex(wfilename, false, "");
+    CheckParallelTextIndex(wfilename, false, "a");
+
+    {
+        // One sequence per line, including blank lines and lines without the main stream.
+        ofstream file(filename, ios::binary);
+        for (size_t i = 0; i < 500; ++i)
+        {
+            auto kind = rng() % 6;
+            if (kind == 0)
+                file << "\n";
+            else if (kind == 1)
+                file << "|b 1\n";
+            else
+                file << "|a " << rng() % 1000 << " |b 2\n";
+        }
+    }
+
+    CheckParallelTextIndex(wfilename, true, "");
+    CheckParallelTextIndex(wfilename, true, "a");
+
+    _wunlink(wfilename.c_str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(PackerTests)
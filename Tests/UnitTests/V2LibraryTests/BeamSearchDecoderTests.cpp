@@ -0,0 +1,227 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Common.h"
+
+using namespace CNTK;
+using namespace std;
+
+namespace CNTK { namespace Test {
+
+// A recurrent decoder step: state' = tanh(Wx token + Wh state + context), log-probabilities = LogSoftmax(Wo state').
+// The weights are kept on the CPU for the reference implementation below.
+struct DecoderStepModel
+{
+    size_t vocabularySize, stateDim;
+    vector<float> wx, wh, wo;
+
+    DecoderStepModel(size_t vocabularySize, size_t stateDim, unsigned long seed)
+        : vocabularySize(vocabularySize), stateDim(stateDim)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> distribution(-1.5f, 1.5f);
+        for (auto weights : { &wx, &wh, &wo })
+        {
+            weights->resize(stateDim * (weights == &wh ? stateDim : vocabularySize));
+            for (auto& weight : *weights)
+                weight = distribution(generator);
+        }
+    }
+
+    // Column major, as NDArrayView
+    static vector<float> MatrixVectorProduct(const vector<float>& w, const vector<float>& x)
+    {
+        vector<float> y(w.size() / x.size(), 0);
+        for (size_t j = 0; j < x.size(); j++)
+            for (size_t i = 0; i < y.size(); i++)
+                y[i] += w[i + j * y.size()] * x[j];
+        return y;
+    }
+
+    vector<float> Step(size_t token, const vector<float>& state, const vector<float>& context, vector<double>& logProbabilities) const
+    {
+        vector<float> oneHot(vocabularySize, 0);
+        oneHot[token] = 1;
+        auto x = MatrixVectorProduct(wx, oneHot);
+        auto h = MatrixVectorProduct(wh, state);
+        vector<float> newState(stateDim);
+        for (size_t i = 0; i < stateDim; i++)
+            newState[i] = tanh(x[i] + h[i] + context[i]);
+
+        auto logits = MatrixVectorProduct(wo, newState);
+        double maxLogit = *max_element(logits.begin(), logits.end()), sum = 0;
+        for (auto logit : logits)
+            sum += exp(logit - maxLogit);
+        logProbabilities.resize(vocabularySize);
+        for (size_t i = 0; i < vocabularySize; i++)
+            logProbabilities[i] = logits[i] - maxLogit - log(sum);
+        return newState;
+    }
+
+    FunctionPtr CreateFunction(const Variable& token, const Variable& state, const Variable& context, const DeviceDescriptor& device) const
+    {
+        auto parameter = [&](vector<float> weights, const NDShape& shape)
+        {
+            return Constant(MakeSharedObject<NDArrayView>(shape, weights.data(), weights.size(), DeviceDescriptor::CPUDevice(), true)->DeepClone(device));
+        };
+        auto newState = Tanh(Plus(Plus(Times(parameter(wx, { stateDim, vocabularySize }), token), Times(parameter(wh, { stateDim, stateDim }), state)), context), L"newState");
+        auto logProbabilities = LogSoftmax(Times(parameter(wo, { vocabularySize, stateDim }), newState), L"logProbabilities");
+        return Combine(vector<Variable>{ logProbabilities, newState });
+    }
+};
+
+double ReferenceScore(double logProbability, size_t length, double lengthPenalty)
+{
+    return logProbability / pow((5.0 + length) / 6.0, lengthPenalty);
+}
+
+// All hypotheses that end with the end token or reach the maximum length
+void EnumerateHypotheses(const DecoderStepModel& model, const vector<float>& context, const vector<float>& state, size_t token, vector<size_t>& tokens, double logProbability,
+                         size_t endToken, size_t maxLength, double lengthPenalty, vector<BeamSearchHypothesis>& hypotheses)
+{
+    vector<double> logProbabilities;
+    auto newState = model.Step(token, state, context, logProbabilities);
+    for (size_t next = 0; next < model.vocabularySize; next++)
+    {
+        double nextLogProbability = logProbability + logProbabilities[next];
+        if (next == endToken)
+            hypotheses.push_back({ tokens, nextLogProbability, ReferenceScore(nextLogProbability, tokens.size() + 1, lengthPenalty) });
+        else
+        {
+            tokens.push_back(next);
+            if (tokens.size() == maxLength)
+                hypotheses.push_back({ tokens, nextLogProbability, ReferenceScore(nextLogProbability, tokens.size(), lengthPenalty) });
+            else
+                EnumerateHypotheses(model, context, newState, next, tokens, nextLogProbability, endToken, maxLength, lengthPenalty, hypotheses);
+            tokens.pop_back();
+        }
+    }
+}
+
+void CheckHypotheses(const vector<BeamSearchHypothesis>& actual, const vector<BeamSearchHypothesis>& expected, size_t count)
+{
+    BOOST_REQUIRE(actual.size() >= count && expected.size() >= count);
+    for (size_t i = 0; i < count; i++)
+    {
+        BOOST_CHECK(actual[i].tokens == expected[i].tokens);
+        FloatingPointCompare(actual[i].logProbability, expected[i].logProbability, "Log-probability of a beam search result does not match");
+        FloatingPointCompare(actual[i].score, expected[i].score, "Score of a beam search result does not match");
+    }
+}
+
+void TestBeamSearchDecoder(const DeviceDescriptor& device)
+{
+    const size_t vocabularySize = 4, stateDim = 3, startToken = 0, endToken = 3, numSequences = 2;
+    DecoderStepModel model(vocabularySize, stateDim, 1);
+
+    auto token = InputVariable({ vocabularySize }, DataType::Float, L"token", { Axis::DefaultBatchAxis() });
+    auto state = InputVariable({ stateDim }, DataType::Float, L"state", { Axis::DefaultBatchAxis() });
+    auto context = InputVariable({ stateDim }, DataType::Float, L"context", { Axis::DefaultBatchAxis() });
+    auto step = model.CreateFunction(token, state, context, device);
+    auto logProbabilities = step->Outputs()[0];
+    auto newState = step->Outputs()[1];
+
+    vector<float> contextData = { 0.5f, -1.0f, 0.2f, -0.3f, 0.8f, 0.1f }, initialStateData = { 0.1f, 0.2f, -0.4f, 0.0f, -0.7f, 0.3f };
+    auto contextValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(NDShape({ stateDim, numSequences }), contextData.data(), contextData.size(), DeviceDescriptor::CPUDevice(), true));
+    auto initialStateValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(NDShape({ stateDim, numSequences }), initialStateData.data(), initialStateData.size(), DeviceDescriptor::CPUDevice(), true));
+    auto sequenceData = [&](const vector<float>& data, size_t sequence) { return vector<float>(data.begin() + sequence * stateDim, data.begin() + (sequence + 1) * stateDim); };
+
+    // A beam that holds all candidates of every step gives the result of an exhaustive search.
+    for (double lengthPenalty : { 0.0, 1.0 })
+    {
+        BeamSearchOptions options;
+        options.beamWidth = 36; // (vocabularySize - 1)^2 hypotheses at the last step, with vocabularySize candidates each
+        options.maxLength = 3;
+        options.lengthPenalty = lengthPenalty;
+        auto decoder = CreateBeamSearchDecoder(step, token, logProbabilities, { { newState, state } }, startToken, endToken, options);
+        auto results = decoder->Decode({ { state, initialStateValue } }, { { context, contextValue } }, device);
+        BOOST_REQUIRE(results.size() == numSequences);
+
+        for (size_t sequence = 0; sequence < numSequences; sequence++)
+        {
+            vector<BeamSearchHypothesis> expected;
+            vector<size_t> tokens;
+            EnumerateHypotheses(model, sequenceData(contextData, sequence), sequenceData(initialStateData, sequence), startToken, tokens, 0, endToken, options.maxLength, lengthPenalty, expected);
+            stable_sort(expected.begin(), expected.end(), [](const BeamSearchHypothesis& a, const BeamSearchHypothesis& b) { return a.score > b.score; });
+            CheckHypotheses(results[sequence], expected, 10);
+        }
+    }
+
+    // A beam of width 1 is greedy decoding; the states start at zero without initial states.
+    {
+        BeamSearchOptions options;
+        options.beamWidth = 1;
+        options.maxLength = 8;
+        auto decoder = CreateBeamSearchDecoder(step, token, logProbabilities, { { newState, state } }, startToken, endToken, options);
+        auto results = decoder->Decode({}, { { context, contextValue } }, device);
+
+        for (size_t sequence = 0; sequence < numSequences; sequence++)
+        {
+            vector<float> referenceState(stateDim, 0);
+            vector<double> stepLogProbabilities;
+            BeamSearchHypothesis expected{ {}, 0, 0 };
+            size_t previous = startToken;
+            for (size_t length = 1; length <= options.maxLength; length++)
+            {
+                referenceState = model.Step(previous, referenceState, sequenceData(contextData, sequence), stepLogProbabilities);
+                previous = max_element(stepLogProbabilities.begin(), stepLogProbabilities.end()) - stepLogProbabilities.begin();
+                expected.logProbability += stepLogProbabilities[previous];
+                if (previous == endToken)
+                    break;
+                expected.tokens.push_back(previous);
+            }
+            expected.score = expected.logProbability;
+            CheckHypotheses(results[sequence], { expected }, 1);
+        }
+    }
+
+    // The sequences of a batch are decoded independently of each other, also when they are done after a different number of steps.
+    for (bool earlyStopping : { false, true })
+    {
+        BeamSearchOptions options;
+        options.beamWidth = 3;
+        options.maxLength = 10;
+        options.lengthPenalty = 0.6;
+        options.earlyStopping = earlyStopping;
+        auto decoder = CreateBeamSearchDecoder(step, token, logProbabilities, { { newState, state } }, startToken, endToken, options);
+        auto results = decoder->Decode({ { state, initialStateValue } }, { { context, contextValue } }, device);
+
+        for (size_t sequence = 0; sequence < numSequences; sequence++)
+        {
+            auto sequenceValue = [&](vector<float>& data)
+            {
+                return MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(NDShape({ stateDim, 1 }), data.data() + sequence * stateDim, stateDim, DeviceDescriptor::CPUDevice(), true));
+            };
+            auto single = decoder->Decode({ { state, sequenceValue(initialStateData) } }, { { context, sequenceValue(contextData) } }, device);
+            BOOST_REQUIRE(single.size() == 1);
+            BOOST_CHECK(results[sequence].size() == single[0].size());
+            CheckHypotheses(results[sequence], single[0], single[0].size());
+
+            BOOST_CHECK(results[sequence].size() <= options.beamWidth);
+            for (size_t i = 1; i < results[sequence].size(); i++)
+                BOOST_CHECK(results[sequence][i - 1].score >= results[sequence][i].score);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(BeamSearchDecoderSuite)
+
+BOOST_AUTO_TEST_CASE(BeamSearchDecoderInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestBeamSearchDecoder(DeviceDescriptor::CPUDevice());
+}
+
+BOOST_AUTO_TEST_CASE(BeamSearchDecoderInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestBeamSearchDecoder(DeviceDescriptor::GPUDevice(0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}
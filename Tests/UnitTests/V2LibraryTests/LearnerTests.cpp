@@ -141,6 +141,62 @@ void TestUniversalLearner(size_t numParameters, size_t numMinibatches, const Dev
 
 }
 
+// Dense parameters in CPU memory are updated all at once (see LearnerBase::UpdateFused), except when the gradients
+// are clipped by their norm. With a threshold that is never reached, this gives the results of the update of one
+// parameter at a time. A parameter larger than a chunk of the fused update is included.
+template <typename ElementType>
+void TestFusedUpdate(const function<LearnerPtr(const vector<Parameter>&, AdditionalLearningOptions)>& createLearner)
+{
+    auto device = DeviceDescriptor::CPUDevice();
+    vector<NDShape> shapes = { { 3 }, { 200, 100 }, { 4, 5 }, { 1 } };
+    vector<Parameter> fusedParameters, parameters;
+    for (size_t i = 0; i < shapes.size(); i++)
+    {
+        auto value = NDArrayView::RandomUniform<ElementType>(shapes[i], -1.0, 1.0, i, device);
+        fusedParameters.push_back(Parameter(value->DeepClone(), L"fused_" + to_wstring(i)));
+        parameters.push_back(Parameter(value->DeepClone(), L"parameter_" + to_wstring(i)));
+    }
+
+    AdditionalLearningOptions options;
+    options.l1RegularizationWeight = 0.0001;
+    options.l2RegularizationWeight = 0.001;
+    auto fusedLearner = createLearner(fusedParameters, options);
+    options.gradientClippingThresholdPerSample = 1e30;
+    options.gradientClippingWithTruncation = false;
+    auto learner = createLearner(parameters, options);
+
+    auto update = [&](size_t minibatch)
+    {
+        unordered_map<Parameter, NDArrayViewPtr> fusedGradients, gradients;
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            auto gradient = NDArrayView::RandomUniform<ElementType>(shapes[i], -1.0, 1.0, 10 * minibatch + i, device);
+            fusedGradients[fusedParameters[i]] = gradient->DeepClone();
+            gradients[parameters[i]] = gradient;
+        }
+        fusedLearner->Update(fusedGradients, 5, false);
+        learner->Update(gradients, 5, false);
+
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            auto totalSize = shapes[i].TotalSize();
+            auto fusedData = fusedParameters[i].Value()->DataBuffer<ElementType>();
+            auto data = parameters[i].Value()->DataBuffer<ElementType>();
+            FloatingPointVectorCompare(vector<ElementType>(fusedData, fusedData + totalSize), vector<ElementType>(data, data + totalSize),
+                                       "Fused learner update does not match the update of each parameter");
+        }
+    };
+
+    for (size_t minibatch = 0; minibatch < 3; minibatch++)
+        update(minibatch);
+
+    // The checkpoint of the fused learner has the same format: restored by the other learner, both continue the same way.
+    learner->RestoreFromCheckpoint(fusedLearner->CreateCheckpoint());
+    for (size_t i = 0; i < shapes.size(); i++)
+        parameters[i].Value()->CopyFrom(*fusedParameters[i].Value());
+    update(3);
+}
+
 void TestTrainingParametersSchedule()
 {
     LearningRateSchedule schedule1(0.5, 1);
@@ -477,6 +533,32 @@ BOOST_AUTO_TEST_CASE(CreateAndUpdateAdamaxLearner)
     }
 }
 
+BOOST_AUTO_TEST_CASE(FusedLearnerUpdate)
+{
+    if (!ShouldRunOnCpu())
+        return;
+
+    LearningRateSchedule learningRate = TrainingParameterPerSampleSchedule(0.05);
+    MomentumSchedule momentum = MomentumAsTimeConstantSchedule(10);
+    MomentumSchedule varianceMomentum = MomentumSchedule(0.99, 1);
+    vector<function<LearnerPtr(const vector<Parameter>&, AdditionalLearningOptions)>> createLearners = {
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return SGDLearner(parameters, learningRate, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return MomentumSGDLearner(parameters, learningRate, momentum, true, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return NesterovLearner(parameters, learningRate, momentum, false, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return AdaGradLearner(parameters, learningRate, true, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return FSAdaGradLearner(parameters, learningRate, momentum, true, varianceMomentum, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return AdamLearner(parameters, learningRate, momentum, true, varianceMomentum, 1e-8, false, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return AdamLearner(parameters, learningRate, momentum, true, varianceMomentum, 1e-8, true, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return RMSPropLearner(parameters, learningRate, 0.95, 1.2, 0.7, 10.0, 0.001, true, options); },
+    };
+
+    for (const auto& createLearner : createLearners)
+    {
+        TestFusedUpdate<float>(createLearner);
+        TestFusedUpdate<double>(createLearner);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TestResettingLearningRate)
 {
     NDShape shape = { 1 };
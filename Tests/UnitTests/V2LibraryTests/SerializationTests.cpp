@@ -462,6 +462,53 @@ void TestFunctionSerialization(const DeviceDescriptor& device)
     TestFunctionSaveAndLoad(BuildLSTMClassifierNet(inputVar, 5, device), device);
 }
 
+void TestMappedFunctionSerialization(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 20, numOutputClasses = 5;
+    auto inputVar = InputVariable({ inputDim }, DataType::Float, L"features");
+    auto function = BuildFFClassifierNet(inputVar, numOutputClasses, device);
+    auto file = L"TestMappedFunctionSerialization.out";
+
+    function->Save(file, ModelFormat::CNTKv2Mapped);
+    auto reloadedFunction = Function::Load(file, device, ModelFormat::CNTKv2Mapped);
+    if (!AreEqual(function, reloadedFunction))
+        BOOST_ERROR("TestMappedFunctionSerialization: original and reloaded functions are not identical.");
+
+    auto inputValue = GenerateSequences<float>({ 4, 4 }, { inputDim }, device, false);
+    auto evaluate = [&inputValue, &device](const FunctionPtr& f)
+    {
+        std::unordered_map<Variable, ValuePtr> outputs = { { f->Output(), nullptr } };
+        f->Evaluate({ { f->Arguments()[0], inputValue } }, outputs, device);
+        return outputs.begin()->second->Data();
+    };
+    if (!AreEqual(evaluate(function), evaluate(reloadedFunction)))
+        BOOST_ERROR("TestMappedFunctionSerialization: original and reloaded functions evaluate differently.");
+
+    // Updating the parameters of a loaded model does not modify the model file.
+    for (auto& parameter : reloadedFunction->Parameters())
+        parameter.Value()->SetValue(0.5f);
+    if (!AreEqual(function, Function::Load(file, device, ModelFormat::CNTKv2Mapped)))
+        BOOST_ERROR("TestMappedFunctionSerialization: updating a loaded function modified the model file.");
+
+    // Saving another model to the same file does not modify the loaded one. On Windows the file cannot be replaced
+    // while it is mapped, the save fails and keeps the loaded model.
+    reloadedFunction = Function::Load(file, device, ModelFormat::CNTKv2Mapped);
+    auto otherFunction = BuildFFClassifierNet(inputVar, numOutputClasses, device, /*seed*/ 2);
+#ifdef _WIN32
+    VerifyException([&otherFunction, &file]() { otherFunction->Save(file, ModelFormat::CNTKv2Mapped); }, "Was able to replace a mapped model file.");
+    if (!AreEqual(function, reloadedFunction) || !AreEqual(function, Function::Load(file, device, ModelFormat::CNTKv2Mapped)))
+        BOOST_ERROR("TestMappedFunctionSerialization: failing to overwrite the model file modified it.");
+    reloadedFunction = nullptr;
+    otherFunction->Save(file, ModelFormat::CNTKv2Mapped);
+#else
+    otherFunction->Save(file, ModelFormat::CNTKv2Mapped);
+    if (!AreEqual(function, reloadedFunction))
+        BOOST_ERROR("TestMappedFunctionSerialization: overwriting the model file modified a loaded function.");
+#endif
+    if (!AreEqual(otherFunction, Function::Load(file, device, ModelFormat::CNTKv2Mapped)))
+        BOOST_ERROR("TestMappedFunctionSerialization: original and reloaded functions are not identical.");
+}
+
 TrainerPtr BuildTrainer(const FunctionPtr& function, const Variable& labels,
                      LearningRateSchedule lr = LearningRateSchedule(0.005, 1),
                      MomentumSchedule m = MomentumAsTimeConstantSchedule(0.0))
@@ -1024,6 +1071,11 @@ BOOST_AUTO_TEST_CASE(FunctionSerializationInCPU)
     TestFunctionSerialization(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(MappedFunctionSerializationInCPU)
+{
+    TestMappedFunctionSerialization(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(ModelSerializationDuringTrainingInCPU)
 {
     TestModelSerializationDuringTraining(DeviceDescriptor::CPUDevice());
@@ -1077,6 +1129,14 @@ BOOST_AUTO_TEST_CASE(FunctionSerializationInGPU)
     }
 }
 
+BOOST_AUTO_TEST_CASE(MappedFunctionSerializationInGPU)
+{
+    if (ShouldRunOnGpu())
+    {
+        TestMappedFunctionSerialization(DeviceDescriptor::GPUDevice(0));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ModelSerializationDuringTrainingInGPU)
 {
     if (ShouldRunOnGpu())
@@ -235,6 +235,7 @@ IGNORE_FUNCTION CNTK::Internal::UniversalLearner;
 IGNORE_CLASS CNTK::DistributedLearner;
 IGNORE_FUNCTION CNTK::CreateDataParallelDistributedLearner;
 IGNORE_FUNCTION CNTK::CreateQuantizedDataParallelDistributedLearner;
+IGNORE_FUNCTION CNTK::CreateSparseDataParallelDistributedLearner;
 IGNORE_FUNCTION CNTK::CreateBlockMomentumDistributedLearner;
 IGNORE_STRUCT std::hash<::CNTK::StreamInformation>;
 %ignore operator==(const StreamInformation& left, const StreamInformation& right);
@@ -252,6 +253,10 @@ IGNORE_FUNCTION CNTK::CreateBasicTrainingSession;
 IGNORE_FUNCTION CNTK::CreateTrainingSession;
 IGNORE_FUNCTION CNTK::CreateDataParallelDistributedTrainer;
 IGNORE_FUNCTION CNTK::CreateQuantizedDataParallelDistributedTrainer;
+IGNORE_CLASS CNTK::BeamSearchDecoder;
+IGNORE_FUNCTION CNTK::CreateBeamSearchDecoder;
+IGNORE_STRUCT CNTK::BeamSearchOptions;
+IGNORE_STRUCT CNTK::BeamSearchHypothesis;
 IGNORE_FUNCTION CNTK::SetCheckedMode;
 IGNORE_FUNCTION CNTK::GetCheckedMode;
 IGNORE_STRUCT std::hash<::CNTK::DistributedWorkerDescriptor>;
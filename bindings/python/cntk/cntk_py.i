@@ -158,6 +158,8 @@
 %template() std::vector<std::shared_ptr<CNTK::Trainer>>;
 %template() std::vector<std::shared_ptr<CNTK::Evaluator>>;
 %template() std::vector<std::shared_ptr<CNTK::ProgressWriter>>;
+%template() std::vector<CNTK::BeamSearchHypothesis>;
+%template() std::vector<std::vector<CNTK::BeamSearchHypothesis>>;
 %template() std::pair<double, double>;
 %template() std::pair<size_t, double>;
 %template() std::pair<size_t, size_t>;
@@ -1482,6 +1484,7 @@ std::unordered_map<CNTK::StreamInformation, std::pair<CNTK::NDArrayViewPtr, CNTK
 
 %shared_ptr(CNTK::IDictionarySerializable)
 %shared_ptr(CNTK::Evaluator)
+%shared_ptr(CNTK::BeamSearchDecoder)
 %shared_ptr(CNTK::Trainer)
 %shared_ptr(CNTK::TrainingSession)
 %shared_ptr(CNTK::Function)
@@ -2314,9 +2314,10 @@ def element_select(flag, value_if_true, value_if_false, name=''):
 def optimized_rnnstack(operand, weights, hidden_size, num_layers,
                        bidirectional=False, recurrent_op='lstm', name=''):
     '''
-    An RNN implementation that uses the primitives in cuDNN.
-    If cuDNN is not available it fails. You can use :class:`~cntk.misc.optimized_rnnstack_converter.convert_optimized_rnnstack`
-    to convert a model to GEMM-based implementation when no cuDNN.
+    An RNN implementation that uses the primitives in cuDNN on GPU, and a native
+    implementation with the same weight layout on CPU, so models can be moved between the two.
+    You can still use :class:`~cntk.misc.optimized_rnnstack_converter.convert_optimized_rnnstack`
+    to convert a model to a GEMM-based implementation built from the layers library.
 
     Args:
         operand: input of the optimized RNN stack.
@@ -44,6 +44,12 @@ class ModelFormat(Enum):
     subset of CNTK functionalities.
     '''
 
+    CNTKv2Mapped = cntk_py.ModelFormat_CNTKv2Mapped
+    '''
+    CNTK version 2 format with the parameter values stored as aligned raw blobs; loading it memory-maps
+    the file, so that processes loading the same model share its pages.
+    '''
+
 @unique
 class CloneMethod(Enum):
     '''
@@ -145,6 +145,31 @@ def data_parallel_distributed_learner(learner, distributed_after=0, num_quantiza
             distributed_after,
             use_async_buffered_parameter_update)
 
+@typemap
+def sparse_data_parallel_distributed_learner(learner, top_k_ratio=0.01, threshold=0.0, distributed_after=0):
+    '''
+    Creates a data parallel distributed learner that exchanges only the largest
+    values of each gradient, as (index, value) pairs. The values that are not
+    exchanged are accumulated locally and added to the gradients of the
+    following minibatches.
+
+    Args:
+        learner: a local learner (i.e. sgd)
+        top_k_ratio (float): fraction of the values of each gradient that are
+         exchanged, the ones of largest magnitude; 0 to use ``threshold`` instead
+        threshold (float): magnitude above which gradient values are exchanged
+         when ``top_k_ratio`` is 0
+        distributed_after (int): number of samples after which distributed training starts
+    Returns:
+        a distributed learner instance
+    '''
+    return cntk_py.create_sparse_data_parallel_distributed_learner(
+        cntk_py.mpicommunicator(),
+        learner,
+        distributed_after,
+        top_k_ratio,
+        threshold)
+
 @typemap
 def block_momentum_distributed_learner(learner, block_size, block_momentum_as_time_constant=None, use_nestrov_momentum=True, reset_sgd_momentum_after_aggregation=True, block_learning_rate=1.0, distributed_after=0):
     '''
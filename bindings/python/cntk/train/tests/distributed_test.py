@@ -31,6 +31,12 @@ def create_block_momentum_distributed_learner_with_time_constant(learner, distri
         block_momentum_as_time_constant=4096,
         distributed_after=distributed_after)
 
+def create_sparse_data_parallel_distributed_learner(learner, distributed_after):
+    return distributed.sparse_data_parallel_distributed_learner(
+        learner=learner,
+        top_k_ratio=0.5,
+        distributed_after=distributed_after)
+
 def run_distributed_training(tmpdir, create_func):
 
     in1 = sequence.input_variable(shape=1)
@@ -233,6 +239,9 @@ def test_distributed(tmpdir):
     quantized_aggregation=lambda learner: create_data_parallel_distributed_learner(learner, True, 100)
     run_distributed_training(tmpdir, create_func=quantized_aggregation)
 
+    sparse_aggregation=lambda learner: create_sparse_data_parallel_distributed_learner(learner, 0)
+    run_distributed_training(tmpdir, create_func=sparse_aggregation)
+
     block_momentum=lambda learner: create_block_momentum_distributed_learner(learner, 100)
     run_distributed_training(tmpdir, create_func=block_momentum)
 